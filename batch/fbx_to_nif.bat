@@ -1,11 +1,11 @@
 @echo off
 
-setlocal enabledelayedexpansion
+setlocal
 
-set argCount=0
-for %%x in (%*) do (
-   set /A argCount+=1
-   set "argVec[!argCount!]=%%~x"
-)
+rem one ck-cmd process for all the files, Havok and the FBX SDK start only once
+set "manifest=%TEMP%\ck-cmd-fbx_to_nif-%RANDOM%.txt"
+type nul > "%manifest%"
+for %%x in (%*) do echo importfbx "%%~x" -e .>> "%manifest%"
 
-for /L %%i in (1,1,%argCount%) do "%~dp0ck-cmd.exe" importfbx "!argVec[%%i]!" -e .
\ No newline at end of file
+"%~dp0ck-cmd.exe" batch "%manifest%"
+del "%manifest%"
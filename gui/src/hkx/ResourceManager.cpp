@@ -413,15 +413,15 @@ std::set<Sk::IDLERecord*> ResourceManager::idles(size_t index)
 long long crc_32_ll(std::string& to_crc)
 {
 	transform(to_crc.begin(), to_crc.end(), to_crc.begin(), ::tolower);
-	long long crc = stoll(HkCRC::compute(to_crc), NULL, 16);
-	return crc;
+	auto crc = HkCRC::crc32(to_crc);
+	if (!crc)
+		throw std::invalid_argument("Cannot compute the CRC of " + to_crc);
+	return *crc;
 }
 
 std::string crc_32(std::string& to_crc)
 {
-	transform(to_crc.begin(), to_crc.end(), to_crc.begin(), ::tolower);
-	long long crc = stoll(HkCRC::compute(to_crc), NULL, 16);
-	return to_string(crc);
+	return std::to_string(crc_32_ll(to_crc));
 }
 
 std::array<std::string, 4>  ResourceManager::animationCrc32(const fs::path& path)
@@ -758,8 +758,7 @@ void ResourceManager::saveProject(int project_index)
 			auto entry = _cache.find(get_sanitized_name(project_index));
 			std::shared_ptr<CreatureCacheEntry> creature_entry = dynamic_pointer_cast<CreatureCacheEntry>(entry);
 			bool creature = (creature_entry != nullptr);
-			entry->block.clear();
-			entry->movements.clear();
+			entry->clear();
 			auto& clips_cache = entry->block.getClips();
 			auto& movements_cache = entry->movements.getMovementData();
 
@@ -837,7 +836,7 @@ void ResourceManager::saveProject(int project_index)
 											clip_block.setCacheIndex(movements_cache.size());
 											AnimData::ClipMovementData data(movement_it->second);
 											data.setCacheIndex(movements_cache.size());
-											movements_cache.push_back(data);
+											entry->addMovement(data);
 											movement_serialization_map.push_back(&movement_it->second);
 										}
 										else {
@@ -907,7 +906,7 @@ void ResourceManager::saveProject(int project_index)
 										eventList.append(trigger.second + ":" + AnimData::ClipMovementData::tes_float_cache_to_string(trigger.first));
 									}
 									clip_block.setEvents(eventList);
-									clips_cache.push_back(clip_block);
+									entry->addClip(clip_block);
 								}
 							}
 							
@@ -28,15 +28,16 @@ AnimationInfo Conversion::convertFbxAnimationToHkx(
 		{
 			auto time = std::get<0>(traslation);
 			auto value = std::get<1>(traslation);
-			out.first.translations.insert({ time, {value(0), value(1), value(2)} });
+			out.first.addTranslation(time, value(0), value(1), value(2));
 		}
 
 		for (auto& rotation : outmovement.rotations)
 		{
 			auto time = std::get<0>(rotation);
 			auto value = std::get<1>(rotation);
-			out.first.rotations.insert({ time, {value(0), value(1), value(2), value(3)} });
+			out.first.addRotation(time, value(0), value(1), value(2), value(3));
 		}
+		out.first.sortKeys();
 		out.first.duration = outmovement.duration;
 
 		out.second = out_path;
@@ -59,16 +60,7 @@ bool Conversion::convertHkxAnimationToFBX
 	vector<FbxProperty> floats;
 	vector<FbxNode*> ordered_skeleton = wrangler.importExternalSkeleton(skeleton_file.string(), "", floats);
 
-	RootMovement movement;
-	movement.duration = movements.duration;
-	for (const auto& translation : movements.translations)
-	{
-		movement.translations.push_back({ translation.first, hkVector4(translation.second[0], translation.second[1], translation.second[2]) });
-	}
-	for (const auto& rotation : movements.rotations)
-	{
-		movement.rotations.push_back({ rotation.first, ::hkQuaternion(rotation.second[0], rotation.second[1], rotation.second[2], rotation.second[3])});
-	}
+	RootMovement movement(movements, {});
 
 	wrangler.importAnimationOnSkeleton(source_file.string(), ordered_skeleton, floats, movement);
 
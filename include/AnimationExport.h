@@ -127,7 +127,7 @@ namespace ConvertKF {
 	{
 		AnimationExport(
 			Niflib::NiControllerSequenceRef seq, 
-			hkRefPtr<hkaSkeleton> skeleton, 
+			hkaSkeleton* skeleton, 
 			hkRefPtr<hkaAnimationBinding> binding, 
 			const Niflib::NifInfo& info,
 			const std::set<Niflib::Ref<Niflib::NiNode>>& other_bones_in_accum,
@@ -143,7 +143,8 @@ namespace ConvertKF {
 		//bool SampleAnimation( INode * node, Interval &range, PosRotScale prs, NiKeyframeDataRef data );
 		Niflib::NiControllerSequenceRef seq;
 		hkRefPtr<hkaAnimationBinding> binding;
-		hkRefPtr<hkaSkeleton> skeleton;
+		// only read, not reference counted: clips converted at the same time share it
+		hkaSkeleton* skeleton;
 		static bool noRootSiblings;
 		const Niflib::NifInfo& _info;
 		ckcmd::HKX::RootMovement _root_info;
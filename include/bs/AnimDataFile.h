@@ -3,23 +3,30 @@
 #include "ProjectBlock.h"
 #include "ProjectDataBlock.h"
 #include <map>
+#include <deque>
 
 namespace AnimData {
 	class AnimDataFile {
 
 		StringListBlock projectsList; // = new StringListBlock();
-		std::vector<ProjectBlock> projectBlockList; // = new ArrayList<ProjectBlock>();
+		// deque, cache entries keep references to the blocks while projects are added
+		std::deque<ProjectBlock> projectBlockList; // = new ArrayList<ProjectBlock>();
 		std::map<int, ProjectDataBlock> projectMovementBlockList; // = new HashMap<>();
 
 	public: 
 
-		AnimDataFile() : projectsList(1000) { projectBlockList.reserve(1000); }
+		AnimDataFile() : projectsList(1000) {}
 
-		StringListBlock getProjectList() {
+		// const, projects are added through putProject so the names stay in step with the blocks
+		const StringListBlock& getProjectList() const {
 			return projectsList;
 		}
 
-		std::vector<ProjectBlock> getProjectBlockList() {
+		std::deque<ProjectBlock>& getProjectBlockList() {
+			return projectBlockList;
+		}
+
+		const std::deque<ProjectBlock>& getProjectBlockList() const {
 			return projectBlockList;
 		}
 
@@ -27,21 +34,18 @@ namespace AnimData {
 			return projectBlockList[i];
 		}
 
-		size_t putProject(const string& name, ProjectBlock& projectBlock) {
-			std::vector<std::string>& projects = projectsList.getStrings();
-			projects.push_back(name);
-			projectsList.setStrings(projects);
-			projectBlockList.push_back(projectBlock);
+		// blocks are copied, pass temporaries or std::move them to avoid it
+		size_t putProject(string name, ProjectBlock projectBlock) {
+			projectsList.append(std::move(name));
+			projectBlockList.push_back(std::move(projectBlock));
 			return projectBlockList.size() - 1;
 		}
 
-		size_t putProject(string name, ProjectBlock& projectBlock, ProjectDataBlock& projectDataBlock) {
-			std::vector<std::string>& projects = projectsList.getStrings();
-			projects.push_back(name);
-			projectsList.setStrings(projects);
+		size_t putProject(string name, ProjectBlock projectBlock, ProjectDataBlock projectDataBlock) {
+			projectsList.append(std::move(name));
 			size_t next = projectBlockList.size();
-			projectBlockList.push_back(projectBlock);
-			projectMovementBlockList[next] = projectDataBlock;
+			projectBlockList.push_back(std::move(projectBlock));
+			projectMovementBlockList[(int)next] = std::move(projectDataBlock);
 			return next;
 		}
 
@@ -49,26 +53,31 @@ namespace AnimData {
 			return projectMovementBlockList[i];
 		}
 
-		std::map<int, ProjectDataBlock> getProjectMovementBlockList() {
+		std::map<int, ProjectDataBlock>& getProjectMovementBlockList() {
+			return projectMovementBlockList;
+		}
+
+		const std::map<int, ProjectDataBlock>& getProjectMovementBlockList() const {
 			return projectMovementBlockList;
 		}
 
-		void parse(std::string content) {
+		// content is scanned in place, it can be a mapped file or any loaded buffer
+		void parse(std::string_view content) {
 			scannerpp::Scanner input(content);
 			projectsList.fromASCII(input);
-			int i = 0;
-			for (std::string project : projectsList.getStrings()) {
-				StringListBlock n; // = new StringListBlock();
-				n.fromASCII(input);
+			for (size_t i = 0; i < projectsList.size(); i++) {
+				int lines = input.nextInt();
+				scannerpp::Scanner n = input.slice(lines);
 				ProjectBlock b; // = new ProjectBlock();
-				b.IBlockObject::parseBlock(n.getBlock());
-				projectBlockList.push_back(b);
-				if (b.getHasAnimationCache()) {
+				if (lines > 0)
+					b.parseBlock(n);
+				bool hasAnimationCache = b.getHasAnimationCache();
+				projectBlockList.push_back(std::move(b));
+				if (hasAnimationCache) {
 					ProjectDataBlock n1; // = new ProjectDataBlock();
 					n1.fromASCII(input);
-					projectMovementBlockList[i] = n1;
+					projectMovementBlockList[(int)i] = std::move(n1);
 				}
-				i++;
 			}
 		}
 
@@ -76,7 +85,7 @@ namespace AnimData {
 			try {
 				std::string out = projectsList.toASCII();
 				int i = 0;
-				for (ProjectBlock b : projectBlockList) {
+				for (ProjectBlock& b : projectBlockList) {
 					out += b.toASCII();
 					if (b.getHasAnimationCache()) {
 						out += projectMovementBlockList[i].toASCII();
@@ -2,63 +2,70 @@
 
 #include "ProjectAttackListBlock.h"
 #include "StringListBlock.h"
+#include "NameIndex.h"
+
+#include <deque>
 
 
 namespace AnimData {
 	class AnimSetDataFile {
 
 		StringListBlock projectsList;
-		std::vector<ProjectAttackListBlock> projectAttacks;
+		// deque, cache entries keep references to the blocks while projects are added
+		std::deque<ProjectAttackListBlock> projectAttacks;
+		// set name -> index into projectAttacks
+		name_index_t<int> projectsIndex;
+
+		void indexProject(const string& name, int index) {
+			projectsIndex.emplace(name, index);
+		}
+
 	public:
 
-		AnimSetDataFile() : projectsList(1000) { projectAttacks.reserve(1000); }
+		AnimSetDataFile() : projectsList(1000) {}
 
-		StringListBlock getProjectsList() { return projectsList; }
-		std::vector<ProjectAttackListBlock> getProjectAttackList() { return projectAttacks; }
+		// const, projects are added through putProjectAttackBlock so the index follows
+		const StringListBlock& getProjectsList() const { return projectsList; }
+		std::deque<ProjectAttackListBlock>& getProjectAttackList() { return projectAttacks; }
+		const std::deque<ProjectAttackListBlock>& getProjectAttackList() const { return projectAttacks; }
 
 		ProjectAttackListBlock& getProjectAttackBlock(int i) {
 			return projectAttacks[i];
 		}
 
 		int getProjectAttackBlock(const string& name) {
-			string nameLower{ name };
-			std::transform(nameLower.begin(), nameLower.end(), nameLower.begin(), ::tolower);
-
-			const std::vector<std::string>& projects = projectsList.getStrings();
-			for (size_t i = 0; i < projects.size(); i++)
-			{
-				string projLower{ projects[i] };
-				std::transform(projLower.begin(), projLower.end(), projLower.begin(), ::tolower);
-
-				if (projLower == nameLower)
-					return i;
-			}
+			auto it = projectsIndex.find(name);
+			if (it != projectsIndex.end())
+				return it->second;
 			return -1;
 		}
 
-		size_t putProjectAttackBlock(const string& name, const ProjectAttackListBlock& block)
+		size_t putProjectAttackBlock(const string& name, ProjectAttackListBlock block)
 		{
-			std::vector<std::string>& projects = projectsList.getStrings();
-			projects.push_back(name);
-			projectsList.setStrings(projects);
-			projectAttacks.push_back(block);
+			projectsList.append(name);
+			projectAttacks.push_back(std::move(block));
+			indexProject(name, (int)projectAttacks.size() - 1);
 			return projectAttacks.size() - 1;
 		}
 
-		void parse(std::string content) {
+		// content is scanned in place, it can be a mapped file or any loaded buffer
+		void parse(std::string_view content) {
 			scannerpp::Scanner input(content);
 			projectsList.fromASCII(input);
+			const std::vector<std::string>& projects = projectsList.getStrings();
+			for (size_t i = 0; i < projects.size(); i++)
+				indexProject(projects[i], (int)i);
 			while (input.hasNextLine()) {
 				ProjectAttackListBlock pa;
 				pa.parseBlock(input);
-				projectAttacks.push_back(pa);
+				projectAttacks.push_back(std::move(pa));
 			}
 		}
 
 		std::string toString() {
 			try {
 				std::string out = projectsList.toASCII();
-				for (ProjectAttackListBlock b : projectAttacks)
+				for (ProjectAttackListBlock& b : projectAttacks)
 					out += b.getBlock();
 				return out;
 			}
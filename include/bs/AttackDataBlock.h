@@ -22,7 +22,11 @@ namespace AnimData {
 			this->mirrored = unk1;
 		}
 
-		StringListBlock getClips() {
+		StringListBlock& getClips() {
+			return clips;
+		}
+
+		const StringListBlock& getClips() const {
 			return clips;
 		}
 
@@ -36,7 +40,7 @@ namespace AnimData {
 		}
 
 		void setClips(StringListBlock clips) {
-			this->clips = clips;
+			this->clips = std::move(clips);
 		}
 
 		void addClip(const std::string& clip) {
@@ -19,7 +19,11 @@ namespace AnimData {
 			this->blocks = blocks;
 		}
 
-		std::vector<AttackDataBlock> getAttackData() {
+		std::vector<AttackDataBlock>& getAttackData() {
+			return attackData;
+		}
+
+		const std::vector<AttackDataBlock>& getAttackData() const {
 			return attackData;
 		}
 
@@ -74,7 +78,7 @@ namespace AnimData {
 
 		void setAttackData(std::vector<AttackDataBlock> attackData) {
 			this->blocks = attackData.size();
-			this->attackData = attackData;
+			this->attackData = std::move(attackData);
 		}
 
 		void parseBlock(scannerpp::Scanner& input) override {
@@ -83,7 +87,7 @@ namespace AnimData {
 				ad.eventName = input.nextLine();
 				ad.mirrored = input.nextInt();
 				ad.clips.fromASCII(input);
-				attackData.push_back(ad);
+				attackData.push_back(std::move(ad));
 			}
 		}
 
@@ -27,26 +27,31 @@ namespace AnimData {
 
 
 		void setStrings(std::vector<std::string> strings) {
-			this->strings = strings;
+			this->strings = std::move(strings);
 		}
 
 		std::vector<std::string>& getStrings() {
 			return strings;
 		}
 
+		const std::vector<std::string>& getStrings() const {
+			return strings;
+		}
+
 
 		std::string getBlock() override {
 			std::string out = "";
 			if (strings.size() == 0) return "";
-			for (std::string s : strings) {
-				out += s + "\n";
+			for (const std::string& s : strings) {
+				out += s;
+				out += '\n';
 			}
 			return out;
 		}
 
 		void parseBlock(scannerpp::Scanner& input) {
 			while (input.hasNextLine()) {
-				strings.push_back(input.nextLine());
+				strings.emplace_back(input.nextLineView());
 			}
 		}
 
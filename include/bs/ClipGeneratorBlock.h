@@ -49,16 +49,20 @@ namespace AnimData {
 			return cropEndTime;
 		}
 
-		void setCropEndTime(std::string unknown2) {
+		void setCropEndTime(std::string cropEndTime) {
 			this->cropEndTime = cropEndTime;
 		}
 
-		StringListBlock getEvents() {
+		StringListBlock& getEvents() {
+			return events;
+		}
+
+		const StringListBlock& getEvents() const {
 			return events;
 		}
 
 		void setEvents(StringListBlock events) {
-			this->events = events;
+			this->events = std::move(events);
 		}
 
 		std::string getBlock() override {
@@ -3,6 +3,22 @@
 #include "RootMovement.h"
 #include "StringListBlock.h"
 
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string_view>
+
+//floating point from_chars and to_chars came with Visual Studio 2019 16.4,
+//older toolsets parse and format through the C library
+#if defined(_MSC_VER) && _MSC_VER < 1924
+#define ANIMDATA_FLOAT_CHARCONV 0
+#else
+#define ANIMDATA_FLOAT_CHARCONV 1
+#endif
+
 namespace AnimData {
 
 	class ClipMovementData : public BlockObject {
@@ -12,57 +28,165 @@ namespace AnimData {
 		StringListBlock traslations;
 		StringListBlock rotations;
 
-		void addTranslation(root_movement_t& data, const std::string& line) {
-			float time, x, y, z;
-			sscanf(line.c_str(), "%f %f %f %f\n", &time, &x, &y, &z);
-			data.translations.insert({ time, { x, y, z } });
+		// parsed on first access, the text blocks stay the serialized form. Readers of
+		// a shared cache may ask at once, the first parse is taken under parse_mutex
+		std::atomic<bool> parsed{ false };
+		root_movement_t movement;
+
+		static std::mutex& parse_mutex() {
+			static std::mutex mutex;
+			return mutex;
 		}
 
-		void addRotation(root_movement_t& data, const std::string& line) {
-			float time, x, y, z, w;
-			sscanf(line.c_str(), "%f %f %f %f %f\n", &time, &x, &y, &z, &w);
-			data.rotations.insert({ time, { x, y, z, w} });
+		// reads up to count blank separated floats, returns how many were read
+		static size_t parseFloats(std::string_view line, float* values, size_t count) {
+			const char* first = line.data();
+			const char* last = first + line.size();
+			size_t read = 0;
+			while (read < count) {
+				while (first < last && (*first == ' ' || *first == '\t' || *first == '\r' || *first == '\n'))
+					first++;
+				//from_chars does not take the sign sscanf accepted
+				if (first < last && *first == '+')
+					first++;
+#if ANIMDATA_FLOAT_CHARCONV
+				auto result = std::from_chars(first, last, values[read]);
+				if (result.ec != std::errc())
+					break;
+				first = result.ptr;
+#else
+				//the line is not null terminated, strtof reads a copy of the number
+				char number[64];
+				size_t length = std::min<size_t>(last - first, sizeof(number) - 1);
+				std::copy(first, first + length, number);
+				number[length] = '\0';
+				char* end;
+				values[read] = strtof(number, &end);
+				if (end == number)
+					break;
+				first += end - number;
+#endif
+				read++;
+			}
+			return read;
+		}
+
+		void parseMovement() {
+			movement = root_movement_t();
+			parseFloats(duration, &movement.duration, 1);
+
+			float values[root_movement_t::rotation_stride];
+			movement.translations.reserve(traslations.size() * root_movement_t::translation_stride);
+			for (size_t s = 0; s < traslations.size(); s++)
+			{
+				if (parseFloats(traslations[s], values, root_movement_t::translation_stride) == root_movement_t::translation_stride)
+					movement.addTranslation(values[0], values[1], values[2], values[3]);
+			}
+			movement.rotations.reserve(rotations.size() * root_movement_t::rotation_stride);
+			for (size_t s = 0; s < rotations.size(); s++)
+			{
+				if (parseFloats(rotations[s], values, root_movement_t::rotation_stride) == root_movement_t::rotation_stride)
+					movement.addRotation(values[0], values[1], values[2], values[3], values[4]);
+			}
+			movement.sortKeys();
+			parsed.store(true, std::memory_order_release);
+		}
+
+		static std::string formatKey(const float* key, size_t count) {
+			char line[320];
+			char* end = line;
+			for (size_t i = 0; i < count; i++)
+			{
+				if (i > 0)
+					*end++ = ' ';
+				end = tes_float_cache_to_chars(end, line + sizeof(line), key[i]);
+			}
+			return std::string(line, end);
 		}
 
 	public: 
 
 		ClipMovementData() {}
 
-		ClipMovementData(root_movement_t data)
+		// copies and moves take the text blocks, the movement is parsed again on demand
+		ClipMovementData(const ClipMovementData& other) :
+			BlockObject(other),
+			cacheIndex(other.cacheIndex),
+			duration(other.duration),
+			traslations(other.traslations),
+			rotations(other.rotations)
 		{
-			duration = std::to_string(data.duration);
-			for (const auto& translation : data.translations)
+		}
+
+		ClipMovementData(ClipMovementData&& other) noexcept :
+			BlockObject(std::move(other)),
+			cacheIndex(other.cacheIndex),
+			duration(std::move(other.duration)),
+			traslations(std::move(other.traslations)),
+			rotations(std::move(other.rotations))
+		{
+			other.parsed.store(false, std::memory_order_relaxed);
+		}
+
+		ClipMovementData& operator=(const ClipMovementData& other) {
+			if (this != &other)
 			{
-				char temp[260] = { 0 };
-				sprintf(temp, "%s %s %s %s", 
-					tes_float_cache_to_string(translation.first).c_str(),
-					tes_float_cache_to_string(translation.second[0]).c_str(),
-					tes_float_cache_to_string(translation.second[1]).c_str(),
-					tes_float_cache_to_string(translation.second[2]).c_str()
-				);
-				traslations.append(temp);
+				cacheIndex = other.cacheIndex;
+				duration = other.duration;
+				traslations = other.traslations;
+				rotations = other.rotations;
+				parsed.store(false, std::memory_order_relaxed);
 			}
-			for (const auto& rotation : data.rotations)
+			return *this;
+		}
+
+		ClipMovementData& operator=(ClipMovementData&& other) noexcept {
+			if (this != &other)
 			{
-				char temp[260] = { 0 };
-				sprintf(temp, "%s %s %s %s %s", 
-					tes_float_cache_to_string(rotation.first).c_str(), 
-					tes_float_cache_to_string(rotation.second[0]).c_str(),
-					tes_float_cache_to_string(rotation.second[1]).c_str(),
-					tes_float_cache_to_string(rotation.second[2]).c_str(),
-					tes_float_cache_to_string(rotation.second[3]).c_str()
-				);
-				rotations.append(temp);
+				cacheIndex = other.cacheIndex;
+				duration = std::move(other.duration);
+				traslations = std::move(other.traslations);
+				rotations = std::move(other.rotations);
+				parsed.store(false, std::memory_order_relaxed);
+				other.parsed.store(false, std::memory_order_relaxed);
 			}
+			return *this;
+		}
+
+		ClipMovementData(const root_movement_t& data)
+		{
+			duration = std::to_string(data.duration);
+			traslations.reserve(data.translationCount());
+			for (size_t i = 0; i < data.translationCount(); i++)
+				traslations.append(formatKey(data.translation(i), root_movement_t::translation_stride));
+			rotations.reserve(data.rotationCount());
+			for (size_t i = 0; i < data.rotationCount(); i++)
+				rotations.append(formatKey(data.rotation(i), root_movement_t::rotation_stride));
+		}
+
+		// std::to_string formatting without the trailing zeros, nor the point if nothing is left after it.
+		// Writes at most 48 characters
+		static char* tes_float_cache_to_chars(char* first, char* last, float t)
+		{
+#if ANIMDATA_FLOAT_CHARCONV
+			char* end = std::to_chars(first, last, (double)t, std::chars_format::fixed, 6).ptr;
+#else
+			int written = snprintf(first, last - first, "%.6f", (double)t);
+			char* end = first + std::max(0, std::min(written, (int)(last - first) - 1));
+#endif
+			if (std::find(first, end, '.') == end)
+				return end;
+			while (end[-1] == '0')
+				end--;
+			if (end[-1] == '.')
+				end--;
+			return end;
 		}
 
 		static std::string tes_float_cache_to_string(const float& t)
 		{
-			std::string str{ std::to_string(t) };
-			int offset{ 1 };
-			if (str.find_last_not_of('0') == str.find('.')) { offset = 0; }
-			str.erase(str.find_last_not_of('0') + offset, std::string::npos);
-			return str;
+			char buffer[64];
+			return std::string(buffer, tes_float_cache_to_chars(buffer, buffer + sizeof(buffer), t));
 		}
 
 
@@ -71,6 +195,7 @@ namespace AnimData {
 			duration = input.nextLine();
 			traslations.fromASCII(input);
 			rotations.fromASCII(input);
+			parsed.store(false, std::memory_order_relaxed);
 		}
 
 		std::string getBlock() override {
@@ -95,37 +220,38 @@ namespace AnimData {
 
 		void setDuration(std::string duration) {
 			this->duration = duration;
+			parsed.store(false, std::memory_order_relaxed);
 		}
 
-		StringListBlock getTraslations() {
+		// const, edits go through the setters so the parsed movement is refreshed
+		const StringListBlock& getTraslations() const {
 			return traslations;
 		}
 
 		void setTraslations(StringListBlock traslations) {
-			this->traslations = traslations;
+			this->traslations = std::move(traslations);
+			parsed.store(false, std::memory_order_relaxed);
 		}
 
-		StringListBlock getRotations() {
+		const StringListBlock& getRotations() const {
 			return rotations;
 		}
 
 		void setRotations(StringListBlock rotations) {
-			this->rotations = rotations;
+			this->rotations = std::move(rotations);
+			parsed.store(false, std::memory_order_relaxed);
 		}
 
-		root_movement_t getMovement()
+		// safe from several threads at once, not alongside parseBlock or a setter
+		const root_movement_t& getMovement()
 		{
-			root_movement_t out;
-			out.duration = std::stof(duration);
-			for (size_t s = 0; s < traslations.size(); s++)
+			if (!parsed.load(std::memory_order_acquire))
 			{
-				addTranslation(out, traslations[s]);
+				std::lock_guard<std::mutex> lock(parse_mutex());
+				if (!parsed.load(std::memory_order_relaxed))
+					parseMovement();
 			}
-			for (size_t s = 0; s < rotations.size(); s++)
-			{
-				addRotation(out, rotations[s]);
-			}
-			return out;
+			return movement;
 		}
 	};
 }
@@ -37,10 +37,7 @@ namespace AnimData {
 
 		virtual void fromASCII(scannerpp::Scanner& input) {
 			int numASCIIlines = input.nextInt();
-			std::string blockContent = "";
-			for (int i = 0; i < numASCIIlines*linesPerBlock; i++) {
-				blockContent += input.nextLine() + "\n";
-			}
+			scannerpp::Scanner blockContent = input.slice(numASCIIlines*linesPerBlock);
 			if (numASCIIlines > 0) {
 				try {
 					parseBlock(blockContent);
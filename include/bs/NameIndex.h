@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <cctype>
+
+namespace AnimData {
+
+	// case insensitive hashing for project, set and clip names.
+	// Bethesda tools are not consistent about casing so every name lookup
+	// into the caches goes through these instead of lowercased copies
+	struct iname_hash {
+		size_t operator()(std::string_view name) const {
+			//FNV-1a over the lowercased bytes
+			size_t hash = sizeof(size_t) == 8 ? (size_t)14695981039346656037ULL : (size_t)2166136261U;
+			const size_t prime = sizeof(size_t) == 8 ? (size_t)1099511628211ULL : (size_t)16777619U;
+			for (unsigned char c : name) {
+				hash ^= (size_t)::tolower(c);
+				hash *= prime;
+			}
+			return hash;
+		}
+	};
+
+	struct iname_equal {
+		bool operator()(std::string_view a, std::string_view b) const {
+			if (a.size() != b.size())
+				return false;
+			for (size_t i = 0; i < a.size(); i++)
+				if (::tolower((unsigned char)a[i]) != ::tolower((unsigned char)b[i]))
+					return false;
+			return true;
+		}
+	};
+
+	template<typename T>
+	using name_index_t = std::unordered_map<std::string, T, iname_hash, iname_equal>;
+}
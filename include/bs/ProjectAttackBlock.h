@@ -16,7 +16,19 @@ namespace AnimData {
 		ClipAttacksBlock attackData;
 		ClipFilesCRC32Block crc32Data;
 	public:
-		StringListBlock getSwapEventsList() const {
+		const std::string& getAnimVersion() const {
+			return animVersion;
+		}
+
+		void setAnimVersion(std::string animVersion) {
+			this->animVersion = std::move(animVersion);
+		}
+
+		StringListBlock& getSwapEventsList() {
+			return swapEventsList;
+		}
+
+		const StringListBlock& getSwapEventsList() const {
 			return swapEventsList;
 		}
 
@@ -48,7 +60,11 @@ namespace AnimData {
 			this->handVariableData = handVariableData;
 		}
 
-		ClipAttacksBlock getAttackData() const {
+		ClipAttacksBlock& getAttackData() {
+			return attackData;
+		}
+
+		const ClipAttacksBlock& getAttackData() const {
 			return attackData;
 		}
 
@@ -13,11 +13,14 @@ namespace AnimData {
 			projectFiles.clear();
 			projectAttackBlocks.clear();
 		}
-		StringListBlock getProjectFiles() {
+		StringListBlock& getProjectFiles() {
+			return projectFiles;
+		}
+		const StringListBlock& getProjectFiles() const {
 			return projectFiles;
 		}
 		void setProjectFiles(StringListBlock projectFiles) {
-			this->projectFiles = projectFiles;
+			this->projectFiles = std::move(projectFiles);
 		}
 		void addProjectFile(const std::string& projectFile) {
 			this->projectFiles.append(projectFile);
@@ -28,17 +31,17 @@ namespace AnimData {
 		std::vector<ProjectAttackBlock>& getProjectAttackBlocks() {
 			return projectAttackBlocks;
 		}
-		void setProjectAttackBlocks(const std::vector<ProjectAttackBlock>& projectAttackBlocks) {
-			this->projectAttackBlocks = projectAttackBlocks;
+		const std::vector<ProjectAttackBlock>& getProjectAttackBlocks() const {
+			return projectAttackBlocks;
+		}
+		void setProjectAttackBlocks(std::vector<ProjectAttackBlock> projectAttackBlocks) {
+			this->projectAttackBlocks = std::move(projectAttackBlocks);
 		}
 
-		void putProjectAttack(const string& project_file, ProjectAttackBlock& project_attack)
+		void putProjectAttack(const string& project_file, ProjectAttackBlock project_attack)
 		{
-			//vector<string>& projects = projectFiles.getStrings();
-			//projects.push_back(project_file);
-			projectAttackBlocks.push_back(project_attack);
+			projectAttackBlocks.push_back(std::move(project_attack));
 			projectFiles.append(project_file);
-			//projectFiles.setStrings(projects);
 		}
 
 		void removeProjectAttack(int index)
@@ -156,16 +159,17 @@ namespace AnimData {
 
 		void parseBlock(scannerpp::Scanner& input) override {
 			projectFiles.fromASCII(input);
-			for (std::string p : projectFiles.getStrings()) {
+			projectAttackBlocks.reserve(projectFiles.size());
+			for (size_t i = 0; i < projectFiles.size(); i++) {
 				ProjectAttackBlock pb;
 				pb.parseBlock(input);
-				projectAttackBlocks.push_back(pb);
+				projectAttackBlocks.push_back(std::move(pb));
 			}
 		}
 
 		std::string getBlock() override {
 			std::string out = projectFiles.toASCII();
-			for (ProjectAttackBlock p : projectAttackBlocks) {
+			for (ProjectAttackBlock& p : projectAttackBlocks) {
 				out += p.getBlock();
 			}
 			return out;
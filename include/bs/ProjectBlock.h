@@ -10,6 +10,8 @@ namespace AnimData {
 		StringListBlock projectFiles;
 		bool hasAnimationCache = false;
 		std::list<ClipGeneratorBlock> clips;
+		// bumped whenever the clips may have been edited, indexes over them compare it
+		size_t clipsRevision = 0;
 
 	public:
 
@@ -18,22 +20,39 @@ namespace AnimData {
 			projectFiles.clear();
 			hasAnimationCache = false;
 			clips.clear();
+			clipsRevision++;
 		}
 
 		bool getHasAnimationCache() {
 			return hasAnimationCache;
 		}
 
-		StringListBlock getProjectFiles() {
+		StringListBlock& getProjectFiles() {
 			return projectFiles;
 		}
 
+		const StringListBlock& getProjectFiles() const {
+			return projectFiles;
+		}
+
+		// counts as an edit: take the list again for every change, not a reference kept
+		// across lookups
 		std::list<ClipGeneratorBlock>& getClips() {
+			clipsRevision++;
+			return clips;
+		}
+
+		const std::list<ClipGeneratorBlock>& getClips() const {
 			return clips;
 		}
 
+		size_t getClipsRevision() const {
+			return clipsRevision;
+		}
+
 		void setClips(std::list<ClipGeneratorBlock> clips) {
-			this->clips = clips;
+			this->clips = std::move(clips);
+			clipsRevision++;
 		}
 
 		bool isHasProjectFiles() {
@@ -53,7 +72,7 @@ namespace AnimData {
 		}
 
 		void setProjectFiles(StringListBlock projectFiles) {
-			this->projectFiles = projectFiles;
+			this->projectFiles = std::move(projectFiles);
 		}
 
 		std::string getBlock() override {
@@ -62,7 +81,7 @@ namespace AnimData {
 			out += projectFiles.toASCII();
 			out += (hasAnimationCache ? "1" : "0") + std::string("\n");
 			if (hasAnimationCache) {
-				for (ClipGeneratorBlock clip : clips)
+				for (ClipGeneratorBlock& clip : clips)
 					out += clip.getBlock();
 			}
 			return out;
@@ -73,11 +92,12 @@ namespace AnimData {
 			if (hasProjectFiles)
 				projectFiles.fromASCII(input);
 			hasAnimationCache = input.nextInt() == 1;// input.nextLine();
+			clipsRevision++;
 			if (hasAnimationCache) {
 				while (input.hasNextLine()) {
 					ClipGeneratorBlock b; // = new ClipGeneratorBlock();
 					b.parseBlock(input);
-					clips.push_back(b);
+					clips.push_back(std::move(b));
 					input.nextLine();
 				}
 			}
@@ -6,32 +6,52 @@ namespace AnimData {
 	class ProjectDataBlock : public Block {
 
 		std::vector<ClipMovementData> movementData; // = new ArrayList<>();
+		// bumped whenever the movements may have been edited, indexes over them compare it
+		size_t movementRevision = 0;
 
 	public: 
+		// counts as an edit, as ProjectBlock::getClips
 		std::vector<ClipMovementData>& getMovementData() {
+			movementRevision++;
 			return movementData;
 		}
 
+		const std::vector<ClipMovementData>& getMovementData() const {
+			return movementData;
+		}
+
+		// one movement, to read or edit in place without counting as an edit of the list
+		ClipMovementData& getMovementAt(size_t index) {
+			return movementData[index];
+		}
+
+		size_t getMovementRevision() const {
+			return movementRevision;
+		}
+
 		void setMovementData(std::vector<ClipMovementData> movementData) {
-			this->movementData = movementData;
+			this->movementData = std::move(movementData);
+			movementRevision++;
 		}
 
 		void clear() {
 			movementData.clear();
+			movementRevision++;
 		}
 
 		void parseBlock(scannerpp::Scanner& input) override {
+			movementRevision++;
 			while (input.hasNextLine()) {
 				ClipMovementData b;
 				b.parseBlock(input);
-				movementData.push_back(b);
+				movementData.push_back(std::move(b));
 				input.nextLine();
 			}
 		}
 
 		std::string getBlock() override {
 			std::string out = "";
-			for (ClipMovementData data : movementData)
+			for (ClipMovementData& data : movementData)
 				out += data.getBlock();
 			return out;
 		}
@@ -1,13 +1,66 @@
 #pragma once
 
-#include <map>
-#include <array>
+#include <algorithm>
+#include <numeric>
+#include <vector>
 
 namespace AnimData {
 
+	// Root motion of a clip, keys packed in contiguous arrays sorted by time:
+	// translations as time x y z, rotations as time x y z w
 	struct root_movement_t {
-		float duration;
-		std::map<float, std::array<float, 3>> translations;
-		std::map<float, std::array<float, 4>> rotations;
+		static const size_t translation_stride = 4;
+		static const size_t rotation_stride = 5;
+
+		float duration = 0.f;
+		std::vector<float> translations;
+		std::vector<float> rotations;
+
+		size_t translationCount() const { return translations.size() / translation_stride; }
+		size_t rotationCount() const { return rotations.size() / rotation_stride; }
+
+		const float* translation(size_t index) const { return &translations[index * translation_stride]; }
+		const float* rotation(size_t index) const { return &rotations[index * rotation_stride]; }
+
+		void addTranslation(float time, float x, float y, float z) {
+			translations.insert(translations.end(), { time, x, y, z });
+		}
+
+		void addRotation(float time, float x, float y, float z, float w) {
+			rotations.insert(rotations.end(), { time, x, y, z, w });
+		}
+
+		// Keys are kept in insertion order; this restores time order and drops
+		// repeated times, keeping the first one
+		void sortKeys() {
+			sortKeys(translations, translation_stride);
+			sortKeys(rotations, rotation_stride);
+		}
+
+	private:
+
+		static void sortKeys(std::vector<float>& keys, size_t stride) {
+			size_t count = keys.size() / stride;
+			bool sorted = true;
+			for (size_t i = 1; i < count && sorted; i++)
+				sorted = keys[(i - 1) * stride] < keys[i * stride];
+			if (sorted)
+				return;
+
+			std::vector<size_t> order(count);
+			std::iota(order.begin(), order.end(), 0);
+			std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+				return keys[a * stride] < keys[b * stride];
+			});
+			std::vector<float> out;
+			out.reserve(keys.size());
+			for (size_t i = 0; i < count; i++) {
+				const float* key = &keys[order[i] * stride];
+				if (!out.empty() && out[out.size() - stride] == key[0])
+					continue;
+				out.insert(out.end(), key, key + stride);
+			}
+			keys.swap(out);
+		}
 	};
-}
\ No newline at end of file
+}
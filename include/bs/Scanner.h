@@ -24,43 +24,117 @@
 #include<iostream>
 #include<istream>
 #include<string>
+#include<string_view>
 #include<sstream>
 #include<algorithm>
 
 #include<vector>
 #include<map>
 
+#include <limits.h>
 #include <stdlib.h>
 
 namespace scannerpp
 {
 	using namespace std;
 
+	// Non-owning line cursor. The scanned buffer must outlive the scanner:
+	// nothing is copied until a line is returned as a std::string.
 	class Scanner
 	{
 	private:
-		istringstream input;
+		string_view input;
+		size_t pos = 0;
+		// lines requested past the end of the buffer by slice(), returned as empty lines
+		size_t padding = 0;
+		bool failed = false;
+
+		static bool isSpace(char c) {
+			return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+		}
+
+		size_t lineEnd() const {
+			size_t end = input.find('\n', pos);
+			return end == string_view::npos ? input.size() : end;
+		}
 
 	public:
 
-		Scanner(const string& input) : input(input) {}
+		Scanner(string_view input) : input(input) {}
+		Scanner(const char* input) : input(input) {}
+		Scanner(string&& input) = delete;
 
 		virtual ~Scanner() {}
 
 		int nextInt() {
-			int i;
-			input >> i;
+			// same semantics as istream >> int: leading whitespace (newlines included) is skipped
+			long long i = 0;
+			if (!failed) {
+				while (true) {
+					while (pos < input.size() && isSpace(input[pos])) pos++;
+					if (pos < input.size() || padding == 0) break;
+					padding = 0;
+				}
+				bool negative = false;
+				if (pos < input.size() && (input[pos] == '-' || input[pos] == '+'))
+					negative = input[pos++] == '-';
+				size_t digits = pos;
+				while (pos < input.size() && input[pos] >= '0' && input[pos] <= '9') {
+					if (i <= INT_MAX) i = i * 10 + (input[pos] - '0');
+					pos++;
+				}
+				if (pos == digits) {
+					failed = true;
+					i = 0;
+				}
+				else {
+					if (negative) i = -i;
+					if (i > INT_MAX) { failed = true; i = INT_MAX; }
+					if (i < INT_MIN) { failed = true; i = INT_MIN; }
+				}
+			}
 			nextLine();
-			return i;
+			return (int)i;
 		}
-		bool hasNextLine() { return !input.eof() && !input.fail() && !(EOF == input.peek()); }
-		string nextLine() {
-			string line;
-			getline(input, line);
+		bool hasNextLine() { return !failed && (pos < input.size() || padding > 0); }
+		string_view nextLineView() {
+			if (failed) return {};
+			if (pos >= input.size()) {
+				if (padding > 0)
+					padding--;
+				else
+					failed = true;
+				return {};
+			}
+			size_t end = lineEnd();
+			string_view line = input.substr(pos, end - pos);
+			pos = end < input.size() ? end + 1 : end;
 			if (!line.empty() && *line.rbegin() == '\r')
-				line.erase(line.size() - 1); //remove \r
+				line.remove_suffix(1); //remove \r
 			return line;
 		}
+		string nextLine() {
+			return string(nextLineView());
+		}
+		// Returns a scanner over the next lines of this one and moves past them
+		Scanner slice(int lines) {
+			Scanner out(string_view{});
+			if (failed || lines <= 0) return out;
+			size_t begin = pos;
+			size_t count = 0;
+			while (count < (size_t)lines && pos < input.size()) {
+				size_t end = lineEnd();
+				pos = end < input.size() ? end + 1 : end;
+				count++;
+			}
+			out.input = input.substr(begin, pos - begin);
+			out.padding = (size_t)lines - count;
+			size_t padded = std::min(padding, out.padding);
+			padding -= padded;
+			// reading past the end leaves the stream failed, as getline would
+			if (out.padding > padded) failed = true;
+			return out;
+		}
 	};
 }
 #endif /*SCANNERPP_H_*/
@@ -19,8 +19,8 @@ namespace AnimData {
 		{
 		}
 
-		void append(const std::string& file) {
-			strings.push_back(file);
+		void append(std::string file) {
+			strings.push_back(std::move(file));
 		}
 
 		void remove(int index) {
@@ -28,14 +28,23 @@ namespace AnimData {
 		}
 
 		void setStrings(std::vector<std::string> strings) {
-			this->strings = strings;
+			this->strings = std::move(strings);
 		}
 
-		virtual std::vector<std::string> getStrings() {
+		std::vector<std::string>& getStrings() {
 			return strings;
 		}
 
-		virtual size_t size() {
+		const std::vector<std::string>& getStrings() const {
+			return strings;
+		}
+
+		std::vector<std::string>::iterator begin() { return strings.begin(); }
+		std::vector<std::string>::iterator end() { return strings.end(); }
+		std::vector<std::string>::const_iterator begin() const { return strings.begin(); }
+		std::vector<std::string>::const_iterator end() const { return strings.end(); }
+
+		virtual size_t size() const {
 			return strings.size();
 		}
 
@@ -51,22 +60,35 @@ namespace AnimData {
 			return strings[index];
 		}
 
+		const std::string& operator[](int index) const {
+			return strings[index];
+		}
+
 		void clear() {
 			strings.clear();
 		}
 
 		virtual std::string getBlock() {
+			return static_cast<const StringListBlock&>(*this).getBlock();
+		}
+
+		std::string getBlock() const {
 			std::string out = "";
 			if (strings.size() == 0) return out;
-			for (std::string s : strings) {
-				out += s + "\n";
+			size_t length = 0;
+			for (const std::string& s : strings)
+				length += s.size() + 1;
+			out.reserve(length);
+			for (const std::string& s : strings) {
+				out += s;
+				out += '\n';
 			}
 			return out;
 		}
 
 		virtual void parseBlock(scannerpp::Scanner& input) {
 			while (input.hasNextLine()) {
-				strings.push_back(input.nextLine());
+				strings.emplace_back(input.nextLineView());
 			}
 		}
 	};
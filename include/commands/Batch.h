@@ -0,0 +1,25 @@
+#ifndef BATCH_H
+#define BATCH_H
+#include "stdafx.h"
+
+// Command Base
+#include <commands/CommandBase.h>
+
+class Batch : public Command<Batch>
+{
+	REGISTER_COMMAND_HEADER(Batch)
+
+private:
+	Batch() = default;
+	virtual ~Batch() = default;
+
+public:
+	virtual string GetName() const;
+	virtual string GetHelp() const;
+	virtual string GetHelpShort() const;
+
+protected:
+	virtual bool InternalRunCommand(map<string, docopt::value> parsedArgs);
+};
+
+#endif //BATCH_H
@@ -0,0 +1,25 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+#include "stdafx.h"
+
+// Command Base
+#include <commands/CommandBase.h>
+
+class Benchmark : public Command<Benchmark>
+{
+	REGISTER_COMMAND_HEADER(Benchmark)
+
+private:
+	Benchmark() = default;
+	virtual ~Benchmark() = default;
+
+public:
+	virtual string GetName() const;
+	virtual string GetHelp() const;
+	virtual string GetHelpShort() const;
+
+protected:
+	virtual bool InternalRunCommand(map<string, docopt::value> parsedArgs);
+};
+
+#endif //BENCHMARK_H
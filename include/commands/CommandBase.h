@@ -106,6 +106,9 @@ public:
     virtual string GetHelpShort() const = 0;
 
     bool RunCommand(int argc, char** argv);
+    // args[0] is the command name. Unlike RunCommand, wrong arguments and --help throw
+    // instead of printing the usage and exiting, so one process can run many commands
+    bool RunJob(const vector<string>& args);
 
 protected:
     virtual bool InternalRunCommand(map<string, docopt::value> parsedArgs) = 0;
@@ -301,6 +301,24 @@ namespace Geometry {
 	void CalculateNormals(const vector<Vector3>& vertices, const vector<Triangle>& faces,
 		vector<Vector3>& normals, Vector3& COM, bool sphericalNormals = false, bool calculateCOM = false);
 
+	//how much each face touching a vertex counts in its normal
+	enum NormalWeighting {
+		NORMALS_UNIFORM,
+		NORMALS_AREA,
+		NORMALS_ANGLE
+	};
+
+	//Per vertex normals of a mesh given as flat x, y, z arrays. Face normals are computed
+	//four at a time over chunks of faces, then every vertex sums its faces in face order:
+	//the result is the same whatever the threads (0 means one per core, or the calling
+	//thread alone when it is a pool worker)
+	void AccumulateNormals(const float* x, const float* y, const float* z, size_t vertex_count,
+		const Triangle* faces, size_t face_count, NormalWeighting weighting,
+		float* nx, float* ny, float* nz, size_t threads = 0);
+
+	void CalculateNormals(const vector<Vector3>& vertices, const vector<Triangle>& faces,
+		vector<Vector3>& normals, NormalWeighting weighting, size_t threads = 0);
+
 	vector<Triangle> triangulate(vector<unsigned short> strip);
 	vector<Triangle> triangulate(vector<vector<unsigned short>> strips);
 
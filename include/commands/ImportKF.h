@@ -63,7 +63,8 @@ public:
         , hkPackFormat pkFormat, const hkPackfileWriter::Options& packFileOptions
         , hkSerializeUtil::SaveOptionBits flags
         , ckcmd::HKX::RootMovement& root_info
-        , bool norelativepath = false);
+        , bool norelativepath = false
+        , size_t threads = 0);
 
 protected:
     virtual bool InternalRunCommand(map<string, docopt::value> parsedArgs);
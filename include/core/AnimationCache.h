@@ -5,12 +5,17 @@
 #include <core/hkfutils.h>
 #include <core/log.h>
 #include <core/bsa.h>
+#include <core/hkcrc.h>
 #include <bs/AnimDataFile.h>
 #include <bs/AnimSetDataFile.h>
+#include <bs/NameIndex.h>
 
 #include <set>
+#include <unordered_map>
 #include <filesystem>
 #include <memory>
+#include <mutex>
+#include <utility>
 #include <algorithm>
 
 #if _MSC_VER < 1920
@@ -19,20 +24,82 @@ namespace fs = std::experimental::filesystem;
 namespace fs = std::filesystem;
 #endif
 
-/**
-* Created by Bet on 10.03.2016.
-*/
-class HkCRC {
-	//int crc_order = 32;
-	//std::string crc_poly = "4C11DB7";
-	//std::string initial_value = "000000";
-	//std::string final_value = "000000";
-
-	static int reflectByte(int c);
-	static void reflect(int* crc, int bitnum, int startLSB);
+// Secondary indexes over a project block: clip name -> clip and cacheIndex -> movement.
+// Built lazily on the first lookup and then kept up to date by the CacheEntry
+// add/remove helpers. Taking the clip or movement list for writing, through the
+// non-const getClips() or getMovementData(), bumps the block revision and the next
+// lookup rebuilds; code that renames a clip or changes a cache index through a
+// pointer a lookup returned must call invalidate().
+// Lookups may run on several threads while nothing edits the project, the first
+// one builds the index under a lock. Edits, and the add/remove helpers, are not
+// thread safe.
+class ClipIndex
+{
+	AnimData::name_index_t<AnimData::ClipGeneratorBlock*> clips;
+	std::unordered_map<int, size_t> movements;
+	size_t clips_revision = 0;
+	size_t movements_revision = 0;
+	bool valid = false;
+	std::mutex build_mutex;
+
 public:
-	
-	static std::string compute(std::string input);
+
+	ClipIndex() {}
+	//pointers refer to the owner lists, a copy has to be rebuilt against its own
+	ClipIndex(const ClipIndex&) {}
+	ClipIndex& operator=(const ClipIndex&) { invalidate(); return *this; }
+
+	void invalidate() {
+		clips.clear();
+		movements.clear();
+		valid = false;
+	}
+
+	void ensure(AnimData::ProjectBlock& block, AnimData::ProjectDataBlock& data) {
+		std::lock_guard<std::mutex> lock(build_mutex);
+		if (valid && clips_revision == block.getClipsRevision() && movements_revision == data.getMovementRevision())
+			return;
+		invalidate();
+		for (auto& clip : block.getClips())
+			clips.emplace(clip.getName(), &clip);
+		const auto& movement_data = std::as_const(data).getMovementData();
+		for (size_t m = 0; m < movement_data.size(); ++m)
+			movements.emplace(movement_data[m].getCacheIndex(), m);
+		//taken after the walk, which counts as an edit itself
+		clips_revision = block.getClipsRevision();
+		movements_revision = data.getMovementRevision();
+		valid = true;
+	}
+
+	AnimData::ClipGeneratorBlock* clip(const std::string& clip_name) const {
+		auto it = clips.find(clip_name);
+		return it != clips.end() ? it->second : nullptr;
+	}
+
+	AnimData::ClipMovementData* movement(int cache_index, AnimData::ProjectDataBlock& data) const {
+		auto it = movements.find(cache_index);
+		return it != movements.end() ? &data.getMovementAt(it->second) : nullptr;
+	}
+
+	//the helpers run right after their own edit of the list, the revision they
+	//take is the one that edit left
+	void addClip(AnimData::ClipGeneratorBlock& clip, const AnimData::ProjectBlock& block) {
+		if (!valid) return;
+		clips.emplace(clip.getName(), &clip);
+		clips_revision = block.getClipsRevision();
+	}
+
+	void removeClip(const std::string& clip_name, const AnimData::ProjectBlock& block) {
+		if (!valid) return;
+		clips.erase(clip_name);
+		clips_revision = block.getClipsRevision();
+	}
+
+	void addMovement(int cache_index, size_t position, const AnimData::ProjectDataBlock& data) {
+		if (!valid) return;
+		movements.emplace(cache_index, position);
+		movements_revision = data.getMovementRevision();
+	}
 };
 
 struct CacheEntry
@@ -40,19 +107,30 @@ struct CacheEntry
 	string name;
 	AnimData::ProjectBlock& block;
 	AnimData::ProjectDataBlock& movements;
+	ClipIndex index;
 
 	CacheEntry() : block(AnimData::ProjectBlock()) , movements(AnimData::ProjectDataBlock()){}
 	CacheEntry(const string& name, AnimData::ProjectBlock& block, AnimData::ProjectDataBlock& movements) : name(name), block(block), movements(movements) {}
 
 	bool hasCache() { return block.getHasAnimationCache(); }
 
+	AnimData::ClipGeneratorBlock* findClip(const std::string& clip_name) {
+		index.ensure(block, movements);
+		return index.clip(clip_name);
+	}
+
+	AnimData::ClipMovementData* findMovementData(int cache_index) {
+		index.ensure(block, movements);
+		return index.movement(cache_index, movements);
+	}
+
 	std::vector<std::string> getEvents(const std::string& clip_name) {
 		if (hasCache())
 		{
-			auto it = find_if(block.getClips().begin(), block.getClips().end(), [&clip_name](AnimData::ClipGeneratorBlock& block) {return block.getName() == clip_name; });
-			if (it != block.getClips().end())
+			auto clip = findClip(clip_name);
+			if (clip != nullptr)
 			{
-				return it->getEvents().getStrings();
+				return clip->getEvents().getStrings();
 			}
 		}
 		return {};
@@ -62,26 +140,58 @@ struct CacheEntry
 		return movements.getMovementData();
 	}
 
-	AnimData::root_movement_t findMovement(const std::string& clip_name)
+	const AnimData::root_movement_t& findMovement(const std::string& clip_name)
 	{
+		static const AnimData::root_movement_t no_movement;
 		if (hasCache())
 		{
-			auto it = find_if(block.getClips().begin(), block.getClips().end(), [&clip_name](AnimData::ClipGeneratorBlock& block) {return block.getName() == clip_name; });
-			if (it != block.getClips().end())
+			auto clip = findClip(clip_name);
+			if (clip != nullptr)
 			{
-				if ((size_t)it->getCacheIndex() < movements.getMovementData().size())
+				if ((size_t)clip->getCacheIndex() < std::as_const(movements).getMovementData().size())
 				{
-					auto& data = movements.getMovementData();
-					for (size_t m = 0; m < data.size(); ++m)
-					{
-						if (data[m].getCacheIndex() == it->getCacheIndex())
-							return data[m].getMovement();
-					}
-					return AnimData::root_movement_t();
+					auto data = findMovementData(clip->getCacheIndex());
+					if (data != nullptr)
+						return data->getMovement();
 				}
 			}
 		}
-		return {};
+		return no_movement;
+	}
+
+	AnimData::ClipGeneratorBlock& addClip(const AnimData::ClipGeneratorBlock& clip) {
+		index.ensure(block, movements);
+		auto& clips = block.getClips();
+		clips.push_back(clip);
+		index.addClip(clips.back(), block);
+		return clips.back();
+	}
+
+	void removeClip(const std::string& clip_name) {
+		auto clip = findClip(clip_name);
+		if (clip == nullptr)
+			return;
+		block.getClips().remove_if([clip](const AnimData::ClipGeneratorBlock& c) { return &c == clip; });
+		index.removeClip(clip_name, block);
+	}
+
+	AnimData::ClipMovementData& addMovement(const AnimData::ClipMovementData& data) {
+		index.ensure(block, movements);
+		auto& movement_data = movements.getMovementData();
+		movement_data.push_back(data);
+		index.addMovement(data.getCacheIndex(), movement_data.size() - 1, movements);
+		return movement_data.back();
+	}
+
+	void clear() {
+		block.clear();
+		movements.clear();
+		index.invalidate();
+	}
+
+	//to be called after editing block or movements in place
+	void invalidate() {
+		index.invalidate();
 	}
 
 	virtual void none() {}
@@ -92,12 +202,23 @@ struct StaticCacheEntry
 	string name;
 	AnimData::ProjectBlock block;
 	AnimData::ProjectDataBlock movements;
+	ClipIndex index;
 
 	StaticCacheEntry() {}
 	StaticCacheEntry(const string& name, AnimData::ProjectBlock& block, AnimData::ProjectDataBlock& movements) : name(name), block(block), movements(movements) {}
 
 	bool hasCache() { return block.getHasAnimationCache(); }
 
+	AnimData::ClipGeneratorBlock* findClip(const std::string& clip_name) {
+		index.ensure(block, movements);
+		return index.clip(clip_name);
+	}
+
+	AnimData::ClipMovementData* findMovementData(int cache_index) {
+		index.ensure(block, movements);
+		return index.movement(cache_index, movements);
+	}
+
 	virtual void none() {}
 };
 
@@ -114,12 +235,13 @@ struct CreatureCacheEntry : public CacheEntry
 		//meshes\actors\dragon\animations
 		fs::path folder = "meshes" / fs::relative(fs::path(file).parent_path(), "meshes");
 		std::string to_crc = fs::path(file).filename().replace_extension("").string();
-		transform(to_crc.begin(), to_crc.end(), to_crc.begin(), ::tolower);
-		long long crc = stoll(HkCRC::compute(to_crc), NULL, 16);
-		string crc_str = to_string(crc);
+		auto crc = HkCRC::crc32_path(to_crc);
+		if (!crc)
+			return out;
+		string crc_str = HkCRC::cache_string(*crc);
 
-		auto blocks = sets.getProjectAttackBlocks();
-		auto projectFiles = sets.getProjectFiles().getStrings();
+		auto& blocks = sets.getProjectAttackBlocks();
+		const auto& projectFiles = sets.getProjectFiles().getStrings();
 		for (size_t i = 0; i < blocks.size(); i++) {
 			auto& crc32 = blocks[i].getCrc32Data().getStrings();
 			for (auto& entry : crc32) {
@@ -131,7 +253,7 @@ struct CreatureCacheEntry : public CacheEntry
 		return out;
 	}
 
-	vector<string> getProjectSetFiles()
+	const vector<string>& getProjectSetFiles() const
 	{
 		return sets.getProjectFiles().getStrings();
 	}
@@ -141,24 +263,22 @@ struct CreatureCacheEntry : public CacheEntry
 		return sets.getProjectAttackBlocks();
 	}
 
-	vector<string> getProjectSetEvents(const std::string& file) {
-		auto projectFiles = sets.getProjectFiles().getStrings();
-		auto blocks = sets.getProjectAttackBlocks();
-		size_t set_index = distance(projectFiles.begin(), find(projectFiles.begin(), projectFiles.end(), file));
-		return blocks[set_index].getSwapEventsList().getStrings();
+	size_t findProjectSet(const std::string& file) const {
+		const auto& projectFiles = sets.getProjectFiles().getStrings();
+		return distance(projectFiles.begin(), find(projectFiles.begin(), projectFiles.end(), file));
+	}
+
+	const vector<string>& getProjectSetEvents(const std::string& file) {
+		return sets.getProjectAttackBlocks()[findProjectSet(file)].getSwapEventsList().getStrings();
 	}
 
 	AnimData::HandVariableData& getProjectSetVariables(const std::string& file) {
-		auto projectFiles = sets.getProjectFiles().getStrings();
-		auto blocks = sets.getProjectAttackBlocks();
-		size_t set_index = distance(projectFiles.begin(), find(projectFiles.begin(), projectFiles.end(), file));
-		return blocks[set_index].getHandVariableData();
+		return sets.getProjectAttackBlocks()[findProjectSet(file)].getHandVariableData();
 	}
 
 	pair<vector<string>, AnimData::HandVariableData> getProjectSetInfo(const std::string& project_set_key) {
-		auto projectFiles = sets.getProjectFiles().getStrings();
-		auto blocks = sets.getProjectAttackBlocks();
-		size_t set_index = distance(projectFiles.begin(), find(projectFiles.begin(), projectFiles.end(), project_set_key));
+		auto& blocks = sets.getProjectAttackBlocks();
+		size_t set_index = findProjectSet(project_set_key);
 		return { 
 			blocks[set_index].getSwapEventsList().getStrings(),
 			blocks[set_index].getHandVariableData() 
@@ -178,13 +298,23 @@ struct AnimationCache {
 	static constexpr const char* animation_data_merged_file = "animationdatasinglefile.txt";
 	static constexpr const char* animation_set_data_folder = "animationsetdata";
 	static constexpr const char* animation_set_data_merged_file = "animationsetdatasinglefile.txt";
+	// binary image of the two merged files, next to animationdatasinglefile.txt
+	static constexpr const char* compiled_cache_file = "animationcache.bin";
 
-	//project, clip -> movement
-	typedef pair<string, string> movement_key_t;
-	map< movement_key_t, AnimData::ClipMovementData> movements_map;
-
-	const AnimData::ClipMovementData& getMovement(string project, string clip) {
-		return movements_map.at({ project, clip });
+	//project, clip -> movement, resolved through the project clip index
+	const AnimData::ClipMovementData& getMovement(const string& project, const string& clip) {
+		auto entry = find(project);
+		if (entry != NULL)
+		{
+			auto clip_block = entry->findClip(clip);
+			if (clip_block != nullptr && (size_t)clip_block->getCacheIndex() < std::as_const(entry->movements).getMovementData().size())
+			{
+				auto data = entry->findMovementData(clip_block->getCacheIndex());
+				if (data != nullptr)
+					return *data;
+			}
+		}
+		throw std::out_of_range("movement not found: " + project + ", " + clip);
 	}
 
 	enum event_type_t
@@ -200,11 +330,21 @@ struct AnimationCache {
 		vector<AnimData::HandVariableData::Data> animation_set;
 	};
 
-	//project, event -> type
+	//project, event -> type. Project names are case insensitive, events are not
 	typedef pair<string, string> eventset_key_t;
-	multimap< eventset_key_t, event_info_t> events_map;
+	struct eventset_key_hash {
+		size_t operator()(const eventset_key_t& key) const {
+			return AnimData::iname_hash()(key.first) * 31 + std::hash<string>()(key.second);
+		}
+	};
+	struct eventset_key_equal {
+		bool operator()(const eventset_key_t& a, const eventset_key_t& b) const {
+			return a.second == b.second && AnimData::iname_equal()(a.first, b.first);
+		}
+	};
+	unordered_multimap< eventset_key_t, event_info_t, eventset_key_hash, eventset_key_equal> events_map;
 
-	vector<event_info_t> getEventsInfo(string project, string anim_event) {
+	vector<event_info_t> getEventsInfo(const string& project, const string& anim_event) {
 		vector<event_info_t> out;
 		auto entries = events_map.equal_range({ project, anim_event });
 		for (auto it = entries.first; it != entries.second; it++) {
@@ -228,7 +368,10 @@ struct AnimationCache {
 	AnimData::AnimDataFile animationData;
 	AnimData::AnimSetDataFile animationSetData;
 
-	map<string, std::shared_ptr<CacheEntry>> projects_index;
+	//project name -> entry
+	AnimData::name_index_t<std::shared_ptr<CacheEntry>> projects_index;
+	//keys of projects_index in alphabetical order, kept by addToIndex and rebuildIndex
+	vector<string> project_names;
 
 	std::shared_ptr<CacheEntry> findOrCreate(const string& name, bool creature) {
 		std::shared_ptr<CacheEntry> out = find(name);
@@ -240,26 +383,24 @@ struct AnimationCache {
 			{
 				auto creature_index = animationSetData.putProjectAttackBlock(name + "Data\\" + name + ".txt", AnimData::ProjectAttackListBlock());
 
-				creature_entries.push_back(
-				std::make_shared<CreatureCacheEntry>(
-						name,
-						animationData.getProjectBlock(index),
-						animationData.getprojectMovementBlock(index),
-						animationSetData.getProjectAttackBlock(creature_index)
-					)
+				auto entry = std::make_shared<CreatureCacheEntry>(
+					name,
+					animationData.getProjectBlock(index),
+					animationData.getprojectMovementBlock(index),
+					animationSetData.getProjectAttackBlock(creature_index)
 				);
+				creature_entries.push_back(entry);
+				out = entry;
 			}
 			else {
-				misc_entries.push_back(
-					std::make_shared<CacheEntry>(
-						name,
-						animationData.getProjectBlock(index),
-						animationData.getprojectMovementBlock(index)
-					)
+				out = std::make_shared<CacheEntry>(
+					name,
+					animationData.getProjectBlock(index),
+					animationData.getprojectMovementBlock(index)
 				);
+				misc_entries.push_back(out);
 			}
-			rebuildIndex();
-			out = find(name);
+			addToIndex(out);
 		}
 		return out;
 	}
@@ -283,8 +424,13 @@ struct AnimationCache {
 		const fs::path& root_folder = ".",
 		bool saveMergedSets = true);
 
+	void addToIndex(const std::shared_ptr<CacheEntry>& entry);
 	void rebuildIndex();
-	void build(const string& animationDataContent, const string& animationSetDataContent);
+	void build(std::string_view animationDataContent, std::string_view animationSetDataContent);
+	void load(const fs::path& animationDataPath, const fs::path& animationSetDataPath);
+	void createEntries();
+
+	static string read_file(const fs::path& path);
 
 	static void get_entries(
 		StaticCacheEntry& entry,
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <core/bsa.h>
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ckcmd {
+namespace BSA {
+
+	// read only istream over an extracted buffer, lets niflib and the cache parsers
+	// read an asset without copying it into a string and then into an istringstream
+	class MemoryStream : public std::istream {
+
+		struct buffer : public std::streambuf {
+			buffer(const char* data, size_t size);
+			pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+			pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+		} buf;
+
+	public:
+		MemoryStream(const uint8_t* data, size_t size);
+		MemoryStream(std::string_view data);
+	};
+
+	// write only ostream over a caller owned buffer. Writes past the capacity are
+	// dropped and set badbit, so a writer can retry with a larger buffer
+	class MemoryOutputStream : public std::ostream {
+
+		struct buffer : public std::streambuf {
+			buffer(char* data, size_t capacity);
+			size_t written() const { return pptr() - pbase(); }
+			pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+			pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+		} buf;
+
+	public:
+		MemoryOutputStream(uint8_t* data, size_t capacity);
+
+		size_t written() const { return buf.written(); }
+		bool overflowed() const { return bad(); }
+	};
+
+	class BSAExtractor;
+
+	// bytes of one extracted asset. The buffer is freed, and its size given back to the
+	// extractor memory budget, when the asset goes out of scope
+	class ExtractedAsset {
+
+		friend class BSAExtractor;
+
+		std::string asset_path;
+		const uint8_t* bytes = nullptr;
+		size_t length = 0;
+		BSAExtractor* owner = nullptr;
+
+		ExtractedAsset(const std::string& path, const uint8_t* bytes, size_t length, BSAExtractor* owner) :
+			asset_path(path), bytes(bytes), length(length), owner(owner) {}
+
+		void reset();
+
+	public:
+
+		ExtractedAsset() {}
+		ExtractedAsset(ExtractedAsset&& other) noexcept;
+		ExtractedAsset& operator=(ExtractedAsset&& other) noexcept;
+		ExtractedAsset(const ExtractedAsset&) = delete;
+		ExtractedAsset& operator=(const ExtractedAsset&) = delete;
+		~ExtractedAsset();
+
+		const std::string& path() const { return asset_path; }
+		const uint8_t* data() const { return bytes; }
+		size_t size() const { return length; }
+		std::string_view view() const { return std::string_view((const char*)bytes, length); }
+		MemoryStream stream() const { return MemoryStream(bytes, length); }
+	};
+
+	struct ExtractorOptions {
+		// worker threads, 0 means one per core
+		size_t threads = 0;
+		// extracted bytes allowed to be alive at once. The asset the consumer waits for
+		// always goes through, so the worst case is the budget plus one asset per worker
+		size_t memory_budget = 256 * 1024 * 1024;
+		// completed results allowed to wait for the consumer, 0 means twice the threads
+		size_t queue_depth = 0;
+	};
+
+	// Extracts and parses assets of a BSA on a pool of workers, each with its own
+	// libbsa handle. Results are handed to the calling thread in asset order, so
+	// consumers that touch global state (logs, niflib writers, plugin records) do
+	// not need any locking. Memory is bounded by the budget and the queue depth.
+	class BSAExtractor {
+
+		friend class ExtractedAsset;
+
+		const BSAFile& bsa;
+		ExtractorOptions options;
+
+		std::mutex mutex;
+		std::condition_variable ready;
+		std::condition_variable window;
+		std::condition_variable budget;
+		size_t next_index = 0;
+		size_t consumed = 0;
+		size_t held_bytes = 0;
+		size_t peak_bytes = 0;
+		bool aborted = false;
+		std::vector<char> done;
+		std::vector<std::exception_ptr> errors;
+
+		void schedule(
+			size_t count,
+			const std::function<void(const BSAFile&, size_t)>& produce,
+			const std::function<void(size_t)>& consume);
+
+		void release(size_t size);
+
+	public:
+
+		BSAExtractor(const BSAFile& bsa, const ExtractorOptions& options = ExtractorOptions());
+
+		size_t threads() const;
+		// highest amount of extracted bytes alive at once during the last run
+		size_t peak_memory() const { return peak_bytes; }
+
+		// extracts the asset with the given handle, waiting for room in the memory budget
+		ExtractedAsset extract(const BSAFile& handle, size_t index, const std::string& asset_path);
+
+		// generic ordered jobs, job runs on the workers with a worker owned BSA handle
+		template<typename T>
+		void for_each(
+			size_t count,
+			const std::function<T(const BSAFile&, size_t)>& job,
+			const std::function<void(size_t, T&)>& consume)
+		{
+			std::vector<std::optional<T>> results(count);
+			schedule(count,
+				[&](const BSAFile& handle, size_t i) { results[i].emplace(job(handle, i)); },
+				[&](size_t i) { consume(i, *results[i]); results[i].reset(); }
+			);
+		}
+
+		// parse runs on the workers with the extracted bytes, which are freed right after.
+		// Assets that fail to parse are logged and skipped
+		template<typename T>
+		void run(
+			const std::vector<std::string>& assets,
+			const std::function<T(const ExtractedAsset&)>& parse,
+			const std::function<void(const std::string&, T&)>& consume)
+		{
+			for_each<T>(assets.size(),
+				[&](const BSAFile& handle, size_t i) {
+					try {
+						return parse(extract(handle, i, assets[i]));
+					}
+					catch (const std::exception& e) {
+						throw std::runtime_error(assets[i] + ": " + e.what());
+					}
+				},
+				[&](size_t i, T& result) { consume(assets[i], result); }
+			);
+		}
+
+		// consume receives the raw bytes, freed when the consumer returns
+		void run(
+			const std::vector<std::string>& assets,
+			const std::function<void(ExtractedAsset&)>& consume);
+	};
+
+}
+}
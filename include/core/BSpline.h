@@ -0,0 +1,36 @@
+#pragma once
+
+namespace ckcmd {
+
+	// Clamped B-spline over uniform knots, the curves NiBSplineData holds the control
+	// points of: degree + 1 knots at each end and unit steps in between, so the
+	// parameter runs over [0, spans()]. Control points interleave any number of
+	// channels, i.e. 1 for scales, 3 for translations and 4 for rotations.
+	// A sample is evaluated with de Boor's algorithm on the span holding it, in
+	// degree * (degree + 1) / 2 blends of whole control points; nothing is allocated
+	// per sample
+	class BSpline {
+
+	public:
+
+		// a degree of control_points or more is lowered to control_points - 1
+		BSpline(int control_points, int degree);
+
+		int controlPoints() const { return ncontrol; }
+		int degree() const { return order - 1; }
+		int spans() const { return ncontrol - order + 1; }
+
+		// count samples evenly spaced over the whole curve, the last one being the
+		// last control point. control holds controlPoints() * channels floats and
+		// output count * channels
+		void sample(const float* control, int channels, float* output, int count) const;
+
+	private:
+
+		float knot(int index) const;
+
+		int ncontrol;
+		int order;
+	};
+
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#if _MSC_VER < 1920
+namespace fs = std::experimental::filesystem;
+#else
+namespace fs = std::filesystem;
+#endif
+
+namespace ckcmd {
+
+	// Sidecar of the merged animation cache files written by cachegen. For each
+	// project and each attack set it records a hash of the split files it was built
+	// from and where its serialized block sits in the merged file, so an unchanged
+	// block can be copied from the previous output instead of parsed and written again.
+	// Offsets are into the merged files without carriage returns; the merged files
+	// themselves are hashed too, any edit made after cachegen wrote them discards
+	// the whole manifest, and so does a manifest saved with another serializer_version
+	class CacheManifest {
+
+	public:
+
+		// bump whenever a block serializer or the merged file layout changes, so blocks
+		// written by an older cachegen are written again instead of copied
+		static const uint32_t serializer_version = 1;
+
+		enum Kind { project, set };
+
+		struct Entry {
+			uint64_t hash = 0;
+			size_t offset = 0;
+			// 0 for sets left out of the merged file
+			size_t length = 0;
+		};
+
+		static const char* file_name;
+
+		// 64 bit FNV-1a, chained through seed
+		static uint64_t hash(std::string_view bytes, uint64_t seed = 0xcbf29ce484222325ull);
+
+		// false if the file is missing, malformed or from another serializer_version
+		bool load(const fs::path& manifest_file);
+		bool save(const fs::path& manifest_file) const;
+
+		// true if data_file and sets_file are the merged files this manifest was saved with
+		bool matches(std::string_view data_file, std::string_view sets_file) const;
+		void setOutputs(std::string_view data_file, std::string_view sets_file);
+
+		const Entry* find(Kind kind, const std::string& name) const;
+		void add(Kind kind, const std::string& name, const Entry& entry);
+
+		size_t size() const { return projects.size() + sets.size(); }
+
+	private:
+
+		struct Output {
+			size_t size = 0;
+			uint64_t hash = 0;
+		};
+
+		Output data_output;
+		Output sets_output;
+		std::unordered_map<std::string, Entry> projects;
+		std::unordered_map<std::string, Entry> sets;
+	};
+
+}
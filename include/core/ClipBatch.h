@@ -0,0 +1,57 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#if _MSC_VER < 1920
+namespace fs = std::experimental::filesystem;
+#else
+namespace fs = std::filesystem;
+#endif
+
+namespace ckcmd {
+
+	// Animation clips converted in one run against data loaded once, i.e. a base
+	// skeleton. Clips come from a folder walk or a manifest and are converted on a
+	// ThreadPool whose workers each join the HavokSession for the whole run. A clip
+	// that fails or throws is reported with its time and the others go on; the
+	// messages of a clip are logged together when it ends.
+	// The first clip runs alone so lazily registered SDK state (niflib block types,
+	// Havok classes) is set up before the workers start. The caller must hold a
+	// HavokSession, the shared data must only be read by the conversion
+	class ClipBatch {
+
+	public:
+
+		struct Clip {
+			fs::path source;
+			fs::path destination;
+		};
+
+		void add(const fs::path& source, const fs::path& destination);
+
+		// every file with the extension under the folder, written under output with
+		// the same relative path and the output extension. Returns the clips added
+		size_t addFolder(const fs::path& folder, const std::string& extension, const fs::path& output, const std::string& output_extension);
+
+		// one clip per line, "source" or "source<tab>destination". Empty lines and
+		// lines starting with # are skipped, relative paths are relative to the
+		// manifest folder and a missing destination is the source file name under
+		// output with the output extension. Returns the clips added, -1 if unreadable
+		int addManifest(const fs::path& manifest, const fs::path& output, const std::string& output_extension);
+
+		size_t size() const { return clips.size(); }
+		const Clip& operator[](size_t index) const { return clips[index]; }
+
+		// creates the destination folders then converts every clip, 0 threads means
+		// one per core. Returns the number of failed clips
+		size_t run(const std::function<bool(const Clip&)>& convert, size_t threads = 0);
+
+	private:
+
+		std::vector<Clip> clips;
+	};
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <bs/AnimDataFile.h>
+#include <bs/AnimSetDataFile.h>
+#include <core/MappedFile.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <filesystem>
+
+#if _MSC_VER < 1920
+namespace fs = std::experimental::filesystem;
+#else
+namespace fs = std::filesystem;
+#endif
+
+namespace ckcmd {
+
+	// Binary image of the two merged animation cache files, written next to them and
+	// mapped read only on load. The text files stay the source of truth: the image
+	// records their size, modification time and hash and is rebuilt when they change.
+	//
+	// Layout, little endian, every section 8 byte aligned:
+	//   header       magic, version, the two sources, section offsets and counts
+	//   strings      u32 offsets (count + 1) into a blob of deduplicated strings
+	//   projects     { u32 name, u32 words offset } per animationdata project
+	//   sets         { u32 name, u32 words offset } per animationsetdata project
+	//   index        open addressing buckets of project index + 1, 0 for empty,
+	//                keyed on the lowercase project name without extension
+	//   words        u32 stream of the blocks, strings as string table ids
+	class CompiledCache {
+
+	public:
+
+		static const uint32_t version = 1;
+
+		// identity of a source text file, hash is 0 until computed
+		struct Source {
+			uint64_t size = 0;
+			uint64_t time = 0;
+			uint64_t hash = 0;
+
+			static Source stat(const fs::path& file);
+		};
+
+		struct Header;
+
+		CompiledCache() {}
+
+		// false if the file is missing, truncated or from another version
+		bool open(const fs::path& file);
+		void close();
+		bool is_open() const { return header != nullptr; }
+
+		const Source& data_source() const;
+		const Source& sets_source() const;
+
+		// rebuilds both files in their original order. Throws std::out_of_range on a
+		// corrupt image, the outputs are then left partially filled
+		void read(AnimData::AnimDataFile& data, AnimData::AnimSetDataFile& sets) const;
+
+		size_t projects() const;
+		std::string_view project_name(size_t index) const;
+
+		// project index by name, case insensitive, with or without the .txt extension.
+		// -1 if there is no such project
+		int find(std::string_view name) const;
+
+		static bool write(
+			const fs::path& file,
+			AnimData::AnimDataFile& data,
+			AnimData::AnimSetDataFile& sets,
+			const Source& data_source,
+			const Source& sets_source);
+
+	private:
+
+		MappedFile mapping;
+		const Header* header = nullptr;
+
+		struct Cursor;
+
+		std::string_view string(uint32_t id) const;
+	};
+
+}
@@ -77,6 +77,7 @@ namespace FBX {
 
 		bool export_skin = false;
 		bool export_rig = false;
+		KeyReduction key_reduction;
 
 		string external_skeleton_path = "";
 		string external_paired_skeleton_path = "";
@@ -101,6 +102,11 @@ namespace FBX {
 		FBXWrangler();
 		~FBXWrangler();
 
+		// While kept, the SDK managers of destroyed wranglers are handed to the next ones
+		// instead of being created again with all their readers and writers. Used when many
+		// files are converted by the same process, false destroys the kept managers
+		static void KeepManagers(bool keep);
+
 		string texture_path;
 
 		HKXWrapper& hkx_wrapper() { return hkxWrapper; }
@@ -118,6 +124,7 @@ namespace FBX {
 
 		void setExportRig(bool _export_rig = true) { export_rig = _export_rig; }
 		void setExportSkin(bool _export_skin = true) { export_skin = _export_skin; }
+		void setKeyReduction(const KeyReduction& reduction) { key_reduction = reduction; hkxWrapper.setKeyReduction(reduction); }
 
 		void AddNif(NifFile& nif);
 		void convert(bhkCollisionObjectRef root, FbxNode* sceneNode, const NifInfo& info);
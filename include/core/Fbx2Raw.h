@@ -12,6 +12,7 @@
 
 #include "RawModel.h"
 
-bool LoadFBXFile(RawModel &raw, const char *fbxFileName, const char *textureExtensions);
+// weldTolerance > 0 merges vertices with every attribute within it, see RawModel::SetWeldTolerance
+bool LoadFBXFile(RawModel &raw, const char *fbxFileName, const char *textureExtensions, const float weldTolerance = 0.0f);
 
 #endif // !__FBX2RAW_H__
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#if _MSC_VER < 1920
+namespace fs = std::experimental::filesystem;
+#else
+namespace fs = std::filesystem;
+#endif
+
+namespace ckcmd {
+
+	// Text files to be written in one go. Every file gets a slot when it is added,
+	// producers can fill slots from any thread as long as each slot has one writer.
+	// write() creates each distinct parent directory once, then writes the files in
+	// parallel with a single write call each. Files are opened in text mode, like the
+	// ofstreams they replace, so '\n' still becomes "\r\n" on Windows
+	class FileBatch {
+
+		struct File {
+			fs::path path;
+			std::string content;
+		};
+
+		std::vector<File> files;
+
+	public:
+
+		size_t add(const fs::path& path);
+		size_t add(const fs::path& path, std::string content);
+
+		std::string& content(size_t slot) { return files[slot].content; }
+
+		size_t size() const { return files.size(); }
+		size_t bytes() const;
+
+		// 0 threads means one per hardware core. Failures are logged, false if any
+		bool write(size_t threads = 0);
+	};
+
+}
@@ -4,6 +4,7 @@
 #include <sys/stat.h>
 #include <map>
 #include <filesystem>
+#include <mutex>
 
 #include "stdafx.h"
 
@@ -53,6 +54,7 @@ namespace fs = std::filesystem;
 #include <Physics\Utilities\Serialize\hkpPhysicsData.h>
 
 #include <core/AnimationCache.h>
+#include <core/KeyReduction.h>
 
 bool isShapeFbxNode(FbxNode* node);
 void to_upper(string& name);
@@ -121,6 +123,11 @@ namespace ckcmd {
 				const std::vector<std::string>& in_translations,
 				const std::vector<std::string>& in_rotations,
 				const std::vector<std::string>& in_events);
+			RootMovement(
+				const AnimData::root_movement_t& movement,
+				const std::vector<std::string>& in_events);
+
+			void addEvents(const std::vector<std::string>& in_events);
 
 			bool IsValid() const { return !translations.empty() || !rotations.empty() || !events.empty(); }
 			bool HasMovements() const { return !translations.empty() || !rotations.empty(); }
@@ -148,6 +155,7 @@ namespace ckcmd {
 			map<fs::path, hkRootLevelContainer> out_data;
 			map<fs::path, RootMovement> out_root_data;
 			map<string, int> float_map;
+			KeyReduction key_reduction;
 
 			void write(hkRootLevelContainer& rootCont, string subfolder = "", string name = "");
 
@@ -213,6 +221,9 @@ namespace ckcmd {
 			void add_bone(FbxNode* bone);
 			int setExternalSkeletonPose(FbxNode* body);
 
+			//animations are written spline compressed within the reduction tolerances unless its fit is none
+			void setKeyReduction(const KeyReduction& reduction) { key_reduction = reduction; }
+
 			set<string> create_animations(
 				const string& skeleton_name,
 				vector<FbxNode*>& skeleton,
@@ -274,8 +285,11 @@ namespace ckcmd {
 
 		typedef map<set<string>, HKXWrapper> wrap_map;
 
+		// behaviors shared by the converted models. Each behavior is built once, by the
+		// first model asking for it; models can be converted from several threads
 		class HKXWrapperCollection {
 			wrap_map wrappers;
+			std::mutex wrappers_mutex;
 
 		public:
 			string wrap(const string& out_name, 
@@ -0,0 +1,25 @@
+#pragma once
+
+namespace ckcmd {
+
+	// Process wide Havok base system. The first acquire sets up the memory system and
+	// the class registry, the last release shuts them down, so commands run one after
+	// the other in the same process (see the batch command) pay the setup only once.
+	// Other threads acquiring while the session is up get their own memory router until
+	// their last release. The thread that started the session must release last
+	class HavokSession {
+	public:
+		static void acquire();
+		static void release();
+
+		class Scope {
+		public:
+			Scope() { acquire(); }
+			~Scope() { release(); }
+
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+		};
+	};
+
+}
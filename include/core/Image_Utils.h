@@ -11,6 +11,8 @@
 #define __IMAGE_UTILS_H__
 
 #include <algorithm>
+#include <cstdint>
+#include <string>
 
 enum ImageOcclusion
 {
@@ -23,10 +25,32 @@ struct ImageProperties
     int            width;
     int            height;
     ImageOcclusion occlusion;
+    int            channels;
+    int            mipLevels;  // 0 if the file does not store mip maps
+    uint32_t       fourCC;     // DDS pixel format FourCC, or the DXGI format of DX10 files; 0 otherwise
+    bool           hasAlpha;   // the pixel format has an alpha channel
 };
 
+/**
+ * DDS files are read from their header only. Their alpha is never decoded, so they stay IMAGE_OPAQUE
+ * like they always did, hasAlpha tells whether the format could be transparent.
+ * Results are cached by path, size and modification time, in memory and in an append only file in
+ * the temp folder, so a texture is only opened again after it changed.
+ */
 ImageProperties GetImageProperties(char const *filePath);
 
+/**
+ * Reads width, height, mip levels and format of a DDS file from its first size bytes: the 128 byte
+ * header, 148 with the DX10 extension. False if they are not a DDS header. Only the DDS fields of
+ * result are written.
+ */
+bool GetDdsProperties(const uint8_t *header, size_t size, ImageProperties &result);
+
+/**
+ * Moves the persistent cache to cacheFile; an empty path keeps the cache in memory only.
+ */
+void SetImagePropertiesCache(const std::string &cacheFile);
+
 /**
  * Very simple method for mapping filename suffix to mime type. The glTF 2.0 spec only accepts values
  * "image/jpeg" and "image/png" so we don't need to get too fancy.
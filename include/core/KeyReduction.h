@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace ckcmd {
+
+	// How importers reduce the keys of the animations they sample. A key is dropped
+	// when the curve through the kept ones reproduces it within the tolerance of its
+	// channel: linear fits a polyline, spline a cubic Hermite curve
+	struct KeyReduction {
+
+		enum Fit { none, linear, spline };
+
+		Fit fit = none;
+		// largest error a dropped key may leave: game units, radians and scale factor
+		float position = 0.01f;
+		float angle = 0.1f * 3.14159265f / 180.0f;
+		float scale = 0.001f;
+
+		// fit is none, linear or spline, tolerances "<position>,<degrees>,<scale>".
+		// False if either does not parse
+		bool parse(const std::string& fit, const std::string& tolerances);
+	};
+
+	// Keys before and after a reduction and the largest error it left per channel
+	struct KeyReport {
+
+		size_t keys = 0;
+		size_t kept = 0;
+		float position = 0.0f;
+		float angle = 0.0f;
+		float scale = 0.0f;
+
+		void add(const KeyReport& other);
+		void log(const std::string& what) const;
+	};
+
+	// One channel of an animation: count samples of width floats at increasing
+	// times. The spline fit takes the slope of the samples at the kept ones, so a
+	// segment only depends on its two ends and every sample it drops is checked
+	class KeyReducer {
+
+	public:
+
+		KeyReducer(const float* times, const float* values, int count, int width);
+
+		// indices of the samples kept, the first and the last always are. error
+		// gets the largest distance left on a dropped sample
+		std::vector<int> reduce(KeyReduction::Fit fit, float tolerance, float& error) const;
+
+		// value per second at a sample, from its neighbours
+		const float* slope(int index) const { return &slopes[index * width]; }
+
+	private:
+
+		// largest distance between the samples strictly inside [from, to] and the
+		// segment, stops early past the tolerance
+		float segment_error(KeyReduction::Fit fit, int from, int to, float tolerance) const;
+
+		const float* times;
+		const float* values;
+		int count;
+		int width;
+		std::vector<float> slopes;
+	};
+
+}
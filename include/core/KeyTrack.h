@@ -0,0 +1,47 @@
+#pragma once
+
+#include <Key.h>
+#include <nif_math.h>
+
+#include <vector>
+
+namespace ckcmd {
+
+	// The keys of one NiKeyframeData track laid out for resampling at a fixed rate.
+	// Key times are kept in a contiguous array and every segment between two keys
+	// is reduced once to the coefficients of its curve. A run of frames is located
+	// with one binary search, then a cursor moves forward through the segments and
+	// each segment is evaluated for all the frames it covers.
+	// Values match the per frame key walk ImportKF used before: quadratic keys are
+	// Hermite curves over their tangents, constant keys step at half the segment,
+	// linear and TBC keys are interpolated linearly and quaternions are slerped
+	// whatever the key type. Times before the first key or after the last one hold
+	// that key
+	template<typename T>
+	class KeyTrack {
+
+	public:
+
+		KeyTrack(const std::vector<Niflib::Key<T>>& keys, int interpolation);
+
+		bool empty() const { return times.empty(); }
+		size_t size() const { return times.size(); }
+
+		// out[frame] = value at frame * step, for frames in [0, frames)
+		void sample(float step, int frames, T* out) const;
+
+	private:
+
+		std::vector<float> times;
+		std::vector<T> values;
+		// stride values per segment, the coefficients of its curve
+		std::vector<T> segments;
+		int stride = 4;
+		bool constant = false;
+	};
+
+	extern template class KeyTrack<float>;
+	extern template class KeyTrack<Niflib::Vector3>;
+	extern template class KeyTrack<Niflib::Quaternion>;
+
+}
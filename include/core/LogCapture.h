@@ -0,0 +1,37 @@
+#pragma once
+
+#include <core/log.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ckcmd {
+
+	typedef std::vector<std::pair<LogLevel, std::string>> LogMessages;
+
+	// Collects what the calling thread logs while it lives, so work running next to
+	// other work can print its messages together when it ends
+	class LogCapture : public ILogListenerA {
+
+		ILogListenerA* previous;
+		LogMessages& messages;
+
+	public:
+
+		explicit LogCapture(LogMessages& messages);
+		~LogCapture();
+
+		LogCapture(const LogCapture&) = delete;
+		LogCapture& operator=(const LogCapture&) = delete;
+
+		void Message(LogLevel level, const char* strMessage);
+
+		// logs the messages again on the calling thread as errors, warnings or infos
+		static void replay(const LogMessages& messages);
+	};
+
+	// text quoted and escaped as a JSON string
+	std::string json_string(const std::string& text);
+
+}
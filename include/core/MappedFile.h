@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <filesystem>
+
+#if _MSC_VER < 1920
+namespace fs = std::experimental::filesystem;
+#else
+namespace fs = std::filesystem;
+#endif
+
+namespace ckcmd {
+
+	// Read only memory mapping of a whole file. Empty and missing files give an
+	// invalid mapping, check is_open() before using the data
+	class MappedFile {
+
+		const uint8_t* bytes = nullptr;
+		size_t length = 0;
+#ifdef _WIN32
+		void* file_handle = nullptr;
+		void* mapping_handle = nullptr;
+#else
+		int file_descriptor = -1;
+#endif
+
+		void close();
+
+	public:
+
+		MappedFile() {}
+		explicit MappedFile(const fs::path& path);
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		~MappedFile();
+
+		bool is_open() const { return bytes != nullptr; }
+		const uint8_t* data() const { return bytes; }
+		size_t size() const { return length; }
+		std::string_view view() const { return std::string_view((const char*)bytes, length); }
+	};
+
+}
@@ -23,6 +23,8 @@ See the included LICENSE file
 #include <nif_basic_types.h>
 #include <gen/SkinPartition.h>
 
+#include <core/MappedFile.h>
+
 #include <unordered_map>
 
 namespace ckcmd {
@@ -30,6 +32,16 @@ namespace NIF {
 
 using namespace Niflib;
 
+		// niflib readers over contiguous bytes, the nif is parsed in place without the
+		// string and istringstream copies. data can be an extracted BSA buffer or a mapping
+		vector<NiObjectRef> ReadNifBuffer(const uint8_t* data, size_t size, NifInfo* info = NULL);
+		// maps the file instead of reading it through an ifstream
+		vector<NiObjectRef> ReadNifMapped(const fs::path& path, NifInfo* info = NULL);
+		// writes the tree into buffer, which is grown and written again if the nif does not
+		// fit. Keep the buffer around between calls to avoid any allocation. Returns the
+		// number of bytes written, buffer.size() is the capacity
+		size_t WriteNifBuffer(vector<uint8_t>& buffer, NiObjectRef root, const NifInfo& info);
+
 		class NifFile {
 		private:
 			NifInfo hdr;
@@ -64,6 +76,10 @@ using namespace Niflib;
 				Load(stream);
 			}
 
+			NifFile(const uint8_t* data, size_t size) {
+				Load(data, size);
+			}
+
 
 			size_t getNumBlocks() const {
 				return blocks.size();
@@ -88,8 +104,12 @@ using namespace Niflib;
 
 			int Load(const string& fileName);
 			int Load(istream& file);
+			int Load(const uint8_t* data, size_t size);
 			int Save(const string& fileName);
 			int Save(std::ostream& file);
+			// -2 if the nif does not fit in capacity
+			int Save(uint8_t* buffer, size_t capacity, size_t& written);
+			int Save(vector<uint8_t>& buffer, size_t& written);
 			int Save() { return fileName.empty() ? -1 : Save(fileName); }
 
 			bool IsValid() { return isValid; }
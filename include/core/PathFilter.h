@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ckcmd {
+
+	// Case insensitive glob rules over file paths. '*' matches inside one path
+	// component, '**' across components, '?' any one character but a separator.
+	// '/' and '\' are the same separator. Rules are compiled when added and match
+	// the whole path, so "**\sky\**" skips every sky folder.
+	// A path is accepted when it matches an include rule, or there are none, and
+	// no exclude rule
+	class PathFilter {
+
+		std::vector<std::string> includes;
+		std::vector<std::string> excludes;
+
+		static std::string compile(std::string_view glob);
+		static bool match(const std::string& rule, const std::string& path);
+
+	public:
+
+		PathFilter() {}
+
+		void include(std::string_view glob);
+		void exclude(std::string_view glob);
+
+		// ';' separated globs, as given on the command line
+		static std::vector<std::string> split(std::string_view globs);
+
+		bool empty() const { return includes.empty() && excludes.empty(); }
+		bool accepts(std::string_view path) const;
+	};
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <Common/Base/hkBase.h>
+#include <Animation/Animation/Rig/hkaSkeleton.h>
+#include <Animation/Animation/Animation/hkaAnimation.h>
+
+#include <vector>
+
+namespace ckcmd {
+
+	// Local and model space poses of a skeleton for every frame of a clip, stored
+	// frame major (frame * bones + bone) like the interleaved uncompressed animation.
+	// Sampling and the hierarchy walk run over ranges of frames on a ThreadPool;
+	// the model poses of a frame are computed in one pass with parents before
+	// children. The caller must hold a HavokSession, the workers join it
+	class PoseBuffer {
+
+	public:
+
+		// fewer frames than this per worker are not worth a thread
+		static const int min_frames_per_task = 16;
+
+		explicit PoseBuffer(const hkaSkeleton& skeleton);
+
+		PoseBuffer(const PoseBuffer&) = delete;
+		PoseBuffer& operator=(const PoseBuffer&) = delete;
+
+		int bones() const { return nbones; }
+		int frames() const { return nframes; }
+		int floats() const { return nfloats; }
+
+		// every frame set to the skeleton reference pose
+		void reference(int frames);
+
+		// samples the clip at duration * frame / frames. Track i drives bone
+		// track_to_bone[i], -1 drops it; without a map track i drives bone i. Bones
+		// no track drives keep the reference pose. 0 threads means one per core,
+		// or the calling thread alone on a pool worker
+		void sample(const hkaAnimation& animation, int frames, const int* track_to_bone = nullptr, size_t threads = 0);
+
+		// model space poses of every frame from the local ones
+		void computeModel(size_t threads = 0);
+
+		hkQsTransform* local(int frame) { return locals.begin() + frame * nbones; }
+		const hkQsTransform* local(int frame) const { return locals.begin() + frame * nbones; }
+		const hkQsTransform* model(int frame) const { return models.begin() + frame * nbones; }
+		const hkReal* floatTracks(int frame) const { return floatValues.begin() + frame * nfloats; }
+
+		// the whole local buffer, i.e. to swap into an hkaInterleavedUncompressedAnimation
+		hkArray<hkQsTransform>& localPoses() { return locals; }
+		hkArray<hkReal>& floatPoses() { return floatValues; }
+
+	private:
+
+		int nbones = 0;
+		int nframes = 0;
+		int nfloats = 0;
+
+		std::vector<int> parents;
+		// bones sorted by depth, a parent always comes before its children
+		std::vector<int> order;
+		hkArray<hkQsTransform> referencePose;
+
+		hkArray<hkQsTransform> locals;
+		hkArray<hkQsTransform> models;
+		hkArray<hkReal> floatValues;
+	};
+
+}
@@ -11,7 +11,9 @@
 #define __RAWMODEL_H__
 
 #include <core/mathfu.h>
+#include <cstdint>
 #include <unordered_map>
+#include <vector>
 #include <functional>
 #include <memory>
 #include <set>
@@ -135,18 +137,51 @@ struct RawVertex
     size_t Difference(const RawVertex &other) const;
 };
 
-class VertexHasher
+/**
+ * Finds the vertex of a model that a new vertex can be merged into.
+ *
+ * The vertices stay in the model's own array. The index keeps an open addressing table from
+ * 64-bit keys to chains of vertex indices, threaded through one flat array, so adding a vertex
+ * allocates nothing but the occasional table growth.
+ *
+ * With no tolerance the key hashes every attribute and vertices merge when they are equal.
+ * With a tolerance the key is the cell of a uniform grid as wide as the tolerance, the 27 cells
+ * around a position are searched and vertices merge when every attribute is within the
+ * tolerance. The lowest matching index wins, so welding does not depend on table layout.
+ */
+class RawVertexIndex
 {
 public:
-    size_t operator()(const RawVertex &v) const
+    explicit RawVertexIndex(float tolerance = 0.0f) : tolerance(tolerance) {}
+
+    void Clear();
+    // Forgets every vertex.
+    void SetTolerance(float tolerance);
+    float GetTolerance() const { return tolerance; }
+
+    // Index in vertices of a vertex that vertex merges into, or -1.
+    int Find(const RawVertex &vertex, const std::vector<RawVertex> &vertices) const;
+    // Records vertices[index], expected to be the last vertex added.
+    void Insert(const int index, const std::vector<RawVertex> &vertices);
+
+private:
+    struct Slot
     {
-        size_t seed = 5381;
-        const auto hasher = std::hash<float>{};
-        seed ^= hasher(v.position[0]) + 0x9e3779b9 + (seed<<6) + (seed>>2);
-        seed ^= hasher(v.position[1]) + 0x9e3779b9 + (seed<<6) + (seed>>2);
-        seed ^= hasher(v.position[2]) + 0x9e3779b9 + (seed<<6) + (seed>>2);
-        return seed;
-    }
+        uint64_t key;
+        int      head;
+    };
+
+    uint64_t Key(const RawVertex &vertex) const;
+    uint64_t CellKey(int64_t x, int64_t y, int64_t z) const;
+    void     Cell(const Vec3f &position, int64_t cell[3]) const;
+    size_t   Probe(const uint64_t key) const;
+    void     Grow();
+    int      FindInChain(const uint64_t key, const RawVertex &vertex, const std::vector<RawVertex> &vertices, int best) const;
+
+    float             tolerance;
+    std::vector<Slot> slots;
+    std::vector<int>  next;
+    size_t            used = 0;
 };
 
 struct RawTriangle
@@ -414,6 +449,9 @@ public:
     // Add geometry.
     void AddVertexAttribute(const RawVertexAttribute attrib);
     int AddVertex(const RawVertex &vertex);
+    // Vertices added afterwards merge into earlier ones with every attribute within tolerance.
+    // 0, the default, merges only equal vertices. Vertices already added are kept as they are.
+    void SetWeldTolerance(const float tolerance);
     int AddTriangle(const int v0, const int v1, const int v2, const int materialIndex, const int surfaceIndex);
     int AddTexture(const std::string &name, const std::string &fileName, const std::string &fileLocation, RawTextureUsage usage);
     int AddMaterial(const RawMaterial &material);
@@ -497,7 +535,13 @@ private:
 
     long                                             rootNodeId;
     int                                              vertexAttributes;
-    std::unordered_map<RawVertex, int, VertexHasher> vertexHash;
+    RawVertexIndex                                   vertexIndex;
+    // Content hash -> index into textures, materials and surfaces. Candidates are
+    // confirmed with the full comparison, the hashes only narrow the search.
+    std::unordered_multimap<uint64_t, int>           textureIndex;
+    std::unordered_multimap<uint64_t, int>           materialIndex;
+    std::unordered_multimap<uint64_t, int>           surfaceNameIndex;
+    std::unordered_map<long, int>                    surfaceIdIndex;
     std::vector<RawVertex>                           vertices;
     std::vector<RawTriangle>                         triangles;
     std::vector<RawTexture>                          textures;
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <core/Image_Utils.h>
+#include <core/VFS.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ckcmd {
+
+	// Existence and DDS header of the textures referenced by meshes, answered from
+	// memory. Roots are file systems searched in the order they were added; in each
+	// one a texture is looked up as given, then under "textures\", as nif texture
+	// sets are written both ways. Headers are read once per texture: preload() maps
+	// every loose .dds in parallel, archived ones are extracted on first request.
+	// Lookups are thread safe
+	class TextureIndex {
+
+	public:
+
+		struct Texture {
+			bool exists = false;
+			// found only once "textures\" was put in front of the path
+			bool prefixed = false;
+			// a DDS header was read, properties holds its fields
+			bool dds = false;
+			ImageProperties properties = {};
+		};
+
+		TextureIndex() {}
+
+		TextureIndex(const TextureIndex&) = delete;
+		TextureIndex& operator=(const TextureIndex&) = delete;
+
+		// the game Data folder and its archives, i.e. games.vfs(game). Must outlive the index
+		void add(VirtualFileSystem& files);
+		// a loose folder, walked once now
+		void add(const fs::path& folder);
+
+		const Texture& find(std::string_view path);
+		bool exists(std::string_view path) { return find(path).exists; }
+
+		// reads the header of every loose .dds of every root. 0 threads means one per core
+		void preload(size_t threads = 0);
+
+		size_t size() const;
+
+	private:
+
+		std::vector<VirtualFileSystem*> roots;
+		std::vector<std::unique_ptr<VirtualFileSystem>> owned;
+
+		mutable std::mutex mutex;
+		// normalized path as asked -> texture
+		std::unordered_map<std::string, Texture> textures;
+
+		Texture load(const std::string& key) const;
+	};
+
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <queue>
+#include <vector>
+
+namespace ckcmd {
+
+	// Fixed size pool of worker threads. Tasks are started in submission order
+	// by the first free worker, submit() returns a future for the task result
+	class ThreadPool {
+
+		std::vector<std::thread> workers;
+		std::queue<std::function<void()>> tasks;
+		std::mutex mutex;
+		std::condition_variable available;
+		std::condition_variable idle;
+		size_t running = 0;
+		bool stopping = false;
+
+		void work();
+
+	public:
+
+		// 0 threads means one per hardware core
+		explicit ThreadPool(size_t threads = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		size_t size() const { return workers.size(); }
+
+		static size_t default_threads();
+
+		// true on the threads of any pool. Work that would start a pool of its own
+		// runs inline there, a pool per worker would multiply the threads by the cores
+		static bool on_worker();
+
+		template<typename F>
+		auto submit(F&& task) -> std::future<decltype(task())>
+		{
+			typedef decltype(task()) result_t;
+			auto packaged = std::make_shared<std::packaged_task<result_t()>>(std::forward<F>(task));
+			std::future<result_t> result = packaged->get_future();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				tasks.emplace([packaged]() { (*packaged)(); });
+			}
+			available.notify_one();
+			return result;
+		}
+
+		// blocks until every submitted task has finished
+		void wait();
+
+		// runs body(i) for every i in [0, count) on all the workers and blocks until
+		// done. Indices are taken one at a time from a shared counter, so a worker
+		// stuck on a large item does not hold back the others. After an exception no
+		// new index is started and the first exception is rethrown
+		template<typename F>
+		void parallel_for(size_t count, F&& body)
+		{
+			std::atomic<size_t> next(0);
+			std::vector<std::future<void>> results;
+			results.reserve(size());
+			for (size_t t = 0; t < size(); t++)
+			{
+				results.push_back(submit([&]() {
+					for (size_t i = next++; i < count; i = next++)
+					{
+						try {
+							body(i);
+						}
+						catch (...) {
+							next = count;
+							throw;
+						}
+					}
+				}));
+			}
+			for (auto& result : results)
+				result.wait();
+			for (auto& result : results)
+				result.get();
+		}
+	};
+
+}
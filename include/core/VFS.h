@@ -0,0 +1,88 @@
+#pragma once
+
+#include <core/bsa.h>
+#include <core/BSAExtractor.h>
+#include <core/MappedFile.h>
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ckcmd {
+
+	// Bytes of a file resolved through the VirtualFileSystem: a mapping of a loose
+	// file or the extracted buffer of an archived one. Move only, the memory is
+	// released with the view
+	class FileView {
+
+		friend class VirtualFileSystem;
+
+		MappedFile mapping;
+		std::unique_ptr<const uint8_t[]> extracted;
+		const uint8_t* bytes = nullptr;
+		size_t length = 0;
+
+	public:
+
+		bool is_open() const { return bytes != nullptr; }
+		const uint8_t* data() const { return bytes; }
+		size_t size() const { return length; }
+		std::string_view view() const { return std::string_view((const char*)bytes, length); }
+		BSA::MemoryStream stream() const { return BSA::MemoryStream(bytes, length); }
+	};
+
+	// One case insensitive index over the loose files of a Data folder and the
+	// entries of its archives. Loose files win over archives, archives are searched
+	// in the given order, the first one containing a path wins.
+	// Archive listings are persisted to index_file together with the archive size and
+	// modification time, so only archives that changed are listed again. Loose files
+	// are always walked, their folders give no cheap way to detect nested changes
+	class VirtualFileSystem {
+
+		struct Source {
+			fs::path path;
+			bool archive;
+			uint64_t size;
+			int64_t mtime;
+			std::unique_ptr<BSA::BSAFile> handle;
+			std::unique_ptr<std::mutex> handle_mutex;
+		};
+
+		fs::path data_folder;
+		std::vector<Source> sources;
+		// normalized path -> source index
+		std::unordered_map<std::string, uint16_t> index;
+
+		bool loadIndex(const fs::path& index_file, std::vector<std::vector<std::string>>& listings, std::vector<char>& listed);
+		void saveIndex(const fs::path& index_file, const std::vector<std::vector<std::string>>& listings);
+		const Source* find(std::string_view path) const;
+
+	public:
+
+		VirtualFileSystem(const fs::path& data_folder, const std::list<fs::path>& archives, const fs::path& index_file = fs::path());
+
+		VirtualFileSystem(const VirtualFileSystem&) = delete;
+		VirtualFileSystem& operator=(const VirtualFileSystem&) = delete;
+
+		// lowercase, backslash separated, no leading separator or "data\" prefix
+		static std::string normalize(std::string_view path);
+
+		bool exists(std::string_view path) const;
+		bool in_archive(std::string_view path) const;
+		// loose file path or archive path providing the file, empty if not found
+		fs::path source(std::string_view path) const;
+		// invalid view if the file is not found
+		FileView open(std::string_view path);
+
+		// normalized paths of the files with the given lowercase extension, i.e. ".dds"
+		std::vector<std::string> files(std::string_view extension) const;
+
+		size_t size() const { return index.size(); }
+		const fs::path& data() const { return data_folder; }
+	};
+
+}
@@ -15,6 +15,7 @@ namespace BSA {
 	//TODO: exceptions
 	class BSAFile {
 		bsa_handle bh;
+		fs::path bsa_path;
 	public:
 
 		BSAFile(const fs::path& p) {
@@ -26,13 +27,20 @@ namespace BSA {
 
 		BSAFile(BSAFile&& other) {
 			bh = other.bh;
+			bsa_path = std::move(other.bsa_path);
 			other.bh = NULL;
 		}
 
 		void open(const fs::path& p) {
+			bsa_path = p;
 			unsigned int ret = bsa_open(&bh, p.string().c_str());
 		}
 
+		// handles are not thread safe, workers open their own from this path
+		const fs::path& path() const {
+			return bsa_path;
+		}
+
 		void close() {
 			bsa_close(bh);
 		}
@@ -4,7 +4,9 @@
 
 #include <map>
 #include <core/bsa.h>
+#include <core/VFS.h>
 #include <fstream>
+#include <memory>
 
 #define MAX_KEY_LENGTH 255
 #define MAX_VALUE_NAME 16383
@@ -130,26 +132,31 @@ namespace ckcmd {
 			}
 
 			bool load(const Games::Game& game, const std::string& path, std::vector<uint8_t>& result) {
-				//search in override
-				fs::path override_path = override(game) / path;
-				if (fs::exists(override_path) && fs::is_regular_file(override_path))
+				FileView view = open(game, path);
+				if (!view.is_open())
+					return false;
+				result.assign(view.data(), view.data() + view.size());
+				return true;
+			}
+
+			// loose files and archives of the game Data folder behind one path index,
+			// built on first use. Archive listings are kept in the temp folder
+			VirtualFileSystem& vfs(const Game& game) {
+				auto it = file_systems.find(game);
+				if (it == file_systems.end())
 				{
-					load(override_path, result);
-					return true;
-				}
-				if (opened_bsas.empty())
-					loadBsas(game);
-				for (auto& bsa_file : opened_bsas) {
-					if (bsa_file.find(path)) {
-						size_t size = -1;
-						const uint8_t* data = bsa_file.extract(path, size);
-						result.resize(size);
-						result.assign(data, data+size);
-						delete data;
-						return true;
-					}
+					std::error_code ec;
+					fs::path index_file = fs::temp_directory_path(ec) / "ck-cmd" / (Games::string(game) + ".vfs");
+					it = file_systems.emplace(game, std::make_unique<VirtualFileSystem>(data(game), bsas(game), ec ? fs::path() : index_file)).first;
 				}
-				return false;
+				return *it->second;
+			}
+
+			// loose override first, then the archives. The view maps or owns the bytes
+			FileView open(const Game& game, const std::string& path) {
+				if (!isGameInstalled(game))
+					return FileView();
+				return vfs(game).open(path);
 			}
 
 			typedef std::map<Game, fs::path> GamesPathMapT;
@@ -160,6 +167,8 @@ namespace ckcmd {
 
 			std::list<ckcmd::BSA::BSAFile> opened_bsas;
 
+			std::map<Game, std::unique_ptr<VirtualFileSystem>> file_systems;
+
 			LONG GetStringRegKey(HKEY hKey, const std::wstring &strValueName, std::wstring &strValue)
 			{
 				strValue;
@@ -3,18 +3,38 @@
 * C++ converted by aerisarn
 */
 
+#pragma once
+
+#include <cstdint>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
 
+/**
+* Havok CRC-32 as used by the animation set data: polynomial 0x04C11DB7,
+* reflected input and output, no initial or final xor.
+* %XY escapes in the input are decoded to the byte 0xXY before hashing.
+*/
 class HkCRC {
+
+	static bool update(uint32_t& crc, std::string_view input);
+
 public:
-	int crc_order = 32;
-	std::string crc_poly = "4C11DB7";
-	std::string initial_value = "000000";
-	std::string final_value = "000000";
 
-	int reflectByte(int c);
+	// CRC of the bytes as they are, nothing on a malformed escape
+	static std::optional<uint32_t> crc32(std::string_view input);
+
+	// CRC of a project path or clip name: lower case, '/' replaced with '\'.
+	// Nothing on a malformed escape
+	static std::optional<uint32_t> crc32_path(std::string_view input);
+
+	// crc32_path of each input, in order
+	static std::vector<std::optional<uint32_t>> crc32_paths(const std::vector<std::string>& inputs);
 
-	int* reflect(int* crc, int bitnum, int startLSB);
+	// decimal form stored in ClipFilesCRC32Block
+	static std::string cache_string(uint32_t crc);
 
-	std::string compute(std::string input);
-};
\ No newline at end of file
+	// upper case hex form without leading zeros, "failure" on a malformed escape
+	static std::string compute(std::string input);
+};
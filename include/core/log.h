@@ -59,6 +59,10 @@ public:
 	static void RemoveListener( ILogListenerA* pListener );
 	static void RemoveListener( ILogListenerW* pListener );
 	static void ClearListeners();
+	// messages logged by the calling thread go to pListener only, nullptr restores the
+	// shared listeners. Lets workers collect the diagnostics of the item they process.
+	// Returns the listener it replaces, so collectors can be nested
+	static ILogListenerA* SetThreadListener( ILogListenerA* pListener );
 
 	static bool IsErrorEnabled();
 	static bool IsWarnEnabled();
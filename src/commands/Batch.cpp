@@ -0,0 +1,252 @@
+#include <commands/Batch.h>
+
+#include "stdafx.h"
+#include <core/hkxcmd.h>
+#include <core/log.h>
+
+#include <core/FBXWrangler.h>
+#include <core/HavokSession.h>
+#include <core/LogCapture.h>
+#include <core/ThreadPool.h>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <set>
+
+//jobs of these commands keep no state between runs and only write where their arguments
+//say, so they may run at the same time. importfbx is not one of them: rigs write their
+//skeletons into the working folder
+static const set<string> parallel_commands = { "exportfbx", "nifscan" };
+
+string Batch::GetName() const
+{
+	return "batch";
+}
+
+string Batch::GetHelp() const
+{
+	string name = GetName();
+	transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+	// Usage: ck-cmd batch [<manifest>] [-j <threads>] [-r <records>] [--stop]
+	string usage = "Usage: " + ExeCommandList::GetExeName() + " " + name + " [<manifest>] [-j <threads>] [-r <records>] [--stop]\r\n";
+
+	const char help[] =
+		R"(Runs many commands in one process: Havok and the FBX SDK are set up once
+		for all of them instead of once per command.
+		Every line is a job, a command followed by its arguments quoted as on the
+		command line, i.e. exportfbx "meshes\my mesh.nif" -e out
+		Empty lines and lines starting with # are skipped.
+		Each job is reported with its time when it ends.
+
+		Arguments:
+			<manifest> file with the jobs. Without it jobs are read from the standard
+			           input and run as they arrive, until the input is closed
+
+		Options:
+			-j <threads>, --threads <threads>  jobs run at the same time. Only exportfbx
+			                                   and nifscan jobs run in parallel, any other
+			                                   job waits for the running ones [default: 1]
+			-r <records>, --records <records>  json lines file with one record per job
+			-s, --stop                         stop at the first failed job
+
+		)";
+	return usage + help;
+}
+
+string Batch::GetHelpShort() const
+{
+	return "Runs a list of commands in a single process";
+}
+
+struct BatchJob {
+	size_t index = 0;
+	size_t line = 0;
+	string command;
+	vector<string> args;
+	bool ok = false;
+	string exception;
+	double ms = 0.0;
+	ckcmd::LogMessages messages;
+};
+
+//{"job":..., "line":..., "command":..., "args":[...], "status":"ok"|"failed", "exception":..., "ms":...}
+static string to_json(const BatchJob& job)
+{
+	char ms[32];
+	snprintf(ms, sizeof(ms), "%.2f", job.ms);
+
+	string out = "{\"job\":" + to_string(job.index) + ",\"line\":" + to_string(job.line);
+	out += ",\"command\":" + ckcmd::json_string(job.command) + ",\"args\":[";
+	for (size_t i = 1; i < job.args.size(); i++)
+	{
+		if (i > 1)
+			out += ",";
+		out += ckcmd::json_string(job.args[i]);
+	}
+	out += string("],\"status\":\"") + (job.ok ? "ok" : "failed") + "\"";
+	if (!job.exception.empty())
+		out += ",\"exception\":" + ckcmd::json_string(job.exception);
+	out += string(",\"ms\":") + ms;
+	return out + "}";
+}
+
+class BatchJournal {
+	mutex journal_mutex;
+	ofstream records;
+	size_t finished = 0;
+	size_t failed = 0;
+	double job_ms = 0.0;
+
+public:
+
+	BatchJournal(const string& records_path)
+	{
+		if (records_path.empty())
+			return;
+		records.open(records_path, ios::trunc);
+		if (!records.is_open())
+			Log::Error("Unable to write the records %s", records_path.c_str());
+	}
+
+	size_t jobs() { lock_guard<mutex> lock(journal_mutex); return finished; }
+	size_t failures() { lock_guard<mutex> lock(journal_mutex); return failed; }
+	double total_ms() { lock_guard<mutex> lock(journal_mutex); return job_ms; }
+
+	void write(const BatchJob& job)
+	{
+		lock_guard<mutex> lock(journal_mutex);
+		finished++;
+		job_ms += job.ms;
+		if (!job.ok)
+			failed++;
+		if (records.is_open())
+			records << to_json(job) << endl;
+
+		ckcmd::LogCapture::replay(job.messages);
+		if (!job.exception.empty())
+			Log::Error("%s", job.exception.c_str());
+		Log::Info("[%zu] %s: %s in %.2f ms", job.index, job.command.c_str(), job.ok ? "ok" : "failed", job.ms);
+	}
+};
+
+//same quoting rules as the command line
+static vector<string> split_arguments(const string& line)
+{
+	int nargs = 0, nchars = 0;
+	hkxcmd::ParseLine(line.c_str(), NULL, NULL, &nargs, &nchars);
+	vector<char*> argv(nargs + 1);
+	vector<char> chars(nchars + 1);
+	hkxcmd::ParseLine(line.c_str(), argv.data(), chars.data(), &nargs, &nchars);
+	//the count includes the closing null pointer
+	return vector<string>(argv.begin(), argv.begin() + max(0, nargs - 1));
+}
+
+static void RunJob(BatchJob& job)
+{
+	auto start = chrono::steady_clock::now();
+	try {
+		job.ok = ExeCommandList::GetCommandByName(job.command)->RunJob(job.args);
+	}
+	catch (exception* e) {
+		job.exception = e->what();
+	}
+	catch (exception& e) {
+		job.exception = e.what();
+	}
+	catch (...) {
+		job.exception = "Unknown exception occurred";
+	}
+	job.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+bool Batch::InternalRunCommand(map<string, docopt::value> parsedArgs)
+{
+	size_t threads = (size_t)max(1, atoi(parsedArgs["--threads"].asString().c_str()));
+	string records = parsedArgs["--records"].isString() ? parsedArgs["--records"].asString() : "";
+	bool stop = parsedArgs["--stop"].asBool();
+
+	ifstream manifest;
+	if (parsedArgs["<manifest>"].isString())
+	{
+		manifest.open(parsedArgs["<manifest>"].asString());
+		if (!manifest.is_open())
+		{
+			Log::Error("Unable to open the manifest %s", parsedArgs["<manifest>"].asString().c_str());
+			return false;
+		}
+	}
+	istream& jobs_input = manifest.is_open() ? (istream&)manifest : cin;
+
+	auto start = chrono::steady_clock::now();
+	BatchJournal journal(records);
+	ckcmd::HavokSession::Scope havok;
+	ckcmd::FBX::FBXWrangler::KeepManagers(true);
+	{
+		unique_ptr<ckcmd::ThreadPool> pool;
+		if (threads > 1)
+			pool = make_unique<ckcmd::ThreadPool>(threads);
+
+		//jobs handed to the pool must outlive it
+		list<BatchJob> running;
+		//niflib registers its block types on the first read: the first job always runs alone
+		bool primed = false;
+		size_t count = 0;
+		size_t line_number = 0;
+		string line;
+		while (getline(jobs_input, line))
+		{
+			line_number++;
+			size_t first = line.find_first_not_of(" \t\r");
+			if (first == string::npos || line[first] == '#')
+				continue;
+			if (stop && journal.failures() > 0)
+				break;
+
+			BatchJob job;
+			job.index = ++count;
+			job.line = line_number;
+			job.args = split_arguments(line);
+			job.command = job.args[0];
+			transform(job.command.begin(), job.command.end(), job.command.begin(), ::tolower);
+
+			if (job.command == GetName())
+			{
+				job.exception = "Line " + to_string(line_number) + ": batch jobs cannot run other batches";
+				journal.write(job);
+				continue;
+			}
+
+			if (pool && primed && parallel_commands.count(job.command) > 0)
+			{
+				running.push_back(move(job));
+				BatchJob* parallel_job = &running.back();
+				pool->submit([parallel_job, &journal]() {
+					{
+						ckcmd::LogCapture diagnostics(parallel_job->messages);
+						RunJob(*parallel_job);
+					}
+					journal.write(*parallel_job);
+				});
+				continue;
+			}
+
+			if (pool)
+				pool->wait();
+			running.clear();
+			RunJob(job);
+			journal.write(job);
+			primed = true;
+		}
+		if (pool)
+			pool->wait();
+	}
+	ckcmd::FBX::FBXWrangler::KeepManagers(false);
+
+	double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	Log::Info("Batch: %zu jobs, %zu failed, %.2f ms of jobs in %.2f ms", journal.jobs(), journal.failures(), journal.total_ms(), ms);
+	return journal.failures() == 0;
+}
@@ -0,0 +1,908 @@
+#include <commands/Benchmark.h>
+
+#include "stdafx.h"
+#include <core/hkxcmd.h>
+#include <core/log.h>
+
+#include <commands/Geometry.h>
+
+#include <bs/AnimDataFile.h>
+#include <bs/AnimSetDataFile.h>
+#include <core/AnimationCache.h>
+#include <core/BSpline.h>
+#include <core/CompiledCache.h>
+#include <core/hkcrc.h>
+#include <core/KeyTrack.h>
+#include <core/MappedFile.h>
+#include <core/NifFile.h>
+#include <core/NiflibHelper.h>
+
+#include <obj/NiBSplineBasisData.h>
+#include <obj/NiBSplineData.h>
+#include <obj/NiBSplineCompTransformInterpolator.h>
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+static bool BenchmarkAnimationData(const fs::path& cachePath, int iterations);
+static bool BenchmarkAnimationCache(const fs::path& cachePath, int iterations);
+static bool BenchmarkCRC(const fs::path& dataPath, int iterations);
+static bool BenchmarkNif(const fs::path& meshesPath, int iterations);
+static bool BenchmarkPartitions(const fs::path& meshesPath, int iterations);
+static bool BenchmarkKeys(const fs::path& kfPath, int iterations);
+static bool BenchmarkBSplines(const fs::path& kfPath, int iterations);
+
+string Benchmark::GetName() const
+{
+	return "benchmark";
+}
+
+string Benchmark::GetHelp() const
+{
+	string name = GetName();
+	transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+	// Usage: ck-cmd benchmark <suite> <path> [-n <iterations>]
+	string usage = "Usage: " + ExeCommandList::GetExeName() + " " + name + " <suite> <path> [-n <iterations>]\r\n";
+
+	const char help[] =
+		R"(Measures the throughput of ck-cmd core routines on real game data
+		
+		Arguments:
+			<suite> benchmark to run, see below
+			<path> input of the benchmark
+
+		Options:
+			-n <iterations>  times each measure is repeated [default: 10]
+
+		Suites:
+			animdata   parse and write back animationdatasinglefile.txt and animationsetdatasinglefile.txt.
+			           <path> is the folder containing the two merged cache files
+			animcache  load the same two files into an AnimationCache, query the sets of every
+			           creature and rewrite both files project by project, as CacheGen does.
+			           Then load them again through the compiled cache, which is written
+			           next to them if missing
+			crc        HkCRC of every file name and folder under <path> (i.e. Data\meshes),
+			           timed against the bitwise reference implementation
+			nif        load and save every .nif under <path> through the stream copies
+			           (ifstream, istringstream, ostringstream) and through mapped
+			           files and preallocated buffers
+			partition  remake the skin partitions of every skinned shape of the .nif files
+			           under <path>, with 60 bones per partition and 4 per vertex.
+			           Meant for high poly bodies, i.e. meshes\actors\character\character assets
+			kf         resample the translation, rotation and scale keys of every .kf under <path>
+			           at 30 fps as importkf does, through the key tracks and through the
+			           per frame key walk, and check they agree.
+			           Meant for Oblivion animations, i.e. meshes\characters\_male
+			bspline    decompress the B-spline interpolators of every .kf under <path> at 30 fps
+			           as importkf does, through de Boor's algorithm and through the recursive
+			           evaluation, and check they agree
+
+		)";
+	return usage + help;
+}
+
+string Benchmark::GetHelpShort() const
+{
+	return "Measures the throughput of core routines";
+}
+
+bool Benchmark::InternalRunCommand(map<string, docopt::value> parsedArgs)
+{
+	string suite = parsedArgs["<suite>"].asString();
+	string path = parsedArgs["<path>"].asString();
+	int iterations = max(1, atoi(parsedArgs["-n"].asString().c_str()));
+	transform(suite.begin(), suite.end(), suite.begin(), ::tolower);
+
+	if (suite == "animdata")
+		return BenchmarkAnimationData(path, iterations);
+	if (suite == "animcache")
+		return BenchmarkAnimationCache(path, iterations);
+	if (suite == "crc")
+		return BenchmarkCRC(path, iterations);
+	if (suite == "nif")
+		return BenchmarkNif(path, iterations);
+	if (suite == "partition")
+		return BenchmarkPartitions(path, iterations);
+	if (suite == "kf")
+		return BenchmarkKeys(path, iterations);
+	if (suite == "bspline")
+		return BenchmarkBSplines(path, iterations);
+
+	Log::Error("Unknown benchmark suite: %s", suite.c_str());
+	return false;
+}
+
+typedef std::chrono::high_resolution_clock bench_clock;
+
+static double elapsed_ms(const bench_clock::time_point& start)
+{
+	return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+}
+
+static string strip_carriage_returns(const string& content)
+{
+	string out;
+	out.reserve(content.size());
+	for (char c : content)
+		if (c != '\r') out += c;
+	return out;
+}
+
+bool BenchmarkAnimationData(const fs::path& cachePath, int iterations)
+{
+	fs::path animDataPath = cachePath / AnimationCache::animation_data_merged_file;
+	fs::path animDataSetPath = cachePath / AnimationCache::animation_set_data_merged_file;
+	if (!fs::exists(animDataPath) || !fs::exists(animDataSetPath))
+	{
+		Log::Error("Cannot locate cache files: %s", cachePath.string().c_str());
+		return false;
+	}
+
+	auto start = bench_clock::now();
+	string animationDataContent = AnimationCache::read_file(animDataPath);
+	string animationSetDataContent = AnimationCache::read_file(animDataSetPath);
+	double read_ms = elapsed_ms(start);
+	double megabytes = (animationDataContent.size() + animationSetDataContent.size()) / (1024.0 * 1024.0);
+	Log::Info("Read %.2f MB in %.2f ms", megabytes, read_ms);
+
+	double parse_ms = 0.0, write_ms = 0.0;
+	string animationDataOut, animationSetDataOut;
+	for (int i = 0; i < iterations; i++)
+	{
+		AnimData::AnimDataFile animationData;
+		AnimData::AnimSetDataFile animationSetData;
+		start = bench_clock::now();
+		animationData.parse(animationDataContent);
+		animationSetData.parse(animationSetDataContent);
+		parse_ms += elapsed_ms(start);
+
+		start = bench_clock::now();
+		animationDataOut = animationData.toString();
+		animationSetDataOut = animationSetData.toString();
+		write_ms += elapsed_ms(start);
+	}
+	parse_ms /= iterations;
+	write_ms /= iterations;
+
+	Log::Info("Parse: %.2f ms, %.2f MB/s", parse_ms, megabytes / (parse_ms / 1000.0));
+	Log::Info("Write: %.2f ms, %.2f MB/s", write_ms, megabytes / (write_ms / 1000.0));
+
+	//the writer always emits \n line ends
+	bool identical = animationDataOut == strip_carriage_returns(animationDataContent) &&
+		animationSetDataOut == strip_carriage_returns(animationSetDataContent);
+	if (identical)
+		Log::Info("Round trip: output identical to input");
+	else
+		Log::Warn("Round trip: output differs from input");
+	return true;
+}
+
+bool BenchmarkAnimationCache(const fs::path& cachePath, int iterations)
+{
+	fs::path animDataPath = cachePath / AnimationCache::animation_data_merged_file;
+	fs::path animDataSetPath = cachePath / AnimationCache::animation_set_data_merged_file;
+	if (!fs::exists(animDataPath) || !fs::exists(animDataSetPath))
+	{
+		Log::Error("Cannot locate cache files: %s", cachePath.string().c_str());
+		return false;
+	}
+
+	string animationDataContent = AnimationCache::read_file(animDataPath);
+	string animationSetDataContent = AnimationCache::read_file(animDataSetPath);
+	double megabytes = (animationDataContent.size() + animationSetDataContent.size()) / (1024.0 * 1024.0);
+
+	double load_ms = 0.0, query_ms = 0.0, rewrite_ms = 0.0;
+	size_t projects = 0, sets = 0, events = 0;
+	string animationDataOut, animationSetDataOut;
+	for (int i = 0; i < iterations; i++)
+	{
+		auto start = bench_clock::now();
+		AnimationCache cache(animationDataContent, animationSetDataContent);
+		load_ms += elapsed_ms(start);
+
+		start = bench_clock::now();
+		sets = events = 0;
+		for (auto& creature : cache.creature_entries)
+		{
+			for (const auto& set_file : creature->getProjectSetFiles())
+			{
+				events += creature->getProjectSetEvents(set_file).size();
+				events += creature->getProjectSetVariables(set_file).getVariables().size();
+				sets++;
+			}
+		}
+		query_ms += elapsed_ms(start);
+
+		start = bench_clock::now();
+		AnimData::AnimDataFile animationData;
+		AnimData::AnimSetDataFile animationSetData;
+		const auto& project_list = cache.animationData.getProjectList();
+		projects = project_list.size();
+		for (size_t p = 0; p < projects; p++)
+		{
+			AnimData::ProjectBlock& block = cache.animationData.getProjectBlock((int)p);
+			if (block.getHasAnimationCache())
+				animationData.putProject(project_list[(int)p], block, cache.animationData.getprojectMovementBlock((int)p));
+			else
+				animationData.putProject(project_list[(int)p], block);
+		}
+		const auto& set_list = cache.animationSetData.getProjectsList();
+		for (size_t s = 0; s < set_list.size(); s++)
+			animationSetData.putProjectAttackBlock(set_list[(int)s], cache.animationSetData.getProjectAttackBlock((int)s));
+		animationDataOut = animationData.toString();
+		animationSetDataOut = animationSetData.toString();
+		rewrite_ms += elapsed_ms(start);
+	}
+	load_ms /= iterations;
+	query_ms /= iterations;
+	rewrite_ms /= iterations;
+
+	Log::Info("%zu projects, %zu creature sets, %zu events and variables", projects, sets, events);
+	Log::Info("Load: %.2f ms, %.2f MB/s", load_ms, megabytes / (load_ms / 1000.0));
+	Log::Info("Query: %.3f ms", query_ms);
+	Log::Info("Rewrite: %.2f ms, %.2f MB/s", rewrite_ms, megabytes / (rewrite_ms / 1000.0));
+
+	bool identical = animationDataOut == strip_carriage_returns(animationDataContent) &&
+		animationSetDataOut == strip_carriage_returns(animationSetDataContent);
+	if (identical)
+		Log::Info("Round trip: output identical to input");
+	else
+		Log::Warn("Round trip: output differs from input");
+
+	//the first load from the files writes the compiled image, the next ones map it
+	{
+		AnimationCache cache(animDataPath, animDataSetPath);
+	}
+	ckcmd::CompiledCache compiled;
+	if (!compiled.open(cachePath / AnimationCache::compiled_cache_file))
+	{
+		Log::Warn("No compiled cache written in %s", cachePath.string().c_str());
+		return true;
+	}
+	double compiled_ms = 0.0, lookup_ms = 0.0;
+	size_t found = 0;
+	for (int i = 0; i < iterations; i++)
+	{
+		auto start = bench_clock::now();
+		AnimationCache cache(animDataPath, animDataSetPath);
+		compiled_ms += elapsed_ms(start);
+		if (i == 0)
+		{
+			animationDataOut = cache.animationData.toString();
+			animationSetDataOut = cache.animationSetData.toString();
+		}
+
+		start = bench_clock::now();
+		found = 0;
+		for (size_t p = 0; p < compiled.projects(); p++)
+			found += compiled.find(compiled.project_name(p)) == (int)p;
+		lookup_ms += elapsed_ms(start);
+	}
+	compiled_ms /= iterations;
+	lookup_ms /= iterations;
+
+	Log::Info("Compiled load: %.2f ms, %.1fx the text load", compiled_ms, compiled_ms > 0 ? load_ms / compiled_ms : 0.0);
+	Log::Info("Compiled lookup: %.3f ms, %zu of %zu projects found", lookup_ms, found, compiled.projects());
+	identical = animationDataOut == strip_carriage_returns(animationDataContent) &&
+		animationSetDataOut == strip_carriage_returns(animationSetDataContent);
+	if (identical)
+		Log::Info("Compiled round trip: output identical to input");
+	else
+		Log::Warn("Compiled round trip: output differs from input");
+	return true;
+}
+
+//one bit at a time, the timing baseline of the tables. Correctness is covered by the
+//fixed values in test/HkCRCTest.cpp
+static uint32_t reference_crc32(const string& input)
+{
+	uint32_t crc = 0;
+	for (unsigned char c : input)
+	{
+		crc ^= c;
+		for (int bit = 0; bit < 8; bit++)
+			crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+	}
+	return crc;
+}
+
+bool BenchmarkCRC(const fs::path& dataPath, int iterations)
+{
+	if (!fs::exists(dataPath) || !fs::is_directory(dataPath))
+	{
+		Log::Error("Invalid folder: %s", dataPath.string().c_str());
+		return false;
+	}
+
+	set<string> unique_names;
+	for (auto& entry : fs::recursive_directory_iterator(dataPath))
+	{
+		fs::path relative = "meshes" / fs::relative(entry.path(), dataPath);
+		if (entry.is_directory())
+			unique_names.insert(relative.string());
+		else
+			unique_names.insert(entry.path().filename().replace_extension("").string());
+	}
+	vector<string> names(unique_names.begin(), unique_names.end());
+	size_t bytes = 0;
+	for (const auto& name : names)
+		bytes += name.size();
+	Log::Info("Hashing %zu names, %zu bytes", names.size(), bytes);
+
+	uint32_t checksum = 0;
+	auto start = bench_clock::now();
+	for (int i = 0; i < iterations; i++)
+		for (auto crc : HkCRC::crc32_paths(names))
+			checksum ^= crc.value_or(0);
+	double table_ms = elapsed_ms(start) / iterations;
+
+	start = bench_clock::now();
+	for (int i = 0; i < iterations; i++)
+		for (const auto& name : names)
+			checksum ^= reference_crc32(name);
+	double reference_ms = elapsed_ms(start) / iterations;
+
+	Log::Info("Table: %.3f ms, %.2f MB/s", table_ms, bytes / (1024.0 * 1024.0) / (table_ms / 1000.0));
+	Log::Info("Reference: %.3f ms, %.2f MB/s", reference_ms, bytes / (1024.0 * 1024.0) / (reference_ms / 1000.0));
+	Log::Info("Checksum %u", checksum);
+	return true;
+}
+
+bool BenchmarkNif(const fs::path& meshesPath, int iterations)
+{
+	if (!fs::exists(meshesPath) || !fs::is_directory(meshesPath))
+	{
+		Log::Error("Invalid folder: %s", meshesPath.string().c_str());
+		return false;
+	}
+
+	vector<fs::path> nifs;
+	for (auto& entry : fs::recursive_directory_iterator(meshesPath))
+	{
+		string extension = entry.path().extension().string();
+		transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (entry.is_regular_file() && extension == ".nif")
+			nifs.push_back(entry.path());
+	}
+
+	//keep only the files niflib can read, so both paths measure the same work
+	vector<fs::path> valid;
+	size_t bytes = 0;
+	for (const auto& nif : nifs)
+	{
+		try {
+			NifInfo info;
+			ReadNifList(nif.string(), &info);
+			valid.push_back(nif);
+			bytes += (size_t)fs::file_size(nif);
+		}
+		catch (const std::exception& e) {
+			Log::Warn("Skipping %s: %s", nif.string().c_str(), e.what());
+		}
+	}
+	double megabytes = bytes / (1024.0 * 1024.0);
+	Log::Info("Loading %zu of %zu nifs, %.2f MB", valid.size(), nifs.size(), megabytes);
+
+	double stream_load_ms = 0.0, mapped_load_ms = 0.0;
+	double stream_save_ms = 0.0, buffer_save_ms = 0.0;
+	size_t mismatches = 0;
+	vector<uint8_t> output;
+	for (int i = 0; i < iterations; i++)
+	{
+		for (const auto& nif : valid)
+		{
+			//what the BSA and loose paths used to do: file -> string -> istringstream
+			NifInfo stream_info;
+			auto start = bench_clock::now();
+			ifstream file(nif.string(), ios::binary);
+			string sdata((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+			istringstream iss(sdata);
+			vector<NiObjectRef> stream_blocks = ReadNifList(iss, &stream_info);
+			stream_load_ms += elapsed_ms(start);
+
+			NifInfo mapped_info;
+			start = bench_clock::now();
+			vector<NiObjectRef> mapped_blocks = ckcmd::NIF::ReadNifMapped(nif, &mapped_info);
+			mapped_load_ms += elapsed_ms(start);
+
+			start = bench_clock::now();
+			ostringstream oss;
+			WriteNifTree(oss, GetFirstRoot(stream_blocks), stream_info);
+			string stream_out = oss.str();
+			stream_save_ms += elapsed_ms(start);
+
+			start = bench_clock::now();
+			size_t written = ckcmd::NIF::WriteNifBuffer(output, GetFirstRoot(mapped_blocks), mapped_info);
+			buffer_save_ms += elapsed_ms(start);
+
+			if (i == 0 && (written != stream_out.size() || memcmp(output.data(), stream_out.data(), written) != 0))
+			{
+				Log::Error("Output mismatch: %s", nif.string().c_str());
+				mismatches++;
+			}
+		}
+	}
+	stream_load_ms /= iterations;
+	mapped_load_ms /= iterations;
+	stream_save_ms /= iterations;
+	buffer_save_ms /= iterations;
+
+	Log::Info("Load, stream copies: %.2f ms, %.2f MB/s", stream_load_ms, megabytes / (stream_load_ms / 1000.0));
+	Log::Info("Load, mapped: %.2f ms, %.2f MB/s", mapped_load_ms, megabytes / (mapped_load_ms / 1000.0));
+	Log::Info("Save, ostringstream: %.2f ms, %.2f MB/s", stream_save_ms, megabytes / (stream_save_ms / 1000.0));
+	Log::Info("Save, buffer: %.2f ms, %.2f MB/s", buffer_save_ms, megabytes / (buffer_save_ms / 1000.0));
+	Log::Info("%zu nifs read, %zu output mismatches", valid.size(), mismatches);
+	return mismatches == 0;
+}
+
+static vector<NiTriBasedGeomRef> skinned_shapes(const vector<NiObjectRef>& blocks)
+{
+	vector<NiTriBasedGeomRef> shapes;
+	for (const auto& block : blocks)
+	{
+		NiTriBasedGeomRef shape = DynamicCast<NiTriBasedGeom>(block);
+		if (shape == NULL || shape->GetSkinInstance() == NULL)
+			continue;
+		NiSkinInstanceRef skin = shape->GetSkinInstance();
+		NiSkinPartitionRef partition = skin->GetSkinPartition();
+		if (partition == NULL && skin->GetData() != NULL)
+			partition = skin->GetData()->GetSkinPartition();
+		if (partition != NULL)
+			shapes.push_back(shape);
+	}
+	return shapes;
+}
+
+static void partition_stats(const vector<NiTriBasedGeomRef>& shapes, size_t& partitions, size_t& triangles, size_t& max_bones)
+{
+	for (const auto& shape : shapes)
+	{
+		for (const auto& block : shape->GetSkinInstance()->GetSkinPartition()->GetSkinPartitionBlocks())
+		{
+			partitions++;
+			triangles += block.triangles.size() + ckcmd::Geometry::triangulate(block.strips).size();
+			max_bones = max(max_bones, block.bones.size());
+		}
+	}
+}
+
+bool BenchmarkPartitions(const fs::path& meshesPath, int iterations)
+{
+	if (!fs::exists(meshesPath) || !fs::is_directory(meshesPath))
+	{
+		Log::Error("Invalid folder: %s", meshesPath.string().c_str());
+		return false;
+	}
+
+	vector<fs::path> nifs;
+	for (auto& entry : fs::recursive_directory_iterator(meshesPath))
+	{
+		string extension = entry.path().extension().string();
+		transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (entry.is_regular_file() && extension == ".nif")
+			nifs.push_back(entry.path());
+	}
+
+	//remake_partitions changes the shapes, every iteration works on a fresh copy
+	vector<fs::path> skinned;
+	size_t partitions_before = 0, triangles = 0, max_bones_before = 0;
+	for (const auto& nif : nifs)
+	{
+		try {
+			vector<NiObjectRef> blocks = ckcmd::NIF::ReadNifMapped(nif, NULL);
+			vector<NiTriBasedGeomRef> shapes = skinned_shapes(blocks);
+			if (shapes.empty())
+				continue;
+			skinned.push_back(nif);
+			partition_stats(shapes, partitions_before, triangles, max_bones_before);
+		}
+		catch (const std::exception& e) {
+			Log::Warn("Skipping %s: %s", nif.string().c_str(), e.what());
+		}
+	}
+	Log::Info("%zu of %zu nifs are skinned, %zu triangles in %zu partitions, up to %zu bones each",
+		skinned.size(), nifs.size(), triangles, partitions_before, max_bones_before);
+
+	double partition_ms = 0.0;
+	size_t partitions_after = 0, triangles_after = 0, max_bones_after = 0;
+	for (int i = 0; i < iterations; i++)
+	{
+		for (const auto& nif : skinned)
+		{
+			vector<NiObjectRef> blocks = ckcmd::NIF::ReadNifMapped(nif, NULL);
+			vector<NiTriBasedGeomRef> shapes = skinned_shapes(blocks);
+			auto start = bench_clock::now();
+			for (auto& shape : shapes)
+			{
+				int bones = 60;
+				int weights = 4;
+				remake_partitions(shape, bones, weights, false, false);
+			}
+			partition_ms += elapsed_ms(start);
+			if (i == 0)
+				partition_stats(shapes, partitions_after, triangles_after, max_bones_after);
+		}
+	}
+	partition_ms /= iterations;
+
+	Log::Info("Partition: %.2f ms, %.2f M triangles/s", partition_ms, triangles / 1000000.0 / (partition_ms / 1000.0));
+	Log::Info("%zu partitions, up to %zu bones each, %zu triangles", partitions_after, max_bones_after, triangles_after);
+	if (triangles_after != triangles)
+		Log::Error("Triangle count changed: %zu before, %zu after", triangles, triangles_after);
+	return triangles_after == triangles && max_bones_after <= 60;
+}
+
+//the per frame key walk importkf resampled with before the key tracks
+template <typename K>
+static bool reference_time_index(float time, const vector<K>& keys, int& i, int& j, float& x)
+{
+	int count = (int)keys.size();
+	if (count == 0)
+		return false;
+	if (time <= keys[0].time) {
+		i = j = 0;
+		x = 0.0f;
+		return true;
+	}
+	if (time >= keys[count - 1].time) {
+		i = j = count - 1;
+		x = 0.0f;
+		return true;
+	}
+	if (i < 0 || i >= count)
+		i = 0;
+
+	float tI = keys[i].time;
+	if (time > tI) {
+		j = i + 1;
+		float tJ;
+		while (time >= (tJ = keys[j].time)) {
+			i = j++;
+			tI = tJ;
+		}
+		x = (time - tI) / (tJ - tI);
+		return true;
+	}
+	else if (time < tI) {
+		j = i - 1;
+		float tJ;
+		while (time <= (tJ = keys[j].time)) {
+			i = j--;
+			tI = tJ;
+		}
+		x = 1.0f - (time - tI) / (tJ - tI);
+		swap(i, j);
+		return true;
+	}
+	j = i;
+	x = 0.0f;
+	return true;
+}
+
+template <typename T>
+static bool reference_interpolate(int interpolation, T& value, const vector<Key<T>>& keys, float time, int& last)
+{
+	int next;
+	float x;
+	if (!reference_time_index(time, keys, last, next, x))
+		return false;
+
+	const T& v1 = keys[last].data;
+	const T& v2 = keys[next].data;
+	if (interpolation == QUADRATIC_KEY)
+	{
+		const T& t1 = keys[last].backward_tangent;
+		const T& t2 = keys[next].forward_tangent;
+		float x2 = x * x;
+		float x3 = x2 * x;
+		value = v1 * (2.0f * x3 - 3.0f * x2 + 1.0f) + v2 * (-2.0f * x3 + 3.0f * x2) + t1 * (x3 - 2.0f * x2 + x) + t2 * (x3 - x2);
+	}
+	else if (interpolation == CONST_KEY)
+		value = x < 0.5f ? v1 : v2;
+	else
+		value = v1 + (v2 - v1) * x;
+	return true;
+}
+
+static bool reference_interpolate(int, Quaternion& value, const vector<Key<Quaternion>>& keys, float time, int& last)
+{
+	int next;
+	float x;
+	if (!reference_time_index(time, keys, last, next, x))
+		return false;
+
+	Quaternion v1 = keys[last].data;
+	Quaternion v2 = keys[next].data;
+	if (v1.Dot(v2) < 0)
+		v1 = v1.Inverse();
+	value = QuaternionSlerp(x, v1, v2);
+	return true;
+}
+
+static float key_difference(float a, float b) { return fabs(a - b) / max(1.0f, fabs(a)); }
+static float key_difference(const Vector3& a, const Vector3& b) { return max(key_difference(a.x, b.x), max(key_difference(a.y, b.y), key_difference(a.z, b.z))); }
+static float key_difference(const Quaternion& a, const Quaternion& b) { return max(max(key_difference(a.w, b.w), key_difference(a.x, b.x)), max(key_difference(a.y, b.y), key_difference(a.z, b.z))); }
+
+struct KeyBench
+{
+	double walk_ms = 0.0;
+	double track_ms = 0.0;
+	size_t keys = 0;
+	size_t samples = 0;
+	size_t mismatches = 0;
+
+	template <typename T>
+	void run(const vector<Key<T>>& keys, int interpolation, float step, int frames, bool check)
+	{
+		if (keys.empty())
+			return;
+		vector<T> walked(frames), tracked(frames);
+
+		auto start = bench_clock::now();
+		int last = 0;
+		for (int frame = 0; frame < frames; frame++)
+			reference_interpolate(interpolation, walked[frame], keys, frame * step, last);
+		walk_ms += elapsed_ms(start);
+
+		start = bench_clock::now();
+		ckcmd::KeyTrack<T> track(keys, interpolation);
+		track.sample(step, frames, tracked.data());
+		track_ms += elapsed_ms(start);
+
+		if (!check)
+			return;
+		this->keys += keys.size();
+		samples += frames;
+		for (int frame = 0; frame < frames; frame++)
+			if (!(key_difference(walked[frame], tracked[frame]) <= 1e-4f))
+				mismatches++;
+	}
+};
+
+struct KeyframeClip
+{
+	float duration;
+	int frames;
+	NiTransformDataRef data;
+};
+
+bool BenchmarkKeys(const fs::path& kfPath, int iterations)
+{
+	if (!fs::exists(kfPath) || !fs::is_directory(kfPath))
+	{
+		Log::Error("Invalid folder: %s", kfPath.string().c_str());
+		return false;
+	}
+
+	vector<fs::path> kfs;
+	for (auto& entry : fs::recursive_directory_iterator(kfPath))
+	{
+		string extension = entry.path().extension().string();
+		transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (entry.is_regular_file() && extension == ".kf")
+			kfs.push_back(entry.path());
+	}
+
+	//the keyframe data of every controlled block, with the frames importkf samples it at
+	vector<KeyframeClip> clips;
+	for (const auto& kf : kfs)
+	{
+		try {
+			for (const auto& block : ckcmd::NIF::ReadNifMapped(kf, NULL))
+			{
+				NiControllerSequenceRef seq = DynamicCast<NiControllerSequence>(block);
+				if (seq == NULL)
+					continue;
+				float duration = seq->GetStopTime() - seq->GetStartTime();
+				int frames = (int)roundf(duration / 0.033333f);
+				for (const auto& controlled : seq->GetControlledBlocks())
+				{
+					NiTransformInterpolatorRef interpolator = DynamicCast<NiTransformInterpolator>(controlled.interpolator);
+					if (interpolator != NULL && interpolator->GetData() != NULL)
+						clips.push_back({ duration, frames, interpolator->GetData() });
+				}
+			}
+		}
+		catch (const std::exception& e) {
+			Log::Warn("Skipping %s: %s", kf.string().c_str(), e.what());
+		}
+	}
+	Log::Info("%zu tracks in %zu kfs", clips.size(), kfs.size());
+
+	KeyBench bench;
+	for (int i = 0; i < iterations; i++)
+	{
+		for (const auto& clip : clips)
+		{
+			float step = clip.duration / (clip.frames - 1);
+			KeyGroup<Vector3> translations = clip.data->GetTranslations();
+			bench.run(translations.keys, translations.interpolation, step, clip.frames, i == 0);
+			if (clip.data->GetRotationType() == XYZ_ROTATION_KEY)
+			{
+				Niflib::array<3, KeyGroup<float>> rotations = clip.data->GetXyzRotations();
+				for (int axis = 0; axis < 3; axis++)
+					bench.run(rotations[axis].keys, rotations[axis].interpolation, step, clip.frames, i == 0);
+			}
+			else
+				bench.run(clip.data->GetQuaternionKeys(), clip.data->GetRotationType(), step, clip.frames, i == 0);
+			KeyGroup<float> scales = clip.data->GetScales();
+			bench.run(scales.keys, scales.interpolation, step, clip.frames, i == 0);
+		}
+	}
+	bench.walk_ms /= iterations;
+	bench.track_ms /= iterations;
+
+	Log::Info("Key walk: %.2f ms, %.2f M samples/s", bench.walk_ms, bench.samples / 1000000.0 / (bench.walk_ms / 1000.0));
+	Log::Info("Key tracks: %.2f ms, %.2f M samples/s", bench.track_ms, bench.samples / 1000000.0 / (bench.track_ms / 1000.0));
+	Log::Info("%zu keys resampled to %zu samples, %zu mismatches", bench.keys, bench.samples, bench.mismatches);
+	return bench.mismatches == 0;
+}
+
+//the recursive Cox-de Boor evaluation importkf sampled B-spline interpolators with
+static float reference_blend(int k, int t, const int* u, float v)
+{
+	if (t == 1)
+		return ((u[k] <= v) && (v < u[k + 1])) ? 1.0f : 0.0f;
+	if ((u[k + t - 1] == u[k]) && (u[k + t] == u[k + 1]))
+		return 0.0f;
+	if (u[k + t - 1] == u[k])
+		return (u[k + t] - v) / (u[k + t] - u[k + 1]) * reference_blend(k + 1, t - 1, u, v);
+	if (u[k + t] == u[k + 1])
+		return (v - u[k]) / (u[k + t - 1] - u[k]) * reference_blend(k, t - 1, u, v);
+	return (v - u[k]) / (u[k + t - 1] - u[k]) * reference_blend(k, t - 1, u, v) +
+		(u[k + t] - v) / (u[k + t] - u[k + 1]) * reference_blend(k + 1, t - 1, u, v);
+}
+
+static void reference_bspline(int n, int t, int l, const float* control, float* output, int num_output)
+{
+	vector<int> u(n + t + 1);
+	for (int j = 0; j <= n + t; j++)
+		u[j] = j < t ? 0 : (j <= n ? j - t + 1 : n - t + 2);
+
+	float increment = (float)(n - t + 2) / (num_output - 1);
+	float interval = 0;
+	for (int output_index = 0; output_index < num_output - 1; output_index++) {
+		float* point = &output[output_index * l];
+		for (int j = 0; j < l; j++)
+			point[j] = 0;
+		for (int k = 0; k <= n; k++) {
+			float temp = reference_blend(k, t, u.data(), interval);
+			for (int j = 0; j < l; j++)
+				point[j] = point[j] + control[k * l + j] * temp;
+		}
+		interval = interval + increment;
+	}
+	for (int j = 0; j < l; j++)
+		output[(num_output - 1) * l + j] = control[n * l + j];
+}
+
+struct BenchmarkSplineData {};
+
+template<>
+struct Accessor<BenchmarkSplineData> {
+
+	NiBSplineData& _data;
+
+	Accessor(NiBSplineData& data) : _data(data) {}
+
+	// count control points from offset, compact ones scaled to [-1, 1]
+	bool GetControlPoints(bool compact, int offset, int count, vector<float>& out) const
+	{
+		size_t size = compact ? _data.compactControlPoints.size() : _data.floatControlPoints.size();
+		if (offset < 0 || count <= 0 || size_t(offset + count) > size)
+			return false;
+		out.resize(count);
+		for (int i = 0; i < count; i++)
+			out[i] = compact ? float(_data.compactControlPoints[offset + i]) / float(32767) : _data.floatControlPoints[offset + i];
+		return true;
+	}
+};
+
+struct SplineCurve
+{
+	int channels;
+	int frames;
+	int control_points;
+	vector<float> control;
+};
+
+bool BenchmarkBSplines(const fs::path& kfPath, int iterations)
+{
+	if (!fs::exists(kfPath) || !fs::is_directory(kfPath))
+	{
+		Log::Error("Invalid folder: %s", kfPath.string().c_str());
+		return false;
+	}
+
+	vector<fs::path> kfs;
+	for (auto& entry : fs::recursive_directory_iterator(kfPath))
+	{
+		string extension = entry.path().extension().string();
+		transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (entry.is_regular_file() && extension == ".kf")
+			kfs.push_back(entry.path());
+	}
+
+	//the translation, rotation and scale curves importkf samples, the ones with more than 3 control points
+	vector<SplineCurve> curves;
+	size_t control_points = 0;
+	for (const auto& kf : kfs)
+	{
+		try {
+			for (const auto& block : ckcmd::NIF::ReadNifMapped(kf, NULL))
+			{
+				NiControllerSequenceRef seq = DynamicCast<NiControllerSequence>(block);
+				if (seq == NULL)
+					continue;
+				int frames = (int)roundf((seq->GetStopTime() - seq->GetStartTime()) / 0.033333f);
+				if (frames < 2)
+					continue;
+				for (const auto& controlled : seq->GetControlledBlocks())
+				{
+					NiBSplineTransformInterpolatorRef interpolator = DynamicCast<NiBSplineTransformInterpolator>(controlled.interpolator);
+					if (interpolator == NULL || interpolator->GetSplineData() == NULL || interpolator->GetBasisData() == NULL)
+						continue;
+					int nctrl = interpolator->GetBasisData()->GetNumControlPoints();
+					if (nctrl <= 3)
+						continue;
+					bool compact = DynamicCast<NiBSplineCompTransformInterpolator>(controlled.interpolator) != NULL;
+					Accessor<BenchmarkSplineData> data(*interpolator->GetSplineData());
+					pair<unsigned int, int> handles[] = {
+						{ interpolator->GetTranslationHandle(), 3 },
+						{ interpolator->GetRotationHandle(), 4 },
+						{ interpolator->GetScaleHandle(), 1 }
+					};
+					for (const auto& handle : handles)
+					{
+						SplineCurve curve = { handle.second, frames, nctrl };
+						if (handle.first != USHRT_MAX && data.GetControlPoints(compact, handle.first, nctrl * handle.second, curve.control))
+						{
+							control_points += nctrl;
+							curves.push_back(curve);
+						}
+					}
+				}
+			}
+		}
+		catch (const std::exception& e) {
+			Log::Warn("Skipping %s: %s", kf.string().c_str(), e.what());
+		}
+	}
+	Log::Info("%zu curves, %zu control points in %zu kfs", curves.size(), control_points, kfs.size());
+
+	double recursive_ms = 0.0, de_boor_ms = 0.0;
+	size_t samples = 0, mismatches = 0;
+	vector<float> recursive, de_boor;
+	for (int i = 0; i < iterations; i++)
+	{
+		for (const auto& curve : curves)
+		{
+			recursive.resize(curve.frames * curve.channels);
+			de_boor.resize(curve.frames * curve.channels);
+
+			auto start = bench_clock::now();
+			reference_bspline(curve.control_points - 1, 4, curve.channels, curve.control.data(), recursive.data(), curve.frames);
+			recursive_ms += elapsed_ms(start);
+
+			start = bench_clock::now();
+			ckcmd::BSpline(curve.control_points, 3).sample(curve.control.data(), curve.channels, de_boor.data(), curve.frames);
+			de_boor_ms += elapsed_ms(start);
+
+			if (i > 0)
+				continue;
+			samples += curve.frames;
+			for (size_t j = 0; j < de_boor.size(); j++)
+				if (!(fabs(recursive[j] - de_boor[j]) <= 1e-4f * max(1.0f, fabs(recursive[j]))))
+					mismatches++;
+		}
+	}
+	recursive_ms /= iterations;
+	de_boor_ms /= iterations;
+
+	Log::Info("Recursive: %.2f ms, %.2f M samples/s", recursive_ms, samples / 1000000.0 / (recursive_ms / 1000.0));
+	Log::Info("de Boor: %.2f ms, %.2f M samples/s", de_boor_ms, samples / 1000000.0 / (de_boor_ms / 1000.0));
+	Log::Info("%zu samples, %zu mismatches", samples, mismatches);
+	return mismatches == 0;
+}
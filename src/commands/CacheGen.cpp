@@ -11,13 +11,30 @@
 #include <bs/AnimDataFile.h>
 #include <bs/AnimSetDataFile.h>
 #include <core/AnimationCache.h>
+#include <core/CacheManifest.h>
+#include <core/FileBatch.h>
+#include <core/ThreadPool.h>
+
+#include <atomic>
+#include <chrono>
+#include <sstream>
 
 
 using namespace ckcmd::info;
+using namespace ckcmd;
 using namespace ckcmd::BSA;
 
 static bool BeginConversion(const string& cachePath, const string& exportPath);
 
+static string strip_carriage_returns(const string& content)
+{
+	string out;
+	out.reserve(content.size());
+	for (char c : content)
+		if (c != '\r') out += c;
+	return out;
+}
+
 string CacheGen::GetName() const
 {
 	return "cachegen";
@@ -75,10 +92,42 @@ bool BeginConversion(const string& cachePath, const string& exportPath) {
 	}
 
 	Log::Info("Reading Projects from %s and %s", animDataDir.string().c_str(), animSetDir.string().c_str());
-	
-	AnimData::AnimDataFile animationData{};
-	AnimData::AnimSetDataFile animationSetData;
 
+	fs::path dataOut = outPath / "animationdatasinglefile.txt";
+	fs::path setsOut = outPath / "animationsetdatasinglefile.txt";
+	fs::path manifestPath = outPath / CacheManifest::file_name;
+
+	//blocks whose split files did not change since the last run are copied from the previous output
+	CacheManifest previous;
+	string previousData, previousSets;
+	bool incremental = fs::exists(dataOut) && fs::exists(setsOut) && fs::exists(manifestPath);
+	if (incremental && !previous.load(manifestPath))
+	{
+		Log::Warn("%s is unreadable or from another cachegen version, rebuilding all projects", manifestPath.string().c_str());
+		incremental = false;
+	}
+	if (incremental)
+	{
+		previousData = strip_carriage_returns(AnimationCache::read_file(dataOut));
+		previousSets = strip_carriage_returns(AnimationCache::read_file(setsOut));
+		incremental = previous.matches(previousData, previousSets);
+		if (!incremental)
+			Log::Warn("%s does not match the cache files, rebuilding all projects", manifestPath.string().c_str());
+	}
+
+	CacheManifest manifest;
+	std::atomic<size_t> rebuilt(0);
+	size_t reused = 0;
+
+	//one task per project and per set, each serializes its block into its own buffer
+	struct MergeTask {
+		string name;
+		fs::path path;
+		CacheManifest::Entry entry;
+		string block;
+	};
+
+	vector<MergeTask> projects;
 	for (auto& dirEntry : fs::directory_iterator(animDataDir))
 	{
 		if (fs::is_directory(dirEntry.path()))
@@ -86,18 +135,8 @@ bool BeginConversion(const string& cachePath, const string& exportPath) {
 
 		std::string entry_extension = dirEntry.path().extension().string();
 		transform(entry_extension.begin(), entry_extension.end(), entry_extension.begin(), ::tolower);
-		if (entry_extension == ".txt") {
-			StaticCacheEntry cacheEntry{};
-			AnimationCache::get_entries(cacheEntry, dirEntry.path().string());
-
-			string pName = dirEntry.path().filename().string();
-			if (cacheEntry.hasCache()) {
-				animationData.putProject(pName, cacheEntry.block, cacheEntry.movements);
-			}
-			else {
-				animationData.putProject(pName, cacheEntry.block);
-			}
-		}
+		if (entry_extension == ".txt")
+			projects.push_back({ dirEntry.path().filename().string(), dirEntry.path() });
 	}
 
 	// read dirlist instead
@@ -108,29 +147,121 @@ bool BeginConversion(const string& cachePath, const string& exportPath) {
 		return false;
 	}
 
+	vector<MergeTask> sets;
 	std::ifstream ifs{ dirList };
 	for (std::string line; std::getline(ifs, line); )
 	{
 		fs::path projectFile = animSetDir / line;
-		if (!fs::exists(projectFile))
-			continue;
+		if (fs::exists(projectFile))
+			sets.push_back({ line, projectFile });
+	}
 
-		AnimData::ProjectAttackListBlock attackBlock{};
-		AnimationCache::get_attack_entries(attackBlock, projectFile);
+	auto start = chrono::steady_clock::now();
+	ThreadPool pool;
+	pool.parallel_for(projects.size(), [&](size_t i) {
+		MergeTask& task = projects[i];
+		string blockContent = AnimationCache::read_file(task.path);
+		fs::path movementPath = boundAnims / ("anims_" + task.name);
+		string movementContent = fs::exists(movementPath) ? AnimationCache::read_file(movementPath) : string();
+		task.entry.hash = CacheManifest::hash(movementContent, CacheManifest::hash(blockContent));
 
-		if (attackBlock.getProjectAttackBlocks().size() > 0)
+		auto old = incremental ? previous.find(CacheManifest::project, task.name) : nullptr;
+		if (old != nullptr && old->hash == task.entry.hash && old->length > 0)
 		{
-			animationSetData.putProjectAttackBlock(line, attackBlock);
+			task.block = previousData.substr(old->offset, old->length);
+		}
+		else
+		{
+			StaticCacheEntry cacheEntry{};
+			AnimationCache::get_entries(cacheEntry, task.path.string());
+			task.block = cacheEntry.block.toASCII();
+			if (cacheEntry.hasCache())
+				task.block += cacheEntry.movements.toASCII();
+			rebuilt++;
 		}
+	});
+
+	pool.parallel_for(sets.size(), [&](size_t i) {
+		MergeTask& task = sets[i];
+		//the set list and every set it names
+		string listContent = AnimationCache::read_file(task.path);
+		task.entry.hash = CacheManifest::hash(listContent);
+		std::istringstream setFiles(listContent);
+		for (std::string setFile; std::getline(setFiles, setFile); )
+		{
+			fs::path setPath = task.path.parent_path() / setFile;
+			if (fs::exists(setPath))
+				task.entry.hash = CacheManifest::hash(AnimationCache::read_file(setPath), CacheManifest::hash(setFile, task.entry.hash));
+		}
+
+		auto old = incremental ? previous.find(CacheManifest::set, task.name) : nullptr;
+		if (old != nullptr && old->hash == task.entry.hash)
+		{
+			task.block = previousSets.substr(old->offset, old->length);
+		}
+		else
+		{
+			AnimData::ProjectAttackListBlock attackBlock{};
+			AnimationCache::get_attack_entries(attackBlock, task.path);
+			if (attackBlock.getProjectAttackBlocks().size() > 0)
+				task.block = attackBlock.getBlock();
+			rebuilt++;
+		}
+	});
+	reused = projects.size() + sets.size() - rebuilt;
+	double serialized = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	//header then the blocks in list order, offsets follow the header
+	AnimData::StringListBlock projectList;
+	for (const auto& task : projects)
+		projectList.append(task.name);
+	AnimData::StringListBlock setList;
+	for (const auto& task : sets)
+	{
+		if (!task.block.empty())
+			setList.append(task.name);
 	}
 
-	std::ofstream outstream;
-	outstream.open(outPath / "animationdatasinglefile.txt"); // append instead of overwrite
-	outstream << animationData.toString();
-	outstream.close();
-	outstream.open(outPath / "animationsetdatasinglefile.txt");
-	outstream << animationSetData.toString();
-	outstream.close();
+	FileBatch batch;
+	size_t dataSlot = batch.add(dataOut, projectList.toASCII());
+	size_t setsSlot = batch.add(setsOut, setList.toASCII());
+	string& data = batch.content(dataSlot);
+	string& setsData = batch.content(setsSlot);
 
-	return true;
+	size_t total = data.size();
+	for (const auto& task : projects)
+		total += task.block.size();
+	data.reserve(total);
+	for (auto& task : projects)
+	{
+		task.entry.offset = data.size();
+		task.entry.length = task.block.size();
+		data += task.block;
+		manifest.add(CacheManifest::project, task.name, task.entry);
+	}
+
+	total = setsData.size();
+	for (const auto& task : sets)
+		total += task.block.size();
+	setsData.reserve(total);
+	for (auto& task : sets)
+	{
+		task.entry.offset = setsData.size();
+		task.entry.length = task.block.size();
+		setsData += task.block;
+		manifest.add(CacheManifest::set, task.name, task.entry);
+	}
+
+	manifest.setOutputs(data, setsData);
+	bool written = batch.write(pool.size());
+	double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	double megabytes = batch.bytes() / (1024.0 * 1024.0);
+
+	if (written && !manifest.save(manifestPath))
+		Log::Warn("Unable to write %s, the next run will rebuild all projects", manifestPath.string().c_str());
+
+	Log::Info("%zu blocks rebuilt, %zu unchanged", rebuilt.load(), reused);
+	Log::Info("Wrote %.2f MB in %.2fs (serialize %.2fs, write %.2fs), %.1f MB/s",
+		megabytes, elapsed, serialized, elapsed - serialized, elapsed > 0 ? megabytes / elapsed : 0.0);
+	return written;
 }
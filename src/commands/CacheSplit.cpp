@@ -11,6 +11,10 @@
 #include <bs/AnimDataFile.h>
 #include <bs/AnimSetDataFile.h>
 #include <core/AnimationCache.h>
+#include <core/FileBatch.h>
+#include <core/ThreadPool.h>
+
+#include <chrono>
 
 
 using namespace ckcmd::info;
@@ -81,25 +85,41 @@ bool BeginConversion(const string& cachePath, const string& exportPath) {
 	
 	fs::create_directories(boundAnims);
 	fs::create_directory(animSetDir);
-	
-	size_t i{ 0 };
+
+	//file layout first, the blocks are then serialized into their slots one project per task
+	//blocks are resolved here, the workers only follow the pointers
+	struct SplitTask {
+		AnimData::ProjectBlock* block = nullptr;
+		size_t block_slot;
+		AnimData::ProjectDataBlock* movement = nullptr;
+		int movement_slot = -1;
+		AnimData::ProjectAttackListBlock* attacks = nullptr;
+		size_t attack_slot = 0;
+		size_t attack_files = 0;
+	};
+
+	FileBatch batch;
+	vector<SplitTask> tasks;
 	vector<string> dirList{};
-	for (const auto& project : cache.animationData.getProjectList().getStrings())
+	const auto& projects = cache.animationData.getProjectList().getStrings();
+	tasks.reserve(projects.size());
+	for (size_t i = 0; i < projects.size(); i++)
 	{
-		auto& projectBlock = cache.animationData.getProjectBlock(i);
-		fs::path pFile = animDataDir / project;
-		fs::path mFile = boundAnims / ("anims_" + project);
-		ofstream ostream;
-
-		ostream.open(pFile);
-		ostream << projectBlock.getBlock();
-		ostream.close();
-
-		if (projectBlock.getHasAnimationCache()) {
-			auto& pmBlock = cache.animationData.getprojectMovementBlock(i);
-			ostream.open(mFile);
-			ostream << pmBlock.getBlock();
-			ostream.close();
+		const string& project = projects[i];
+		SplitTask task;
+		task.block = &cache.animationData.getProjectBlock((int)i);
+		task.block_slot = batch.add(animDataDir / project);
+		if (task.block->getHasAnimationCache())
+		{
+			auto& movements = cache.animationData.getProjectMovementBlockList();
+			auto movement = movements.find((int)i);
+			if (movement != movements.end())
+			{
+				task.movement = &movement->second;
+				task.movement_slot = (int)batch.add(boundAnims / ("anims_" + project));
+			}
+			else
+				Log::Warn("%s has an animation cache but no movement block", project.c_str());
 		}
 
 		string setDataProj = fs::path(project).filename().replace_extension("").string();
@@ -109,40 +129,56 @@ bool BeginConversion(const string& cachePath, const string& exportPath) {
 		setDataDir /= setDataFolder;
 
 		fs::path relPath = fs::path(setDataFolder) / project;
-		int index = cache.animationSetData.getProjectAttackBlock(relPath.string());
-		if (index != -1)
+		int attack_index = cache.animationSetData.getProjectAttackBlock(relPath.string());
+		if (attack_index != -1)
 		{
-			fs::create_directory(setDataDir);
-
+			task.attacks = &cache.animationSetData.getProjectAttackBlock(attack_index);
 			// Iterate over all project attack files (there can be multiple) and write them to separate files
-			auto& attackBlock = cache.animationSetData.getProjectAttackBlock(index);
-			ofstream mainFile{};
-			mainFile.open(setDataDir / project);
-			size_t j = 0;
-			for (const auto& projectComp : attackBlock.getProjectFiles().getStrings())
+			const auto& projectFiles = task.attacks->getProjectFiles().getStrings();
+			string mainFile;
+			task.attack_slot = batch.size();
+			task.attack_files = projectFiles.size();
+			for (const auto& projectComp : projectFiles)
 			{
-				ostream.open(setDataDir / projectComp);
-				ostream << attackBlock.getProjectAttackBlocks()[j++].getBlock();
-				ostream.close();
-
-				mainFile << projectComp << endl;
+				batch.add(setDataDir / projectComp);
+				mainFile += projectComp + "\n";
 			}
-			mainFile.close();
+			batch.add(setDataDir / project, std::move(mainFile));
 			dirList.push_back(relPath.string());
 		}
-
-		++i;
+		tasks.push_back(task);
 	}
 
 	if (!dirList.empty())
 	{
-		ofstream ostream{ animSetDir / "dirlist.txt" };
+		string dirListContent;
 		for (const auto& entry : dirList)
+			dirListContent += entry + "\n";
+		batch.add(animSetDir / "dirlist.txt", std::move(dirListContent));
+	}
+
+	auto start = chrono::steady_clock::now();
+	ckcmd::ThreadPool pool;
+	pool.parallel_for(tasks.size(), [&](size_t t) {
+		const SplitTask& task = tasks[t];
+		batch.content(task.block_slot) = task.block->getBlock();
+		if (task.movement != nullptr)
+			batch.content(task.movement_slot) = task.movement->getBlock();
+		if (task.attacks != nullptr)
 		{
-			ostream << entry << endl;
+			auto& attacks = task.attacks->getProjectAttackBlocks();
+			for (size_t j = 0; j < task.attack_files && j < attacks.size(); j++)
+				batch.content(task.attack_slot + j) = attacks[j].getBlock();
 		}
-		ostream.close();
-	}
+	});
+	double serialized = chrono::duration<double>(chrono::steady_clock::now() - start).count();
 
-	return true;
+	bool written = batch.write(pool.size());
+	double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	double megabytes = batch.bytes() / (1024.0 * 1024.0);
+	Log::Info("Wrote %zu files, %.2f MB in %.2fs (serialize %.2fs, write %.2fs), %.1f MB/s",
+		batch.size(), megabytes, elapsed, serialized, elapsed - serialized, elapsed > 0 ? megabytes / elapsed : 0.0);
+
+	return written;
 }
+
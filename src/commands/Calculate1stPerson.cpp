@@ -6,6 +6,9 @@
 #include <core/hkxutils.h>
 #include <core/log.h>
 #include <core/hkcrc.h>
+#include <core/ClipBatch.h>
+#include <core/HavokSession.h>
+#include <core/PoseBuffer.h>
 
 #include <map>
 #include <direct.h>
@@ -244,6 +247,8 @@ static hkPackfileWriter::Options GetWriteOptionsFromFormat(hkPackFormat format);
 
 static bool ExportFile(const char *baseSkel, const char *sourceAnim, const char *destAnim,
                        const hkPackfileWriter::Options& packFileOptions, hkSerializeUtil::SaveOptionBits flags);
+static bool ExportClips(const char *baseSkel, const char *sources, const char *outdir, 
+                        const hkPackfileWriter::Options& packFileOptions, hkSerializeUtil::SaveOptionBits flags, size_t threads);
 
 //////////////////////////////////////////////////////////////////////////
 // Class
@@ -267,8 +272,8 @@ string Calculate1stPerson::GetHelp() const
     string name = GetName();
     transform(name.begin(), name.end(), name.begin(), ::tolower);
 
-    // Usage: ck-cmd calculate1stperson <base_skel> <output_anim> [-i <anim>] [-d <level>] [-v <flags>] [-f <flags> ...]
-    string usage = "Usage: " + ExeCommandList::GetExeName() + " " + name + " <base_skel> <output_anim> [-i <anim>] [-d <level>] [-v <flags>] [-f <flags> ...]\r\n";
+    // Usage: ck-cmd calculate1stperson <base_skel> <output_anim> [-i <anim>] [-j <threads>] [-d <level>] [-v <flags>] [-f <flags> ...]
+    string usage = "Usage: " + ExeCommandList::GetExeName() + " " + name + " <base_skel> <output_anim> [-i <anim>] [-j <threads>] [-d <level>] [-v <flags>] [-f <flags> ...]\r\n";
 
 // TODO: [default: anim.hkx with kf ext]
 const char help[] =
@@ -276,10 +281,13 @@ R"(Convert Havok HKX animation to Gamebryo HKX animation using another skeleton
 
 Arguments:
     <base_skel>     Path to Havok skeleton for animation binding
-    <output_anim>   Path to Havok animation to write
+    <output_anim>   Path to Havok animation to write, the output folder when converting many
 
 Options:
     -i <anim>   Path to Gamebryo animation to convert - Defaults to anim.hkx with kf extension
+                A folder converts every .hkx under it, a .txt manifest the clips it lists one
+                per line, optionally followed by a tab and the output path
+    -j <threads>  Clips converted at the same time, 0 uses every core [default: 0]
     -d <level>  Debug Level: ERROR, WARN, INFO, DEBUG, VERBOSE 
                 [default: INFO]
     -v <flags>  Havok Packfile saving flags: DEFAULT, XML, WIN32, AMD64, XBOX, XBOX360 
@@ -486,9 +494,9 @@ bool Calculate1stPerson::InternalRunCommand(map<string, docopt::value> parsedArg
         flags = (hkSerializeUtil::SaveOptionBits)(flags | hkSerializeUtil::SAVE_TEXT_FORMAT);
     }
 
-    hkMallocAllocator baseMalloc;
-    hkMemoryRouter* memoryRouter = hkMemoryInitUtil::initDefault(&baseMalloc, hkMemorySystem::FrameInfo(1024 * 1024));
-    hkBaseSystem::init(memoryRouter, ErrorReport);
+    size_t threads = (size_t)max(0, atoi(parsedArgs["-j"].asString().c_str()));
+
+    ckcmd::HavokSession::acquire();
 
     char base[MAX_PATH], source[MAX_PATH], dest[MAX_PATH];
     GetFullPathName(strBase.c_str(), MAX_PATH, base, NULL);
@@ -524,13 +532,16 @@ bool Calculate1stPerson::InternalRunCommand(map<string, docopt::value> parsedArg
     //f1.parse(str1);
 
     ////stringlist skelNames = TokenizeString(skelNames, ",.", true);
-    ExportFile(base, source, dest, GetWriteOptionsFromFormat(pkFormat), flags);
+    bool ok;
+    if (PathIsDirectory(source) || _stricmp(PathFindExtension(source), ".txt") == 0)
+        ok = ExportClips(base, source, dest, GetWriteOptionsFromFormat(pkFormat), flags, threads);
+    else
+        ok = ExportFile(base, source, dest, GetWriteOptionsFromFormat(pkFormat), flags);
 
-    hkBaseSystem::quit();
-    hkMemoryInitUtil::quit();
+    ckcmd::HavokSession::release();
 
 
-    return true;
+    return ok;
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -618,8 +629,11 @@ static void FillTransforms(hkArray<hkQsTransform>& transforms, int boneIdx, int
 
 //////////////////////////////////////////////////////////////////////////
 
-static hkRefPtr<hkaAnimation> DoCalculate1stPerson(hkRefPtr<hkaSkeleton> baseSkel, 
-                                                   hkRefPtr<hkaAnimationBinding> srcBinding)
+// the skeleton is only read and not reference counted, it may be shared by clips
+// converted at the same time. threads samples the clip, 0 means one per core
+static hkRefPtr<hkaAnimation> DoCalculate1stPerson(const hkaSkeleton* baseSkel, 
+                                                   hkaAnimationBinding* srcBinding, 
+                                                   size_t threads = 0)
 {
 
 	hkRefPtr<hkaAnimation> srcAnim = srcBinding->m_animation;
@@ -645,15 +659,12 @@ static hkRefPtr<hkaAnimation> DoCalculate1stPerson(hkRefPtr<hkaSkeleton> baseSke
 	int eyeBoneIndex = baseSkel->m_parentIndices[firstPersonIndex];
 	//int cameraParendBoneIndex = 36;
 	
-	hkArray<hkQsTransform> eyeBoneWorldTransforms(nframes, hkQsTransform::getIdentity());
+	ckcmd::PoseBuffer poses(*baseSkel);
 
 	//calculate skeleton pose eyebone level
-	int findroot = eyeBoneIndex;
-	hkQsTransform defaultEyeBonePoseFromWorld(hkQsTransform::IDENTITY);
-	while (findroot != -1) {
-		defaultEyeBonePoseFromWorld.setMul(baseSkel->m_referencePose[findroot], defaultEyeBonePoseFromWorld);
-		findroot = baseSkel->m_parentIndices[findroot];
-	}
+	poses.reference(1);
+	poses.computeModel(1);
+	hkQsTransform defaultEyeBonePoseFromWorld = poses.model(0)[eyeBoneIndex];
 
 	hkQsTransform worldcam = hkQsTransform::getIdentity();
 	worldcam.setTranslation(hkVector4(
@@ -669,40 +680,32 @@ static hkRefPtr<hkaAnimation> DoCalculate1stPerson(hkRefPtr<hkaSkeleton> baseSke
 		tempAnim->m_annotationTracks[i] = srcAnim->m_annotationTracks[i];
 	}
 
-	hkArray<hkQsTransform>& transforms = tempAnim->m_transforms;
-
-	// Walk through source animation and transfer animation
-	hkArray<hkQsTransform> srcTransforms(srcAnim->m_numberOfTransformTracks);
-	hkArray<float> srcFloats(srcAnim->m_numberOfFloatTracks);
+	// Walk through source animation and transfer animation, all the frames are
+	// sampled first and the hierarchy is then walked once per frame for every bone
+	poses.sample(*srcAnim, nframes, nullptr, threads);
+	poses.computeModel(threads);
 
-	hkReal incrFrame = srcAnim->m_duration / (hkReal)nframes;
+	int numCopiedTracks = numSrcTracks < nbones ? numSrcTracks : nbones;
 	int nCurrentFrame = 0;
 	int nCurrentFloat = 0;
 	int nFrame = 0;
 
-	//for (hkReal time = 0.0f; time<srcAnim->m_duration; time += incrFrame, nCurrentFrame+= nbones, nCurrentFloat+=numFloats)
 	for (nFrame = 0; nFrame<nframes ; nFrame++, nCurrentFrame+= nbones, nCurrentFloat+=numFloats)
 	{
-		hkReal time = incrFrame*nFrame;
-		srcAnim->sampleTracks(time, srcTransforms.begin(), srcFloats.begin(), NULL);
-		hkaSkeletonUtils::normalizeRotations (srcTransforms.begin(), numSrcTracks);
 		//Copy over the tracks
-		for (int i=0; i<numSrcTracks; ++i)
+		const hkQsTransform* srcTransforms = poses.local(nFrame);
+		for (int i=0; i<numCopiedTracks; ++i)
 		{
 			tempAnim->m_transforms[nCurrentFrame + i] = srcTransforms[i];
 		}
+		const hkReal* srcFloats = poses.floatTracks(nFrame);
 		for (int i=0; i<numFloats; ++i)
 		{
 			tempAnim->m_floats[nCurrentFloat + i] = srcFloats[i];
 		}
 
-		//calculate skeleton pose eyebone
-		int findroot = eyeBoneIndex;
-		hkQsTransform& eyeBonePoseFromWorld = eyeBoneWorldTransforms[nCurrentFrame / nbones];
-		while (findroot != -1) {
-			eyeBonePoseFromWorld.setMul(srcTransforms[findroot], eyeBonePoseFromWorld);
-			findroot = baseSkel->m_parentIndices[findroot];
-		}
+		//skeleton pose eyebone
+		const hkQsTransform& eyeBonePoseFromWorld = poses.model(nFrame)[eyeBoneIndex];
 
 		//fix the cam, move it canceling out the orientation
 		hkQsTransform& cam = tempAnim->m_transforms[nCurrentFrame + nbones - 1];
@@ -725,96 +728,56 @@ static hkRefPtr<hkaAnimation> DoCalculate1stPerson(hkRefPtr<hkaSkeleton> baseSke
 	return tempAnim;
 }
 
-static bool ExportFile(const char *baseSkel, const char *sourceAnim, const char *destAnim, 
-                       const hkPackfileWriter::Options& packFileOptions, hkSerializeUtil::SaveOptionBits flags)
+// Loads a Havok file holding an animation container, what names the file in the messages
+static hkResource* LoadAnimationContainer(const char *file, const char *what, hkaAnimationContainer*& container, int& nErrors)
 {
-	hkResource* baseResource = NULL;
-	hkResource* srcResource = NULL;
-	hkaAnimationContainer *baseAnimCont = NULL;
-	hkaAnimationContainer *srcAnimCont = NULL;
-	hkaSkeleton* baseSkeleton = NULL;
-
-	hkSerializeUtil::FormatDetails detailsOut;
-
-	Log::Verbose("Begin ExportFile");
-	Log::Info("Base Skeleton: %s", baseSkel);
-	Log::Info("Source File: %s", sourceAnim);
-	Log::Info("Output File: %s", destAnim);
-
-	int nErrors = 0;
-
-	// Read back skeleton file
+	container = NULL;
+	hkIstream stream(file);
+	hkStreamReader *reader = stream.getStreamReader();
+	hkBool32 isLoadable = hkSerializeUtil::isLoadable( reader );
+	if (!isLoadable)
 	{
-		hkIstream stream(baseSkel);
-		hkStreamReader *reader = stream.getStreamReader();
-		hkBool32 isLoadable = hkSerializeUtil::isLoadable( reader );
-		if (!isLoadable)
-		{
-			Log::Warn("Base skeleton file reports that it is not loadable");
-		}
-		if (baseResource = hkSerializeUtilLoad(reader))
-		{
-			const char * hktypename = baseResource->getContentsTypeName();
-			void * contentPtr = baseResource->getContentsPointer(HK_NULL, HK_NULL);
-			if (hkRootLevelContainer* scene = baseResource->getContents<hkRootLevelContainer>())
-			{
-				baseAnimCont = scene->findObject<hkaAnimationContainer>();
-				if (baseAnimCont == NULL)
-				{
-					Log::Error("Base File does not contain an animation container");
-					++nErrors;
-				}
-			}
-			else
-			{
-				Log::Error("Base File does not a root level container");
-				++nErrors;
-			}
-		}
-		else
-		{
-			Log::Error("Base File could not be loaded");
-			++nErrors;
-		}
+		Log::Warn("%s file reports that it is not loadable", what);
 	}
-	if (baseAnimCont != NULL)
+	hkResource* resource = hkSerializeUtilLoad(reader);
+	if (resource)
 	{
-		hkIstream stream(sourceAnim);
-		hkStreamReader *reader = stream.getStreamReader();
-
-		// details will be used later when writing packfile
-		hkSerializeUtil::detectFormat( reader, detailsOut );
-		hkBool32 isLoadable = hkSerializeUtil::isLoadable( reader );
-		if (!isLoadable)
+		if (hkRootLevelContainer* scene = resource->getContents<hkRootLevelContainer>())
 		{
-			Log::Warn("Source file reports that it is not loadable");
-		}
-		if (srcResource = hkSerializeUtilLoad(reader))
-		{
-			const char * hktypename = srcResource->getContentsTypeName();
-			void * contentPtr = srcResource->getContentsPointer(HK_NULL, HK_NULL);
-			if (hkRootLevelContainer* scene = srcResource->getContents<hkRootLevelContainer>())
+			container = scene->findObject<hkaAnimationContainer>();
+			if (container == NULL)
 			{
-				srcAnimCont = scene->findObject<hkaAnimationContainer>();
-				if (srcAnimCont == NULL)
-				{
-					Log::Error("Source File does not contain an animation container");
-					++nErrors;
-				}
-			}
-			else
-			{
-				Log::Error("Source File does not a root level container");
+				Log::Error("%s File does not contain an animation container", what);
 				++nErrors;
 			}
 		}
 		else
 		{
-			Log::Error("Source File could not be loaded");
+			Log::Error("%s File does not a root level container", what);
 			++nErrors;
 		}
 	}
-	if (baseAnimCont != NULL && srcAnimCont != NULL)
+	else
+	{
+		Log::Error("%s File could not be loaded", what);
+		++nErrors;
+	}
+	return resource;
+}
+
+// Converts one clip on the skeletons of an already loaded base container, which is only read
+static bool ExportClip(hkaAnimationContainer *baseAnimCont, const char *sourceAnim, const char *destAnim, 
+                       const hkPackfileWriter::Options& packFileOptions, hkSerializeUtil::SaveOptionBits flags, 
+                       size_t threads)
+{
+	hkaAnimationContainer *srcAnimCont = NULL;
+
+	Log::Info("Source File: %s", sourceAnim);
+	Log::Info("Output File: %s", destAnim);
+
+	int nErrors = 0;
+	hkResource* srcResource = LoadAnimationContainer(sourceAnim, "Source", srcAnimCont, nErrors);
+	if (srcAnimCont != NULL)
 	{
 		if (nErrors == 0)
 		{
@@ -854,10 +817,10 @@ static bool ExportFile(const char *baseSkel, const char *sourceAnim, const char
 					}
 					else
 					{
-						hkRefPtr<hkaSkeleton> baseSkeleton, srcSkeleton;
+						hkaSkeleton* baseSkeleton = HK_NULL;
 						for (int i=0,n=baseAnimCont->m_skeletons.getSize(); i<n; ++i)
 						{
-							hkRefPtr<hkaSkeleton> skeleton = baseAnimCont->m_skeletons[i];
+							hkaSkeleton* skeleton = baseAnimCont->m_skeletons[i];
 							if ( skName == skeleton->m_name ) {
 								baseSkeleton = skeleton;
 								break;
@@ -870,7 +833,7 @@ static bool ExportFile(const char *baseSkel, const char *sourceAnim, const char
 						}
 						else
 						{
-							hkRefPtr<hkaAnimation> outAnim = DoCalculate1stPerson(baseSkeleton, srcBinding);
+							hkRefPtr<hkaAnimation> outAnim = DoCalculate1stPerson(baseSkeleton, srcBinding, threads);
 							if (outAnim == NULL)
 							{
 								Log::Error("Output animation not exported");
@@ -909,6 +872,11 @@ static bool ExportFile(const char *baseSkel, const char *sourceAnim, const char
 				{
 					res = hkSerializeUtil::save( &rootCont, rootCont.staticClass(), stream.getStreamWriter(), flags );
 				}
+				if (res != HK_SUCCESS)
+				{
+					Log::Error("Havok reports save failed for '%s'", destAnim);
+					++nErrors;
+				}
 			}
 			else
 			{
@@ -918,7 +886,61 @@ static bool ExportFile(const char *baseSkel, const char *sourceAnim, const char
 	}
 	if (srcResource)
 		srcResource->removeReference();
+	return (nErrors == 0);
+}
+
+static bool ExportFile(const char *baseSkel, const char *sourceAnim, const char *destAnim, 
+                       const hkPackfileWriter::Options& packFileOptions, hkSerializeUtil::SaveOptionBits flags)
+{
+	hkaAnimationContainer *baseAnimCont = NULL;
+
+	Log::Verbose("Begin ExportFile");
+	Log::Info("Base Skeleton: %s", baseSkel);
+
+	int nErrors = 0;
+	hkResource* baseResource = LoadAnimationContainer(baseSkel, "Base", baseAnimCont, nErrors);
+	if (baseAnimCont != NULL && nErrors == 0)
+	{
+		if (!ExportClip(baseAnimCont, sourceAnim, destAnim, packFileOptions, flags, 0))
+			++nErrors;
+	}
 	if (baseResource)
 		baseResource->removeReference();
 	return (nErrors == 0);
-}
\ No newline at end of file
+}
+
+// Converts every clip of a folder, or listed by a manifest, against one load of the base skeleton
+static bool ExportClips(const char *baseSkel, const char *sources, const char *outdir, 
+                        const hkPackfileWriter::Options& packFileOptions, hkSerializeUtil::SaveOptionBits flags, size_t threads)
+{
+	ckcmd::ClipBatch clips;
+	if (PathIsDirectory(sources))
+	{
+		clips.addFolder(sources, ".hkx", outdir, ".hkx");
+	}
+	else if (clips.addManifest(sources, outdir, ".hkx") < 0)
+	{
+		Log::Error("Unable to read the manifest '%s'", sources);
+		return false;
+	}
+	if (clips.size() == 0)
+	{
+		Log::Warn("No animations found in '%s'", sources);
+		return false;
+	}
+
+	Log::Info("Base Skeleton: %s", baseSkel);
+	hkaAnimationContainer *baseAnimCont = NULL;
+	int nErrors = 0;
+	hkResource* baseResource = LoadAnimationContainer(baseSkel, "Base", baseAnimCont, nErrors);
+	if (baseAnimCont != NULL && nErrors == 0)
+	{
+		//the clips already run side by side, each one is sampled on its own worker
+		nErrors += (int)clips.run([&](const ckcmd::ClipBatch::Clip& clip) {
+			return ExportClip(baseAnimCont, clip.source.string().c_str(), clip.destination.string().c_str(), packFileOptions, flags, 1);
+		}, threads);
+	}
+	if (baseResource)
+		baseResource->removeReference();
+	return (nErrors == 0);
+}
@@ -21,6 +21,14 @@ bool CommandBase::RunCommand(int argc, char** argv)
     return InternalRunCommand(parsedArgs);
 }
 
+bool CommandBase::RunJob(const vector<string>& args)
+{
+    map<string, docopt::value> parsedArgs =
+        docopt::docopt_parse(GetHelp(), args, true, false);
+
+    return InternalRunCommand(parsedArgs);
+}
+
 
 void ExeCommandList::AddCommand(CommandBase* cmd)
 {
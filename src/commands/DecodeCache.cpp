@@ -9,6 +9,7 @@
 #undef min
 
 #include <core/hkxcmd.h>
+#include <core/HavokSession.h>
 #include <core/hkxutils.h>
 #include <core/AnimationCache.h>
 #include <core/HKXWrangler.h>
@@ -298,12 +299,13 @@ void populateDecodingMap(const fs::path& folder, std::map<std::string, std::stri
 		}
 		if (to_crc.at(to_crc.size() - 1) == '\\')
 			to_crc = to_crc.substr(0, to_crc.size() - 1);
-		long long crc = stoll(HkCRC::compute(to_crc), NULL, 16);
-		string crc_str = to_string(crc);
-		decoding_map[crc_str] = to_crc;
-		long long name_crc = stoll(HkCRC::compute(filename.string()), NULL, 16);
-		string name_crc_str = to_string(name_crc);
-		decoding_map[name_crc_str] = filename.string();
+		//names with a malformed escape have no crc the cache could hold
+		auto crc = HkCRC::crc32(to_crc);
+		if (crc)
+			decoding_map[HkCRC::cache_string(*crc)] = to_crc;
+		auto name_crc = HkCRC::crc32(filename.string());
+		if (name_crc)
+			decoding_map[HkCRC::cache_string(*name_crc)] = filename.string();
 
 	}
 }
@@ -1135,14 +1137,10 @@ static hkThreadMemory* threadMemory = NULL;
 static char* stackBuffer = NULL;
 static void InitializeHavok()
 {
-	// Initialize the base system including our memory system
-	hkMemoryRouter*		pMemoryRouter(hkMemoryInitUtil::initDefault(hkMallocAllocator::m_defaultMallocAllocator, hkMemorySystem::FrameInfo(5000000)));
-	hkBaseSystem::init(pMemoryRouter, errorReport);
-	LoadDefaultRegistry();
+	ckcmd::HavokSession::acquire();
 }
 
 static void CloseHavok()
 {
-	hkBaseSystem::quit();
-	hkMemoryInitUtil::quit();
+	ckcmd::HavokSession::release();
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include <commands/ExportAnimation.h>
 #include <core/MathHelper.h>
+#include <core/HavokSession.h>
 
 #include "stdafx.h"
 #include <core/hkxcmd.h>
@@ -208,14 +209,10 @@ static hkThreadMemory* threadMemory = NULL;
 static char* stackBuffer = NULL;
 static void InitializeHavok()
 {
-	// Initialize the base system including our memory system
-	hkMemoryRouter*		pMemoryRouter(hkMemoryInitUtil::initDefault(hkMallocAllocator::m_defaultMallocAllocator, hkMemorySystem::FrameInfo(5000000)));
-	hkBaseSystem::init(pMemoryRouter, errorReport);
-	LoadDefaultRegistry();
+	ckcmd::HavokSession::acquire();
 }
 
 static void CloseHavok()
 {
-	hkBaseSystem::quit();
-	hkMemoryInitUtil::quit();
+	ckcmd::HavokSession::release();
 }
\ No newline at end of file
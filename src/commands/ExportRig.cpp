@@ -2,6 +2,7 @@
 
 #include "stdafx.h"
 #include <core/hkxcmd.h>
+#include <core/HavokSession.h>
 #include <core/hkfutils.h>
 #include <core/log.h>
 
@@ -252,14 +253,10 @@ static hkThreadMemory* threadMemory = NULL;
 static char* stackBuffer = NULL;
 static void InitializeHavok()
 {
-	// Initialize the base system including our memory system
-	hkMemoryRouter*		pMemoryRouter(hkMemoryInitUtil::initDefault(hkMallocAllocator::m_defaultMallocAllocator, hkMemorySystem::FrameInfo(5000000)));
-	hkBaseSystem::init(pMemoryRouter, errorReport);
-	LoadDefaultRegistry();
+	ckcmd::HavokSession::acquire();
 }
 
 static void CloseHavok()
 {
-	hkBaseSystem::quit();
-	hkMemoryInitUtil::quit();
+	ckcmd::HavokSession::release();
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include <commands/ImportAnimation.h>
 #include <core/MathHelper.h>
+#include <core/HavokSession.h>
 
 #include "stdafx.h"
 #include <core/hkxcmd.h>
@@ -19,7 +20,7 @@ using namespace ckcmd::FBX;
 using namespace ckcmd::info;
 using namespace ckcmd::BSA;
 
-static bool BeginConversion(const string& importSkeleton, const string& importFBX, const string& cacheFilePath, const string& behaviorFolder, const string& exportPath);
+static bool BeginConversion(const string& importSkeleton, const string& importFBX, const string& cacheFilePath, const string& behaviorFolder, const string& exportPath, const ckcmd::KeyReduction& reduction);
 static void InitializeHavok();
 static void CloseHavok();
 
@@ -43,7 +44,7 @@ string ImportAnimation::GetHelp() const
 	transform(name.begin(), name.end(), name.begin(), ::tolower);
 
 	// Usage: ck-cmd importanimation
-	string usage = "Usage: " + ExeCommandList::GetExeName() + " " + name + " <path_to_skeleton_hkx> <path_to_fbx_animation> [--b=<path_to_behavior_folder>] [--c=<path_to_cache_file>] [--e=<path_to_export>]\r\n";
+	string usage = "Usage: " + ExeCommandList::GetExeName() + " " + name + " <path_to_skeleton_hkx> <path_to_fbx_animation> [--b=<path_to_behavior_folder>] [--c=<path_to_cache_file>] [--e=<path_to_export>] [--reduce=<fit>] [--tolerance=<tolerances>]\r\n";
 
 	const char help[] =
 		R"(Converts a FBX animation to NIF. Requires a preexisting HKX skeleton
@@ -54,6 +55,11 @@ string ImportAnimation::GetHelp() const
 			--c=<path_to_cache_file>, --cache <path_to_cache_file> necessary to extract root motion into animations
 			--b=<path_to_behavior_folder>, --behavior <path_to_behavior_folder> necessary to extract root motion
 			--e=<path_to_export> path to the output directory
+			--reduce=<fit> Havok spline compression of the animations: none keeps every frame
+			               uncompressed, linear uses degree 1 splines, spline degree 3. Default none
+			--tolerance=<tolerances> Havok spline compression tolerances as position,degrees,scale,
+			               default 0.01,0.1,0.001. The error the compression left is measured
+			               against every frame and logged
 
 		)";
 	return usage + help;
@@ -79,13 +85,22 @@ bool ImportAnimation::InternalRunCommand(map<string, docopt::value> parsedArgs)
 		behaviorFolder = parsedArgs["--b"].asString();
 	if (parsedArgs["--e"].isString())
 		exportPath = parsedArgs["--e"].asString();
+
+	ckcmd::KeyReduction reduction;
+	string fit = parsedArgs["--reduce"].isString() ? parsedArgs["--reduce"].asString() : "none";
+	string tolerances = parsedArgs["--tolerance"].isString() ? parsedArgs["--tolerance"].asString() : "0.01,0.1,0.001";
+	if (!reduction.parse(fit, tolerances)) {
+		Log::Error("Invalid key reduction: %s %s", fit.c_str(), tolerances.c_str());
+		return false;
+	}
+
 	InitializeHavok();
-	BeginConversion(importSkeleton, importFBX, cacheFilePath, behaviorFolder, exportPath);
+	BeginConversion(importSkeleton, importFBX, cacheFilePath, behaviorFolder, exportPath, reduction);
 	CloseHavok();
 	return true;
 }
 
-bool BeginConversion(const string& importSkeleton, const string& importFBX, const string& cacheFilePath, const string& behaviorFolder, const string& exportPath) {
+bool BeginConversion(const string& importSkeleton, const string& importFBX, const string& cacheFilePath, const string& behaviorFolder, const string& exportPath, const ckcmd::KeyReduction& reduction) {
 	bool batch = false;
 	fs::path fbxModelpath = fs::path(importFBX);
 	if (!fs::exists(importSkeleton) || !fs::is_regular_file(importSkeleton)) {
@@ -115,6 +130,7 @@ bool BeginConversion(const string& importSkeleton, const string& importFBX, cons
 	{
 		FBXWrangler wrangler;
 		wrangler.setExternalSkeletonPath(importSkeleton);
+		wrangler.setKeyReduction(reduction);
 		wrangler.ImportScene(fbxModelpath.string().c_str());
 
 		fs::path out_path = outputDir / fbxModelpath.filename().replace_extension(".hkx");
@@ -166,6 +182,7 @@ bool BeginConversion(const string& importSkeleton, const string& importFBX, cons
 			Log::Info("Importing: %s, using current_dir", fbx.string().c_str());
 			FBXWrangler wrangler;
 			wrangler.setExternalSkeletonPath(importSkeleton);
+			wrangler.setKeyReduction(reduction);
 			wrangler.ImportScene(fbx.string().c_str());
 			fs::path parent_path = fbx.parent_path();
 			fs::path rel_path = "";
@@ -213,14 +230,10 @@ static hkThreadMemory* threadMemory = NULL;
 static char* stackBuffer = NULL;
 static void InitializeHavok()
 {
-	// Initialize the base system including our memory system
-	hkMemoryRouter*		pMemoryRouter(hkMemoryInitUtil::initDefault(hkMallocAllocator::m_defaultMallocAllocator, hkMemorySystem::FrameInfo(5000000)));
-	hkBaseSystem::init(pMemoryRouter, errorReport);
-	LoadDefaultRegistry();
+	ckcmd::HavokSession::acquire();
 }
 
 static void CloseHavok()
 {
-	hkBaseSystem::quit();
-	hkMemoryInitUtil::quit();
+	ckcmd::HavokSession::release();
 }
\ No newline at end of file
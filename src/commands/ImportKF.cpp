@@ -1,5 +1,9 @@
 #include "stdafx.h"
 #include <core/hkxcmd.h>
+#include <core/BSpline.h>
+#include <core/ClipBatch.h>
+#include <core/HavokSession.h>
+#include <core/KeyTrack.h>
 #include <core/hkfutils.h>
 #include <core/log.h>
 
@@ -148,7 +152,7 @@ string ImportKF::GetHelp() const
 	transform(name.begin(), name.end(), name.begin(), ::tolower);
 
 	// Usage: ck-cmd exportfbx
-	string usage = "Usage: " + ExeCommandList::GetExeName() + " " + name + " <path_to_skeleton> <path_to_animations> [-e <path_to_export>]\r\n";
+	string usage = "Usage: " + ExeCommandList::GetExeName() + " " + name + " <path_to_skeleton> <path_to_animations> [-e <path_to_export>] [-j <threads>]\r\n";
 
 	const char help[] =
 		R"(Converts KF format to HKX.
@@ -158,6 +162,9 @@ string ImportKF::GetHelp() const
 			<path_to_animations> the animation directory containing fk files to convert
 			<path_to_export> path to the output directory
 
+		Options:
+			-j <threads>  animations converted at the same time, 0 uses every core [default: 0]
+
 		)";
 	return usage + help;
 }
@@ -262,100 +269,6 @@ static void HelpString(hkxcmd::HelpType type){
 	}
 }
 
-/*********************************************************************
-Simple b-spline curve algorithm
-Copyright 1994 by Keith Vertanen (vertankd@cda.mrs.umn.edu)
-Released to the public domain (your mileage may vary)
-Found at: Programmers Heaven (www.programmersheaven.com/zone3/cat415/6660.htm)
-Modified by: Theo
-- reformat and convert doubles to floats
-- removed point structure in favor of arbitrary sized float array
-**********************************************************************/
-static void copy_floats(float* dest, float* src, int l)
-{
-	for (int i = 0; i < l; ++i)
-		dest[i] = src[i];
-}
-
-// calculate the blending value
-static float blend(int k, int t, int* u, float v)
-{
-	float value;
-	if (t == 1) {			// base case for the recursion
-		value = ((u[k] <= v) && (v < u[k + 1])) ? 1.0f : 0.0f;
-	}
-	else {
-		if ((u[k + t - 1] == u[k]) && (u[k + t] == u[k + 1]))  // check for divide by zero
-			value = 0;
-		else if (u[k + t - 1] == u[k]) // if a term's denominator is zero,use just the other
-			value = (u[k + t] - v) / (u[k + t] - u[k + 1]) * blend(k + 1, t - 1, u, v);
-		else if (u[k + t] == u[k + 1])
-			value = (v - u[k]) / (u[k + t - 1] - u[k]) * blend(k, t - 1, u, v);
-		else
-			value = (v - u[k]) / (u[k + t - 1] - u[k]) * blend(k, t - 1, u, v) +
-			(u[k + t] - v) / (u[k + t] - u[k + 1]) * blend(k + 1, t - 1, u, v);
-	}
-	return value;
-}
-
-// figure out the knots
-static void compute_intervals(int* u, int n, int t)
-{
-	for (int j = 0; j <= n + t; j++) {
-		if (j < t)
-			u[j] = 0;
-		else if ((t <= j) && (j <= n))
-			u[j] = j - t + 1;
-		else if (j > n)
-			u[j] = n - t + 2;  // if n-t=-2 then we're screwed, everything goes to 0
-	}
-}
-
-static void compute_point(int* u, int n, int t, float v, int l, float* control, float* output)
-{
-	// initialize the variables that will hold our output
-	for (int j = 0; j < l; j++)
-		output[j] = 0;
-	for (int k = 0; k <= n; k++) {
-		float temp = blend(k, t, u, v);  // same blend is used for each dimension coordinate
-		for (int j = 0; j < l; j++)
-			output[j] = output[j] + control[k * l + j] * temp;
-	}
-}
-
-/*********************************************************************
-bspline(int n, int t, int l, float *control, float *output, int num_output)
-Parameters:
-n          - the number of control points minus 1
-t          - the degree of the polynomial plus 1
-l          - size of control and output float vector block
-control    - control point array made up of float structure
-output     - array in which the calculate spline points are to be put
-num_output - how many points on the spline are to be calculated
-Pre-conditions:
-n+2>t  (no curve results if n+2<=t)
-control array contains the number of points specified by n
-output array is the proper size to hold num_output point structures
-control and output vectors must be contiguous float arrays
-**********************************************************************/
-void bspline(int n, int t, int l, float* control, float* output, int num_output)
-{
-	float* calc = new float[l];
-	int* u = new int[n + t + 1];
-	compute_intervals(u, n, t);
-
-	float increment = (float)(n - t + 2) / (num_output - 1);  // how much parameter goes up each time
-	float interval = 0;
-	for (int output_index = 0; output_index < num_output - 1; output_index++) {
-		compute_point(u, n, t, interval, l, control, calc);
-		copy_floats(&output[output_index * l], calc, l);
-		interval = interval + increment;  // increment our parameter
-	}
-	copy_floats(&output[(num_output - 1) * l], &control[n * l], l); // put in the last points
-	delete[] u;
-	delete[] calc;
-}
-
 struct NiBSplineTransformInterpolatorAccessor {};
 
 template<>
@@ -485,10 +398,8 @@ vector< Key<Quaternion> > SampleQuatRotateKeys(NiBSplineCompTransformInterpolato
 			for (int k = 0; k < SizeofQuat; ++k)
 				control[i * SizeofQuat + k] = float(points[j++]) / float(32767);
 		}
-		if (degree >= nctrl)
-			degree = nctrl - 1;
 		// fit data
-		bspline(nctrl - 1, degree + 1, SizeofQuat, &control[0], &output[0], npoints);
+		ckcmd::BSpline(nctrl, degree).sample(&control[0], SizeofQuat, &output[0], npoints);
 
 		// copy to key
 		float time = interpolator->GetStartTime();
@@ -525,7 +436,7 @@ vector< Key<Vector3> > SampleTranslateKeys(NiBSplineCompTransformInterpolatorRef
 				control[i * SizeofTrans + k] = float(points[j++]) / float(32767);
 		}
 		// fit data
-		bspline(nctrl - 1, degree + 1, SizeofTrans, &control[0], &output[0], npoints);
+		ckcmd::BSpline(nctrl, degree).sample(&control[0], SizeofTrans, &output[0], npoints);
 
 		// copy to key
 		float time = interpolator->GetStartTime();
@@ -561,7 +472,7 @@ vector< Key<float> > SampleScaleKeys(NiBSplineCompTransformInterpolatorRef inter
 			control[i] = float(points[j++]) / float(32767);
 		}
 		// fit data
-		bspline(nctrl - 1, degree + 1, SizeofScale, &control[0], &output[0], npoints);
+		ckcmd::BSpline(nctrl, degree).sample(&control[0], SizeofScale, &output[0], npoints);
 
 		// copy to key
 		float time = interpolator->GetStartTime();
@@ -598,10 +509,8 @@ vector< Key<Quaternion> > SampleQuatRotateKeys(NiBSplineTransformInterpolatorRef
 			for (int k = 0; k < SizeofQuat; ++k)
 				control[i * SizeofQuat + k] = float(points[j++]);
 		}
-		if (degree >= nctrl)
-			degree = nctrl - 1;
 		// fit data
-		bspline(nctrl - 1, degree + 1, SizeofQuat, &control[0], &output[0], npoints);
+		ckcmd::BSpline(nctrl, degree).sample(&control[0], SizeofQuat, &output[0], npoints);
 
 		// copy to key
 		float time = interpolator->GetStartTime();
@@ -638,7 +547,7 @@ vector< Key<Vector3> > SampleTranslateKeys(NiBSplineTransformInterpolatorRef& in
 				control[i * SizeofTrans + k] = float(points[j++]);
 		}
 		// fit data
-		bspline(nctrl - 1, degree + 1, SizeofTrans, &control[0], &output[0], npoints);
+		ckcmd::BSpline(nctrl, degree).sample(&control[0], SizeofTrans, &output[0], npoints);
 
 		// copy to key
 		float time = interpolator->GetStartTime();
@@ -675,7 +584,7 @@ vector< Key<float> > SampleScaleKeys(NiBSplineTransformInterpolatorRef& interpol
 			control[i] = float(points[j++]) / float(32767);
 		}
 		// fit data
-		bspline(nctrl - 1, degree + 1, SizeofScale, &control[0], &output[0], npoints);
+		ckcmd::BSpline(nctrl, degree).sample(&control[0], SizeofScale, &output[0], npoints);
 
 		// copy to key
 		float time = interpolator->GetStartTime();
@@ -760,7 +669,7 @@ bool AnimationExport::noRootSiblings = true;
 
 AnimationExport::AnimationExport(
 	NiControllerSequenceRef seq, 
-	hkRefPtr<hkaSkeleton> skeleton, 
+	hkaSkeleton* skeleton, 
 	hkRefPtr<hkaAnimationBinding> binding, 
 	const NifInfo& info,
 	const set<NiNodeRef>& other_bones_in_accum,
@@ -1142,321 +1051,52 @@ static void PosRotScaleNode(hkQsTransform& transform, hkVector4& p, ::hkQuaterni
 	if (prs & prsRot) SetTransformRotation(transform, q);
 	if (prs & prsPos) SetTransformPosition(transform, p);
 }
-static void SetTransformPositionRange( hkArray<hkQsTransform>& transforms, int numTracks, int boneIdx
-						   , int &frame
-						   , Vector3Key &first)
-{
-	int n = transforms.getSize()/numTracks;
-	hkVector4 p = TOVECTOR4(first.data);
-	hkQsTransform& transform = transforms[frame*numTracks + boneIdx];
-	SetTransformPosition(transform, p);
-}
-static void SetTransformRotationRange( hkArray<hkQsTransform>& transforms, int numTracks, int boneIdx
-									  , int &frame
-									  , QuatKey &first)
-{
-	int n = transforms.getSize()/numTracks;
-	::hkQuaternion q = TOQUAT(first.data);
-	hkQsTransform& transform = transforms[frame*numTracks + boneIdx];
-	SetTransformRotation(transform, q);
-}
-static void SetTransformRotationRange(hkArray<hkQsTransform>& transforms, int numTracks, int boneIdx
-	, int& frame
-	, const FloatKey& x_first
-	, const FloatKey& y_first
-	, const FloatKey& z_first
-	)
-{
-	int n = transforms.getSize() / numTracks;
-	hkRotation rot_z; rot_z.setAxisAngle(hkVector4(0., 0., 1.), x_first.data);
-	hkRotation rot_y; rot_y.setAxisAngle(hkVector4(0., 1., 0.), y_first.data);
-	hkRotation rot_x; rot_x.setAxisAngle(hkVector4(1., 0., 0.), z_first.data);
-
-	hkRotation rot(rot_z), result; rot.mul(rot_y); rot.mul(rot_x);
-	::hkQuaternion q(result);
-
-	hkQsTransform& transform = transforms[frame * numTracks + boneIdx];
-	SetTransformRotation(transform, q);
-}
-static void SetTransformScaleRange( hkArray<hkQsTransform>& transforms, int numTracks, int boneIdx
-									  , int &frame
-									  , FloatKey &first)
-{
-	int n = transforms.getSize()/numTracks;
-	hkQsTransform& transform = transforms[frame*numTracks + boneIdx];
-	SetTransformScale(transform, first.data);
-}
-
-template <typename K>
-static bool timeIndex(float time, const K& keysArray, int& i, int& j, float& x)
-{
-	int count;
-
-	if ((count = keysArray.size()) > 0) {
-		if (time <= keysArray[0].time) {
-			i = j = 0;
-			x = 0.0;
-
-			return true;
-		}
-
-		if (time >= keysArray[count - 1].time /*nif->get<float>(array.child(count - 1, 0), "Time")*/) {
-			i = j = count - 1;
-			x = 0.0;
-
-			return true;
-		}
-
-		if (i < 0 || i >= count)
-			i = 0;
-
-		float tI = keysArray[i].time; // nif->get<float>(array.child(i, 0), "Time");
-
-		if (time > tI) {
-			j = i + 1;
-			float tJ;
-
-			while (time >= (tJ = keysArray[j].time /*nif->get<float>(array.child(j, 0), "Time")*/)) {
-				i = j++;
-				tI = tJ;
-			}
-
-			x = (time - tI) / (tJ - tI);
-
-			return true;
-		}
-		else if (time < tI) {
-			j = i - 1;
-			float tJ;
-
-			while (time <= (tJ = keysArray[j].time /*nif->get<float>(array.child(j, 0), "Time")*/)) {
-				i = j--;
-				tI = tJ;
-			}
-
-			x = (time - tI) / (tJ - tI);
-
-			// Quadratic Bug Fix
-
-			// Invert x
-			//	Previously, this branch was causing x to decrement from 1.0.
-			//	(This works fine for linear interpolation apparently)
-			x = 1.0 - x;
-
-			// Swap I and J
-			//	With x inverted, we must swap I and J or the animation will reverse.
-			auto tmpI = i;
-			i = j;
-			j = tmpI;
-
-			// End Bug Fix
-
-			return true;
-		}
-
-		j = i;
-		x = 0.0;
-
-		return true;
-	}
-
-	return false;
-}
-
-
-template <typename T, typename K> bool interpolate(int interpolation_type, T& value, const K& array, float time, int& last)
-{
-	//const NifModel * nif = static_cast<const NifModel *>( array.model() );
-
-	//if ( nif && array.isValid() ) {
-		//QModelIndex frames = nif->getIndex( array, "Keys" );
-	int next;
-	float x;
-
-	if (timeIndex(time, array, last, next, x)) {
-		T v1(array[last].data); // nif->get<T>(frames.child(last, 0), "Value");
-		T v2(array[next].data); // nif->get<T>( frames.child( next, 0 ), "Value" );
-
-		switch (interpolation_type) {
-
-		case 2:
-		{
-			// Quadratic
-			/*
-				In general, for keyframe values v1 = 0, v2 = 1 it appears that
-				setting v1's corresponding "Backward" value to 1 and v2's
-				corresponding "Forward" to 1 results in a linear interpolation.
-			*/
-
-			// Tangent 1
-			T t1(array[last].backward_tangent); // nif->get<float>( frames.child( last, 0 ), "Backward" );
-			// Tangent 2
-			T t2(array[next].forward_tangent); // nif->get<float>(frames.child(next, 0), "Forward");
-
-			float x2 = x * x;
-			float x3 = x2 * x;
-
-			// Cubic Hermite spline
-			//	x(t) = (2t^3 - 3t^2 + 1)P1  + (-2t^3 + 3t^2)P2 + (t^3 - 2t^2 + t)T1 + (t^3 - t^2)T2
-
-			value = v1 * (2.0f * x3 - 3.0f * x2 + 1.0f) + v2 * (-2.0f * x3 + 3.0f * x2) + t1 * (x3 - 2.0f * x2 + x) + t2 * (x3 - x2);
-
-		}	return true;
-
-		case 5:
-			// Constant
-			if (x < 0.5)
-				value = v1;
-			else
-				value = v2;
-
-			return true;
-		default:
-			value = v1 + (v2 - v1) * x;
-			return true;
-		}
-		//	}
-	}
-
-	return false;
-}
-
-//template <> bool interpolate(int interpolation_type, float& value, const KeyGroup<float>& array, float time, int& last)
-//{
-//	return ::interpolate(interpolation_type, value, array, time, last);
-//}
-//
-//template <> bool interpolate(int interpolation_type, ::Vector3& value, const KeyGroup<Niflib::Vector3>& array, float time, int& last)
-//{
-//	return ::interpolate(interpolation_type, value, array, time, last);
-//}
-
-//template <> bool interpolate(int interpolation_type, ::Color4& value, const KeyGroup<Niflib::Color4>& array, float time, int& last)
-//{
-//	return ::interpolate(interpolation_type, value, array, time, last);
-//}
-//
-//template <> bool interpolate(int interpolation_type, ::Color3& value, const KeyGroup<Niflib::Color3>& array, float time, int& last)
-//{
-//	return ::interpolate(interpolation_type, value, array, time, last);
-//}
-//
-//template <> bool interpolate(int interpolation_type, bool& value, const KeyGroup<bool>& array, float time, int& last)
-//{
-//	int next;
-//	float x;
-//	//const NifModel * nif = static_cast<const NifModel *>( iBlock.model() );
-//
-//	//if ( nif && array.isValid() ) {
-//		//QModelIndex frames = nif->getIndex( array, "Keys" );
-//
-//
-//	if (timeIndex(time, array, last, next, x)) {
-//		value = array.keys[last].data; //nif->get<int>( frames.child( last, 0 ), "Value" );
-//
-//		return true;
-//	}
-//	//}
-//
-//	return false;
-//}
-
-//XYZ rotations
-template <> bool interpolate(int interpolation_type, Niflib::Matrix33& value, const Niflib::array<3, KeyGroup<float > >& array, float time, int& last)
-{
-
-	int next;
-	float x;
-
-	if (!array.empty()) {
-		float r[3] = {};
-
-		for (int s = 0; s < 3 && s < array.size(); s++) {
-			r[s] = 0;
-			interpolate(interpolation_type, r[s], array[s].keys, time, last);
-		}
-
-		value = MatrixFromEuler(0, 0, r[2]) * MatrixFromEuler(0, r[1], 0) * MatrixFromEuler(r[0], 0, 0);
-
-		return true;
-	}
-
-	return false;
-}
-
-//Quaternion rotations
-template <> bool interpolate(int interpolation_type, Niflib::Quaternion& value, const vector<Key<Quaternion > >& array, float time, int& last)
-{
-
-	int next;
-	float x;
-
-	if (timeIndex(time, array, last, next, x)) {
-		Niflib::Quaternion v1 = array[last].data;
-		Niflib::Quaternion v2 = array[next].data;
-
-		if (v1.Dot(v2) < 0)
-			v1 = v1.Inverse(); // don't take the long path
-
-		value = QuaternionSlerp(x, v1, v2);
-
-		return true;
-	}
-
-	return false;
-}
-
+// one key per frame, i.e. sampled from a B-spline
 void importVectorOfKeys(vector<Vector3Key>& keys, hkArray<hkQsTransform>& transforms, int nbones, int boneIdx, float duration) {
-	int n = keys.size();
-	if (n > 0)
+	int n = min((int)keys.size(), transforms.getSize() / nbones);
+	for (int frame = 0; frame < n; ++frame)
 	{
-		for (int i = 0; i < n; ++i)
-		{
-			SetTransformPositionRange(transforms, nbones, boneIdx, i, keys[i]);
-		}
+		hkVector4 p = TOVECTOR4(keys[frame].data);
+		SetTransformPosition(transforms[frame * nbones + boneIdx], p);
 	}
 }
 
 void importVectorOfKeys(vector<FloatKey>& keys, hkArray<hkQsTransform>& transforms, int nbones, int boneIdx, float duration) {
-	int n = keys.size();
-	if (n > 0)
-	{
-		for (int i = 0; i < n; ++i)
-		{
-			SetTransformScaleRange(transforms, nbones, boneIdx, i, keys[i]);
-		}
-	}
+	int n = min((int)keys.size(), transforms.getSize() / nbones);
+	for (int frame = 0; frame < n; ++frame)
+		SetTransformScale(transforms[frame * nbones + boneIdx], keys[frame].data);
 }
 
 void importVectorOfKeys(vector<QuatKey>& keys, hkArray<hkQsTransform>& transforms, int nbones, int boneIdx, float duration) {
-	int n = keys.size();
-	if (n > 0)
+	int n = min((int)keys.size(), transforms.getSize() / nbones);
+	for (int frame = 0; frame < n; ++frame)
 	{
-		for (int i = 0; i < n; ++i)
-		{
-			SetTransformRotationRange(transforms, nbones, boneIdx, i, keys[i]);
-		}
+		::hkQuaternion q = TOQUAT(keys[frame].data);
+		SetTransformRotation(transforms[frame * nbones + boneIdx], q);
 	}
 }
 
-
+// keys resampled at nframes evenly spaced times over the duration
+template<typename T>
+static vector<T> sampleKeys(const vector<Key<T>>& keys, int interpolationType, float duration, int nframes)
+{
+	vector<T> values;
+	ckcmd::KeyTrack<T> track(keys, interpolationType);
+	if (!track.empty())
+	{
+		values.resize(nframes);
+		track.sample(duration / (nframes - 1), nframes, values.data());
+	}
+	return values;
+}
 
 void importVectorOfKeys(int interpolationType, vector<Vector3Key>& keys, hkArray<hkQsTransform>& transforms, int nbones, int boneIdx, float duration, int nframes) {
-	int n = keys.size();
-	if (n > 0)
+	vector<Vector3> values = sampleKeys(keys, interpolationType, duration, nframes);
+	for (int frame = 0; frame < (int)values.size(); frame++)
 	{
-		const float frameTime = duration / (nframes - 1);
-		int lastKey = 0;
-
-		for (int frame = 0; frame < nframes; frame++)
-		{
-			float time = frame * frameTime;
-			Vector3 value;
-			interpolate(interpolationType, value, keys, time, lastKey);
-			hkQsTransform& transform = transforms[frame * nbones + boneIdx];
-			hkVector4 v(value.x, value.y, value.z);
-			SetTransformPosition(transform, v);
-		}
+		const Vector3& value = values[frame];
+		hkVector4 v(value.x, value.y, value.z);
+		SetTransformPosition(transforms[frame * nbones + boneIdx], v);
 	}
 }
 
@@ -1464,38 +1104,21 @@ void importVectorOfKeys(int interpolationType, const Niflib::array<3, KeyGroup<f
 
 	if (rotations[0].keys.size() > 0 && rotations[1].keys.size() > 0 && rotations[2].keys.size() > 0)
 	{
-
-		const float frameTime = duration / (nframes - 1);
-		int lastKeyX = 0;
-		int lastKeyY = 0;
-		int lastKeyZ = 0;
+		vector<float> x = sampleKeys(rotations[0].keys, rotations[0].interpolation, duration, nframes);
+		vector<float> y = sampleKeys(rotations[1].keys, rotations[1].interpolation, duration, nframes);
+		vector<float> z = sampleKeys(rotations[2].keys, rotations[2].interpolation, duration, nframes);
 
 		for (int frame = 0; frame < nframes; frame++)
 		{
-			float time = frame * frameTime;
-			float x = 0., y = 0., z = 0.;
-			bool interpolateX = interpolate(rotations[0].interpolation, x, rotations[0].keys, time, lastKeyX);
-			bool interpolateY = interpolate(rotations[1].interpolation, y, rotations[1].keys, time, lastKeyY);
-			bool interpolateZ = interpolate(rotations[2].interpolation, z, rotations[2].keys, time, lastKeyZ);
-			hkQsTransform& transform = transforms[frame * nbones + boneIdx];
-
-			hkRotation rot_z; rot_z.setIdentity();
-			if (interpolateZ)
-				rot_z.setAxisAngle(hkVector4(0., 0., 1.), z);
-			hkRotation rot_y; rot_y.setIdentity();
-			if (interpolateY)
-				rot_y.setAxisAngle(hkVector4(0., 1., 0.), y);
-			hkRotation rot_x; rot_x.setIdentity();
-			if (interpolateX)
-				rot_x.setAxisAngle(hkVector4(1., 0., 0.), x);
+			hkRotation rot_z; rot_z.setAxisAngle(hkVector4(0., 0., 1.), z[frame]);
+			hkRotation rot_y; rot_y.setAxisAngle(hkVector4(0., 1., 0.), y[frame]);
+			hkRotation rot_x; rot_x.setAxisAngle(hkVector4(1., 0., 0.), x[frame]);
 
 			hkRotation rot(rot_z); rot.mul(rot_y); rot.mul(rot_x);
 			::hkQuaternion q(rot);
 
-			if (interpolateX || interpolateY || interpolateZ)
-				SetTransformRotation(transform, q);
-
-		}	
+			SetTransformRotation(transforms[frame * nbones + boneIdx], q);
+		}
 	}
 	else {
 		Log::Warn("Found XYZ key vector with null keys component");
@@ -1503,43 +1126,18 @@ void importVectorOfKeys(int interpolationType, const Niflib::array<3, KeyGroup<f
 }
 
 void importVectorOfKeys(int interpolationType, vector<QuatKey>& keys, hkArray<hkQsTransform>& transforms, int nbones, int boneIdx, float duration, int nframes) {
-	int n = keys.size();
-	if (n > 0)
+	vector<Quaternion> values = sampleKeys(keys, interpolationType, duration, nframes);
+	for (int frame = 0; frame < (int)values.size(); frame++)
 	{
-		const float frameTime = duration / (nframes - 1);
-		int lastKey = 0;
-
-		for (int frame = 0; frame < nframes; frame++)
-		{
-			float time = frame * frameTime;
-			Niflib::Quaternion value;
-			interpolate(interpolationType, value, keys, time, lastKey);
-			hkQsTransform& transform = transforms[frame * nbones + boneIdx];
-			::hkQuaternion q = TOQUAT(value);
-			SetTransformRotation(transform, q);
-		}
+		::hkQuaternion q = TOQUAT(values[frame]);
+		SetTransformRotation(transforms[frame * nbones + boneIdx], q);
 	}
 }
 
 void importVectorOfKeys(int interpolationType, vector<FloatKey>& keys, hkArray<hkQsTransform>& transforms, int nbones, int boneIdx, float duration, int nframes) {
-	int n = keys.size();
-	if (n > 0)
-	{
-
-		const float frameTime = duration / (nframes - 1);
-		int lastKey = 0;
-
-		for (int frame = 0; frame < nframes; frame++)
-		{
-			float time = frame * frameTime;
-			float s;
-			interpolate(interpolationType, s, keys, time, lastKey);
-			hkQsTransform& transform = transforms[frame * nbones + boneIdx];
-
-			SetTransformScale(transform, s);
-
-		}
-	}
+	vector<float> values = sampleKeys(keys, interpolationType, duration, nframes);
+	for (int frame = 0; frame < (int)values.size(); frame++)
+		SetTransformScale(transforms[frame * nbones + boneIdx], values[frame]);
 }
 
 template<typename T>
@@ -2109,7 +1707,8 @@ void ImportKF::ExportAnimations(const string& rootdir, const fs::path& skelfile
                       , hkPackFormat pkFormat, const hkPackfileWriter::Options& packFileOptions
                       , hkSerializeUtil::SaveOptionBits flags
 					  , ckcmd::HKX::RootMovement& root_info
-                      , bool norelativepath)
+                      , bool norelativepath
+                      , size_t threads)
 {
 	hkResource* skelResource = NULL;
 	hkResource* animResource = NULL;
@@ -2137,13 +1736,12 @@ void ImportKF::ExportAnimations(const string& rootdir, const fs::path& skelfile
 	}
 	if (skeleton != NULL)
 	{
+		ckcmd::ClipBatch clips;
 		for (vector<fs::path>::const_iterator itr = animlist.begin(); itr != animlist.end(); ++itr)
 		{
 			string animfile = (*itr).string();
-			Log::Verbose("ExportAnimation Starting '%s'", animfile.c_str());
-
 
-			char outfile[MAX_PATH], relout[MAX_PATH];
+			char outfile[MAX_PATH];
 			LPCSTR extn = PathFindExtension(outdir.c_str());
 			if (stricmp(extn, ".kf") == 0)
 			{
@@ -2165,13 +1763,19 @@ void ImportKF::ExportAnimations(const string& rootdir, const fs::path& skelfile
 				PathRemoveExtension(outfile);
 				PathAddExtension(outfile, ".hkx");
 			}
-			char workdir[MAX_PATH];
-			_getcwd(workdir, MAX_PATH);
-			PathRelativePathTo(relout, workdir, FILE_ATTRIBUTE_DIRECTORY, outfile, 0);
+			clips.add(*itr, outfile);
+		}
 
+		//root movement of every clip, the one of the last in the list is returned
+		vector<ckcmd::HKX::RootMovement> movements(clips.size());
+		vector<char> exported(clips.size(), 0);
+		hkSerializeUtil::SaveOptionBits saveFlags = (hkSerializeUtil::SaveOptionBits)(hkSerializeUtil::SAVE_TEXT_FORMAT | hkSerializeUtil::SAVE_TEXT_NUMBERS);
+		clips.run([&](const ckcmd::ClipBatch::Clip& clip) {
+			size_t index = &clip - &clips[0];
+			string animfile = clip.source.string();
+			string outfile = clip.destination.string();
 			Log::Verbose("ExportAnimation Reading '%s'", animfile.c_str());
 
-
 			//Niflib::NifOptions options;
 			//options.exceptionOnErrors = false;
 			NifInfo info;
@@ -2181,62 +1785,61 @@ void ImportKF::ExportAnimations(const string& rootdir, const fs::path& skelfile
 			if ( nbindings == 0)
 			{
 				Log::Error("Animation file contains no animation bindings.  Not exporting.");
+				return false;
 			}
-			else if ( nbindings != 1)
+			if ( nbindings != 1)
 			{
 				Log::Error("Animation file contains more than one animation binding.  Not exporting.");
+				return false;
 			}
-			else
+
+			NiControllerSequenceRef seq = blocks[0];
+			hkRootLevelContainer rootCont;
+			hkRefPtr<hkaAnimationContainer> skelAnimCont = new hkaAnimationContainer();
+			hkRefPtr<hkaAnimationBinding> newBinding = new hkaAnimationBinding();
+			skelAnimCont->m_bindings.append(&newBinding, 1);
+			rootCont.m_namedVariants.pushBack( hkRootLevelContainer::NamedVariant("Merged Animation Container", skelAnimCont.val(), &skelAnimCont->staticClass()) );
+
+			Log::Verbose("ExportAnimation Exporting '%s'", outfile.c_str());
+
+			AnimationExport exporter(
+				seq, 
+				skeleton, 
+				newBinding, 
+				info,
+				{},
+				hkTransform(),
+				{},
+				{}
+			);
+			if ( !exporter.doExport() )
 			{
-				for ( int i=0, n=nbindings; i<n; ++i)
-				{
-					char fname[MAX_PATH];
-					_splitpath(animfile.c_str(), NULL, NULL, fname, NULL);
-
-					NiControllerSequenceRef seq = blocks[i];
-					hkRootLevelContainer rootCont;
-					hkRefPtr<hkaAnimationContainer> skelAnimCont = new hkaAnimationContainer();
-					hkRefPtr<hkaAnimationBinding> newBinding = new hkaAnimationBinding();
-					skelAnimCont->m_bindings.append(&newBinding, 1);
-					rootCont.m_namedVariants.pushBack( hkRootLevelContainer::NamedVariant("Merged Animation Container", skelAnimCont.val(), &skelAnimCont->staticClass()) );
-
-					Log::Verbose("ExportAnimation Exporting '%s'", outfile);
-
-					AnimationExport exporter(
-						seq, 
-						skeleton, 
-						newBinding, 
-						info,
-						{},
-						hkTransform(),
-						{},
-						{}
-					);
-					if ( exporter.doExport() )
-					{
-						char outfiledir[MAX_PATH];
-						strcpy(outfiledir, outfile);
-						PathRemoveFileSpec(outfiledir);
-						CreateDirectories(outfiledir);
-
-						Log::Info("Exporting '%s'", outfile);
-						skelAnimCont->m_animations.pushBack(newBinding->m_animation);
-
-						hkOstream stream(outfile);
-						hkVariant root = { &rootCont, &rootCont.staticClass() };
-						flags = (hkSerializeUtil::SaveOptionBits)(hkSerializeUtil::SAVE_TEXT_FORMAT | hkSerializeUtil::SAVE_TEXT_NUMBERS);
-						hkResult res = hkSerializeUtilSave(pkFormat, root, stream, flags, packFileOptions);
-						if ( res != HK_SUCCESS )
-						{
-							Log::Error("Havok reports save failed.");
-						}
-						root_info = exporter._root_info;
-					}
-					else
-					{
-						Log::Error("Export failed for '%s'", relout);
-					}
-				}
+				Log::Error("Export failed for '%s'", outfile.c_str());
+				return false;
+			}
+
+			Log::Info("Exporting '%s'", outfile.c_str());
+			skelAnimCont->m_animations.pushBack(newBinding->m_animation);
+
+			hkOstream stream(outfile.c_str());
+			hkVariant root = { &rootCont, &rootCont.staticClass() };
+			hkResult res = hkSerializeUtilSave(pkFormat, root, stream, saveFlags, packFileOptions);
+			if ( res != HK_SUCCESS )
+			{
+				Log::Error("Havok reports save failed.");
+				return false;
+			}
+			movements[index] = exporter._root_info;
+			exported[index] = 1;
+			return true;
+		}, threads);
+
+		for (size_t i = clips.size(); i-- > 0; )
+		{
+			if (exported[i])
+			{
+				root_info = movements[i];
+				break;
 			}
 		}
 	}
@@ -2263,7 +1866,7 @@ static void findFiles(fs::path startingDir, string extension, vector<fs::path>&
 
 static void ExportProject( const string &projfile, const char * rootPath, const char * outdir
                           , hkPackFormat pkFormat, const hkPackfileWriter::Options& packFileOptions
-                          , hkSerializeUtil::SaveOptionBits flags, bool recursion)
+                          , hkSerializeUtil::SaveOptionBits flags, bool recursion, size_t threads)
 {
 	vector<fs::path> skelfiles, animfiles;
 	char projpath[MAX_PATH], skelpath[MAX_PATH], animpath[MAX_PATH];
@@ -2292,15 +1895,10 @@ static void ExportProject( const string &projfile, const char * rootPath, const
 	else
 	{
 		ckcmd::HKX::RootMovement movement;
-		ImportKF::ExportAnimations(string(rootPath), skelfiles[0],animfiles, outdir, pkFormat, packFileOptions, flags, movement, false);
+		ImportKF::ExportAnimations(string(rootPath), skelfiles[0],animfiles, outdir, pkFormat, packFileOptions, flags, movement, false, threads);
 	}
 }
 
-static void HK_CALL debugReport(const char* msg, void* userContext)
-{
-	Log::Debug("%s", msg);
-}
-
 
 bool ImportKF::InternalRunCommand(map<string, docopt::value> parsedArgs)
 {
@@ -2309,6 +1907,7 @@ bool ImportKF::InternalRunCommand(map<string, docopt::value> parsedArgs)
 	importKF = parsedArgs["<path_to_skeleton>"].asString();
 	animationPaths = parsedArgs["<path_to_animations>"].asString();
 	exportPath = parsedArgs["<path_to_export>"].asString();
+	size_t threads = (size_t)max(0, atoi(parsedArgs["-j"].asString().c_str()));
 
 	bool recursion = true;
 	vector<string> paths;
@@ -2324,10 +1923,8 @@ bool ImportKF::InternalRunCommand(map<string, docopt::value> parsedArgs)
 		return false;
 	}
 
-	hkMallocAllocator baseMalloc;
-	hkMemoryRouter* memoryRouter = hkMemoryInitUtil::initDefault( &baseMalloc, hkMemorySystem::FrameInfo(1024 * 1024) );
-	hkBaseSystem::init( memoryRouter, debugReport );
-	LoadDefaultRegistry();
+	//the clip workers join this session
+	ckcmd::HavokSession::Scope havok;
 
    if (pkFormat == HKPF_XML || pkFormat == HKPF_TAGXML) // set text format to indicate xml
    {
@@ -2379,7 +1976,7 @@ bool ImportKF::InternalRunCommand(map<string, docopt::value> parsedArgs)
 		for (vector<string>::iterator itr = files.begin(); itr != files.end(); ++itr)
 		{
 			string projfile = (*itr).c_str();
-			ExportProject(projfile, rootPath, outdir, pkFormat, packFileOptions, flags, recursion);
+			ExportProject(projfile, rootPath, outdir, pkFormat, packFileOptions, flags, recursion, threads);
 		}
 	}
 	else
@@ -2411,7 +2008,7 @@ bool ImportKF::InternalRunCommand(map<string, docopt::value> parsedArgs)
 				} else { 
 					strcpy(outdir, rootPath); 
 				}
-				ExportProject(skelpath, rootPath, outdir, pkFormat, packFileOptions, flags, recursion);
+				ExportProject(skelpath, rootPath, outdir, pkFormat, packFileOptions, flags, recursion, threads);
 			}
 		}
 		else
@@ -2442,7 +2039,7 @@ bool ImportKF::InternalRunCommand(map<string, docopt::value> parsedArgs)
 						PathRemoveFileSpec(tempdir);
 						PathCombine(animDir, tempdir, "..\animations");
 						PathAddBackslash(animDir);
-						ExportProject(skelpath, rootPath, rootPath, pkFormat, packFileOptions, flags, recursion);
+						ExportProject(skelpath, rootPath, rootPath, pkFormat, packFileOptions, flags, recursion, threads);
 					}
 					else if (paths.size() == 2) // second path will be output
 					{
@@ -2454,7 +2051,7 @@ bool ImportKF::InternalRunCommand(map<string, docopt::value> parsedArgs)
 						PathCombine(rootPath,tempdir,"..\\animations");
 						GetFullPathName(rootPath, MAX_PATH, rootPath, NULL);
 						GetFullPathName(outdir, MAX_PATH, outdir, NULL);
-						ExportProject(skelpath, rootPath, outdir, pkFormat, packFileOptions, flags, recursion);
+						ExportProject(skelpath, rootPath, outdir, pkFormat, packFileOptions, flags, recursion, threads);
 					}
 					else // second path is animation, third is output
 					{
@@ -2482,7 +2079,7 @@ bool ImportKF::InternalRunCommand(map<string, docopt::value> parsedArgs)
 								strcpy(outdir, rootPath); 
 							}
 							ckcmd::HKX::RootMovement movement;
-							ExportAnimations(string(rootPath), skelpath, animfiles, outdir, pkFormat, packFileOptions, flags, movement, norelativepath);
+							ExportAnimations(string(rootPath), skelpath, animfiles, outdir, pkFormat, packFileOptions, flags, movement, norelativepath, threads);
 						}
 
 					}
@@ -2504,14 +2101,10 @@ static hkThreadMemory* threadMemory = NULL;
 static char* stackBuffer = NULL;
 static void InitializeHavok()
 {
-	// Initialize the base system including our memory system
-	hkMemoryRouter* pMemoryRouter(hkMemoryInitUtil::initDefault(hkMallocAllocator::m_defaultMallocAllocator, hkMemorySystem::FrameInfo(5000000)));
-	hkBaseSystem::init(pMemoryRouter, errorReport);
-	LoadDefaultRegistry();
+	ckcmd::HavokSession::acquire();
 }
 
 static void CloseHavok()
 {
-	hkBaseSystem::quit();
-	hkMemoryInitUtil::quit();
+	ckcmd::HavokSession::release();
 }
@@ -5,6 +5,9 @@
 #include <core/hkxcmd.h>
 #include <core/hkxutils.h>
 #include <core/log.h>
+#include <core/ClipBatch.h>
+#include <core/HavokSession.h>
+#include <core/PoseBuffer.h>
 
 #include <map>
 #include <direct.h>
@@ -233,6 +236,8 @@ const float FloatNegINF = *(float*)&IntegerNegInf;
 
 static bool ExportFile(const char *baseSkel, const char *sourceAnim, const char *destAnim, 
                        const hkPackfileWriter::Options& packFileOptions, hkSerializeUtil::SaveOptionBits flags);
+static bool ExportClips(const char *baseSkel, const char *sources, const char *outdir, 
+                        const hkPackfileWriter::Options& packFileOptions, hkSerializeUtil::SaveOptionBits flags, size_t threads);
 
 static hkPackfileWriter::Options GetWriteOptionsFromFormat(hkPackFormat format);
 
@@ -259,19 +264,22 @@ string Retarget::GetHelp() const
     string name = GetName();
     transform(name.begin(), name.end(), name.begin(), ::tolower);
 
-    // Usage: ck-cmd retarget <base_skel> <output_anim> [-i <anim>] [-n <name>] [-d <level>] [-v <flags>] [-f <flags> ...]
-    string usage = "Usage: " + ExeCommandList::GetExeName() + " " + name + " <base_skel> <output_anim> [-i <anim>] [-n <name>] [-d <level>] [-v <flags>] [-f <flags> ...]\r\n";
+    // Usage: ck-cmd retarget <base_skel> <output_anim> [-i <anim>] [-n <name>] [-j <threads>] [-d <level>] [-v <flags>] [-f <flags> ...]
+    string usage = "Usage: " + ExeCommandList::GetExeName() + " " + name + " <base_skel> <output_anim> [-i <anim>] [-n <name>] [-j <threads>] [-d <level>] [-v <flags>] [-f <flags> ...]\r\n";
 
     const char help[] =
 R"(Convert Havok HKX animation to Gamebryo HKX animation using another skeleton
 
 Arguments:
     <base_skel>     Path to Havok skeleton for animation binding
-    <output_anim>   Path to Havok animation to write
+    <output_anim>   Path to Havok animation to write, the output folder when converting many
 
 Options:
     -i <anim>   Path to Gamebryo animation to convert - Defaults to anim.hkx with kf extension
+                A folder converts every .hkx under it, a .txt manifest the clips it lists one
+                per line, optionally followed by a tab and the output path
     -n <name>   Skeleton name
+    -j <threads>  Clips converted at the same time, 0 uses every core [default: 0]
     -d <level>  Debug Level: ERROR, WARN, INFO, DEBUG, VERBOSE 
                 [default: INFO]
     -v <flags>  Havok Packfile saving flags: DEFAULT, XML, WIN32, AMD64, XBOX, XBOX360 
@@ -479,9 +487,9 @@ bool Retarget::InternalRunCommand(map<string, docopt::value> parsedArgs)
         flags = (hkSerializeUtil::SaveOptionBits)(flags | hkSerializeUtil::SAVE_TEXT_FORMAT);
     }
 
-    hkMallocAllocator baseMalloc;
-    hkMemoryRouter* memoryRouter = hkMemoryInitUtil::initDefault(&baseMalloc, hkMemorySystem::FrameInfo(1024 * 1024));
-    hkBaseSystem::init(memoryRouter, ErrorReport);
+    size_t threads = (size_t)max(0, atoi(parsedArgs["-j"].asString().c_str()));
+
+    ckcmd::HavokSession::acquire();
 
     char base[MAX_PATH], source[MAX_PATH], dest[MAX_PATH];
     GetFullPathName(strBase.c_str(), MAX_PATH, base, NULL);
@@ -489,13 +497,16 @@ bool Retarget::InternalRunCommand(map<string, docopt::value> parsedArgs)
     GetFullPathName(strDest.c_str(), MAX_PATH, dest, NULL);
 
     //stringlist skelNames = TokenizeString(skelNames, ",.", true);
-    ExportFile(base, source, dest, GetWriteOptionsFromFormat(pkFormat), flags);
+    bool ok;
+    if (PathIsDirectory(source) || _stricmp(PathFindExtension(source), ".txt") == 0)
+        ok = ExportClips(base, source, dest, GetWriteOptionsFromFormat(pkFormat), flags, threads);
+    else
+        ok = ExportFile(base, source, dest, GetWriteOptionsFromFormat(pkFormat), flags);
 
-    hkBaseSystem::quit();
-    hkMemoryInitUtil::quit();
+    ckcmd::HavokSession::release();
 
 
-    return true;
+    return ok;
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -592,44 +603,12 @@ static void HelpString(hkxcmd::HelpType type){
 // Classes
 //////////////////////////////////////////////////////////////////////////
 
-static void FillTransforms( hkArray<hkQsTransform>& transforms, int boneIdx, int nbones
-						   , const hkQsTransform& localTransform, PosRotScale prs = prsDefault
-						   , int from=0, int to=-1) 
-{
-	int n = transforms.getSize() / nbones;
-	if (n == 0)
-		return;
-
-	if (to == -1 || to >= n) to = n-1;
-
-	if ((prs & prsDefault) == prsDefault)
-	{
-		for (int idx = from; idx <= to; ++idx)
-		{
-			hkQsTransform& transform = transforms[idx*nbones + boneIdx];
-			transform = localTransform;
-		}
-	}
-	else
-	{
-		for (int idx = from; idx <= to; ++idx)
-		{
-			hkQsTransform& transform = transforms[idx*nbones + boneIdx];
-			if ((prs & prsPos) != 0)
-				transform.setTranslation(localTransform.getTranslation());
-			if ((prs & prsRot) != 0)
-				transform.setRotation(localTransform.getRotation());
-			if ((prs & prsScale) != 0)
-				transform.setScale(localTransform.getScale());
-		}
-	}
-}
-
-//////////////////////////////////////////////////////////////////////////
-
-hkRefPtr<hkaAnimation> RetargetAnimation( hkRefPtr<hkaSkeleton> baseSkel
-										 , hkRefPtr<hkaSkeleton> srcSkel
-										 , hkRefPtr<hkaAnimationBinding> srcBinding 
+// the skeletons are only read and not reference counted, they may be shared by clips
+// retargeted at the same time. threads samples the clip, 0 means one per core
+hkRefPtr<hkaAnimation> RetargetAnimation( const hkaSkeleton* baseSkel
+										 , const hkaSkeleton* srcSkel
+										 , hkaAnimationBinding* srcBinding 
+										 , size_t threads = 0
 										 ) 
 {
 	int nbones = baseSkel->m_bones.getSize();
@@ -642,8 +621,6 @@ hkRefPtr<hkaAnimation> RetargetAnimation( hkRefPtr<hkaSkeleton> baseSkel
 	tempAnim->m_duration = duration;
 	tempAnim->m_numberOfTransformTracks = nbones;
 	tempAnim->m_numberOfFloatTracks = srcAnim->m_numberOfFloatTracks;
-	tempAnim->m_transforms.setSize(numTracks*nframes, hkQsTransform::getIdentity());
-	tempAnim->m_floats.setSize(tempAnim->m_numberOfFloatTracks);
 
 	hkaAnnotationTrack defaultAnnotation;
 	defaultAnnotation.m_trackName="";
@@ -658,7 +635,6 @@ hkRefPtr<hkaAnimation> RetargetAnimation( hkRefPtr<hkaSkeleton> baseSkel
 
 	int srcNBones = srcSkel->m_bones.getSize();
 	int srcNTracks = srcAnim->m_numberOfTransformTracks;
-	int srcNFloats = srcAnim->m_numberOfFloatTracks;
 	hkLocalArray<int> iBoneMap(srcNBones), rBoneMap(nbones);
 	iBoneMap.setSize(srcNBones, -1);
 	rBoneMap.setSize(nbones, -1);
@@ -684,53 +660,28 @@ hkRefPtr<hkaAnimation> RetargetAnimation( hkRefPtr<hkaSkeleton> baseSkel
 		tempAnim->m_annotationTracks[idx] = srcAnim->m_annotationTracks[i];
 	}
 
-	hkArray<hkQsTransform>& transforms = tempAnim->m_transforms;
-
-	// Initialize transforms to base skeleton bind pose for bones missing in source
+	// Base skeleton bind pose for bones missing in source
 	for (int i=0; i<nbones; ++i)
 	{
-		int boneIdx = i;
-		if (rBoneMap[boneIdx] == -1)
-		{
+		if (rBoneMap[i] == -1)
 			Log::Verbose("Defaulting transforms to bind pose for '%s'", (LPCSTR)baseSkel->m_bones[i].m_name);
-			hkQsTransform localTransform = baseSkel->m_referencePose[boneIdx];
-			FillTransforms(transforms, boneIdx, nbones, localTransform);
-		}
 	}
 
-	// Walk through source animation and transfer animation
-	hkArray<hkQsTransform> srcTransforms;
-	srcTransforms.setSize(srcNTracks, hkQsTransform::getIdentity());
-	hkArray<float> srcFloats;
-	srcFloats.setSize(srcNFloats, 0.0f);
-
-	hkReal incrFrame = srcAnim->m_duration / (hkReal)nframes;
-	int nCurrentFrame = 0;
-
-	hkArray<float>::iterator curFrameTrackFloats = tempAnim->m_floats.begin();
-	hkArray<hkQsTransform>::iterator curFrameTrackTransforms = transforms.begin();
-	for (hkReal time = 0.0f; time<srcAnim->m_duration; time += incrFrame, nCurrentFrame+=numTracks)
+	// Walk through source animation and transfer animation, source tracks follow the
+	// source skeleton bones and are moved to the matching base bones
+	hkLocalArray<int> trackToBone(srcNTracks);
+	trackToBone.setSize(srcNTracks, -1);
+	for (int i=0; i<srcNTracks && i<srcNBones; ++i)
 	{
-		srcAnim->sampleTracks(time, srcTransforms.begin(), srcFloats.begin(), NULL);
-		//srcAnim->samplePartialTracks(time, srcNTracks, srcTransforms.begin(), srcNFloats, srcFloats.begin(), HK_NULL);
-		hkaSkeletonUtils::normalizeRotations (srcTransforms.begin(), srcNTracks);
-		for (int i=0; i<srcNTracks; ++i)
-		{
-			int boneIdx = iBoneMap[i];
-			hkArray<hkQsTransform>::iterator boneTransform = curFrameTrackTransforms + boneIdx;
-			*boneTransform = srcTransforms[i];
-		}
-		for (int i=0; i<srcNFloats; ++i)
-		{
-			int boneIdx = iBoneMap[i];
-			hkArray<float>::iterator floatTransform = curFrameTrackFloats + boneIdx;
-			*floatTransform = srcFloats[i];
-		}
-		std::advance(curFrameTrackTransforms, srcNTracks);
-		std::advance(curFrameTrackFloats, srcNFloats);
+		trackToBone[i] = iBoneMap[i];
 	}
 
-	hkaSkeletonUtils::normalizeRotations (transforms.begin(), transforms.getSize()); 
+	ckcmd::PoseBuffer poses(*baseSkel);
+	poses.sample(*srcAnim, nframes, trackToBone.begin(), threads);
+	tempAnim->m_transforms.swap(poses.localPoses());
+	tempAnim->m_floats.swap(poses.floatPoses());
+
+	hkaSkeletonUtils::normalizeRotations (tempAnim->m_transforms.begin(), tempAnim->m_transforms.getSize()); 
 
 	// create the animation with default settings
 	//if (stricmp(animType, "hkaInterleavedUncompressedAnimation") == 0)	{
@@ -753,96 +704,56 @@ hkRefPtr<hkaAnimation> RetargetAnimation( hkRefPtr<hkaSkeleton> baseSkel
 	return hkRefPtr<hkaAnimation>();	
 }
 
-static bool ExportFile(const char *baseSkel, const char *sourceAnim, const char *destAnim
-					   , const hkPackfileWriter::Options& packFileOptions, hkSerializeUtil::SaveOptionBits flags)
+// Loads a Havok file holding an animation container, what names the file in the messages
+static hkResource* LoadAnimationContainer(const char *file, const char *what, hkaAnimationContainer*& container, int& nErrors)
 {
-	hkResource* baseResource = NULL;
-	hkResource* srcResource = NULL;
-	hkaAnimationContainer *baseAnimCont = NULL;
-	hkaAnimationContainer *srcAnimCont = NULL;
-	hkaSkeleton* baseSkeleton = NULL;
-
-	hkSerializeUtil::FormatDetails detailsOut;
-
-	Log::Verbose("Begin ExportFile");
-	Log::Info("Base Skeleton: %s", baseSkel);
-	Log::Info("Source File: %s", sourceAnim);
-	Log::Info("Output File: %s", destAnim);
-
-	int nErrors = 0;
-
-	// Read back skeleton file
+	container = NULL;
+	hkIstream stream(file);
+	hkStreamReader *reader = stream.getStreamReader();
+	hkBool32 isLoadable = hkSerializeUtil::isLoadable( reader );
+	if (!isLoadable)
 	{
-		hkIstream stream(baseSkel);
-		hkStreamReader *reader = stream.getStreamReader();
-		hkBool32 isLoadable = hkSerializeUtil::isLoadable( reader );
-		if (!isLoadable)
-		{
-			Log::Warn("Base skeleton file reports that it is not loadable");
-		}
-		if (baseResource = hkSerializeUtilLoad(reader))
-		{
-			const char * hktypename = baseResource->getContentsTypeName();
-			void * contentPtr = baseResource->getContentsPointer(HK_NULL, HK_NULL);
-			if (hkRootLevelContainer* scene = baseResource->getContents<hkRootLevelContainer>())
-			{
-				baseAnimCont = scene->findObject<hkaAnimationContainer>();
-				if (baseAnimCont == NULL)
-				{
-					Log::Error("Base File does not contain an animation container");
-					++nErrors;
-				}
-			}
-			else
-			{
-				Log::Error("Base File does not a root level container");
-				++nErrors;
-			}
-		}
-		else
-		{
-			Log::Error("Base File could not be loaded");
-			++nErrors;
-		}
+		Log::Warn("%s file reports that it is not loadable", what);
 	}
-	if (baseAnimCont != NULL)
+	hkResource* resource = hkSerializeUtilLoad(reader);
+	if (resource)
 	{
-		hkIstream stream(sourceAnim);
-		hkStreamReader *reader = stream.getStreamReader();
-
-		// details will be used later when writing packfile
-		hkSerializeUtil::detectFormat( reader, detailsOut );
-		hkBool32 isLoadable = hkSerializeUtil::isLoadable( reader );
-		if (!isLoadable)
-		{
-			Log::Warn("Source file reports that it is not loadable");
-		}
-		if (srcResource = hkSerializeUtilLoad(reader))
+		if (hkRootLevelContainer* scene = resource->getContents<hkRootLevelContainer>())
 		{
-			const char * hktypename = srcResource->getContentsTypeName();
-			void * contentPtr = srcResource->getContentsPointer(HK_NULL, HK_NULL);
-			if (hkRootLevelContainer* scene = srcResource->getContents<hkRootLevelContainer>())
+			container = scene->findObject<hkaAnimationContainer>();
+			if (container == NULL)
 			{
-				srcAnimCont = scene->findObject<hkaAnimationContainer>();
-				if (srcAnimCont == NULL)
-				{
-					Log::Error("Source File does not contain an animation container");
-					++nErrors;
-				}
-			}
-			else
-			{
-				Log::Error("Source File does not a root level container");
+				Log::Error("%s File does not contain an animation container", what);
 				++nErrors;
 			}
 		}
 		else
 		{
-			Log::Error("Source File could not be loaded");
+			Log::Error("%s File does not a root level container", what);
 			++nErrors;
 		}
 	}
-	if (baseAnimCont != NULL && srcAnimCont != NULL)
+	else
+	{
+		Log::Error("%s File could not be loaded", what);
+		++nErrors;
+	}
+	return resource;
+}
+
+// Retargets one clip on the skeletons of an already loaded base container, which is only read
+static bool ExportClip(hkaAnimationContainer *baseAnimCont, const char *sourceAnim, const char *destAnim
+					   , const hkPackfileWriter::Options& packFileOptions, hkSerializeUtil::SaveOptionBits flags
+					   , size_t threads)
+{
+	hkaAnimationContainer *srcAnimCont = NULL;
+
+	Log::Info("Source File: %s", sourceAnim);
+	Log::Info("Output File: %s", destAnim);
+
+	int nErrors = 0;
+	hkResource* srcResource = LoadAnimationContainer(sourceAnim, "Source", srcAnimCont, nErrors);
+	if (srcAnimCont != NULL)
 	{
 		// Get skeleton names from the animation file
 		//if (inputSkelNames.empty()) 
@@ -916,10 +827,11 @@ static bool ExportFile(const char *baseSkel, const char *sourceAnim, const char
 					}
 					else
 					{
-						hkRefPtr<hkaSkeleton> baseSkeleton, srcSkeleton;
+						hkaSkeleton* baseSkeleton = HK_NULL;
+						hkaSkeleton* srcSkeleton = HK_NULL;
 						for (int i=0,n=baseAnimCont->m_skeletons.getSize(); i<n; ++i)
 						{
-							hkRefPtr<hkaSkeleton> skeleton = baseAnimCont->m_skeletons[i];
+							hkaSkeleton* skeleton = baseAnimCont->m_skeletons[i];
 							if ( skName == skeleton->m_name ) {
 								baseSkeleton = skeleton;
 								break;
@@ -934,7 +846,7 @@ static bool ExportFile(const char *baseSkel, const char *sourceAnim, const char
 						{
 							for (int i=0,n=srcAnimCont->m_skeletons.getSize(); i<n; ++i)
 							{
-								hkRefPtr<hkaSkeleton> skeleton = srcAnimCont->m_skeletons[i];
+								hkaSkeleton* skeleton = srcAnimCont->m_skeletons[i];
 								if ( skName == skeleton->m_name ) {
 									srcSkeleton = skeleton;
 									break;
@@ -947,7 +859,7 @@ static bool ExportFile(const char *baseSkel, const char *sourceAnim, const char
 							}
 							else
 							{
-								hkRefPtr<hkaAnimation> outAnim = RetargetAnimation(baseSkeleton, srcSkeleton, srcBinding);
+								hkRefPtr<hkaAnimation> outAnim = RetargetAnimation(baseSkeleton, srcSkeleton, srcBinding, threads);
 								if (outAnim == NULL)
 								{
 									Log::Error("Output animation not exported");
@@ -986,6 +898,11 @@ static bool ExportFile(const char *baseSkel, const char *sourceAnim, const char
 				{
 					res = hkSerializeUtil::save( &rootCont, rootCont.staticClass(), stream.getStreamWriter(), flags );
 				}
+				if (res != HK_SUCCESS)
+				{
+					Log::Error("Havok reports save failed for '%s'", destAnim);
+					++nErrors;
+				}
 			}
 			else
 			{
@@ -995,6 +912,60 @@ static bool ExportFile(const char *baseSkel, const char *sourceAnim, const char
 	}
 	if (srcResource)
 		srcResource->removeReference();
+	return (nErrors == 0);
+}
+
+static bool ExportFile(const char *baseSkel, const char *sourceAnim, const char *destAnim
+					   , const hkPackfileWriter::Options& packFileOptions, hkSerializeUtil::SaveOptionBits flags)
+{
+	hkaAnimationContainer *baseAnimCont = NULL;
+
+	Log::Verbose("Begin ExportFile");
+	Log::Info("Base Skeleton: %s", baseSkel);
+
+	int nErrors = 0;
+	hkResource* baseResource = LoadAnimationContainer(baseSkel, "Base", baseAnimCont, nErrors);
+	if (baseAnimCont != NULL && nErrors == 0)
+	{
+		if (!ExportClip(baseAnimCont, sourceAnim, destAnim, packFileOptions, flags, 0))
+			++nErrors;
+	}
+	if (baseResource)
+		baseResource->removeReference();
+	return (nErrors == 0);
+}
+
+// Retargets every clip of a folder, or listed by a manifest, against one load of the base skeleton
+static bool ExportClips(const char *baseSkel, const char *sources, const char *outdir, 
+                        const hkPackfileWriter::Options& packFileOptions, hkSerializeUtil::SaveOptionBits flags, size_t threads)
+{
+	ckcmd::ClipBatch clips;
+	if (PathIsDirectory(sources))
+	{
+		clips.addFolder(sources, ".hkx", outdir, ".hkx");
+	}
+	else if (clips.addManifest(sources, outdir, ".hkx") < 0)
+	{
+		Log::Error("Unable to read the manifest '%s'", sources);
+		return false;
+	}
+	if (clips.size() == 0)
+	{
+		Log::Warn("No animations found in '%s'", sources);
+		return false;
+	}
+
+	Log::Info("Base Skeleton: %s", baseSkel);
+	hkaAnimationContainer *baseAnimCont = NULL;
+	int nErrors = 0;
+	hkResource* baseResource = LoadAnimationContainer(baseSkel, "Base", baseAnimCont, nErrors);
+	if (baseAnimCont != NULL && nErrors == 0)
+	{
+		//the clips already run side by side, each one is sampled on its own worker
+		nErrors += (int)clips.run([&](const ckcmd::ClipBatch::Clip& clip) {
+			return ExportClip(baseAnimCont, clip.source.string().c_str(), clip.destination.string().c_str(), packFileOptions, flags, 1);
+		}, threads);
+	}
 	if (baseResource)
 		baseResource->removeReference();
 	return (nErrors == 0);
@@ -9,6 +9,7 @@
 #undef min
 
 #include <core/hkxcmd.h>
+#include <core/HavokSession.h>
 #include <core/hkxutils.h>
 #include <core/AnimationCache.h>
 #include <core/HKXWrangler.h>
@@ -569,8 +570,10 @@ bool RetargetCreatureCmd::InternalRunCommand(map<string, docopt::value> parsedAr
 		}
 		if (to_crc.at(to_crc.size() - 1) == '\\')
 			to_crc = to_crc.substr(0, to_crc.size() - 1);
-		long long crc = stoll(HkCRC::compute(to_crc),NULL,16);
-		string crc_str = to_string(crc);
+		auto crc = HkCRC::crc32(to_crc);
+		if (!crc)
+			continue;
+		string crc_str = HkCRC::cache_string(*crc);
 		//This is bound to occur often
 		if (retarget_map.find(crc_str) != retarget_map.end())
 			continue;
@@ -582,9 +585,10 @@ bool RetargetCreatureCmd::InternalRunCommand(map<string, docopt::value> parsedAr
 		string new_to_crc = to_crc;
 		new_to_crc = replace_all(new_to_crc, old_names, lower_output);
 
-		long long new_crc = stoll(HkCRC::compute(new_to_crc), NULL, 16);
-		string new_crc_str = to_string(new_crc);
-		retarget_map[crc_str] = new_crc_str;
+		auto new_crc = HkCRC::crc32(new_to_crc);
+		if (!new_crc)
+			continue;
+		retarget_map[crc_str] = HkCRC::cache_string(*new_crc);
 
 	}
 	fs::create_directories(fs::path(fs::path(output) / new_char_name).parent_path());
@@ -717,6 +721,7 @@ bool RetargetCreatureCmd::InternalRunCommand(map<string, docopt::value> parsedAr
 	block = replace_all(block, old_names, output_havok_project_name);
 	cache_ptr->block.clear();
 	cache_ptr->block.fromASCII(block);
+	cache_ptr->invalidate();
 	auto set_block = cache_ptr->sets.getBlock();
 	set_block = replace_all(set_block, old_names, output_havok_project_name);
 	//adjust crc
@@ -1064,14 +1069,10 @@ static hkThreadMemory* threadMemory = NULL;
 static char* stackBuffer = NULL;
 static void InitializeHavok()
 {
-	// Initialize the base system including our memory system
-	hkMemoryRouter*		pMemoryRouter(hkMemoryInitUtil::initDefault(hkMallocAllocator::m_defaultMallocAllocator, hkMemorySystem::FrameInfo(5000000)));
-	hkBaseSystem::init(pMemoryRouter, errorReport);
-	LoadDefaultRegistry();
+	ckcmd::HavokSession::acquire();
 }
 
 static void CloseHavok()
 {
-	hkBaseSystem::quit();
-	hkMemoryInitUtil::quit();
+	ckcmd::HavokSession::release();
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include <commands/fixsse.h>
 #include <core/NifFile.h>
+#include <core/HavokSession.h>
 #include <core/HKXWrangler.h>
 #include <core/FBXWrangler.h>
 
@@ -31,6 +32,7 @@
 
 #include <core/EulerAngles.h>
 #include <core/MathHelper.h>
+#include <core/TextureIndex.h>
 
 #include <algorithm>
 
@@ -365,7 +367,7 @@ inline void visit_object(NiNodeRef obj) {
 	obj->SetChildren(children);
 }
 
-void findTextureOrTryToCorrect(BSShaderTextureSetRef texture_set, const fs::path& texture_folder_path, const fs::path& vanilla_path)
+void findTextureOrTryToCorrect(BSShaderTextureSetRef texture_set, TextureIndex& texture_index)
 {
 	vector<string> textures = texture_set->GetTextures();
 	for (int i = 0; i < textures.size(); i++)
@@ -380,30 +382,16 @@ void findTextureOrTryToCorrect(BSShaderTextureSetRef texture_set, const fs::path
 			continue;
 		}
 
+		//mod textures first, then vanilla, each as written and then under textures
 		string this_tex = textures[i];
-		fs::path texture_path = texture_folder_path / this_tex;
-		if (fs::exists(texture_path))
-			continue;
-		texture_path = texture_folder_path / "textures" / this_tex;
-		if (fs::exists(texture_path))
-		{
+		const TextureIndex::Texture& texture = texture_index.find(this_tex);
+		if (texture.exists && texture.prefixed)
 			textures[i] = (fs::path("textures") / this_tex).string().c_str();
-			continue;
-		}
-		texture_path = vanilla_path / this_tex;
-		if (fs::exists(texture_path))
-			continue;
-		texture_path = vanilla_path / "textures" / this_tex;
-		if (fs::exists(texture_path))
-		{
-			textures[i] = (fs::path("textures") / this_tex).string().c_str();
-			continue;
-		}
 	}
 	texture_set->SetTextures(textures);
 }
 
-inline void scanBSProperties(NiTriShapeRef shape, const fs::path& texture_folder_path, const fs::path& vanilla_path)
+inline void scanBSProperties(NiTriShapeRef shape, TextureIndex& texture_index)
 {
 	//check texture sets
 	string shape_name = shape->GetName();
@@ -438,7 +426,7 @@ inline void scanBSProperties(NiTriShapeRef shape, const fs::path& texture_folder
 	BSShaderTextureSetRef textures = property->GetTextureSet();
 	BSLightingShaderPropertyShaderType shader_type = property->GetSkyrimShaderType();
 
-	findTextureOrTryToCorrect(textures, texture_folder_path, vanilla_path);
+	findTextureOrTryToCorrect(textures, texture_index);
 
 	bool hasVCFlag = shape->GetData()->GetHasVertexColors();
 	bool hasVCArray = shape->GetData()->GetVertexColors().size() == shape->GetData()->GetVertices().size();
@@ -1344,7 +1332,7 @@ void rebuild_collisions(NiObjectRef root, vector<NiObjectRef>& blocks, bool forc
 }
 
 
-vector<NiObjectRef> fixssenif(vector<NiObjectRef> blocks, NifInfo info, const fs::path& texture_path, const fs::path& vanilla_texture_path, bool forceCollision) {
+vector<NiObjectRef> fixssenif(vector<NiObjectRef> blocks, NifInfo info, TextureIndex& texture_index, bool forceCollision) {
 
 	NiObjectRef root = GetFirstRoot(blocks);
 
@@ -1368,7 +1356,7 @@ vector<NiObjectRef> fixssenif(vector<NiObjectRef> blocks, NifInfo info, const fs
 		if (block->IsDerivedType(BSXFlags::TYPE))
 			bsx_flags = DynamicCast<BSXFlags>(block);
 		if (block->IsDerivedType(NiTriShape::TYPE))
-			scanBSProperties(DynamicCast<NiTriShape>(block), texture_path, vanilla_texture_path);
+			scanBSProperties(DynamicCast<NiTriShape>(block), texture_index);
 		if (block->IsDerivedType(NiTriShapeData::TYPE))
 		{
 			NiTriShapeDataRef data = DynamicCast<NiTriShapeData>(block);
@@ -1474,16 +1462,12 @@ static hkThreadMemory* threadMemory = NULL;
 static char* stackBuffer = NULL;
 static void InitializeHavok()
 {
-	// Initialize the base system including our memory system
-	hkMemoryRouter* pMemoryRouter(hkMemoryInitUtil::initDefault(hkMallocAllocator::m_defaultMallocAllocator, hkMemorySystem::FrameInfo(5000000)));
-	hkBaseSystem::init(pMemoryRouter, errorReport);
-	LoadDefaultRegistry();
+	ckcmd::HavokSession::acquire();
 }
 
 static void CloseHavok()
 {
-	hkBaseSystem::quit();
-	hkMemoryInitUtil::quit();
+	ckcmd::HavokSession::release();
 }
 
 
@@ -1509,12 +1493,17 @@ bool FixSSENif::InternalRunCommand(map<string, docopt::value> parsedArgs)
 		InitializeHavok();
 		vector<fs::path> nifs; find_files(scanPath, ".nif", nifs);
 		fs::path texture_path = fs::path(scanPath).parent_path();
+		//both folders are walked once, every nif is then checked against the same index
+		TextureIndex texture_index;
+		texture_index.add(texture_path);
+		if (!vanilla_texture_path.empty())
+			texture_index.add(fs::path(vanilla_texture_path));
 		for (size_t i = 0; i < nifs.size(); i++) {
 			Log::Info("Current File: %s", nifs[i].string().c_str());
 			NifInfo info;
 			try {
 				vector<NiObjectRef> blocks = ReadNifList(nifs[i].string().c_str(), &info);
-				vector<NiObjectRef> new_blocks = fixssenif(blocks, info, texture_path, vanilla_texture_path, force_recollision);
+				vector<NiObjectRef> new_blocks = fixssenif(blocks, info, texture_index, force_recollision);
 				fs::path out;
 				if (!doOverwrite) {
 					out = fs::path(scanPath).parent_path() / fs::path("out") / relative_to(nifs[i], scanPath);
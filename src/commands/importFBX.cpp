@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include <core/hkxcmd.h>
+#include <core/HavokSession.h>
 #include <core/hkfutils.h>
 #include <core/log.h>
 
@@ -18,7 +19,7 @@ using namespace ckcmd::FBX;
 using namespace ckcmd::info;
 using namespace ckcmd::BSA;
 
-static bool BeginConversion(string importPath, string exportPath, bool simplifyNodes);
+static bool BeginConversion(string importPath, string exportPath, bool simplifyNodes, const ckcmd::KeyReduction& reduction);
 static void InitializeHavok();
 static void CloseHavok();
 
@@ -41,7 +42,7 @@ string ImportFBX::GetHelp() const
     string name = GetName();
     transform(name.begin(), name.end(), name.begin(), ::tolower);
 
-	string usage = "Usage: " + ExeCommandList::GetExeName() + " " + name + " <path_to_fbx> [--export-dir=<path_to_export>] [--simplify]\r\n";
+	string usage = "Usage: " + ExeCommandList::GetExeName() + " " + name + " <path_to_fbx> [--export-dir=<path_to_export>] [--simplify] [--reduce=<fit>] [--tolerance=<tolerances>]\r\n";
 
 	const char help[] =
 		R"(Converts NIF format to FBX.
@@ -51,6 +52,8 @@ string ImportFBX::GetHelp() const
         Options:
 			-e, --export-dir=<path_to_export>  optional export path [default: ./]
 			-z, --simplify  Simplify output node structure
+			-r, --reduce=<fit>  drop the animation keys a none, linear or spline fit reproduces [default: none]
+			-t, --tolerance=<tolerances>  largest error of a dropped key as position,degrees,scale, the degrees bound the whole rotation and are split over its euler axes [default: 0.01,0.1,0.001]
 
 		)";
 	return usage + help;
@@ -72,13 +75,21 @@ bool ImportFBX::InternalRunCommand(map<string, docopt::value> parsedArgs)
 	if(parsedArgs["--simplify"].isBool())
 		simplifyNodes = parsedArgs["--simplify"].asBool();
 
+	ckcmd::KeyReduction reduction;
+	string fit = parsedArgs["--reduce"].isString() ? parsedArgs["--reduce"].asString() : "none";
+	string tolerances = parsedArgs["--tolerance"].isString() ? parsedArgs["--tolerance"].asString() : "0.01,0.1,0.001";
+	if (!reduction.parse(fit, tolerances)) {
+		Log::Error("Invalid key reduction: %s %s", fit.c_str(), tolerances.c_str());
+		return false;
+	}
+
 	InitializeHavok();
-	BeginConversion(importFBX, exportPath, simplifyNodes);
+	BeginConversion(importFBX, exportPath, simplifyNodes, reduction);
 	CloseHavok();
 	return true;
 }
 
-bool BeginConversion(string importFBX, string exportPath, bool simplifyNodes) {
+bool BeginConversion(string importFBX, string exportPath, bool simplifyNodes, const ckcmd::KeyReduction& reduction) {
 	fs::path fbxModelpath = fs::path(importFBX);
 	if (!fs::exists(fbxModelpath) || !fs::is_regular_file(fbxModelpath)) {
 		Log::Info("Invalid file: %s", importFBX.c_str());
@@ -91,6 +102,7 @@ bool BeginConversion(string importFBX, string exportPath, bool simplifyNodes) {
 	}
 
 	FBXWrangler wrangler;
+	wrangler.setKeyReduction(reduction);
 	if (wrangler.ImportScene(fbxModelpath.string().c_str()))
 	{
 
@@ -121,14 +133,10 @@ static hkThreadMemory* threadMemory = NULL;
 static char* stackBuffer = NULL;
 static void InitializeHavok()
 {
-	// Initialize the base system including our memory system
-	hkMemoryRouter*		pMemoryRouter(hkMemoryInitUtil::initDefault(hkMallocAllocator::m_defaultMallocAllocator, hkMemorySystem::FrameInfo(5000000)));
-	hkBaseSystem::init(pMemoryRouter, errorReport);
-	LoadDefaultRegistry();
+	ckcmd::HavokSession::acquire();
 }
 
 static void CloseHavok()
 {
-	hkBaseSystem::quit();
-	hkMemoryInitUtil::quit();
+	ckcmd::HavokSession::release();
 }
\ No newline at end of file
@@ -9,6 +9,7 @@
 
 #include "stdafx.h"
 #include <core/hkxcmd.h>
+#include <core/HavokSession.h>
 #include <core/hkfutils.h>
 #include <core/log.h>
 
@@ -17,6 +18,8 @@
 #include <commands/Geometry.h>
 #include <core/games.h>
 #include <core/bsa.h>
+#include <core/BSAExtractor.h>
+#include <core/ThreadPool.h>
 #include <core/NifFile.h>
 #include <commands/NifScan.h>
 #include <commands/Skeleton.h>
@@ -103,6 +106,7 @@ static inline hkTransform TOHKTRANSFORM(const Niflib::Matrix33& r, const Niflib:
 }
 
 static bool BeginConversion(string importPath, string exportPath);
+static bool ConvertMeshes(string importPath, string exportPath, size_t threads);
 static void InitializeHavok();
 static void CloseHavok();
 
@@ -127,8 +131,8 @@ string ConvertNif::GetHelp() const
 	string name = GetName();
 	transform(name.begin(), name.end(), name.begin(), ::tolower);
 
-	// Usage: ck-cmd convertnif [-i <path_to_import>] [-e <path_to_export>]
-	string usage = "Usage: " + ExeCommandList::GetExeName() + " " + name + " [<path_to_export>] [<path_to_import>] \r\n";
+	// Usage: ck-cmd convertnif [-i <path_to_import>] [-e <path_to_export>] [-j <threads>]
+	string usage = "Usage: " + ExeCommandList::GetExeName() + " " + name + " [<path_to_export>] [<path_to_import>] [-j <threads>]\r\n";
 
 	//will need to check this help in console/
 	const char help[] =
@@ -138,6 +142,10 @@ string ConvertNif::GetHelp() const
 			<path_to_export> path to exported models;
 			<path_to_import> path to models which you want to convert
 
+		Options:
+			-j <threads>  converts the models only, on this many threads, 0 uses every core.
+			              The output does not depend on the number of threads
+
 		If none of these are present, then the program will look through your Oblivion BSAs. (if present))";
 
 	return usage + help;
@@ -161,7 +169,10 @@ bool ConvertNif::InternalRunCommand(map<string, docopt::value> parsedArgs)
 		exportPath = parsedArgs["<path_to_export>"].asString();
 
 	InitializeHavok();
-	BeginConversion(importPath, exportPath);
+	if (parsedArgs["-j"].isString())
+		ConvertMeshes(importPath, exportPath, (size_t)max(0, atoi(parsedArgs["-j"].asString().c_str())));
+	else
+		BeginConversion(importPath, exportPath);
 	CloseHavok();
 	return true;
 }
@@ -1728,12 +1739,28 @@ public:
 	}
 };
 
+//models converted in parallel can share textures, writes to the same file are serialized
+static HRESULT save_dds(const DirectX::Image* images, size_t count, const DirectX::TexMetadata& metadata, const fs::path& out_path)
+{
+	static std::mutex registry_mutex;
+	static std::map<fs::path, std::unique_ptr<std::mutex>> file_mutexes;
+	std::mutex* file_mutex = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(registry_mutex);
+		auto& entry = file_mutexes[out_path];
+		if (!entry)
+			entry = std::make_unique<std::mutex>();
+		file_mutex = entry.get();
+	}
+	std::lock_guard<std::mutex> lock(*file_mutex);
+	return DirectX::SaveToDDSFile(images, count, metadata, DirectX::DDS_FLAGS_NONE, out_path.wstring().c_str());
+}
+
 void checkDiffuseAlpha(const string& diffuse_name, const string& export_path) {
 	DirectX::ScratchImage g_image;
 	DirectX::ScratchImage g_timage;
 	DirectX::TexMetadata g_original_info;
-	vector<uint8_t> dds_bin;
-	games.load(Games::TES4, diffuse_name, dds_bin);
+	ckcmd::FileView dds_bin = games.open(Games::TES4, diffuse_name);
 	HRESULT result = DirectX::LoadFromDDSMemory(dds_bin.data(), dds_bin.size(),
 		DirectX::DDS_FLAGS_NONE, &g_original_info, g_image);
 	if (FAILED(result)) {
@@ -1774,22 +1801,17 @@ void checkDiffuseAlpha(const string& diffuse_name, const string& export_path) {
 	if (FAILED(hr))
 	{
 		Log::Info("Unable to compress glow map %s", diffuse_name);
-		hr = DirectX::SaveToDDSFile(converted.GetImages(), converted.GetImageCount(), converted.GetMetadata(),
-			DirectX::DDS_FLAGS_NONE,
-			out_path.wstring().c_str());
+		hr = save_dds(converted.GetImages(), converted.GetImageCount(), converted.GetMetadata(), out_path);
 		return;
 	}
-	hr = DirectX::SaveToDDSFile(compressed.GetImages(), compressed.GetImageCount(), compressed.GetMetadata(),
-		DirectX::DDS_FLAGS_NONE,
-		out_path.wstring().c_str());
+	hr = save_dds(compressed.GetImages(), compressed.GetImageCount(), compressed.GetMetadata(), out_path);
 }
 
 void convertGlowMap(const string& glow_name, const string& export_path) {
 	DirectX::ScratchImage g_image;
 	DirectX::ScratchImage g_timage;
 	DirectX::TexMetadata g_original_info;
-	vector<uint8_t> dds_glow_bin;
-	games.load(Games::TES4, glow_name, dds_glow_bin);
+	ckcmd::FileView dds_glow_bin = games.open(Games::TES4, glow_name);
 	HRESULT result = DirectX::LoadFromDDSMemory(dds_glow_bin.data(), dds_glow_bin.size(),
 		DirectX::DDS_FLAGS_NONE, &g_original_info, g_image);
 	if (FAILED(result)) {
@@ -1830,14 +1852,10 @@ void convertGlowMap(const string& glow_name, const string& export_path) {
 	if (FAILED(hr))
 	{
 		Log::Info("Unable to compress glow map %s", glow_name);
-		hr = DirectX::SaveToDDSFile(converted.GetImages(), converted.GetImageCount(), converted.GetMetadata(),
-			DirectX::DDS_FLAGS_NONE,
-			out_path.wstring().c_str());
+		hr = save_dds(converted.GetImages(), converted.GetImageCount(), converted.GetMetadata(), out_path);
 		return;
 	}
-	hr = DirectX::SaveToDDSFile(compressed.GetImages(), compressed.GetImageCount(), compressed.GetMetadata(),
-		DirectX::DDS_FLAGS_NONE,
-		out_path.wstring().c_str());
+	hr = save_dds(compressed.GetImages(), compressed.GetImageCount(), compressed.GetMetadata(), out_path);
 }
 
 class FlipBookConverter
@@ -1878,11 +1896,9 @@ public:
 			if (path == "")
 				path = tex->GetFileName();
 
-			vector<uint8_t> dds_bin;
-			vector<uint8_t> dds_glow_bin;
-			games.load(Games::TES4, name, dds_bin);
-			games.load(Games::TES4, glow_name, dds_glow_bin);
-			if (!dds_glow_bin.empty())
+			ckcmd::FileView dds_bin = games.open(Games::TES4, name);
+			ckcmd::FileView dds_glow_bin = games.open(Games::TES4, glow_name);
+			if (dds_glow_bin.size() > 0)
 				hasGlow = true;
 
 			HRESULT result =  DirectX::LoadFromDDSMemory(dds_bin.data(), dds_bin.size(),
@@ -2034,9 +2050,7 @@ public:
 		fs::path out_path = fs::path(export_path) / path;
 		fs::create_directories(out_path.parent_path());
 
-		hr = DirectX::SaveToDDSFile(cimg, cnimg, cinfo,
-			DirectX::DDS_FLAGS_NONE,
-			out_path.wstring().c_str());
+		hr = save_dds(cimg, cnimg, cinfo, out_path);
 
 		if (FAILED(hr))
 			throw runtime_error("Unable to save NiFlipController sources!");
@@ -2076,9 +2090,7 @@ public:
 
 
 
-			hr = DirectX::SaveToDDSFile(cimg, cnimg, cinfo,
-					DirectX::DDS_FLAGS_NONE,
-					out_path.wstring().c_str());
+			hr = save_dds(cimg, cnimg, cinfo, out_path);
 
 		}
 
@@ -2199,11 +2211,16 @@ public:
 	}
 };
 
-map<NiMaterialColorControllerRef, NiPoint3InterpControllerRef> material_controllers_map;
-map<NiAlphaControllerRef, NiFloatInterpControllerRef> material_alpha_controllers_map;
-map<NiFlipControllerRef, NiFloatInterpControllerRef> material_flip_controllers_map;
-map<NiFlipControllerRef, pair< float, vector<pair<float, float>>>> deferred_blends;
-map<NiTextureTransformControllerRef, NiFloatInterpControllerRef> material_transform_controllers_map;
+//State of the conversion of one nif: the shader controllers created for the Oblivion
+//material and texture controllers, looked up again when sequences and links are fixed.
+//Each convert_blocks call owns one, so models can be converted concurrently
+struct ConversionContext {
+	map<NiMaterialColorControllerRef, NiPoint3InterpControllerRef> material_controllers_map;
+	map<NiAlphaControllerRef, NiFloatInterpControllerRef> material_alpha_controllers_map;
+	map<NiFlipControllerRef, NiFloatInterpControllerRef> material_flip_controllers_map;
+	map<NiFlipControllerRef, pair< float, vector<pair<float, float>>>> deferred_blends;
+	map<NiTextureTransformControllerRef, NiFloatInterpControllerRef> material_transform_controllers_map;
+};
 
 void convert_tt_rotate(NiTextureTransformControllerRef oldController, NiFloatInterpControllerRef newController, NiInterpolatorRef oldInterpolator, NiFloatInterpControllerRef& new_v_controller, NiInterpolatorRef& newInterpolatorU, NiInterpolatorRef& newInterpolatorV)
 {
@@ -2317,6 +2334,12 @@ class ConverterVisitor : public RecursiveFieldVisitor<ConverterVisitor> {
 	int controller_id = 1;
 	bool _is_clutter = false;
 
+	map<NiMaterialColorControllerRef, NiPoint3InterpControllerRef>& material_controllers_map;
+	map<NiAlphaControllerRef, NiFloatInterpControllerRef>& material_alpha_controllers_map;
+	map<NiFlipControllerRef, NiFloatInterpControllerRef>& material_flip_controllers_map;
+	map<NiFlipControllerRef, pair< float, vector<pair<float, float>>>>& deferred_blends;
+	map<NiTextureTransformControllerRef, NiFloatInterpControllerRef>& material_transform_controllers_map;
+
 	NiObjectRef find_parent(NiObjectRef& object) {
 		for (auto& block : blocks) {
 			if (block->IsDerivedType(NiNode::TYPE)) {
@@ -2352,14 +2375,19 @@ public:
 	Vector3 _collision_translation;
 	Vector3 _translation;
 
-	ConverterVisitor(const NifInfo& info, NiObjectRef root, const vector<NiObjectRef>& blocks, const Vector3& translation, const Vector3& collision_translation, bool is_clutter, const fs::path& export_path) :
+	ConverterVisitor(const NifInfo& info, NiObjectRef root, const vector<NiObjectRef>& blocks, const Vector3& translation, const Vector3& collision_translation, bool is_clutter, const fs::path& export_path, ConversionContext& context) :
 		RecursiveFieldVisitor(*this, info),
 		this_info(info),
 		blocks(blocks),
 		_translation(translation),
 		_collision_translation(collision_translation),
 		_is_clutter(is_clutter),
-		_export_path(export_path)
+		_export_path(export_path),
+		material_controllers_map(context.material_controllers_map),
+		material_alpha_controllers_map(context.material_alpha_controllers_map),
+		material_flip_controllers_map(context.material_flip_controllers_map),
+		deferred_blends(context.deferred_blends),
+		material_transform_controllers_map(context.material_transform_controllers_map)
 	{
 		root->accept(*this, info);
 		for (NiObjectRef obj : blocks) {
@@ -2966,12 +2994,7 @@ public:
 	bool findTextureFromBSA(const string& name)
 	{
 		Games& games = Games::Instance();
-		for (const auto& bsa_file : games.bsa_files()) {
-			if (bsa_file.find(name)) {
-				return true;
-			}
-		}
-		return false;
+		return games.isGameInstalled(Games::TES4) && games.vfs(Games::TES4).exists(name);
 	}
 
 	static string replace_all(const string& source, const string& pattern, const string& new_pattern)
@@ -4278,11 +4301,12 @@ public:
 
 class FixTargetsVisitor : public RecursiveFieldVisitor<FixTargetsVisitor> {
 	vector<NiObjectRef>& blocks;
+	map<NiTextureTransformControllerRef, NiFloatInterpControllerRef>& material_transform_controllers_map;
 public:
 
 
-	FixTargetsVisitor(NiObject* root, const NifInfo& info, vector<NiObjectRef>& blocks) :
-		RecursiveFieldVisitor(*this, info), blocks(blocks) {
+	FixTargetsVisitor(NiObject* root, const NifInfo& info, vector<NiObjectRef>& blocks, ConversionContext& context) :
+		RecursiveFieldVisitor(*this, info), blocks(blocks), material_transform_controllers_map(context.material_transform_controllers_map) {
 		root->accept(*this, info);
 	}
 
@@ -5046,7 +5070,8 @@ void convert_blocks(
 
 	NiNode* rootn = DynamicCast<NiNode>(root);
 
-	ConverterVisitor fimpl(info, root, blocks, translation, { 0.,0.,0. }, is_clutter_or_furn == 1, exportPath);
+	ConversionContext context;
+	ConverterVisitor fimpl(info, root, blocks, translation, { 0.,0.,0. }, is_clutter_or_furn == 1, exportPath, context);
 
 	if (root->IsSameType(NiBillboardNode::TYPE)) {
 		isBillboardRoot = true;
@@ -5185,7 +5210,7 @@ void convert_blocks(
 		vector<NiObjectRef> new_blocks = RebuildVisitor(root, info).blocks;
 
 		//fix targets from nitrishapes substitution
-		FixTargetsVisitor(root, info, new_blocks);
+		FixTargetsVisitor(root, info, new_blocks, context);
 
 		if (DynamicCast<NiNode>(root) != NULL && DynamicCast<NiNode>(root)->GetCollisionObject() == NULL) {
 			bhkCollisionObjectRef root_collision = NULL;
@@ -5444,26 +5469,14 @@ std::vector<Ref<NiObject>>  load_override_or_bsa_nif_file(const fs::path& path,
 	fs::path absolute = overridePath / path;
 
 	if (fs::exists(absolute)) {
-		return ReadNifList(absolute.string().c_str(), &info);
+		return ReadNifMapped(absolute, &info);
 	}
 	else {
-		if (games.bsa_files().empty())
+		ckcmd::FileView view = games.open(Games::TES4, path.string());
+		if (view.is_open())
 		{
-			games.loadBsas(Games::TES4);
-		}
-		for (const auto& bsa_file : games.bsa_files()) {
-			bool found = bsa_file.find(path.string());
-			if (found)
-			{
-				//get the shortest path
-				size_t size = -1;
-				const uint8_t* data = bsa_file.extract(path.string(), size);
-				std::string sdata((char*)data, size);
-				std::istringstream iss(sdata);
-				auto result = ReadNifList(iss, &info);
-				delete data;
-				return result;
-			}
+			auto stream = view.stream();
+			return ReadNifList(stream, &info);
 		}
 	}
 	throw runtime_error("File not found:" + path.string());
@@ -5495,9 +5508,7 @@ NifFolderType load_override_or_bsa_nif_folder(const fs::path& skeleton_path, con
 		{
 			size_t size = -1;
 			const uint8_t* data = bsa_file.extract(asset, size);
-			std::string sdata((char*)data, size);
-			std::istringstream iss(sdata);
-			auto result = ReadNifList(iss, &info);
+			auto result = ReadNifBuffer(data, size, &info);
 			if (fs::path(asset) == skeleton_path)
 			{
 				std::get<0>(out) = result;
@@ -5505,7 +5516,7 @@ NifFolderType load_override_or_bsa_nif_folder(const fs::path& skeleton_path, con
 			else {
 				std::get<1>(out)[asset] = (result);
 			}
-			delete data;
+			delete[] data;
 		}
 		ex = ".*" + path.string() + "\.*\.kf";
 		replacepath(ex, "\\", "\\\\");
@@ -5514,11 +5525,9 @@ NifFolderType load_override_or_bsa_nif_folder(const fs::path& skeleton_path, con
 		{
 			size_t size = -1;
 			const uint8_t* data = bsa_file.extract(asset, size);
-			std::string sdata((char*)data, size);
-			std::istringstream iss(sdata);
-			auto result = ReadNifList(iss, &info);
+			auto result = ReadNifBuffer(data, size, &info);
 			std::get<2>(out)[asset] = (result);
-			delete data;
+			delete[] data;
 		}
 	}
 	//replace overrides
@@ -5529,7 +5538,7 @@ NifFolderType load_override_or_bsa_nif_folder(const fs::path& skeleton_path, con
 		findFiles(absolute, ".nif", assets);
 		for (const auto& asset : assets)
 		{
-			auto result = ReadNifList(asset.string(), &info);
+			auto result = ReadNifMapped(asset, &info);
 			if (fs::path(asset) == skeleton_path)
 			{
 				std::get<0>(out) = result;
@@ -5542,7 +5551,7 @@ NifFolderType load_override_or_bsa_nif_folder(const fs::path& skeleton_path, con
 		findFiles(absolute, ".kf", assets);
 		for (const auto& asset : assets)
 		{
-			auto result = ReadNifList(asset.string(), &info);
+			auto result = ReadNifMapped(asset, &info);
 			std::get<2>(out)[asset] = (result);
 		}
 	}
@@ -8346,8 +8355,10 @@ string LCS(string X, string Y, int m, int n)
 static std::string crc_32(std::string& to_crc)
 {
 	transform(to_crc.begin(), to_crc.end(), to_crc.begin(), ::tolower);
-	long long crc = stoll(HkCRC::compute(to_crc), NULL, 16);
-	return to_string(crc);
+	auto crc = HkCRC::crc32(to_crc);
+	if (!crc)
+		throw std::invalid_argument("Cannot compute the CRC of " + to_crc);
+	return HkCRC::cache_string(*crc);
 }
 
 void ConvertAssets(
@@ -8656,11 +8667,6 @@ void ConvertAssets(
 
 			WriteNifTree(creature_output_skeleton.string(), root, info);
 			std::get<0>(assets) = skeleton_converted_blocks;
-			material_controllers_map.clear();
-			material_alpha_controllers_map.clear();
-			material_flip_controllers_map.clear();
-			deferred_blends.clear();
-			material_transform_controllers_map.clear();
 		}
 
 		auto* race = races[entry.first];
@@ -8793,11 +8799,6 @@ void ConvertAssets(
 				armas_records[asset.first.filename().string()] = arma_record;
 
 				WriteNifTree(creature_output_mesh.string(), root, info);
-				material_controllers_map.clear();
-				material_alpha_controllers_map.clear();
-				material_flip_controllers_map.clear();
-				deferred_blends.clear();
-				material_transform_controllers_map.clear();
 			}
 
 			Sk::ARMORecord* most_common_armo = nullptr;
@@ -9082,15 +9083,16 @@ void ConvertAssets(
 				std::string meshes_path_crc32 = crc_32(meshes_path);
 				crc32Data.append(meshes_path_crc32, sanitized_name_crc32);
 			}
-			block.setCrc32Data(crc32Data);
+			block.setCrc32Data(std::move(crc32Data));
 
 			//Assemble Dummy Fullbody
 			entry->block.setHasProjectFiles(true);
-			entry->block.setProjectFiles(project_hkx_files);
-			entry->block.setClips(clips);
+			entry->block.setProjectFiles(std::move(project_hkx_files));
+			entry->block.setClips(std::move(clips));
 			entry->block.setHasAnimationCache(true);
-			entry->movements.setMovementData(movements);
-			entry->sets.putProjectAttack("FullBody.txt", block);
+			entry->movements.setMovementData(std::move(movements));
+			entry->invalidate();
+			entry->sets.putProjectAttack("FullBody.txt", std::move(block));
 		}
 	}
 
@@ -9200,6 +9202,65 @@ bool BeginConversion(string importPath, string exportPath)
 	conversionCollection.SaveMod(conversionPlugin, skSaveFlags, conversionPluginName);
 
 	return true;
+}
+
+//Havok needs a memory router on every thread using it: InitializeHavok sets up the
+//calling thread, conversion workers get their own with the first model they convert
+class HavokThreadMemory {
+	hkMemoryRouter router;
+public:
+	HavokThreadMemory() {
+		hkMemorySystem::getInstance().threadInit(router, "ConvertNif");
+		hkBaseSystem::initThread(&router);
+	}
+	~HavokThreadMemory() {
+		hkBaseSystem::quitThread();
+		hkMemorySystem::getInstance().threadQuit(router);
+	}
+};
+
+static thread_local bool havok_thread_ready = false;
+
+static void EnsureHavokThread()
+{
+	if (havok_thread_ready)
+		return;
+	static thread_local HavokThreadMemory memory;
+	havok_thread_ready = true;
+}
+
+typedef std::vector<std::pair<std::string, Vector3>> model_metadata_t;
+
+static void ConvertModel(vector<NiObjectRef>& blocks, NifInfo& info, const fs::path& nif, const fs::path& out_path, const string& exportPath, HKXWrapperCollection& wrappers, model_metadata_t& metadata)
+{
+	EnsureHavokThread();
+	NiObjectRef root;
+	vector<NiObjectRef> new_blocks;
+	convert_blocks(
+		blocks,
+		new_blocks,
+		root,
+		wrappers,
+		info,
+		nif,
+		exportPath,
+		metadata,
+		true
+	);
+	std::error_code ec;
+	fs::create_directories(out_path.parent_path(), ec);
+	WriteNifTree(out_path.string(), root, info);
+}
+
+//Converts the models under importPath, or the ones in the Oblivion BSAs, on threads workers.
+//Every model is converted on its own, only the behaviors and the textures are shared, and
+//the metadata is gathered in model order: the output is the same whatever the threads
+static bool ConvertMeshes(string importPath, string exportPath, size_t threads)
+{
+	vector<fs::path> nifs;
+	vector<fs::path> spts;
+	HKXWrapperCollection wrappers;
+	model_metadata_t metadata;
 
 	if (fs::exists(importPath) && fs::is_directory(importPath))
 		findFiles(importPath, ".nif", nifs);
@@ -9213,27 +9274,17 @@ bool BeginConversion(string importPath, string exportPath)
 	if (fs::exists(importPath) && fs::is_directory(importPath))
 		findFiles(importPath, ".spt", spts);
 
+	//textures are resolved from the workers, build the index before they start
+	if (games.isGameInstalled(Games::TES4))
+		games.vfs(Games::TES4);
 
-	fs::path out_path;
  	if (nifs.empty() && spts.empty()) {
 		Log::Info("No NIFs found.. trying BSAs");
-		const Games::GamesPathMapT& installations = games.getGames();
 		games.loadBsas(Games::TES4);
 		exportPath = games.data(Games::TES5SE).string();
 		for (const auto& bsa_file : games.bsa_files()) {
-			//std::cout << "Checking: " << bsa.filename() << std::endl;
-			//BSAFile bsa_file(bsa);
-
+			vector<string> bsa_nifs;
 			for (const auto& nif : bsa_file.assets(".*\.nif")) {
-				Log::Info("Current File: %s", nif.c_str());
-
-				std::string nif_path = nif;
-				if (nif.find("meshes") == 0) {
-					nif_path = "meshes\\tes4" + nif_path.substr(std::string("meshes").size(), nif_path.size());
-				}
-
-				out_path = games.data(Games::TES5SE) / nif_path;
-
 				if (nif.find("meshes\\landscape\\lod") != string::npos) {
 					Log::Warn("Ignored LOD file: %s", nif.c_str());
 					continue;
@@ -9262,83 +9313,33 @@ bool BeginConversion(string importPath, string exportPath)
 					Log::Warn("temporarily ignoring: %s", nif.c_str());
 					continue;
 				}
-				size_t size = -1;
-				const uint8_t* data = bsa_file.extract(nif, size);
-
-				std::string sdata((char*)data, size);
-				std::istringstream iss(sdata);
-
-				NiObjectRef root;
-				vector<NiObjectRef> blocks = ReadNifList(iss, &info);
-				vector<NiObjectRef> new_blocks;
-				convert_blocks(
-					blocks,
-					new_blocks,
-					root,
-					wrappers,
-					info,
-					nif,
-					exportPath,
-					metadata,
-					true
-				);
+				bsa_nifs.push_back(nif);
+			}
+
+			//nifs are read and converted on the workers, the metadata is merged in order on this thread
+			ExtractorOptions options;
+			options.threads = threads;
+			BSAExtractor extractor(bsa_file, options);
+			extractor.run<model_metadata_t>(bsa_nifs,
+				[&](const ExtractedAsset& nif) {
+					Log::Info("Current File: %s", nif.path().c_str());
+					NifInfo nif_info;
+					vector<NiObjectRef> blocks = ReadNifBuffer(nif.data(), nif.size(), &nif_info);
+
+					std::string nif_path = nif.path();
+					if (nif_path.find("meshes") == 0) {
+						nif_path = "meshes\\tes4" + nif_path.substr(std::string("meshes").size(), nif_path.size());
+					}
 
-				//out_path = nif_out / nif;
-				fs::create_directories(out_path.parent_path());
-				WriteNifTree(out_path.string(), root, info);
-				material_controllers_map.clear();
-				material_alpha_controllers_map.clear();
-				material_flip_controllers_map.clear();
-				deferred_blends.clear();
-				material_transform_controllers_map.clear();
-				delete data;
-			}
+					model_metadata_t model_metadata;
+					ConvertModel(blocks, nif_info, nif.path(), games.data(Games::TES5SE) / nif_path, exportPath, wrappers, model_metadata);
+					return model_metadata;
+				},
+				[&](const string& nif, model_metadata_t& model_metadata) {
+					metadata.insert(metadata.end(), model_metadata.begin(), model_metadata.end());
+				}
+			);
 		}
-	
-		//Log::Info("Scanning TES4 Override");
-		////Convert overrides for uesp patch
-		//importPath = (games.data(Games::TES4) / "meshes").string();
-		//if (fs::exists(importPath) && fs::is_directory(importPath))
-		//	findFiles(importPath, ".nif", nifs);
-
-		//for (size_t i = 0; i < nifs.size(); i++) {
-		//	Log::Info("Current File: %s", nifs[i].string().c_str());
-
-		//	if (nifs[i].string().find("lod") != string::npos || nifs[i].string().find("LOD") != string::npos)
-		//		continue;
-
-		//	NiObjectRef root;
-		//	vector<NiObjectRef> blocks = ReadNifList(nifs[i].string().c_str(), &info);
-		//	vector<NiObjectRef> new_blocks;
-		//	convert_blocks(
-		//		blocks,
-		//		new_blocks,
-		//		root,
-		//		wrappers,
-		//		info,
-		//		nifs[i],
-		//		exportPath,
-		//		metadata
-		//	);
-
-		//	size_t offset = nifs[i].parent_path().string().find("meshes", 0);
-		//	size_t end = nifs[i].parent_path().string().length();
-		//	std::string newPath = exportPath;
-		//	if (offset < end) {
-		//		std::string relative_path = nifs[i].parent_path().string().substr(offset, end);
-		//		relative_path.insert(6, "\\tes4");
-		//		newPath += std::string("\\") + relative_path;
-		//	}
-		//	out_path = newPath / nifs[i].filename();
-		//	fs::create_directories(out_path.parent_path());
-		//	WriteNifTree(out_path.string(), root, info);
-		//	material_controllers_map.clear();
-		//	material_alpha_controllers_map.clear();
-		//	material_flip_controllers_map.clear();
-		//	deferred_blends.clear();
-		//	material_transform_controllers_map.clear();
-		//}
-	
 	}
 	else {
 		//Load metadata
@@ -9366,8 +9367,8 @@ bool BeginConversion(string importPath, string exportPath)
 			sptconvert(spts[i], exportPath, tree_metadata);
 		}
 
+		vector<fs::path> models;
 		for (size_t i = 0; i < nifs.size(); i++) {
-			Log::Info("Current File: %s", nifs[i].string().c_str());
 #ifdef HAVE_SPEEDTREE
 			if (nifs[i].string().find("spt") != string::npos)
 			{
@@ -9382,36 +9383,33 @@ bool BeginConversion(string importPath, string exportPath)
 
 			if (nifs[i].string().find("lod") != string::npos)
 				continue;
+			models.push_back(nifs[i]);
+		}
 
-			NiObjectRef root;
-			vector<NiObjectRef> blocks = ReadNifList(nifs[i].string().c_str(), &info);
-			vector<NiObjectRef> new_blocks;
-			convert_blocks(
-				blocks,
-				new_blocks,
-				root,
-				wrappers,
-				info,
-				nifs[i],
-				exportPath,
-				metadata,
-				true
-			);
+		vector<model_metadata_t> models_metadata(models.size());
+		auto convert = [&](size_t i) {
+			Log::Info("Current File: %s", models[i].string().c_str());
+			NifInfo info;
+			vector<NiObjectRef> blocks = ReadNifMapped(models[i], &info);
 
-			size_t offset = nifs[i].parent_path().string().find("meshes", 0);
-			size_t end = nifs[i].parent_path().string().length();
+			size_t offset = models[i].parent_path().string().find("meshes", 0);
+			size_t end = models[i].parent_path().string().length();
 			std::string newPath = exportPath;
 			if (offset < end)
-				newPath += nifs[i].parent_path().string().substr(offset, end);
-			out_path = newPath / nifs[i].filename();
-			fs::create_directories(out_path.parent_path());
-			WriteNifTree(out_path.string(), root, info);
-			material_controllers_map.clear();
-			material_alpha_controllers_map.clear();
-			material_flip_controllers_map.clear();
-			deferred_blends.clear();
-			material_transform_controllers_map.clear();
+				newPath += models[i].parent_path().string().substr(offset, end);
+			fs::path out_path = newPath / models[i].filename();
+			ConvertModel(blocks, info, models[i], out_path, exportPath, wrappers, models_metadata[i]);
+		};
+
+		if (!models.empty())
+		{
+			//niflib registers its block types on the first read, do that on this thread
+			convert(0);
+			ckcmd::ThreadPool pool(threads);
+			pool.parallel_for(models.size() - 1, [&](size_t i) { convert(i + 1); });
 		}
+		for (const auto& model_metadata : models_metadata)
+			metadata.insert(metadata.end(), model_metadata.begin(), model_metadata.end());
 	}
 	if (metadata.size())
 	{
@@ -9464,16 +9462,13 @@ static hkThreadMemory* threadMemory = NULL;
 static char* stackBuffer = NULL;
 static void InitializeHavok()
 {
-	// Initialize the base system including our memory system
-	hkMemoryRouter*		pMemoryRouter(hkMemoryInitUtil::initDefault(hkMallocAllocator::m_defaultMallocAllocator, hkMemorySystem::FrameInfo(5000000)));
-	hkBaseSystem::init(pMemoryRouter, errorReport);
-	LoadDefaultRegistry();
+	ckcmd::HavokSession::acquire();
+	havok_thread_ready = true;
 }
 
 static void CloseHavok()
 {
-	hkBaseSystem::quit();
-	hkMemoryInitUtil::quit();
+	ckcmd::HavokSession::release();
 }
 
 //static bool ExecuteCmd(hkxcmdLine &cmdLine) {
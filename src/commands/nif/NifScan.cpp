@@ -15,7 +15,8 @@ using namespace std;
 class RebuildVisitor;
 class FixTargetsVisitor;
 
-static bool BeginScan(string scanPath);
+struct ScanOptions;
+static bool BeginScan(string scanPath, const ScanOptions& options);
 
 
 static Games& games = Games::Instance();
@@ -39,14 +40,29 @@ string NifScan::GetHelp() const
     string name = GetName();
     transform(name.begin(), name.end(), name.begin(), ::tolower);
 
-	// Usage: ck-cmd nifscan [-i <path_to_scan>]
-	string usage = "Usage: " + ExeCommandList::GetExeName() + " " + name + " [-i <path_to_scan>]\r\n";
+	// Usage: ck-cmd nifscan [-i <path_to_scan>] [-j <threads>] [-m <megabytes>] [-r <records>] [-c <checkpoint>] [--include <globs>] [--exclude <globs>]
+	string usage = "Usage: " + ExeCommandList::GetExeName() + " " + name + " [-i <path_to_scan>] [-j <threads>] [-m <megabytes>] [-r <records>] [-c <checkpoint>] [--include <globs>] [--exclude <globs>]\r\n";
 
 	const char help[] =
 		R"(Scan Skyrim meshes for any errors.
 		
 		Arguments:
-			<path_to_scan> path to models you want to check for errors)";
+			<path_to_scan> path to models you want to check for errors
+
+		Options:
+			-j <threads>        scan threads, 0 uses every core [default: 0]
+			-m <megabytes>      extracted BSA data kept in memory at once [default: 256]
+			-r <records>        writes one JSON line per scanned file: status, errors, warnings
+			-c <checkpoint>     lists the scanned files. A scan started again with the same
+			                    checkpoint skips them and appends to the records, the file
+			                    is removed once the scan completes
+			--include <globs>   ';' separated globs, only matching files are scanned.
+			                    '*' matches within a folder, '**' across folders
+			--exclude <globs>   ';' separated globs of files to skip. Without it, loose
+			                    files skip the out, meshes\landscape\lod, marker_,
+			                    minotaurold, sky, menus, creatures, Creatures, amulet, armor,
+			                    weapons and effects folders, matched case sensitively as
+			                    before. Archives are only filtered by the globs given)";
 
     return usage + help;
 }
@@ -132,9 +148,20 @@ public:
 
 #include <core/games.h>
 #include <core/bsa.h>
+#include <core/BSAExtractor.h>
+#include <core/NifFile.h>
+#include <core/LogCapture.h>
+#include <core/PathFilter.h>
+#include <core/TextureIndex.h>
+#include <core/ThreadPool.h>
+
+#include <chrono>
+#include <mutex>
+#include <unordered_set>
 
 using namespace ckcmd::info;
 using namespace ckcmd::BSA;
+using ckcmd::TextureIndex;
 
 //Duplicate Method, just wanted to test.
 void findFilesn(fs::path startingDir, string extension, vector<fs::path>& results) {
@@ -152,47 +179,27 @@ void findFilesn(fs::path startingDir, string extension, vector<fs::path>& result
 	}
 }
 
-static int CheckDDS(fs::path filename, int slot, bool hasAlpha, bool isSpecular)
+static int CheckDDS(const TextureIndex::Texture& texture, int slot, bool hasAlpha, bool isSpecular)
 {
-	ifstream is;
-	int magic;
-	DDS_HEADER header = {};
-
-	is.open(filename, ios::binary);
-
-	if (is.is_open())
+	if (texture.exists)
 	{
-		is.read((char*)&magic, sizeof(int));
-
-		if (magic != DDS_MAGIC)
+		if (!texture.dds)
 			return -1;
 
-		is.read((char*)&header.dwSize, sizeof(DWORD));
-		is.read((char*)&header.dwFlags, sizeof(DWORD));
-		is.read((char*)&header.dwHeight, sizeof(DWORD));
-		is.read((char*)&header.dwWidth, sizeof(DWORD));
-		is.read((char*)&header.dwPitchOrLinearSize, sizeof(DWORD));
-		is.read((char*)&header.dwDepth, sizeof(DWORD));
-		is.read((char*)&header.dwMipMapCount, sizeof(DWORD));
-		is.read((char*)&header.dwReserved1, sizeof(DWORD)*11);
-		is.read((char*)&header.ddspf.dwSize, sizeof(DWORD));
-		is.read((char*)&header.ddspf.dwFlags, sizeof(DWORD));
-		is.read((char*)&header.ddspf.dwFourCC, sizeof(DWORD)); //DXT1, DXT3 or DXT5
-		is.close();
-
-		if (header.ddspf.dwFourCC == DDS_DXT3)
+		const ImageProperties& header = texture.properties;
+		if (header.fourCC == DDS_DXT3)
 			Log::Error("DXT3 is not used in Skyrim.");
 
-		if (header.dwMipMapCount == 0)
+		if (header.mipLevels == 0)
 			Log::Error("No mipmaps found. Mipmaps should be generated for optimisation.");
 
 		if (slot == 0) {
-			if (header.ddspf.dwFourCC == DDS_DXT1)
+			if (header.fourCC == DDS_DXT1)
 			{
 				if (hasAlpha)
 					Log::Error("Block has alpha but diffuse texture is DXT1. Needs to be DXT5.");
 			}
-			else if (header.ddspf.dwFourCC == DDS_DXT5)
+			else if (header.fourCC == DDS_DXT5)
 			{
 				if (!hasAlpha)
 				{
@@ -202,19 +209,19 @@ static int CheckDDS(fs::path filename, int slot, bool hasAlpha, bool isSpecular)
 			}
 		}
 		if (slot == 1) {
-			if (header.ddspf.dwFourCC == DDS_DXT1)
+			if (header.fourCC == DDS_DXT1)
 			{
 				if (isSpecular)
 					Log::Error("Block has specular flag but normal texture is DXT1. Needs to be DXT5.");
 			}
-			else if (header.ddspf.dwFourCC == DDS_DXT5)
+			else if (header.fourCC == DDS_DXT5)
 			{
 				if (!isSpecular)
 					Log::Error("Block does not have specular flag but normal texture is DXT5. Needs to be DXT1.");
 			}
 		}
 		if (slot == 4 || slot == 5) {
-			if (header.ddspf.dwFourCC != DDS_DXT1)
+			if (header.fourCC != DDS_DXT1)
 				Log::Error("Environment/Cube map is needs to be DXT1.");
 		}
 	}
@@ -431,7 +438,7 @@ void ScanNif(vector<NiObjectRef>& blocks, NifInfo info)
 	}
 }
 
-void visitNode(NiNodeRef obj)
+void visitNode(NiNodeRef obj, TextureIndex& texture_index)
 {
 	vector<Ref<NiAVObject>> children = obj->GetChildren();
 	vector<Ref<NiProperty>> properties = obj->GetProperties();
@@ -657,9 +664,10 @@ void visitNode(NiNodeRef obj)
 						else {
 							bool doesExist = false;
 							if (textures[i] != "") {
-								if ((fs::exists(games.data(Games::TES5SE) / textures[i])) || (fs::exists(games.data(Games::TES5SE) / "textures" / textures[i]))) { //this needs sorting out.
+								const TextureIndex::Texture& texture = texture_index.find(textures[i]);
+								if (texture.exists) {
 									Log::Info("Checking texture data of %s", (textures[i]).c_str());
-									if (CheckDDS(games.data(Games::TES5SE) / textures[i], i, hasAlpha, isSpecular) == 1)
+									if (CheckDDS(texture, i, hasAlpha, isSpecular) == 1)
 										shape->SetAlphaProperty(new NiAlphaProperty());
 									doesExist = true;
 								}
@@ -678,7 +686,7 @@ void visitNode(NiNodeRef obj)
 	obj->SetChildren(children);
 }
 
-vector<NiObjectRef> checkNif(vector<NiObjectRef> blocks, NifInfo info) {
+vector<NiObjectRef> checkNif(vector<NiObjectRef> blocks, NifInfo info, TextureIndex& texture_index) {
 
 	NiObjectRef root = GetFirstRoot(blocks);
 
@@ -694,7 +702,7 @@ vector<NiObjectRef> checkNif(vector<NiObjectRef> blocks, NifInfo info) {
 		//}
 		if (block->IsDerivedType(NiNode::TYPE))
 		{
-			visitNode(DynamicCast<NiNode>(block));
+			visitNode(DynamicCast<NiNode>(block), texture_index);
 		}
 	}
 
@@ -707,18 +715,199 @@ vector<NiObjectRef> checkNif(vector<NiObjectRef> blocks, NifInfo info) {
 	return move(new_blocks);
 }
 
-static bool BeginScan(string scanPath) {
-	Log::Info("Begin Scan");
+//the loose folders the scan always skipped before rules could be given, archives
+//were scanned whole. Kept as the case sensitive substrings they always were
+static const char* default_scan_excludes[] = {
+	"\\out\\", "meshes\\landscape\\lod", "\\marker_", "\\minotaurold", "\\sky\\", "\\menus\\",
+	"\\Creatures\\", "\\creatures\\", "\\amulet\\", "\\armor\\", "\\weapons\\", "\\effects\\"
+};
+
+static bool default_excluded(const string& path)
+{
+	for (const char* part : default_scan_excludes)
+		if (path.find(part) != string::npos)
+			return true;
+	return false;
+}
+
+struct ScanRecord {
+	string file;
+	string output;
+	string exception;
+	double ms = 0.0;
+	LogMessages messages;
+};
+
+static string json_messages(const ScanRecord& record, LogLevel level)
+{
+	string out = "[";
+	for (const auto& message : record.messages)
+	{
+		if (message.first != level)
+			continue;
+		if (out.size() > 1)
+			out += ",";
+		out += json_string(message.second);
+	}
+	return out + "]";
+}
+
+//{"file":..., "status":"ok"|"errors"|"failed", "output":..., "exception":..., "ms":..., "errors":[...], "warnings":[...]}
+static string to_json(const ScanRecord& record)
+{
+	bool has_errors = any_of(record.messages.begin(), record.messages.end(),
+		[](const pair<LogLevel, string>& message) { return message.first == LOG_ERROR; });
+	const char* status = !record.exception.empty() ? "failed" : has_errors ? "errors" : "ok";
+	char ms[32];
+	snprintf(ms, sizeof(ms), "%.2f", record.ms);
+
+	string out = "{\"file\":" + json_string(record.file) + ",\"status\":\"" + status + "\"";
+	if (!record.output.empty())
+		out += ",\"output\":" + json_string(record.output);
+	if (!record.exception.empty())
+		out += ",\"exception\":" + json_string(record.exception);
+	out += string(",\"ms\":") + ms;
+	out += ",\"errors\":" + json_messages(record, LOG_ERROR);
+	out += ",\"warnings\":" + json_messages(record, LOG_WARN);
+	return out + "}";
+}
+
+struct ScanOptions {
+	ckcmd::BSA::ExtractorOptions bsa;
+	// loose files
+	ckcmd::PathFilter filter;
+	// skip the default_scan_excludes loose folders, when no exclude is given
+	bool default_excludes = true;
+	// archive assets, only the rules given
+	ckcmd::PathFilter archive_filter;
+	// one JSON record per scanned file, empty to only log
+	fs::path records;
+	// files already scanned, empty to always scan everything
+	fs::path checkpoint;
+};
+
+// Writes the records and the checkpoint, both flushed after every file, so an
+// interrupted scan started again with the same checkpoint skips what was done and
+// appends to the same records. Workers write their own records, the messages a file
+// logged are printed together so the console output of two files never interleaves
+class ScanJournal {
+	mutex journal_mutex;
+	ofstream records;
+	ofstream checkpoint;
+	fs::path checkpoint_path;
+	unordered_set<string> done;
+	size_t total = 0;
+	size_t written = 0;
+	size_t failed = 0;
+
+public:
+
+	ScanJournal(const ScanOptions& options) :
+		checkpoint_path(options.checkpoint)
+	{
+		if (!checkpoint_path.empty())
+		{
+			ifstream previous(checkpoint_path.string());
+			string line;
+			while (getline(previous, line))
+				if (!line.empty())
+					done.insert(line);
+			checkpoint.open(checkpoint_path.string(), ios::app);
+			if (!checkpoint.is_open())
+				Log::Error("Unable to write the checkpoint %s", checkpoint_path.string().c_str());
+		}
+		if (!options.records.empty())
+		{
+			records.open(options.records.string(), done.empty() ? ios::trunc : ios::app);
+			if (!records.is_open())
+				Log::Error("Unable to write the records %s", options.records.string().c_str());
+		}
+		if (!done.empty())
+			Log::Info("Resuming from %s, %zu files already scanned", checkpoint_path.string().c_str(), done.size());
+	}
+
+	bool is_done(const string& file) const { return done.find(file) != done.end(); }
+	void expect(size_t files) { total += files; }
+	size_t failures() const { return failed; }
+
+	void write(const ScanRecord& record)
+	{
+		lock_guard<mutex> lock(journal_mutex);
+		written++;
+		if (!record.exception.empty())
+			failed++;
+		if (records.is_open())
+			records << to_json(record) << endl;
+		if (checkpoint.is_open())
+			checkpoint << record.file << endl;
+
+		Log::Info("[%zu/%zu] %s", written, total, record.file.c_str());
+		LogCapture::replay(record.messages);
+		if (!record.exception.empty())
+			Log::Error("ERROR: %s", record.exception.c_str());
+	}
 
+	//the scan went through, a new run has to start from scratch
+	void complete()
+	{
+		if (checkpoint.is_open())
+		{
+			checkpoint.close();
+			error_code ec;
+			fs::remove(checkpoint_path, ec);
+		}
+	}
+};
+
+typedef chrono::steady_clock scan_clock;
+
+//an archived nif read on an extractor worker, scanned on the consumer
+struct ScanRead {
+	ScanRecord record;
+	vector<NiObjectRef> blocks;
 	NifInfo info;
+};
+
+static double elapsed_ms(const scan_clock::time_point& start)
+{
+	return chrono::duration<double, milli>(scan_clock::now() - start).count();
+}
+
+//fixes a loose nif into the out folder next to it
+static ScanRecord FixNif(const fs::path& nif, const fs::path& out, TextureIndex& texture_index)
+{
+	ScanRecord record;
+	record.file = nif.string();
+	auto start = scan_clock::now();
+	{
+		LogCapture diagnostics(record.messages);
+		try {
+			NifInfo info;
+			vector<NiObjectRef> blocks = NIF::ReadNifMapped(nif, &info);
+			vector<NiObjectRef> new_blocks = checkNif(blocks, info, texture_index);
+			error_code ec;
+			fs::create_directories(out.parent_path(), ec);
+			WriteNifTree(out.string(), GetFirstRoot(new_blocks), info);
+			record.output = out.string();
+		}
+		catch (const std::exception& e) {
+			record.exception = e.what();
+		}
+	}
+	record.ms = elapsed_ms(start);
+	return record;
+}
+
+static bool BeginScan(string scanPath, const ScanOptions& options) {
+	Log::Info("Begin Scan");
 
 	vector<fs::path> nifs;
 
 	//findFilesn(games.data(Games::TES5SE) / "meshes/tes4", ".nif", nifs);
 	//fs::path nif_in = "D:\\git\\ck-cmd\\resources\\in";
 	findFilesn(scanPath, ".nif", nifs);
-	bool write = true;
-	fs::path nif_path = "F:\\FIXED_NIFS";
+
+	ScanJournal journal(options);
 
 	if (nifs.empty())
 	{
@@ -727,93 +916,90 @@ static bool BeginScan(string scanPath) {
 			std::cout << "Scan: " << bsa.filename() << std::endl;
 
 			BSAFile bsa_file(bsa);
-			for (const auto& nif : bsa_file.assets(".*\.nif")) {
-				Log::Info("Current File: %s", nif.c_str());
-
-				size_t size = -1;
-				const uint8_t* data = bsa_file.extract(nif, size);
-
-				std::string sdata((char*)data, size);
-				std::istringstream iss(sdata);
-				try {
-					vector<NiObjectRef> blocks = ReadNifList(iss, &info);
-					ScanNif(blocks, info);
-				}
-				catch (const std::exception& e) {
-					Log::Info("ERROR: %s", e.what());
-				}
-				delete data;
+			vector<string> assets;
+			for (const auto& asset : bsa_file.assets(".*\.nif"))
+			{
+				if (options.archive_filter.accepts(asset) && !journal.is_done((bsa.filename() / asset).string()))
+					assets.push_back(asset);
 			}
+			journal.expect(assets.size());
+
+			//nifs are read on the workers. ScanNif goes through calculateSkyrimBSXFlags and
+			//niflib state that are not thread safe, so it runs here in asset order
+			BSAExtractor extractor(bsa_file, options.bsa);
+			extractor.run<ScanRead>(assets,
+				[&bsa](const ExtractedAsset& nif) {
+					ScanRead read;
+					read.record.file = (bsa.filename() / nif.path()).string();
+					auto start = scan_clock::now();
+					{
+						LogCapture diagnostics(read.record.messages);
+						try {
+							read.blocks = NIF::ReadNifBuffer(nif.data(), nif.size(), &read.info);
+						}
+						catch (const std::exception& e) {
+							read.record.exception = e.what();
+						}
+					}
+					read.record.ms = elapsed_ms(start);
+					return read;
+				},
+				[&journal](const string& nif, ScanRead& read) {
+					if (read.record.exception.empty())
+					{
+						auto start = scan_clock::now();
+						{
+							LogCapture diagnostics(read.record.messages);
+							try {
+								ScanNif(read.blocks, read.info);
+							}
+							catch (const std::exception& e) {
+								read.record.exception = e.what();
+							}
+						}
+						read.record.ms += elapsed_ms(start);
+					}
+					read.blocks.clear();
+					journal.write(read.record);
+				}
+			);
+			Log::Info("Peak extracted memory: %zu MB", extractor.peak_memory() / (1024 * 1024));
 		}
-
-		return true;
 	}
 	else 
 	{
-		for (size_t i = 0; i < nifs.size(); i++) {
-			fs::path out = nifs[i].parent_path() / fs::path("out") / nifs[i].filename();
-			fs::path parent_out = out.parent_path();
-			if (fs::exists(out))
-				continue;
-
-			if (nifs[i].string().find("\\out\\") != string::npos) {
-				continue;
-			}
-			if (nifs[i].string().find("meshes\\landscape\\lod") != string::npos) {
-				continue;
-			}
-			if (nifs[i].string().find("\\marker_") != string::npos) {
-				continue;
-			}
-			if (nifs[i].string().find("\\minotaurold") != string::npos) {
-				continue;
-			}
-			if (nifs[i].string().find("\\sky\\") != string::npos) {
-				continue;
-			}
-			if (nifs[i].string().find("\\menus\\") != string::npos) {
-				continue;
-			}
-			if (nifs[i].string().find("\\Creatures\\") != string::npos) {
-				continue;
-			}
-			if (nifs[i].string().find("\\amulet\\") != string::npos) {
-				continue;
-			}
-			if (nifs[i].string().find("\\armor\\") != string::npos) {
-				continue;
-			}
-			if (nifs[i].string().find("\\weapons\\") != string::npos) {
-				continue;
-			}
-			if (nifs[i].string().find("\\effects\\") != string::npos) {
-				continue;
-			}
-			if (nifs[i].string().find("\\sky\\") != string::npos) {
-				continue;
-			}
-			if (nifs[i].string().find("\\menus\\") != string::npos) {
+		vector<pair<fs::path, fs::path>> jobs;
+		for (const auto& nif : nifs)
+		{
+			fs::path out = nif.parent_path() / fs::path("out") / nif.filename();
+			if (fs::exists(out) || !options.filter.accepts(nif.string()) || journal.is_done(nif.string()))
 				continue;
-			}
-			if (nifs[i].string().find("\\creatures\\") != string::npos) {
+			if (options.default_excludes && default_excluded(nif.string()))
 				continue;
-			}
-			Log::Info("Current File: %s", nifs[i].string().c_str());
-			NifInfo info;
-			try {
-				vector<NiObjectRef> blocks = ReadNifList(nifs[i].string().c_str(), &info);
-				vector<NiObjectRef> new_blocks = checkNif(blocks, info);
-				Log::Info("Output File: %s", out.string().c_str());
-				if (!fs::exists(parent_out))
-					fs::create_directories(parent_out);
-				WriteNifTree(out.string(), GetFirstRoot(new_blocks), info);
-			}
-			catch (const std::exception& e) {
-				Log::Info("ERROR: %s", e.what());
-			}
+			jobs.push_back({ nif, out });
+		}
+		journal.expect(jobs.size());
+
+		if (!jobs.empty())
+		{
+			//built before any worker starts, they only look textures up
+			TextureIndex textures;
+			textures.add(games.vfs(Games::TES5SE));
+			textures.preload(options.bsa.threads);
+
+			//niflib registers its block types on the first read, do that on this thread
+			journal.write(FixNif(jobs[0].first, jobs[0].second, textures));
+
+			ThreadPool pool(options.bsa.threads);
+			pool.parallel_for(jobs.size() - 1, [&](size_t i) {
+				journal.write(FixNif(jobs[i + 1].first, jobs[i + 1].second, textures));
+			});
 		}
-		Log::Info("Done..");
 	}
+
+	journal.complete();
+	Log::Info("Done.. %zu files could not be read", journal.failures());
+	return true;
 }
 
 bool NifScan::InternalRunCommand(map<string, docopt::value> parsedArgs)
@@ -822,7 +1008,30 @@ bool NifScan::InternalRunCommand(map<string, docopt::value> parsedArgs)
 
 	scanPath = parsedArgs["<path_to_scan>"].asString();
 
-	bool result = BeginScan(scanPath);
+	ScanOptions options;
+	options.bsa.threads = max(0, atoi(parsedArgs["-j"].asString().c_str()));
+	options.bsa.memory_budget = (size_t)max(1, atoi(parsedArgs["-m"].asString().c_str())) * 1024 * 1024;
+	if (parsedArgs["-r"].isString())
+		options.records = parsedArgs["-r"].asString();
+	if (parsedArgs["-c"].isString())
+		options.checkpoint = parsedArgs["-c"].asString();
+	if (parsedArgs["--include"].isString())
+		for (const auto& glob : PathFilter::split(parsedArgs["--include"].asString()))
+		{
+			options.filter.include(glob);
+			options.archive_filter.include(glob);
+		}
+	if (parsedArgs["--exclude"].isString())
+	{
+		for (const auto& glob : PathFilter::split(parsedArgs["--exclude"].asString()))
+		{
+			options.filter.exclude(glob);
+			options.archive_filter.exclude(glob);
+		}
+		options.default_excludes = false;
+	}
+
+	bool result = BeginScan(scanPath, options);
 	Log::Info("NifScan Ended");
 	return result;
-}
\ No newline at end of file
+}
@@ -1,132 +1,17 @@
 #include <core/AnimationCache.h>
-
-int HkCRC::reflectByte(int c)
-{
-	int outbyte = 0;
-	int i = 0x01;
-	int j;
-
-	for (j = 0x80; j > 0; j >>= 1)
-	{
-		int val = c & i;
-		if (val > 0) outbyte |= j;
-		i <<= 1;
-	}
-	return (outbyte);
-}
-
-void HkCRC::reflect(int* crc, int bitnum, int startLSB)
-{
-	int i, j, k, iw, jw, bit;
-
-	for (k = 0; k + startLSB < bitnum - 1 - k; k++) {
-
-		iw = 7 - ((k + startLSB) >> 3);
-		jw = 1 << ((k + startLSB) & 7);
-		i = 7 - ((bitnum - 1 - k) >> 3);
-		j = 1 << ((bitnum - 1 - k) & 7);
-
-		bit = crc[iw] & jw;
-		if ((crc[i] & j) > 0) crc[iw] |= jw;
-		else crc[iw] &= (0xff - jw);
-		if ((bit) > 0) crc[i] |= j;
-		else crc[i] &= (0xff - j);
-	}
-}
-
-std::string HkCRC::compute(std::string input) {
-	// computes crc value
-	int i, j, k, bit, datalen, len, flag, counter, c, order, ch, actchar;
-	std::string data, output;
-	int* mask = new int[8];
-	const char hexnum[] = { '0','1','2','3','4','5','6','7','8','9','A','B','C','D','E','F' };
-	int polynom[] = { 0,0,0,0,4,193,29,183 };
-	int init[] = { 0,0,0,0,0,0,0,0 };
-	int crc[] = { 0,0,0,0,0,0,0,0,0 };
-	int xor[] = { 0,0,0,0,0,0,0,0 };
-	order = 32;
-
-	// generate bit mask
-	counter = order;
-	for (i = 7; i > 0; i--)
-	{
-		if (counter >= 8) mask[i] = 255;
-		else mask[i] = (1 << counter) - 1;
-		counter -= 8;
-		if (counter < 0) counter = 0;
-	}
-	data = input;
-	datalen = data.length();
-	len = 0;
-	for (i = 0; i < datalen; i++)
-	{
-		c = (int)data.at(i);
-		if (data.at(i) == '%')				// unescape ::byte by ::byte (%00 allowed)
-		{
-			if (i > datalen - 3)
-				Log::Error("Invalid data sequence");
-
-			try {
-				ch = (int)data.at(++i);
-				c = (int)data.at(++i);
-				c = (c & 15) | ((ch & 15) << 4);
-			}
-			catch (...) {
-				Log::Error("Invalid data sequence");
-				return "failure";
-			}
-
-		}
-		c = reflectByte(c);
-		for (j = 0; j < 8; j++)
-		{
-			bit = 0;
-			if ((crc[7 - ((order - 1) >> 3)] & (1 << ((order - 1) & 7))) > 0) bit = 1;
-			if ((c & 0x80) > 0) bit ^= 1;
-			c <<= 1;
-			for (k = 0; k < 8; k++)		// rotate all (max.8) crc bytes
-			{
-				crc[k] = ((crc[k] << 1) | (crc[k + 1] >> 7)) & mask[k];
-				if ((bit) > 0) crc[k] ^= polynom[k];
-			}
-		}
-		len++;
-	}
-	reflect(crc, order, 0);
-	for (i = 0; i < 8; i++) crc[i] ^= xor [i];
-	output = "";
-	flag = 0;
-	for (i = 0; i < 8; i++)
-	{
-		actchar = crc[i] >> 4;
-		if (flag > 0 || actchar > 0)
-		{
-			output += hexnum[actchar];
-			flag = 1;
-		}
-
-		actchar = crc[i] & 15;
-		if (flag > 0 || actchar > 0 || i == 7)
-		{
-			output += hexnum[actchar];
-			flag = 1;
-		}
-	}
-	return output;
-}
+#include <core/BSAExtractor.h>
+#include <core/CacheManifest.h>
+#include <core/CompiledCache.h>
 
 std::shared_ptr<CacheEntry> AnimationCache::find(const string & name) {
-	string lower = name;
-	transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return tolower(c); });
-	if (projects_index.find(lower) != projects_index.end())
-		return projects_index[lower];
+	auto it = projects_index.find(name);
+	if (it != projects_index.end())
+		return it->second;
 	return NULL;
 }
 
 string AnimationCache::project_at(size_t index) const {
-	auto it = projects_index.begin();
-	std::advance(it, index);
-	return it->first;
+	return project_names[index];
 }
 
 AnimationCache::AnimationCache(const fs::path& workspacePath) :
@@ -137,23 +22,86 @@ AnimationCache::AnimationCache(const fs::path& workspacePath) :
 {
 }
 
+string AnimationCache::read_file(const fs::path& path)
+{
+	//single read, CRLF line ends are handled by the scanner
+	string content;
+	std::ifstream t(path.string(), std::ios::binary);
+	if (t.is_open())
+	{
+		t.seekg(0, std::ios::end);
+		content.resize(static_cast<size_t>(t.tellg()));
+		t.seekg(0, std::ios::beg);
+		t.read(&content[0], content.size());
+		content.resize(static_cast<size_t>(t.gcount()));
+	}
+	return content;
+}
+
 AnimationCache::AnimationCache(const fs::path& animationDataPath, const  fs::path& animationSetDataPath) {
 	if (fs::exists(animationDataPath) && fs::exists(animationSetDataPath))
+		load(animationDataPath, animationSetDataPath);
+}
+
+static bool same_file(const ckcmd::CompiledCache::Source& a, const ckcmd::CompiledCache::Source& b)
+{
+	return a.size == b.size && a.time == b.time;
+}
+
+void AnimationCache::load(const fs::path& animationDataPath, const fs::path& animationSetDataPath)
+{
+	using ckcmd::CompiledCache;
+	fs::path compiledPath = animationDataPath.parent_path() / compiled_cache_file;
+	CompiledCache::Source dataSource = CompiledCache::Source::stat(animationDataPath);
+	CompiledCache::Source setsSource = CompiledCache::Source::stat(animationSetDataPath);
+
+	//the image is used as is while both files keep size and time, after a touch only if their hashes still match
+	string animationDataContent, animationSetDataContent;
+	bool read = false, refresh = false;
+	CompiledCache compiled;
+	if (compiled.open(compiledPath) &&
+		(!same_file(compiled.data_source(), dataSource) || !same_file(compiled.sets_source(), setsSource)))
 	{
-		string animationDataContent;
-		{
-			std::ifstream t(animationDataPath.string());
-			animationDataContent = string((std::istreambuf_iterator<char>(t)),
-				std::istreambuf_iterator<char>());
+		animationDataContent = read_file(animationDataPath);
+		animationSetDataContent = read_file(animationSetDataPath);
+		dataSource.hash = ckcmd::CacheManifest::hash(animationDataContent);
+		setsSource.hash = ckcmd::CacheManifest::hash(animationSetDataContent);
+		read = true;
+		refresh = compiled.data_source().hash == dataSource.hash && compiled.sets_source().hash == setsSource.hash;
+		if (!refresh)
+			compiled.close();
+	}
+
+	if (compiled.is_open())
+	{
+		try {
+			AnimData::AnimDataFile data;
+			AnimData::AnimSetDataFile sets;
+			compiled.read(data, sets);
+			compiled.close();
+			animationData = std::move(data);
+			animationSetData = std::move(sets);
+			createEntries();
+			if (refresh)
+				CompiledCache::write(compiledPath, animationData, animationSetData, dataSource, setsSource);
+			return;
 		}
-		string animationSetDataContent;
-		{
-			std::ifstream t(animationSetDataPath.string());
-			animationSetDataContent = string((std::istreambuf_iterator<char>(t)),
-				std::istreambuf_iterator<char>());
+		catch (const std::out_of_range& e) {
+			Log::Warn("%s: %s, reading the text files", compiledPath.string().c_str(), e.what());
+			compiled.close();
 		}
-		build(animationDataContent, animationSetDataContent);
 	}
+
+	if (!read)
+	{
+		animationDataContent = read_file(animationDataPath);
+		animationSetDataContent = read_file(animationSetDataPath);
+		dataSource.hash = ckcmd::CacheManifest::hash(animationDataContent);
+		setsSource.hash = ckcmd::CacheManifest::hash(animationSetDataContent);
+	}
+	build(animationDataContent, animationSetDataContent);
+	if (!CompiledCache::write(compiledPath, animationData, animationSetData, dataSource, setsSource))
+		Log::Debug("Unable to write %s, the text files will be parsed again next time", compiledPath.string().c_str());
 }
 
 AnimationCache::AnimationCache(const string& animationDataContent, const string& animationSetDataContent) {
@@ -166,23 +114,18 @@ std::shared_ptr<CreatureCacheEntry> AnimationCache::cloneCreature(const std::str
 	if (source == NULL) return NULL;
 	auto creature = dynamic_pointer_cast<CreatureCacheEntry>(source);
 	if (creature == NULL) return NULL;
-	AnimData::ProjectBlock block = creature->block;
-	AnimData::ProjectDataBlock movements = creature->movements;
-	AnimData::ProjectAttackListBlock sets = creature->sets;
-
-	auto index = animationData.putProject(destination_project + ".txt", block, movements);
-	auto creature_index = animationSetData.putProjectAttackBlock(destination_project + "Data\\" + destination_project + ".txt", sets);
-
-	creature_entries.push_back(
-		make_shared<CreatureCacheEntry>(
-			destination_project,
-			animationData.getProjectBlock(index),
-			animationData.getprojectMovementBlock(index),
-			animationSetData.getProjectAttackBlock(creature_index)
-		)
+	auto index = animationData.putProject(destination_project + ".txt", creature->block, creature->movements);
+	auto creature_index = animationSetData.putProjectAttackBlock(destination_project + "Data\\" + destination_project + ".txt", creature->sets);
+
+	auto entry = make_shared<CreatureCacheEntry>(
+		destination_project,
+		animationData.getProjectBlock(index),
+		animationData.getprojectMovementBlock(index),
+		animationSetData.getProjectAttackBlock(creature_index)
 	);
-	rebuildIndex();
-	return dynamic_pointer_cast<CreatureCacheEntry>(find(destination_project));
+	creature_entries.push_back(entry);
+	addToIndex(entry);
+	return entry;
 }
 
 void AnimationCache::save(const fs::path& animationDataPath, const  fs::path& animationSetDataPath) {
@@ -233,9 +176,9 @@ void AnimationCache::save_creature(
 			outstream.open(root_folder / fs::path(animation_set_data_folder) / string("dirlist.txt"));
 			outstream << animationSetData.getProjectsList().getBlock();
 			outstream.close();
-			auto sets = creature_ptr->sets;
-			auto projects = sets.getProjectFiles().getStrings();
-			auto data = sets.getProjectAttackBlocks();
+			auto& sets = creature_ptr->sets;
+			const auto& projects = sets.getProjectFiles().getStrings();
+			auto& data = sets.getProjectAttackBlocks();
 			for (size_t i = 0; i < projects.size(); i++)
 			{
 				string outfile = (root_folder / set_data_directory / projects[i]).string();
@@ -260,66 +203,55 @@ void AnimationCache::save_creature(
 	}
 }
 
-void AnimationCache::rebuildIndex()
+void AnimationCache::addToIndex(const std::shared_ptr<CacheEntry>& entry)
 {
-	for (auto& entry : creature_entries)
-	{
-		string lower = entry->name;
-		transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return tolower(c); });
-		projects_index[lower] = entry;
-	}
-	for (auto& entry : misc_entries)
-	{
-		string lower = entry->name;
-		transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return tolower(c); });
-		projects_index[lower] = entry;
-	}
-
-	movements_map.clear();
-	events_map.clear();
+	string lower = entry->name;
+	transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return tolower(c); });
+	auto name = std::lower_bound(project_names.begin(), project_names.end(), lower);
+	if (name == project_names.end() || *name != lower)
+		project_names.insert(name, lower);
+	projects_index[lower] = entry;
+	entry->invalidate();
+
+	auto creature = dynamic_pointer_cast<CreatureCacheEntry>(entry);
+	if (creature == NULL)
+		return;
 
-	for (const auto& creature : creature_entries)
-	{
-		string project_name = creature->name;
-		transform(project_name.begin(), project_name.end(), project_name.begin(), [](unsigned char c) { return tolower(c); });
-		auto& movements = creature->movements.getMovementData();
-		for (const auto& clip : creature->block.getClips()) {
-			//Bethesda fuck up this
-			if (clip.getCacheIndex() < movements.size())
-			{
-				for (auto& move : movements)
-				{
-					if (move.getCacheIndex() == clip.getCacheIndex())
-						movements_map[{project_name, clip.getName()}] = move;
-				}
+	for (auto& set : creature->sets.getProjectAttackBlocks()) {
+		auto& variables = set.getHandVariableData().getVariables();
+		if (variables.size() == 0)
+		{
+			for (auto& idle_event : set.getSwapEventsList()) {
+				events_map.insert({ {lower, idle_event}, { event_type_t::idle, {} } });
 			}
 		}
-		for (auto set : creature->sets.getProjectAttackBlocks()) {
-			if (set.getHandVariableData().getVariables().size() == 0)
-			{
-				for (auto& idle_event : set.getSwapEventsList().getStrings()) {
-					events_map.insert({ {project_name, idle_event}, { event_type_t::idle, {} } });
-				}
-			}
 
-			for (auto attack_data : set.getAttackData().getAttackData()) {
-				events_map.insert({ {project_name, attack_data.getEventName()},
-					{ event_type_t::attack,
-					attack_data.getUnk1() > 0,
-					set.getHandVariableData().getVariables()} });
-			}
+		for (auto& attack_data : set.getAttackData().getAttackData()) {
+			events_map.insert({ {lower, attack_data.getEventName()},
+				{ event_type_t::attack,
+				attack_data.getUnk1() > 0,
+				variables} });
 		}
 	}
-
 }
 
-void AnimationCache::build(const string& animationDataContent, const string& animationSetDataContent) {
+void AnimationCache::rebuildIndex()
+{
+	projects_index.clear();
+	project_names.clear();
+	events_map.clear();
+	projects_index.reserve(creature_entries.size() + misc_entries.size());
 
-	animationData.parse(animationDataContent);
-	animationSetData.parse(animationSetDataContent);
+	for (auto& entry : creature_entries)
+		addToIndex(entry);
+	for (auto& entry : misc_entries)
+		addToIndex(entry);
+}
+
+void AnimationCache::createEntries() {
 
 	int index = 0;
-	for (string project : animationData.getProjectList().getStrings()) {
+	for (const string& project : animationData.getProjectList()) {
 		string sanitized_project_name = fs::path(project).filename().replace_extension("").string();
 		string sanitized_creature_name = sanitized_project_name + "Data\\" + sanitized_project_name + ".txt";
 		int creature_index = animationSetData.getProjectAttackBlock(sanitized_creature_name);
@@ -349,6 +281,14 @@ void AnimationCache::build(const string& animationDataContent, const string& ani
 	rebuildIndex();
 
 	printInfo();
+}
+
+void AnimationCache::build(std::string_view animationDataContent, std::string_view animationSetDataContent) {
+
+	animationData.parse(animationDataContent);
+	animationSetData.parse(animationSetDataContent);
+	createEntries();
+
 #ifdef __TEST__
 	AnimData::AnimDataFile newAnimationData;
 
@@ -412,13 +352,7 @@ void AnimationCache::get_entries(
 	name = name.filename().replace_extension("");
 	entry.name = name.string();
 
-	string block_content;
-	ifstream t(cacheFile);
-	t.seekg(0, std::ios::end);
-	block_content.reserve(static_cast<size_t>(t.tellg()));
-	t.seekg(0, std::ios::beg);
-	block_content.assign((std::istreambuf_iterator<char>(t)),
-		std::istreambuf_iterator<char>());
+	string block_content = read_file(cacheFile);
 	scannerpp::Scanner p(block_content);
 	entry.block.parseBlock(p);
 
@@ -429,13 +363,7 @@ void AnimationCache::get_entries(
 			Log::Error("Invalid file: %s", movement_path.c_str());
 			return;
 		}
-		ifstream t(movement_path.string());
-		string movement_content;
-		t.seekg(0, std::ios::end);
-		movement_content.reserve(static_cast<size_t>(t.tellg()));
-		t.seekg(0, std::ios::beg);
-		movement_content.assign((std::istreambuf_iterator<char>(t)),
-			std::istreambuf_iterator<char>());
+		string movement_content = read_file(movement_path);
 		scannerpp::Scanner p(movement_content);
 		entry.movements.parseBlock(p);
 	}
@@ -459,18 +387,11 @@ void AnimationCache::get_attack_entries(
 			continue;
 
 		ProjectAttackBlock pb;
-		string block_content;
-		ifstream t(attackEntry);
-		t.seekg(0, std::ios::end);
-		block_content.reserve(static_cast<size_t>(t.tellg()));
-		t.seekg(0, std::ios::beg);
-		block_content.assign((std::istreambuf_iterator<char>(t)),
-			std::istreambuf_iterator<char>());
-		t.close();
+		string block_content = read_file(attackEntry);
 		scannerpp::Scanner p(block_content);
 
 		pb.parseBlock(p);
-		block.putProjectAttack(line, pb);
+		block.putProjectAttack(line, std::move(pb));
 	}
 }
 
@@ -508,7 +429,7 @@ void AnimationCache::create_creature_entry(
 	string directory_content = bsa_file.extract(directory_path);
 	scannerpp::Scanner p(directory_content);
 	list.parseBlock(p);
-	vector<string> project_files = list.getStrings();
+	vector<string>& project_files = list.getStrings();
 
 	std::sort(project_files.begin(), project_files.end(),
 		[](const string& lhs, const string& rhs) -> bool
@@ -541,70 +462,94 @@ void AnimationCache::create_creature_entry(
 		string sub_project_content = bsa_file.extract(sub_project_path);
 		scannerpp::Scanner p(sub_project_content);
 		AnimData::ProjectAttackBlock ab; ab.parseBlock(p);
-		entry.sets.putProjectAttack(project, ab);
+		entry.sets.putProjectAttack(project, std::move(ab));
 	}
 }
 
-void AnimationCache::check_from_bsa(const ckcmd::BSA::BSAFile& bsa_file, const std::vector<string>& actors, const std::vector<string>& misc)
+//owns the blocks an entry extracted from a BSA refers to
+struct BSAProjectEntry
 {
+	AnimData::ProjectBlock block;
+	AnimData::ProjectDataBlock movements;
+	AnimData::ProjectAttackListBlock sets;
+	CreatureCacheEntry entry;
 
-	for (size_t i = 0; i < actors.size(); i++)
-	{
-		CreatureCacheEntry entry;
-		auto default_entry = creature_entries[i];
-		create_creature_entry(entry, bsa_file, fs::path(actors[i]).filename().replace_extension("").string());
-		if (!iequals(entry.name, default_entry->name) ||
-			entry.block.getBlock() != default_entry->block.getBlock() ||
-			entry.movements.getBlock() != default_entry->movements.getBlock() ||
-			entry.sets.getBlock() != default_entry->sets.getBlock())
-			Log::Info("Error");
-
-
-		Log::Info("project creature: %s", entry.name.c_str());
-		int getUnkEventList = 0;
-		int getUnkEventData = 0;
-		int crc32s = 0;
-		size_t movements = entry.movements.getMovementData().size();
-		set<string> paths;
-		set<string> attacks;
-		auto abs = entry.sets.getProjectAttackBlocks();
-		Log::Info("animations sets: %d", abs.size());
-		for (auto& ab : abs)
-		{
-			getUnkEventList += ab.getSwapEventsList().getStrings().size();
-			getUnkEventData += ab.getHandVariableData().getVariables().size() * 3;
-			auto& atts = ab.getAttackData().getAttackData();
-			auto& strings = ab.getCrc32Data().getStrings();
-			for (auto& att : atts)
-				attacks.insert(att.getEventName());
-			std::vector<std::string>::iterator it;
-			int i = 0;
-			string this_path;
-			for (it = strings.begin(); it != strings.end(); ++it) {
-				if (i % 3 == 0)
-					this_path = *it;
-				if (i % 3 == 1)
-					paths.insert(this_path + *it);
-				i++;
+	BSAProjectEntry() : entry("", block, movements, sets) {}
+};
+
+void AnimationCache::check_from_bsa(const ckcmd::BSA::BSAFile& bsa_file, const std::vector<string>& actors, const std::vector<string>& misc)
+{
+	typedef std::unique_ptr<BSAProjectEntry> bsa_project_t;
+	ckcmd::BSA::BSAExtractor extractor(bsa_file);
+
+	//projects are extracted and parsed on the workers, compared in order here
+	extractor.for_each<bsa_project_t>(actors.size(),
+		[&actors](const ckcmd::BSA::BSAFile& handle, size_t i) {
+			auto project = std::make_unique<BSAProjectEntry>();
+			create_creature_entry(project->entry, handle, fs::path(actors[i]).filename().replace_extension("").string());
+			return project;
+		},
+		[&](size_t i, bsa_project_t& project) {
+			CreatureCacheEntry& entry = project->entry;
+			auto default_entry = creature_entries[i];
+			if (!iequals(entry.name, default_entry->name) ||
+				entry.block.getBlock() != default_entry->block.getBlock() ||
+				entry.movements.getBlock() != default_entry->movements.getBlock() ||
+				entry.sets.getBlock() != default_entry->sets.getBlock())
+				Log::Info("Error");
+
+
+			Log::Info("project creature: %s", entry.name.c_str());
+			int getUnkEventList = 0;
+			int getUnkEventData = 0;
+			int crc32s = 0;
+			size_t movements = entry.movements.getMovementData().size();
+			set<string> paths;
+			set<string> attacks;
+			auto& abs = entry.sets.getProjectAttackBlocks();
+			Log::Info("animations sets: %d", abs.size());
+			for (auto& ab : abs)
+			{
+				getUnkEventList += ab.getSwapEventsList().getStrings().size();
+				getUnkEventData += ab.getHandVariableData().getVariables().size() * 3;
+				auto& atts = ab.getAttackData().getAttackData();
+				auto& strings = ab.getCrc32Data().getStrings();
+				for (auto& att : atts)
+					attacks.insert(att.getEventName());
+				std::vector<std::string>::iterator it;
+				int i = 0;
+				string this_path;
+				for (it = strings.begin(); it != strings.end(); ++it) {
+					if (i % 3 == 0)
+						this_path = *it;
+					if (i % 3 == 1)
+						paths.insert(this_path + *it);
+					i++;
+				}
 			}
+			Log::Info("attacks: %d", attacks.size());
+			Log::Info("getUnkEventList: %d", getUnkEventList);
+			Log::Info("getUnkEventData: %d", getUnkEventData);
+			Log::Info("movements: %d", movements);
+			Log::Info("paths: %d", paths.size());
 		}
-		Log::Info("attacks: %d", attacks.size());
-		Log::Info("getUnkEventList: %d", getUnkEventList);
-		Log::Info("getUnkEventData: %d", getUnkEventData);
-		Log::Info("movements: %d", movements);
-		Log::Info("paths: %d", paths.size());
+	);
 
-	}
-	for (size_t i = 0; i < misc.size(); i++)
-	{
-		CacheEntry entry;
-		auto default_entry = misc_entries[i];
-		create_entry(entry, bsa_file, fs::path(misc[i]).filename().replace_extension("").string());
-		if (!iequals(entry.name, default_entry->name) ||
-			entry.block.getBlock() != default_entry->block.getBlock() ||
-			entry.movements.getBlock() != default_entry->movements.getBlock())
-			Log::Info("Error");
-	}
+	extractor.for_each<bsa_project_t>(misc.size(),
+		[&misc](const ckcmd::BSA::BSAFile& handle, size_t i) {
+			auto project = std::make_unique<BSAProjectEntry>();
+			create_entry(project->entry, handle, fs::path(misc[i]).filename().replace_extension("").string());
+			return project;
+		},
+		[&](size_t i, bsa_project_t& project) {
+			CacheEntry& entry = project->entry;
+			auto default_entry = misc_entries[i];
+			if (!iequals(entry.name, default_entry->name) ||
+				entry.block.getBlock() != default_entry->block.getBlock() ||
+				entry.movements.getBlock() != default_entry->movements.getBlock())
+				Log::Info("Error");
+		}
+	);
 }
 
 void AnimationCache::printInfo() {
@@ -0,0 +1,289 @@
+#include <core/BSAExtractor.h>
+#include <core/ThreadPool.h>
+#include <core/log.h>
+
+#include <algorithm>
+#include <climits>
+
+using namespace ckcmd::BSA;
+
+MemoryStream::buffer::buffer(const char* data, size_t size)
+{
+	char* begin = const_cast<char*>(data);
+	setg(begin, begin, begin + size);
+}
+
+std::streambuf::pos_type MemoryStream::buffer::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+	if (!(which & std::ios_base::in))
+		return pos_type(off_type(-1));
+	char* target = nullptr;
+	if (dir == std::ios_base::beg)
+		target = eback() + off;
+	else if (dir == std::ios_base::cur)
+		target = gptr() + off;
+	else
+		target = egptr() + off;
+	if (target < eback() || target > egptr())
+		return pos_type(off_type(-1));
+	setg(eback(), target, egptr());
+	return pos_type(target - eback());
+}
+
+std::streambuf::pos_type MemoryStream::buffer::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+	return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+MemoryStream::MemoryStream(const uint8_t* data, size_t size) :
+	std::istream(nullptr),
+	buf((const char*)data, size)
+{
+	rdbuf(&buf);
+}
+
+MemoryStream::MemoryStream(std::string_view data) :
+	MemoryStream((const uint8_t*)data.data(), data.size())
+{
+}
+
+MemoryOutputStream::buffer::buffer(char* data, size_t capacity)
+{
+	setp(data, data + capacity);
+}
+
+std::streambuf::pos_type MemoryOutputStream::buffer::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+	if (!(which & std::ios_base::out))
+		return pos_type(off_type(-1));
+	char* target = nullptr;
+	if (dir == std::ios_base::beg)
+		target = pbase() + off;
+	else if (dir == std::ios_base::cur)
+		target = pptr() + off;
+	else
+		target = epptr() + off;
+	if (target < pbase() || target > epptr())
+		return pos_type(off_type(-1));
+	char* begin = pbase();
+	char* end = epptr();
+	setp(begin, end);
+	for (off_type step = target - begin; step > 0; )
+	{
+		int chunk = (int)std::min<off_type>(step, INT_MAX);
+		pbump(chunk);
+		step -= chunk;
+	}
+	return pos_type(target - begin);
+}
+
+std::streambuf::pos_type MemoryOutputStream::buffer::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+	return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+MemoryOutputStream::MemoryOutputStream(uint8_t* data, size_t capacity) :
+	std::ostream(nullptr),
+	buf((char*)data, capacity)
+{
+	rdbuf(&buf);
+}
+
+ExtractedAsset::ExtractedAsset(ExtractedAsset&& other) noexcept :
+	asset_path(std::move(other.asset_path)),
+	bytes(other.bytes),
+	length(other.length),
+	owner(other.owner)
+{
+	other.bytes = nullptr;
+	other.length = 0;
+	other.owner = nullptr;
+}
+
+ExtractedAsset& ExtractedAsset::operator=(ExtractedAsset&& other) noexcept
+{
+	if (this != &other)
+	{
+		reset();
+		asset_path = std::move(other.asset_path);
+		bytes = other.bytes;
+		length = other.length;
+		owner = other.owner;
+		other.bytes = nullptr;
+		other.length = 0;
+		other.owner = nullptr;
+	}
+	return *this;
+}
+
+ExtractedAsset::~ExtractedAsset()
+{
+	reset();
+}
+
+void ExtractedAsset::reset()
+{
+	if (bytes != nullptr)
+		delete[] bytes;
+	if (owner != nullptr)
+		owner->release(length);
+	bytes = nullptr;
+	length = 0;
+	owner = nullptr;
+}
+
+BSAExtractor::BSAExtractor(const BSAFile& bsa, const ExtractorOptions& options) :
+	bsa(bsa),
+	options(options)
+{
+}
+
+size_t BSAExtractor::threads() const
+{
+	return options.threads > 0 ? options.threads : ckcmd::ThreadPool::default_threads();
+}
+
+ExtractedAsset BSAExtractor::extract(const BSAFile& handle, size_t index, const std::string& asset_path)
+{
+	size_t size = 0;
+	const uint8_t* data = handle.extract(asset_path, size);
+	if (data == nullptr)
+		size = 0;
+	{
+		//the oldest pending asset always goes through, the consumer could be waiting for it
+		std::unique_lock<std::mutex> lock(mutex);
+		budget.wait(lock, [&] {
+			return aborted || held_bytes == 0 || index <= consumed || held_bytes + size <= options.memory_budget;
+		});
+		held_bytes += size;
+		peak_bytes = std::max(peak_bytes, held_bytes);
+	}
+	return ExtractedAsset(asset_path, data, size, this);
+}
+
+void BSAExtractor::release(size_t size)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		held_bytes -= size;
+	}
+	budget.notify_all();
+}
+
+void BSAExtractor::schedule(
+	size_t count,
+	const std::function<void(const BSAFile&, size_t)>& produce,
+	const std::function<void(size_t)>& consume)
+{
+	next_index = 1;
+	consumed = 0;
+	held_bytes = 0;
+	peak_bytes = 0;
+	aborted = false;
+	done.assign(count, 0);
+	errors.assign(count, nullptr);
+
+	if (count == 0)
+		return;
+
+	//first asset on the calling thread, it primes lazily initialized library state
+	//(niflib object registry, havok class tables) before the workers start
+	try {
+		produce(bsa, 0);
+		consume(0);
+	}
+	catch (const std::exception& e) {
+		Log::Error("%s", e.what());
+	}
+	consumed = 1;
+	if (count == 1)
+		return;
+
+	size_t workers = std::min(threads(), count - 1);
+	size_t depth = options.queue_depth > 0 ? options.queue_depth : 2 * workers;
+
+	std::exception_ptr consumer_error;
+	{
+		ckcmd::ThreadPool pool(workers);
+		for (size_t t = 0; t < workers; t++)
+		{
+			pool.submit([&]() {
+				BSAFile handle(bsa.path());
+				for (;;)
+				{
+					size_t i;
+					{
+						std::unique_lock<std::mutex> lock(mutex);
+						window.wait(lock, [&] { return aborted || next_index >= count || next_index < consumed + depth; });
+						if (aborted || next_index >= count)
+							return;
+						i = next_index++;
+					}
+					try {
+						produce(handle, i);
+					}
+					catch (...) {
+						errors[i] = std::current_exception();
+					}
+					{
+						std::lock_guard<std::mutex> lock(mutex);
+						done[i] = 1;
+					}
+					ready.notify_all();
+				}
+			});
+		}
+
+		try {
+			for (size_t i = 1; i < count; i++)
+			{
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					ready.wait(lock, [&] { return done[i] != 0; });
+				}
+				if (errors[i])
+				{
+					try {
+						std::rethrow_exception(errors[i]);
+					}
+					catch (const std::exception& e) {
+						Log::Error("%s", e.what());
+					}
+					catch (...) {
+						Log::Error("%s: unknown error on item %zu", bsa.path().string().c_str(), i);
+					}
+				}
+				else {
+					consume(i);
+				}
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					consumed = i + 1;
+				}
+				window.notify_all();
+				budget.notify_all();
+			}
+		}
+		catch (...) {
+			consumer_error = std::current_exception();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				aborted = true;
+			}
+			window.notify_all();
+			budget.notify_all();
+		}
+	}
+	if (consumer_error)
+		std::rethrow_exception(consumer_error);
+}
+
+void BSAExtractor::run(
+	const std::vector<std::string>& assets,
+	const std::function<void(ExtractedAsset&)>& consume)
+{
+	for_each<ExtractedAsset>(assets.size(),
+		[&](const BSAFile& handle, size_t i) { return extract(handle, i, assets[i]); },
+		[&](size_t, ExtractedAsset& asset) { consume(asset); }
+	);
+}
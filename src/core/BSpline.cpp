@@ -0,0 +1,52 @@
+#include <core/BSpline.h>
+
+#include <algorithm>
+#include <vector>
+
+using namespace ckcmd;
+
+BSpline::BSpline(int control_points, int degree) :
+	ncontrol(std::max(control_points, 1)),
+	order(std::min(std::max(degree, 0), ncontrol - 1) + 1)
+{
+}
+
+float BSpline::knot(int index) const
+{
+	return (float)std::min(std::max(index - order + 1, 0), spans());
+}
+
+void BSpline::sample(const float* control, int channels, float* output, int count) const
+{
+	if (count <= 0)
+		return;
+
+	const int p = order - 1;
+	const int last = ncontrol - 1;
+	std::vector<float> points(order * channels);
+
+	//the parameter is stepped as the recursive evaluation importkf used did
+	float increment = (float)spans() / (count - 1);
+	float v = 0.0f;
+	for (int i = 0; i < count - 1; i++, v += increment)
+	{
+		//span s holds [knot(s), knot(s + 1)), it blends control points s - p to s
+		int s = std::min(p + (int)v, last);
+		std::copy(control + (s - p) * channels, control + (s + 1) * channels, points.begin());
+
+		for (int r = 1; r <= p; r++)
+		{
+			for (int j = p; j >= r; j--)
+			{
+				float left = knot(s - p + j);
+				float alpha = (v - left) / (knot(s + 1 + j - r) - left);
+				float* to = &points[j * channels];
+				const float* from = &points[(j - 1) * channels];
+				for (int c = 0; c < channels; c++)
+					to[c] = from[c] + alpha * (to[c] - from[c]);
+			}
+		}
+		std::copy(points.begin() + p * channels, points.end(), output + i * channels);
+	}
+	std::copy(control + last * channels, control + ncontrol * channels, output + (count - 1) * channels);
+}
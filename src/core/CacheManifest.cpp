@@ -0,0 +1,94 @@
+#include <core/CacheManifest.h>
+
+#include <fstream>
+#include <sstream>
+
+using namespace ckcmd;
+
+const char* CacheManifest::file_name = "animationcache.manifest";
+
+static const char* cache_manifest_magic = "ckcmd-cache-manifest 1";
+
+uint64_t CacheManifest::hash(std::string_view bytes, uint64_t seed)
+{
+	for (unsigned char c : bytes)
+	{
+		seed ^= c;
+		seed *= 0x100000001b3ull;
+	}
+	return seed;
+}
+
+bool CacheManifest::load(const fs::path& manifest_file)
+{
+	std::ifstream in(manifest_file.string());
+	std::string line;
+	if (!in.is_open() || !std::getline(in, line) || line != cache_manifest_magic)
+		return false;
+
+	//serializer version, data size hash, sets size hash, then one line per block: p|s hash offset length name
+	std::string tag;
+	uint32_t version = 0;
+	if (!std::getline(in, line) || !(std::istringstream(line) >> tag >> version) || tag != "serializer" || version != serializer_version)
+		return false;
+	if (!std::getline(in, line) || !(std::istringstream(line) >> tag >> data_output.size >> data_output.hash) || tag != "data")
+		return false;
+	if (!std::getline(in, line) || !(std::istringstream(line) >> tag >> sets_output.size >> sets_output.hash) || tag != "sets")
+		return false;
+
+	while (std::getline(in, line))
+	{
+		std::istringstream fields(line);
+		Entry entry;
+		std::string name;
+		if (!(fields >> tag >> entry.hash >> entry.offset >> entry.length) || !std::getline(fields >> std::ws, name))
+			return false;
+		if (tag == "p")
+			projects[name] = entry;
+		else if (tag == "s")
+			sets[name] = entry;
+		else
+			return false;
+	}
+	return true;
+}
+
+bool CacheManifest::save(const fs::path& manifest_file) const
+{
+	std::ofstream out(manifest_file.string(), std::ios::trunc);
+	if (!out.is_open())
+		return false;
+	out << cache_manifest_magic << '\n';
+	out << "serializer " << serializer_version << '\n';
+	out << "data " << data_output.size << ' ' << data_output.hash << '\n';
+	out << "sets " << sets_output.size << ' ' << sets_output.hash << '\n';
+	for (const auto& entry : projects)
+		out << "p " << entry.second.hash << ' ' << entry.second.offset << ' ' << entry.second.length << ' ' << entry.first << '\n';
+	for (const auto& entry : sets)
+		out << "s " << entry.second.hash << ' ' << entry.second.offset << ' ' << entry.second.length << ' ' << entry.first << '\n';
+	return out.good();
+}
+
+bool CacheManifest::matches(std::string_view data_file, std::string_view sets_file) const
+{
+	return data_file.size() == data_output.size && sets_file.size() == sets_output.size &&
+		hash(data_file) == data_output.hash && hash(sets_file) == sets_output.hash;
+}
+
+void CacheManifest::setOutputs(std::string_view data_file, std::string_view sets_file)
+{
+	data_output = { data_file.size(), hash(data_file) };
+	sets_output = { sets_file.size(), hash(sets_file) };
+}
+
+const CacheManifest::Entry* CacheManifest::find(Kind kind, const std::string& name) const
+{
+	const auto& entries = kind == project ? projects : sets;
+	auto it = entries.find(name);
+	return it != entries.end() ? &it->second : nullptr;
+}
+
+void CacheManifest::add(Kind kind, const std::string& name, const Entry& entry)
+{
+	(kind == project ? projects : sets)[name] = entry;
+}
@@ -0,0 +1,146 @@
+#include <core/ClipBatch.h>
+#include <core/HavokSession.h>
+#include <core/LogCapture.h>
+#include <core/ThreadPool.h>
+#include <core/log.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <set>
+
+using namespace ckcmd;
+
+static std::string lowercase(std::string text)
+{
+	std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+	return text;
+}
+
+void ClipBatch::add(const fs::path& source, const fs::path& destination)
+{
+	clips.push_back({ source, destination });
+}
+
+size_t ClipBatch::addFolder(const fs::path& folder, const std::string& extension, const fs::path& output, const std::string& output_extension)
+{
+	size_t before = clips.size();
+	std::string wanted = lowercase(extension);
+	std::vector<fs::path> sources;
+	std::error_code error;
+	for (auto it = fs::recursive_directory_iterator(folder, error); !error && it != fs::recursive_directory_iterator(); it.increment(error))
+	{
+		if (it->is_regular_file(error) && lowercase(it->path().extension().string()) == wanted)
+			sources.push_back(it->path());
+	}
+	//directory order is not stable across file systems
+	std::sort(sources.begin(), sources.end());
+	for (const auto& source : sources)
+		add(source, (output / fs::relative(source, folder, error)).replace_extension(output_extension));
+	return clips.size() - before;
+}
+
+int ClipBatch::addManifest(const fs::path& manifest, const fs::path& output, const std::string& output_extension)
+{
+	std::ifstream in(manifest);
+	if (!in.is_open())
+		return -1;
+
+	size_t before = clips.size();
+	fs::path base = manifest.parent_path();
+	std::string line;
+	while (std::getline(in, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		size_t first = line.find_first_not_of(" \t");
+		if (first == std::string::npos || line[first] == '#')
+			continue;
+
+		size_t tab = line.find('\t', first);
+		fs::path source = base / line.substr(first, tab == std::string::npos ? std::string::npos : tab - first);
+		fs::path destination;
+		if (tab != std::string::npos && line.find_first_not_of(" \t", tab) != std::string::npos)
+			destination = base / line.substr(line.find_first_not_of(" \t", tab));
+		else
+			destination = (output / source.filename()).replace_extension(output_extension);
+		add(source, destination);
+	}
+	return (int)(clips.size() - before);
+}
+
+size_t ClipBatch::run(const std::function<bool(const Clip&)>& convert, size_t threads)
+{
+	std::set<fs::path> directories;
+	for (const auto& clip : clips)
+	{
+		if (clip.destination.has_parent_path())
+			directories.insert(clip.destination.parent_path());
+	}
+	for (const auto& directory : directories)
+	{
+		std::error_code error;
+		fs::create_directories(directory, error);
+		if (error)
+			Log::Error("Unable to create %s: %s", directory.string().c_str(), error.message().c_str());
+	}
+
+	std::mutex report_mutex;
+	std::atomic<size_t> failed(0);
+	auto convert_clip = [&](size_t index) {
+		const Clip& clip = clips[index];
+		bool ok = false;
+		std::string exception;
+		LogMessages messages;
+		auto start = std::chrono::steady_clock::now();
+		{
+			LogCapture diagnostics(messages);
+			try {
+				ok = convert(clip);
+			}
+			catch (std::exception& e) {
+				exception = e.what();
+			}
+			catch (...) {
+				exception = "Unknown exception occurred";
+			}
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (!ok)
+			failed++;
+
+		std::lock_guard<std::mutex> lock(report_mutex);
+		LogCapture::replay(messages);
+		if (!exception.empty())
+			Log::Error("%s", exception.c_str());
+		Log::Info("[%zu/%zu] %s: %s in %.2f ms", index + 1, clips.size(), clip.source.string().c_str(), ok ? "ok" : "failed", ms);
+	};
+
+	auto start = std::chrono::steady_clock::now();
+	if (!clips.empty())
+		convert_clip(0);
+
+	//the first clip ran here, a single one needs no pool nor its Havok thread setup
+	size_t workers = 1;
+	std::atomic<size_t> next(1);
+	if (clips.size() > 1)
+	{
+		workers = std::min(threads > 0 ? threads : ThreadPool::default_threads(), clips.size() - 1);
+		ThreadPool pool(workers);
+		for (size_t t = 0; t < pool.size(); t++)
+		{
+			pool.submit([&]() {
+				HavokSession::Scope havok;
+				for (size_t i = next++; i < clips.size(); i = next++)
+					convert_clip(i);
+			});
+		}
+		pool.wait();
+	}
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	Log::Info("Clips: %zu converted, %zu failed in %.2f ms on %zu threads", clips.size() - failed, failed.load(), ms, workers);
+	return failed;
+}
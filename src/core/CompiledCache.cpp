@@ -0,0 +1,493 @@
+#include <core/CompiledCache.h>
+
+#include <cctype>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace ckcmd;
+using namespace AnimData;
+
+static const char compiled_cache_magic[8] = { 'c', 'k', 'c', 'a', 'c', 'h', 'e', '\0' };
+static const uint32_t compiled_cache_byte_order = 0x01020304;
+
+struct CompiledCache::Header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	Source data;
+	Source sets;
+	uint64_t file_size;
+	uint32_t string_count;
+	uint32_t strings_offset;
+	uint32_t blob_offset;
+	uint32_t blob_size;
+	uint32_t project_count;
+	uint32_t projects_offset;
+	uint32_t set_count;
+	uint32_t sets_offset;
+	uint32_t index_buckets;
+	uint32_t index_offset;
+	uint32_t word_count;
+	uint32_t words_offset;
+};
+
+struct TableEntry {
+	uint32_t name;
+	uint32_t words;
+};
+
+//lowercase name without folders and extension, as AnimationCache names its projects
+static std::string project_key(std::string_view name)
+{
+	size_t slash = name.find_last_of("\\/");
+	if (slash != std::string_view::npos)
+		name.remove_prefix(slash + 1);
+	size_t dot = name.rfind('.');
+	if (dot != std::string_view::npos && dot > 0)
+		name = name.substr(0, dot);
+	std::string key(name);
+	for (char& c : key)
+		c = (char)::tolower((unsigned char)c);
+	return key;
+}
+
+static uint32_t key_hash(std::string_view key)
+{
+	uint32_t hash = 0x811c9dc5u;
+	for (unsigned char c : key)
+	{
+		hash ^= c;
+		hash *= 0x01000193u;
+	}
+	return hash;
+}
+
+static uint32_t bucket_count(size_t entries)
+{
+	uint32_t buckets = 1;
+	while (buckets < entries * 2)
+		buckets <<= 1;
+	return buckets;
+}
+
+CompiledCache::Source CompiledCache::Source::stat(const fs::path& file)
+{
+	Source out;
+	std::error_code error;
+	out.size = (uint64_t)fs::file_size(file, error);
+	if (error)
+		return Source();
+	out.time = (uint64_t)fs::last_write_time(file, error).time_since_epoch().count();
+	return out;
+}
+
+// Reading
+
+struct CompiledCache::Cursor {
+	const CompiledCache& cache;
+	const uint32_t* words;
+	size_t count;
+	size_t position;
+
+	uint32_t next() {
+		if (position >= count)
+			throw std::out_of_range("compiled animation cache: block past the end of the image");
+		return words[position++];
+	}
+
+	//element counts, every element takes at least a word so a corrupt count fails here
+	uint32_t size() {
+		uint32_t value = next();
+		if (value > count - position)
+			throw std::out_of_range("compiled animation cache: count past the end of the image");
+		return value;
+	}
+
+	int integer() { return (int)next(); }
+	bool flag() { return next() != 0; }
+	std::string text() { return std::string(cache.string(next())); }
+
+	StringListBlock list() {
+		uint32_t items = size();
+		StringListBlock out(items);
+		for (uint32_t i = 0; i < items; i++)
+			out.append(text());
+		return out;
+	}
+};
+
+bool CompiledCache::open(const fs::path& file)
+{
+	close();
+	mapping = MappedFile(file);
+	if (!mapping.is_open() || mapping.size() < sizeof(Header))
+	{
+		close();
+		return false;
+	}
+
+	const Header* candidate = (const Header*)mapping.data();
+	uint64_t size = mapping.size();
+	auto fits = [size](uint64_t offset, uint64_t count, uint64_t item) {
+		return offset <= size && count <= (size - offset) / item;
+	};
+	if (memcmp(candidate->magic, compiled_cache_magic, sizeof(compiled_cache_magic)) != 0 ||
+		candidate->version != version ||
+		candidate->byte_order != compiled_cache_byte_order ||
+		candidate->file_size != size ||
+		!fits(candidate->strings_offset, (uint64_t)candidate->string_count + 1, sizeof(uint32_t)) ||
+		!fits(candidate->blob_offset, candidate->blob_size, 1) ||
+		!fits(candidate->projects_offset, candidate->project_count, sizeof(TableEntry)) ||
+		!fits(candidate->sets_offset, candidate->set_count, sizeof(TableEntry)) ||
+		!fits(candidate->index_offset, candidate->index_buckets, sizeof(uint32_t)) ||
+		!fits(candidate->words_offset, candidate->word_count, sizeof(uint32_t)) ||
+		candidate->index_buckets == 0 || (candidate->index_buckets & (candidate->index_buckets - 1)) != 0)
+	{
+		close();
+		return false;
+	}
+	header = candidate;
+	return true;
+}
+
+void CompiledCache::close()
+{
+	header = nullptr;
+	mapping = MappedFile();
+}
+
+const CompiledCache::Source& CompiledCache::data_source() const
+{
+	return header->data;
+}
+
+const CompiledCache::Source& CompiledCache::sets_source() const
+{
+	return header->sets;
+}
+
+std::string_view CompiledCache::string(uint32_t id) const
+{
+	if (id >= header->string_count)
+		throw std::out_of_range("compiled animation cache: string id out of range");
+	const uint32_t* offsets = (const uint32_t*)(mapping.data() + header->strings_offset);
+	if (offsets[id] > offsets[id + 1] || offsets[id + 1] > header->blob_size)
+		throw std::out_of_range("compiled animation cache: string out of range");
+	return std::string_view((const char*)mapping.data() + header->blob_offset + offsets[id], offsets[id + 1] - offsets[id]);
+}
+
+size_t CompiledCache::projects() const
+{
+	return header->project_count;
+}
+
+std::string_view CompiledCache::project_name(size_t index) const
+{
+	const TableEntry* projects = (const TableEntry*)(mapping.data() + header->projects_offset);
+	return string(projects[index].name);
+}
+
+int CompiledCache::find(std::string_view name) const
+{
+	std::string key = project_key(name);
+	const uint32_t* buckets = (const uint32_t*)(mapping.data() + header->index_offset);
+	uint32_t mask = header->index_buckets - 1;
+	for (uint32_t probe = key_hash(key) & mask, step = 0; step <= mask; probe = (probe + 1) & mask, step++)
+	{
+		uint32_t entry = buckets[probe];
+		if (entry == 0 || entry > header->project_count)
+			return -1;
+		if (project_key(project_name(entry - 1)) == key)
+			return (int)entry - 1;
+	}
+	return -1;
+}
+
+void CompiledCache::read(AnimDataFile& data, AnimSetDataFile& sets) const
+{
+	Cursor input{ *this, (const uint32_t*)(mapping.data() + header->words_offset), header->word_count, 0 };
+
+	const TableEntry* projects = (const TableEntry*)(mapping.data() + header->projects_offset);
+	for (uint32_t p = 0; p < header->project_count; p++)
+	{
+		input.position = projects[p].words;
+
+		ProjectBlock block;
+		block.setHasProjectFiles(input.flag());
+		block.setProjectFiles(input.list());
+		block.setHasAnimationCache(input.flag());
+		std::list<ClipGeneratorBlock> clips;
+		for (uint32_t c = 0, count = input.size(); c < count; c++)
+		{
+			ClipGeneratorBlock clip;
+			clip.setName(input.text());
+			clip.setCacheIndex(input.integer());
+			clip.setPlaybackSpeed(input.text());
+			clip.setCropStartTime(input.text());
+			clip.setCropEndTime(input.text());
+			clip.setEvents(input.list());
+			clips.push_back(std::move(clip));
+		}
+		block.setClips(std::move(clips));
+
+		std::string name(string(projects[p].name));
+		if (!input.flag())
+		{
+			data.putProject(std::move(name), std::move(block));
+			continue;
+		}
+
+		std::vector<ClipMovementData> movements(input.size());
+		for (auto& movement : movements)
+		{
+			movement.setCacheIndex(input.integer());
+			movement.setDuration(input.text());
+			movement.setTraslations(input.list());
+			movement.setRotations(input.list());
+		}
+		ProjectDataBlock movement_block;
+		movement_block.setMovementData(std::move(movements));
+		data.putProject(std::move(name), std::move(block), std::move(movement_block));
+	}
+
+	const TableEntry* set_table = (const TableEntry*)(mapping.data() + header->sets_offset);
+	for (uint32_t s = 0; s < header->set_count; s++)
+	{
+		input.position = set_table[s].words;
+
+		ProjectAttackListBlock list;
+		list.setProjectFiles(input.list());
+		std::vector<ProjectAttackBlock> attack_blocks(input.size());
+		for (auto& attack_block : attack_blocks)
+		{
+			attack_block.setAnimVersion(input.text());
+			attack_block.setSwapEventsList(input.list());
+
+			HandVariableData variables;
+			for (uint32_t v = 0, count = input.size(); v < count; v++)
+			{
+				HandVariableData::Data variable;
+				variable.variable_name = input.text();
+				variable.value_min = input.integer();
+				variable.value_max = input.integer();
+				variables.addVariable(variable);
+			}
+			attack_block.setHandVariableData(std::move(variables));
+
+			std::vector<AttackDataBlock> attacks(input.size());
+			for (auto& attack : attacks)
+			{
+				attack.eventName = input.text();
+				attack.mirrored = input.integer();
+				attack.clips = input.list();
+			}
+			ClipAttacksBlock attack_data;
+			attack_data.setAttackData(std::move(attacks));
+			attack_block.setAttackData(std::move(attack_data));
+
+			std::vector<std::string> crc32(input.size());
+			for (auto& crc : crc32)
+				crc = input.text();
+			ClipFilesCRC32Block crc32_block;
+			crc32_block.setStrings(std::move(crc32));
+			attack_block.setCrc32Data(std::move(crc32_block));
+		}
+		list.setProjectAttackBlocks(std::move(attack_blocks));
+		sets.putProjectAttackBlock(std::string(string(set_table[s].name)), std::move(list));
+	}
+}
+
+// Writing
+
+namespace {
+
+	struct Writer {
+		std::vector<uint32_t> words;
+		//deque, the ids map keys are views of its elements
+		std::deque<std::string> strings;
+		std::unordered_map<std::string_view, uint32_t> ids;
+
+		void word(size_t value) { words.push_back((uint32_t)value); }
+		void integer(int value) { words.push_back((uint32_t)value); }
+
+		uint32_t id(std::string_view value) {
+			auto it = ids.find(value);
+			if (it != ids.end())
+				return it->second;
+			uint32_t next = (uint32_t)strings.size();
+			strings.emplace_back(value);
+			ids.emplace(strings.back(), next);
+			return next;
+		}
+
+		void text(std::string_view value) { words.push_back(id(value)); }
+
+		void list(const std::vector<std::string>& values) {
+			word(values.size());
+			for (const auto& value : values)
+				text(value);
+		}
+	};
+
+	void align(std::string& image)
+	{
+		image.resize((image.size() + 7) & ~(size_t)7, '\0');
+	}
+
+	template<typename T>
+	uint32_t append(std::string& image, const T* items, size_t count)
+	{
+		align(image);
+		uint32_t offset = (uint32_t)image.size();
+		image.append((const char*)items, count * sizeof(T));
+		return offset;
+	}
+}
+
+bool CompiledCache::write(
+	const fs::path& file,
+	AnimDataFile& data,
+	AnimSetDataFile& sets,
+	const Source& data_source,
+	const Source& sets_source)
+{
+	//both lists name one block each in well formed files, anything else stays text only
+	if (data.getProjectList().size() != data.getProjectBlockList().size() ||
+		sets.getProjectsList().size() != sets.getProjectAttackList().size())
+		return false;
+
+	Writer out;
+	std::vector<TableEntry> projects;
+	projects.reserve(data.getProjectBlockList().size());
+	auto& movements = data.getProjectMovementBlockList();
+	for (size_t p = 0; p < data.getProjectBlockList().size(); p++)
+	{
+		ProjectBlock& block = data.getProjectBlock((int)p);
+		projects.push_back({ out.id(data.getProjectList()[(int)p]), (uint32_t)out.words.size() });
+
+		out.word(block.isHasProjectFiles());
+		out.list(block.getProjectFiles().getStrings());
+		out.word(block.isHasAnimationCache());
+		out.word(block.getClips().size());
+		for (auto& clip : block.getClips())
+		{
+			out.text(clip.getName());
+			out.integer(clip.getCacheIndex());
+			out.text(clip.getPlaybackSpeed());
+			out.text(clip.getCropStartTime());
+			out.text(clip.getCropEndTime());
+			out.list(clip.getEvents().getStrings());
+		}
+
+		auto movement = movements.find((int)p);
+		out.word(movement != movements.end());
+		if (movement == movements.end())
+			continue;
+		out.word(movement->second.getMovementData().size());
+		for (auto& clip_movement : movement->second.getMovementData())
+		{
+			out.integer(clip_movement.getCacheIndex());
+			out.text(clip_movement.getDuration());
+			out.list(clip_movement.getTraslations().getStrings());
+			out.list(clip_movement.getRotations().getStrings());
+		}
+	}
+
+	std::vector<TableEntry> set_table;
+	set_table.reserve(sets.getProjectAttackList().size());
+	for (size_t s = 0; s < sets.getProjectAttackList().size(); s++)
+	{
+		ProjectAttackListBlock& list = sets.getProjectAttackBlock((int)s);
+		set_table.push_back({ out.id(sets.getProjectsList()[(int)s]), (uint32_t)out.words.size() });
+
+		out.list(list.getProjectFiles().getStrings());
+		out.word(list.getProjectAttackBlocks().size());
+		for (auto& attack_block : list.getProjectAttackBlocks())
+		{
+			out.text(attack_block.getAnimVersion());
+			out.list(attack_block.getSwapEventsList().getStrings());
+			auto& variables = attack_block.getHandVariableData().getVariables();
+			out.word(variables.size());
+			for (auto& variable : variables)
+			{
+				out.text(variable.variable_name);
+				out.integer(variable.value_min);
+				out.integer(variable.value_max);
+			}
+			auto& attacks = attack_block.getAttackData().getAttackData();
+			out.word(attacks.size());
+			for (auto& attack : attacks)
+			{
+				out.text(attack.eventName);
+				out.integer(attack.mirrored);
+				out.list(attack.clips.getStrings());
+			}
+			out.list(attack_block.getCrc32Data().getStrings());
+		}
+	}
+
+	std::vector<uint32_t> offsets;
+	offsets.reserve(out.strings.size() + 1);
+	std::string blob;
+	for (const auto& value : out.strings)
+	{
+		offsets.push_back((uint32_t)blob.size());
+		blob += value;
+	}
+	offsets.push_back((uint32_t)blob.size());
+
+	std::vector<uint32_t> index(bucket_count(projects.size()), 0);
+	uint32_t mask = (uint32_t)index.size() - 1;
+	for (size_t p = 0; p < projects.size(); p++)
+	{
+		uint32_t probe = key_hash(project_key(out.strings[projects[p].name])) & mask;
+		while (index[probe] != 0)
+			probe = (probe + 1) & mask;
+		index[probe] = (uint32_t)p + 1;
+	}
+
+	Header header{};
+	memcpy(header.magic, compiled_cache_magic, sizeof(compiled_cache_magic));
+	header.version = version;
+	header.byte_order = compiled_cache_byte_order;
+	header.data = data_source;
+	header.sets = sets_source;
+
+	std::string image(sizeof(Header), '\0');
+	header.string_count = (uint32_t)out.strings.size();
+	header.strings_offset = append(image, offsets.data(), offsets.size());
+	header.blob_size = (uint32_t)blob.size();
+	header.blob_offset = append(image, blob.data(), blob.size());
+	header.project_count = (uint32_t)projects.size();
+	header.projects_offset = append(image, projects.data(), projects.size());
+	header.set_count = (uint32_t)set_table.size();
+	header.sets_offset = append(image, set_table.data(), set_table.size());
+	header.index_buckets = (uint32_t)index.size();
+	header.index_offset = append(image, index.data(), index.size());
+	header.word_count = (uint32_t)out.words.size();
+	header.words_offset = append(image, out.words.data(), out.words.size());
+	align(image);
+	header.file_size = image.size();
+	memcpy(&image[0], &header, sizeof(Header));
+
+	//written aside and renamed over, a reader never maps a half written image
+	fs::path temporary = file;
+	temporary += ".tmp";
+	{
+		std::ofstream stream(temporary.string(), std::ios::binary | std::ios::trunc);
+		stream.write(image.data(), image.size());
+		if (!stream.good())
+			return false;
+	}
+	std::error_code error;
+	fs::rename(temporary, file, error);
+	if (error)
+	{
+		fs::remove(temporary, error);
+		return false;
+	}
+	return true;
+}
@@ -5,6 +5,9 @@ See the included LICENSE file
 */
 
 #include <core/FBXWrangler.h>
+#include <core/ThreadPool.h>
+
+#include <mutex>
 
 #include <Physics\Utilities\Collide\ShapeUtils\CreateShape\hkpCreateShapeUtility.h>
 #include <Common\GeometryUtilities\Misc\hkGeometryUtils.h>
@@ -204,8 +207,48 @@ FbxNode* setMatATransform(const FbxAMatrix& av, FbxNode* node) {
 	return node;
 }
 
+static std::mutex managers_mutex;
+static bool keep_managers = false;
+static vector<FbxManager*> kept_managers;
+
+static FbxManager* AcquireManager() {
+	{
+		std::lock_guard<std::mutex> lock(managers_mutex);
+		if (!kept_managers.empty()) {
+			FbxManager* manager = kept_managers.back();
+			kept_managers.pop_back();
+			//settings of the previous owner must not leak into the next conversion
+			if (manager->GetIOSettings())
+				manager->GetIOSettings()->Destroy();
+			return manager;
+		}
+	}
+	return FbxManager::Create();
+}
+
+static void ReleaseManager(FbxManager* manager) {
+	{
+		std::lock_guard<std::mutex> lock(managers_mutex);
+		if (keep_managers) {
+			kept_managers.push_back(manager);
+			return;
+		}
+	}
+	manager->Destroy();
+}
+
+void FBXWrangler::KeepManagers(bool keep) {
+	std::lock_guard<std::mutex> lock(managers_mutex);
+	keep_managers = keep;
+	if (keep)
+		return;
+	for (FbxManager* manager : kept_managers)
+		manager->Destroy();
+	kept_managers.clear();
+}
+
 FBXWrangler::FBXWrangler() {
-	sdkManager = FbxManager::Create();
+	sdkManager = AcquireManager();
 
 	FbxIOSettings* ios = FbxIOSettings::Create(sdkManager, IOSROOT);
 	sdkManager->SetIOSettings(ios);
@@ -218,7 +261,7 @@ FBXWrangler::~FBXWrangler() {
 		CloseScene();
 
 	if (sdkManager)
-		sdkManager->Destroy();
+		ReleaseManager(sdkManager);
 }
 
 void FBXWrangler::NewScene() {
@@ -4279,6 +4322,140 @@ set<float> convert_rigid_animation(NiTransformInterpolatorRef interpolator, FbxA
 }
 
 
+static inline void key_values(const float& value, float* out)
+{
+	out[0] = value;
+}
+
+static inline void key_values(const Vector3& value, float* out)
+{
+	out[0] = value.x; out[1] = value.y; out[2] = value.z;
+}
+
+static inline float key_tangent(const float* slope, float length, float*)
+{
+	return slope[0] * length;
+}
+
+static inline Vector3 key_tangent(const float* slope, float length, Vector3*)
+{
+	return Vector3(slope[0] * length, slope[1] * length, slope[2] * length);
+}
+
+//drops the keys of a linear or quadratic group the fit reproduces within the tolerance,
+//spline fits become quadratic keys with the tangents of the source slopes
+template<typename T>
+static float reduce_keys(KeyGroup<T>& group, int width, float tolerance, ckcmd::KeyReduction::Fit fit, ckcmd::KeyReport& report)
+{
+	int count = (int)group.keys.size();
+	report.keys += count;
+	if (count < 3 || (group.interpolation != LINEAR_KEY && group.interpolation != QUADRATIC_KEY))
+	{
+		report.kept += count;
+		return 0.0f;
+	}
+
+	vector<float> times(count);
+	vector<float> values(count * width);
+	for (int i = 0; i < count; i++)
+	{
+		times[i] = group.keys[i].time;
+		key_values(group.keys[i].data, &values[i * width]);
+	}
+	ckcmd::KeyReducer reducer(times.data(), values.data(), count, width);
+	float error;
+	vector<int> kept = reducer.reduce(fit, tolerance, error);
+
+	vector<Key<T>> keys;
+	keys.reserve(kept.size());
+	for (size_t k = 0; k < kept.size(); k++)
+	{
+		int i = kept[k];
+		Key<T> key = group.keys[i];
+		if (fit == ckcmd::KeyReduction::spline)
+		{
+			//backward is the outgoing tangent, forward the incoming one, as AdjustBezier sets them
+			float before = k > 0 ? times[i] - times[kept[k - 1]] : 0.0f;
+			float after = k + 1 < kept.size() ? times[kept[k + 1]] - times[i] : 0.0f;
+			key.forward_tangent = key_tangent(reducer.slope(i), before, (T*)NULL);
+			key.backward_tangent = key_tangent(reducer.slope(i), after, (T*)NULL);
+		}
+		keys.push_back(key);
+	}
+	group.interpolation = fit == ckcmd::KeyReduction::spline ? QUADRATIC_KEY : LINEAR_KEY;
+	group.numKeys = keys.size();
+	group.keys = keys;
+	report.kept += keys.size();
+	return error;
+}
+
+static ckcmd::KeyReport reduce_keys(NiTransformData& data, const ckcmd::KeyReduction& reduction)
+{
+	ckcmd::KeyReport report;
+
+	KeyGroup<Vector3> translations = data.GetTranslations();
+	report.position = reduce_keys(translations, 3, reduction.position, reduction.fit, report);
+	data.SetTranslations(translations);
+
+	//quaternion keys are left as they are, the importer writes euler angles.
+	//The angle between two rotations never exceeds the sum of the errors of the
+	//axes composing them, whatever their order: each axis gets a third of the
+	//tolerance and the sum is what the whole rotation may be off by
+	if (data.GetRotationType() == XYZ_ROTATION_KEY)
+	{
+		Niflib::array<3, KeyGroup<float > > rotations = data.GetXyzRotations();
+		float angle = 0.0f;
+		for (int i = 0; i < 3; i++)
+			angle += reduce_keys(rotations[i], 1, reduction.angle / 3.0f, reduction.fit, report);
+		report.angle = std::max(report.angle, angle);
+		data.SetXyzRotations(rotations);
+	}
+
+	KeyGroup<float> scales = data.GetScales();
+	report.scale = reduce_keys(scales, 1, reduction.scale, reduction.fit, report);
+	data.SetScales(scales);
+
+	return report;
+}
+
+//reduces the keys of every transform data in the sequences, one block per task
+static void reduce_sequences(const vector<NiControllerSequenceRef>& sequences, const ckcmd::KeyReduction& reduction)
+{
+	//Refs are not thread safe, the workers only get plain pointers
+	vector<NiTransformData*> datas;
+	for (const auto& sequence : sequences)
+	{
+		for (const ControlledBlock& block : sequence->GetControlledBlocks())
+		{
+			NiTransformInterpolatorRef interpolator = DynamicCast<NiTransformInterpolator>(block.interpolator);
+			if (interpolator != NULL && interpolator->GetData() != NULL)
+				datas.push_back(&*interpolator->GetData());
+		}
+	}
+	sort(datas.begin(), datas.end());
+	datas.erase(unique(datas.begin(), datas.end()), datas.end());
+
+	//inside a pool worker, i.e. a batch job, the channels are reduced on the calling thread
+	vector<ckcmd::KeyReport> reports(datas.size());
+	if (ckcmd::ThreadPool::on_worker())
+	{
+		for (size_t i = 0; i < datas.size(); i++)
+			reports[i] = reduce_keys(*datas[i], reduction);
+	}
+	else
+	{
+		ckcmd::ThreadPool pool;
+		pool.parallel_for(datas.size(), [&](size_t i) {
+			reports[i] = reduce_keys(*datas[i], reduction);
+		});
+	}
+
+	ckcmd::KeyReport total;
+	for (const auto& report : reports)
+		total.add(report);
+	total.log("Key reduction");
+}
+
 //build embedded KF animations, for anything unskinned
 void FBXWrangler::buildKF() {
 	//create a controller manager
@@ -4303,6 +4480,9 @@ void FBXWrangler::buildKF() {
 		sequences.push_back(sequence);
 	}
 
+	if (key_reduction.fit != KeyReduction::none)
+		reduce_sequences(sequences, key_reduction);
+
 	//Reset stack
 	scene->SetCurrentAnimationStack(scene->GetSrcObject<FbxAnimStack>(0));
 
@@ -1431,7 +1431,7 @@ FindFbxTextures(
     }
 }
 
-bool LoadFBXFile(RawModel &raw, const char *fbxFileName, const char *textureExtensions)
+bool LoadFBXFile(RawModel &raw, const char *fbxFileName, const char *textureExtensions, const float weldTolerance)
 {
     FbxManager    *pManager    = FbxManager::Create();
     FbxIOSettings *pIoSettings = FbxIOSettings::Create(pManager, IOSROOT);
@@ -1476,6 +1476,10 @@ bool LoadFBXFile(RawModel &raw, const char *fbxFileName, const char *textureExte
     // this is always 0.01, but let's opt for clarity.
     scaleFactor = FbxSystemUnit::m.GetConversionFactorFrom(FbxSystemUnit::cm);
 
+    if (weldTolerance > 0.0f) {
+        raw.SetWeldTolerance(weldTolerance);
+    }
+
     ReadNodeHierarchy(raw, pScene, pScene->GetRootNode(), 0, "");
     ReadNodeAttributes(raw, pScene, pScene->GetRootNode(), textureLocations);
     ReadAnimations(raw, pScene);
@@ -0,0 +1,61 @@
+#include <core/FileBatch.h>
+#include <core/ThreadPool.h>
+#include <core/log.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <set>
+
+using namespace ckcmd;
+
+size_t FileBatch::add(const fs::path& path)
+{
+	return add(path, std::string());
+}
+
+size_t FileBatch::add(const fs::path& path, std::string content)
+{
+	files.push_back({ path, std::move(content) });
+	return files.size() - 1;
+}
+
+size_t FileBatch::bytes() const
+{
+	size_t total = 0;
+	for (const auto& file : files)
+		total += file.content.size();
+	return total;
+}
+
+bool FileBatch::write(size_t threads)
+{
+	std::set<fs::path> directories;
+	for (const auto& file : files)
+	{
+		if (file.path.has_parent_path())
+			directories.insert(file.path.parent_path());
+	}
+	for (const auto& directory : directories)
+	{
+		std::error_code error;
+		fs::create_directories(directory, error);
+		if (error)
+			Log::Error("Unable to create %s: %s", directory.string().c_str(), error.message().c_str());
+	}
+
+	std::atomic<bool> failed(false);
+	ThreadPool pool(std::min(threads > 0 ? threads : ThreadPool::default_threads(), std::max<size_t>(files.size(), 1)));
+	pool.parallel_for(files.size(), [&](size_t i) {
+		const File& file = files[i];
+		std::ofstream out(file.path);
+		out.write(file.content.data(), file.content.size());
+		out.close();
+		if (out.fail())
+		{
+			Log::Error("Unable to write %s", file.path.string().c_str());
+			failed = true;
+		}
+	});
+	return !failed;
+}
@@ -90,6 +90,8 @@
 
 #include <core/EulerAngles.h>
 #include <core/MathHelper.h>
+#include <core/HavokSession.h>
+#include <core/ThreadPool.h>
 
 #include <algorithm>
 
@@ -944,6 +946,66 @@ bool annotation_sorter(hkaAnnotationTrack::Annotation const& lhs, hkaAnnotationT
 	return lhs.m_time < rhs.m_time;
 }
 
+//largest error a compressed animation leaves on the frames of its source, frames are
+//compared on all the cores
+static ckcmd::KeyReport compression_error(const hkaInterleavedUncompressedAnimation& source, const hkaAnimation& compressed)
+{
+	ckcmd::KeyReport report;
+	int ntracks = source.m_numberOfTransformTracks;
+	int nfloats = compressed.m_numberOfFloatTracks;
+	int frames = ntracks > 0 ? source.m_transforms.getSize() / ntracks : 0;
+	if (frames == 0)
+		return report;
+
+	//scratch buffers are taken here, the workers do not allocate. Inside a pool
+	//worker, i.e. a batch job, the frames are compared on the calling thread alone
+	size_t threads = ckcmd::ThreadPool::on_worker() ? 1 : ckcmd::ThreadPool::default_threads();
+	size_t tasks = std::min<size_t>(threads, frames);
+	vector<ckcmd::KeyReport> reports(tasks);
+	hkArray<hkQsTransform> scratch;
+	scratch.setSize((int)tasks * ntracks, hkQsTransform::getIdentity());
+	hkArray<hkReal> floatScratch;
+	floatScratch.setSize((int)tasks * nfloats + 1, 0.0f);
+
+	auto compare = [&](size_t task) {
+		ckcmd::HavokSession::Scope havok;
+		ckcmd::KeyReport& out = reports[task];
+		hkQsTransform* tracks = scratch.begin() + task * ntracks;
+		for (int frame = (int)(frames * task / tasks); frame < (int)(frames * (task + 1) / tasks); frame++)
+		{
+			hkReal time = frames > 1 ? source.m_duration * frame / (frames - 1) : 0.0f;
+			compressed.sampleTracks(time, tracks, floatScratch.begin() + task * nfloats, HK_NULL);
+			hkaSkeletonUtils::normalizeRotations(tracks, ntracks);
+			const hkQsTransform* expected = source.m_transforms.begin() + frame * ntracks;
+			for (int i = 0; i < ntracks; i++)
+			{
+				float distance = 0.0f, dot = 0.0f;
+				for (int c = 0; c < 3; c++)
+				{
+					float d = (float)tracks[i].m_translation.getSimdAt(c) - (float)expected[i].m_translation.getSimdAt(c);
+					distance += d * d;
+					out.scale = std::max(out.scale, fabsf((float)tracks[i].m_scale.getSimdAt(c) - (float)expected[i].m_scale.getSimdAt(c)));
+				}
+				for (int c = 0; c < 4; c++)
+					dot += (float)tracks[i].m_rotation.m_vec.getSimdAt(c) * (float)expected[i].m_rotation.m_vec.getSimdAt(c);
+				out.position = std::max(out.position, sqrtf(distance));
+				out.angle = std::max(out.angle, 2.0f * acosf(std::min(fabsf(dot), 1.0f)));
+			}
+		}
+	};
+	if (tasks <= 1)
+		compare(0);
+	else
+	{
+		ckcmd::ThreadPool pool(tasks);
+		pool.parallel_for(tasks, compare);
+	}
+
+	for (const auto& r : reports)
+		report.add(r);
+	return report;
+}
+
 set<string> HKXWrapper::create_animations(
 	const string& skeleton_name,
 	vector<FbxNode*>& skeleton,
@@ -1265,19 +1327,32 @@ set<string> HKXWrapper::create_animations(
 
 		hkaSkeletonUtils::normalizeRotations(tempAnim->m_transforms.begin(), tempAnim->m_transforms.getSize());
 
-		// create the animation with default settings
+		// create the animation, spline compressed within the reduction tolerances if any
 		{
-			hkaSplineCompressedAnimation::TrackCompressionParams tparams;
-			hkaSplineCompressedAnimation::AnimationCompressionParams aparams;
-
-			tparams.m_rotationTolerance = 0.001f;
-			tparams.m_rotationQuantizationType = hkaSplineCompressedAnimation::TrackCompressionParams::THREECOMP40;
-
-			auto outAnim = new hkaSplineCompressedAnimation(*tempAnim.val(), tparams, aparams);
-			//DataChunk* dataChunks; int m_numDataChunks
-			//outAnim->getDataChunks(0, 0., dataChunks, m_numDataChunks);
-
 			binding->m_animation = tempAnim;
+			if (key_reduction.fit != KeyReduction::none)
+			{
+				hkaSplineCompressedAnimation::TrackCompressionParams tparams;
+				hkaSplineCompressedAnimation::AnimationCompressionParams aparams;
+
+				int degree = key_reduction.fit == KeyReduction::linear ? 1 : 3;
+				tparams.m_translationTolerance = key_reduction.position;
+				//quaternions move by about half the angle they rotate by
+				tparams.m_rotationTolerance = key_reduction.angle * 0.5f;
+				tparams.m_scaleTolerance = key_reduction.scale;
+				tparams.m_translationDegree = degree;
+				tparams.m_rotationDegree = degree;
+				tparams.m_scaleDegree = degree;
+				tparams.m_rotationQuantizationType = hkaSplineCompressedAnimation::TrackCompressionParams::THREECOMP40;
+
+				hkRefPtr<hkaSplineCompressedAnimation> outAnim = new hkaSplineCompressedAnimation(*tempAnim.val(), tparams, aparams);
+				KeyReport report = compression_error(*tempAnim.val(), *outAnim.val());
+				size_t uncompressed = tempAnim->m_transforms.getSize() * sizeof(hkQsTransform) + tempAnim->m_floats.getSize() * sizeof(hkReal);
+				Log::Info("Animation %s compressed from %zu to %d bytes", stack->GetName(), uncompressed, outAnim->m_data.getSize());
+				report.log(string("Animation ") + stack->GetName());
+
+				binding->m_animation = outAnim;
+			}
 			binding->m_originalSkeletonName = skeleton_name.c_str();
 
 			anim_container->m_bindings.pushBack(binding);
@@ -3698,7 +3773,7 @@ int HKXWrapper::setExternalSkeletonPose(FbxNode* rb_node) {
 
 string HKXWrapperCollection::wrap(const string& out_name, const string& out_path, const string& out_path_root, const string& prefix, const set<string>& sequences_names)
 {
-
+	std::lock_guard<std::mutex> lock(wrappers_mutex);
 	if (wrappers.find(sequences_names) == wrappers.end()) {
 		wrappers[sequences_names] = move(HKXWrapper(out_name, out_path, out_path_root, prefix, sequences_names));
 	}
@@ -3711,6 +3786,7 @@ string HKXWrapperCollection::wrap(const string& out_name,
 	const string& prefix, const
 	HKXWrapper::DefaultBehaviors& behavior_type)
 {
+	std::lock_guard<std::mutex> lock(wrappers_mutex);
 	if (wrappers.find({ to_string(behavior_type) }) == wrappers.end()) {
 		wrappers[{ to_string(behavior_type) }] = move(HKXWrapper(out_name, out_path, out_path_root, prefix, behavior_type));
 	}
@@ -3741,26 +3817,6 @@ struct filename_compare : public std::unary_function<std::string, bool>
 	const fs::path &baseline;
 };
 
-struct cache_block_compare : public std::unary_function<std::string, bool>
-{
-	explicit cache_block_compare(const string& name) : name(name) {}
-	bool operator() (const AnimData::ClipGeneratorBlock &arg)
-	{
-		return name == arg.getName();
-	}
-	const string& name;
-};
-
-struct cache_movement_compare : public std::unary_function<std::string, bool>
-{
-	explicit cache_movement_compare(int index) : index(index) {}
-	bool operator() (const AnimData::ClipMovementData &arg)
-	{
-		return index == arg.getCacheIndex();
-	}
-	int index;
-};
-
 vector<float> RootMovement::getData(string data) {
 	vector<float> out;
 	istringstream ss(data);
@@ -3800,6 +3856,32 @@ RootMovement::RootMovement(
 			::hkQuaternion(values[1],values[2],values[3], values[4]) }
 		);
 	}
+	addEvents(in_events);
+}
+
+RootMovement::RootMovement(
+	const AnimData::root_movement_t& movement,
+	const std::vector<std::string>& in_events)
+{
+	duration = movement.duration;
+
+	translations.reserve(movement.translationCount());
+	for (size_t i = 0; i < movement.translationCount(); i++)
+	{
+		const float* key = movement.translation(i);
+		translations.push_back({ key[0], hkVector4(key[1], key[2], key[3]) });
+	}
+	rotations.reserve(movement.rotationCount());
+	for (size_t i = 0; i < movement.rotationCount(); i++)
+	{
+		const float* key = movement.rotation(i);
+		rotations.push_back({ key[0], ::hkQuaternion(key[1], key[2], key[3], key[4]) });
+	}
+	addEvents(in_events);
+}
+
+void RootMovement::addEvents(const std::vector<std::string>& in_events)
+{
 	for (const auto& event : in_events)
 	{
 		int index = event.find(':');
@@ -3866,8 +3948,6 @@ void HKXWrapper::PutClipMovement(
 	const RootMovement& root_info
 ) {
 	vector<fs::path> behavior_files;
-	auto& cache_clips = entry.block.getClips();
-	auto& cache_movements = entry.movements.getMovementData();
 	find_files(behaviorFolder, ".hkx", behavior_files);
 	for (const auto& behavior_file : behavior_files)
 	{
@@ -3887,15 +3967,15 @@ void HKXWrapper::PutClipMovement(
 				{
 					Log::Info("Found Clip Generator %s", clip->m_name);
 					string clip_generator_name = clip->m_name;
-					auto cache_block_it = find_if(cache_clips.begin(), cache_clips.end(), cache_block_compare(clip_generator_name));
-					if (cache_block_it == cache_clips.end())
+					auto cache_block_it = entry.findClip(clip_generator_name);
+					if (cache_block_it == nullptr)
 					{
 						Log::Error("Cannot find %s into project cache", clip->m_name);
 						continue;
 					}
 					size_t index = cache_block_it->getCacheIndex();
-					auto movements_block_it = find_if(cache_movements.begin(), cache_movements.end(), cache_movement_compare(index));
-					if (movements_block_it == cache_movements.end())
+					auto movements_block_it = entry.findMovementData(index);
+					if (movements_block_it == nullptr)
 					{
 						Log::Error("Cannot find %s movements of index %d into project cache", clip->m_name, index);
 						continue;
@@ -3922,9 +4002,6 @@ void HKXWrapper::PutClipMovement(
 					movements_block_it->setDuration(to_string(root_info.duration));
 					movements_block_it->setTraslations(root_info.getClipTranslations());
 					movements_block_it->setRotations(root_info.getClipRotations());
-					
-					entry.block.setClips(cache_clips);
-					entry.movements.setMovementData(cache_movements);
 				}
 			}
 		}
@@ -3939,8 +4016,6 @@ void HKXWrapper::GetStaticClipsMovements(
 	std::map< fs::path, RootMovement>& map
 ) {
 	vector<fs::path> behavior_files;
-	auto& cache_clips = entry.block.getClips();
-	auto& cache_movements = entry.movements.getMovementData();
 	find_files(behaviorFolder, ".hkx", behavior_files);
 	for (const auto& behavior_file : behavior_files)
 	{
@@ -3960,23 +4035,21 @@ void HKXWrapper::GetStaticClipsMovements(
 				{
 					Log::Info("Found Clip Generator %s", clip->m_name);
 					string clip_generator_name = clip->m_name;
-					auto cache_block_it = find_if(cache_clips.begin(), cache_clips.end(), cache_block_compare(clip_generator_name));
-					if (cache_block_it == cache_clips.end())
+					auto cache_block_it = entry.findClip(clip_generator_name);
+					if (cache_block_it == nullptr)
 					{
 						Log::Error("Cannot find %s into project cache", clip->m_name);
 						continue;
 					}
 					size_t index = cache_block_it->getCacheIndex();
-					auto movements_block_it = find_if(cache_movements.begin(), cache_movements.end(), cache_movement_compare(index));
-					if (movements_block_it == cache_movements.end())
+					auto movements_block_it = entry.findMovementData(index);
+					if (movements_block_it == nullptr)
 					{
 						Log::Error("Cannot find %s movements of index %d into project cache", clip->m_name, index);
 						continue;
 					}
 					map[*it] = RootMovement(
-						std::atof(movements_block_it->getDuration().c_str()),
-						movements_block_it->getTraslations().getStrings(),
-						movements_block_it->getRotations().getStrings(),
+						movements_block_it->getMovement(),
 						cache_block_it->getEvents().getStrings()
 					);
 				}
@@ -4005,8 +4078,6 @@ void HKXWrapper::GetClipsMovements(
 	std::map< fs::path, RootMovement>& map
 ) {
 	vector<fs::path> behavior_files;
-	auto& cache_clips = entry.block.getClips();
-	auto& cache_movements = entry.movements.getMovementData();
 	find_files(behaviorFolder, ".hkx", behavior_files);
 	for (const auto& behavior_file : behavior_files)
 	{
@@ -4026,23 +4097,21 @@ void HKXWrapper::GetClipsMovements(
 				{
 					Log::Info("Found Clip Generator %s", clip->m_name);
 					string clip_generator_name = clip->m_name;
-					auto cache_block_it = find_if(cache_clips.begin(), cache_clips.end(), cache_block_compare(clip_generator_name));
-					if (cache_block_it == cache_clips.end())
+					auto cache_block_it = entry.findClip(clip_generator_name);
+					if (cache_block_it == nullptr)
 					{
 						Log::Error("Cannot find %s into project cache", clip->m_name);
 						continue;
 					}
 					size_t index = cache_block_it->getCacheIndex();
-					auto movements_block_it = find_if(cache_movements.begin(), cache_movements.end(), cache_movement_compare(index));
-					if (movements_block_it == cache_movements.end())
+					auto movements_block_it = entry.findMovementData(index);
+					if (movements_block_it == nullptr)
 					{
 						Log::Error("Cannot find %s movements of index %d into project cache", clip->m_name, index);
 						continue;
 					}
 					map[*it] = RootMovement(
-						std::atof(movements_block_it->getDuration().c_str()),
-						movements_block_it->getTraslations().getStrings(),
-						movements_block_it->getRotations().getStrings(),
+						movements_block_it->getMovement(),
 						cache_block_it->getEvents().getStrings()
 					);
 				}
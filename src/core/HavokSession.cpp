@@ -0,0 +1,60 @@
+#include <core/HavokSession.h>
+#include <core/hkfutils.h>
+#include <core/log.h>
+
+#include <mutex>
+#include <thread>
+
+using namespace ckcmd;
+
+static std::mutex session_mutex;
+static size_t session_users = 0;
+static std::thread::id session_owner;
+
+static thread_local size_t thread_users = 0;
+static thread_local hkMemoryRouter* thread_router = nullptr;
+
+void HavokSession::acquire()
+{
+	std::lock_guard<std::mutex> lock(session_mutex);
+	if (session_users == 0)
+	{
+		// Initialize the base system including our memory system
+		hkMemoryRouter* pMemoryRouter(hkMemoryInitUtil::initDefault(hkMallocAllocator::m_defaultMallocAllocator, hkMemorySystem::FrameInfo(5000000)));
+		hkBaseSystem::init(pMemoryRouter, errorReport);
+		LoadDefaultRegistry();
+		session_owner = std::this_thread::get_id();
+	}
+	else if (thread_users == 0 && std::this_thread::get_id() != session_owner)
+	{
+		thread_router = new hkMemoryRouter();
+		hkMemorySystem::getInstance().threadInit(*thread_router, "HavokSession");
+		hkBaseSystem::initThread(thread_router);
+	}
+	session_users++;
+	thread_users++;
+}
+
+void HavokSession::release()
+{
+	std::lock_guard<std::mutex> lock(session_mutex);
+	if (thread_users == 0)
+	{
+		Log::Error("HavokSession: release without a matching acquire");
+		return;
+	}
+	session_users--;
+	thread_users--;
+	if (thread_users == 0 && thread_router != nullptr)
+	{
+		hkBaseSystem::quitThread();
+		hkMemorySystem::getInstance().threadQuit(*thread_router);
+		delete thread_router;
+		thread_router = nullptr;
+	}
+	if (session_users == 0)
+	{
+		hkBaseSystem::quit();
+		hkMemoryInitUtil::quit();
+	}
+}
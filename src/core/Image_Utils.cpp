@@ -7,7 +7,19 @@
  * of patent rights can be found in the PATENTS file in the same directory.
  */
 
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
 #include <string>
+#include <unordered_map>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#define IMAGE_UTILS_SSE2
+#endif
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <core/stb_image.h>
@@ -16,28 +28,154 @@
 
 #include <core/Image_Utils.h>
 
-static bool imageHasTransparentPixels(FILE *f) {
-    int width, height, channels;
-    // RGBA: we have to load the pixels to figure out if the image is fully opaque
-    uint8_t *pixels = stbi_load_from_file(f, &width, &height, &channels, 0);
-    if (pixels != nullptr) {
-        int pixelCount = width * height;
-        for (int ix = 0; ix < pixelCount; ix ++) {
-            // test fourth ::byte (alpha); 255 is 1.0
-            if (pixels[4*ix + 3] != 255) {
-                return true;
+#if _MSC_VER < 1920
+namespace fs = std::experimental::filesystem;
+#else
+namespace fs = std::filesystem;
+#endif
+
+static const char *imageCacheMagic = "ckcmd-images 1";
+
+static inline uint32_t ReadU32(const uint8_t *bytes)
+{
+    return (uint32_t) bytes[0] | ((uint32_t) bytes[1] << 8) | ((uint32_t) bytes[2] << 16) | ((uint32_t) bytes[3] << 24);
+}
+
+static constexpr uint32_t MakeFourCC(char a, char b, char c, char d)
+{
+    return (uint32_t) (uint8_t) a | ((uint32_t) (uint8_t) b << 8) | ((uint32_t) (uint8_t) c << 16) | ((uint32_t) (uint8_t) d << 24);
+}
+
+// Channels and alpha of a DX10 header DXGI format, for the formats textures actually use.
+static void DxgiFormatProperties(const uint32_t format, ImageProperties &result)
+{
+    switch (format) {
+        case 27: case 28: case 29:          // R8G8B8A8
+        case 87: case 90: case 91:          // B8G8R8A8
+        case 73: case 74: case 75:          // BC2
+        case 76: case 77: case 78:          // BC3
+        case 97: case 98: case 99:          // BC7
+            result.channels = 4;
+            result.hasAlpha = true;
+            break;
+        case 70: case 71: case 72:          // BC1
+        case 88: case 92: case 93:          // B8G8R8X8
+        case 94: case 95: case 96:          // BC6H
+            result.channels = 3;
+            break;
+        case 82: case 83: case 84:          // BC5
+            result.channels = 2;
+            break;
+        case 61: case 62: case 79: case 80: case 81: // R8, BC4
+            result.channels = 1;
+            break;
+        default:
+            result.channels = 4;
+            break;
+    }
+}
+
+// DDS files carry everything but the decoded alpha in the 128 byte header (148 with the DX10 extension).
+bool GetDdsProperties(const uint8_t *header, const size_t read, ImageProperties &result)
+{
+    if (read < 128 || ReadU32(header) != MakeFourCC('D', 'D', 'S', ' ') || ReadU32(header + 4) != 124) {
+        return false;
+    }
+
+    const uint32_t DDPF_ALPHAPIXELS = 0x1;
+    const uint32_t DDPF_FOURCC      = 0x4;
+    const uint32_t DDPF_RGB         = 0x40;
+    const uint32_t DDPF_LUMINANCE   = 0x20000;
+
+    result.height    = (int) ReadU32(header + 12);
+    result.width     = (int) ReadU32(header + 16);
+    result.mipLevels = (int) ReadU32(header + 28);
+
+    const uint32_t flags = ReadU32(header + 80);
+    const uint32_t alphaMask = ReadU32(header + 104);
+    if (flags & DDPF_FOURCC) {
+        const uint32_t fourCC = ReadU32(header + 84);
+        result.fourCC = fourCC;
+        if (fourCC == MakeFourCC('D', 'X', '1', '0')) {
+            if (read < 148) {
+                return false;
             }
+            result.fourCC = ReadU32(header + 128);
+            DxgiFormatProperties(result.fourCC, result);
+        } else if (fourCC == MakeFourCC('D', 'X', 'T', '1')) {
+            result.channels = 3;
+        } else if (fourCC == MakeFourCC('D', 'X', 'T', '2') || fourCC == MakeFourCC('D', 'X', 'T', '3') ||
+                   fourCC == MakeFourCC('D', 'X', 'T', '4') || fourCC == MakeFourCC('D', 'X', 'T', '5')) {
+            result.channels = 4;
+            result.hasAlpha = true;
+        } else if (fourCC == MakeFourCC('A', 'T', 'I', '2') || fourCC == MakeFourCC('B', 'C', '5', 'U')) {
+            result.channels = 2;
+        } else if (fourCC == MakeFourCC('A', 'T', 'I', '1') || fourCC == MakeFourCC('B', 'C', '4', 'U')) {
+            result.channels = 1;
+        } else {
+            result.channels = 4;
+        }
+    } else {
+        result.hasAlpha = (flags & DDPF_ALPHAPIXELS) != 0 && alphaMask != 0;
+        result.channels = ((flags & DDPF_LUMINANCE) && !(flags & DDPF_RGB) ? 1 : 3) + (result.hasAlpha ? 1 : 0);
+    }
+    return true;
+}
+
+static bool ReadDdsHeader(FILE *f, ImageProperties &result)
+{
+    uint8_t header[148];
+    const size_t read = fread(header, 1, sizeof(header), f);
+    return GetDdsProperties(header, read, result);
+}
+
+static bool hasTransparentPixels(const uint8_t *pixels, const size_t pixelCount)
+{
+    size_t ix = 0;
+#ifdef IMAGE_UTILS_SSE2
+    // 16 RGBA pixels per step: their alpha bytes are all 255 only if they are in the AND of the four vectors
+    const __m128i opaque = _mm_set1_epi32((int) 0xFF000000);
+    for (; ix + 16 <= pixelCount; ix += 16) {
+        const __m128i *block = (const __m128i *) (pixels + 4 * ix);
+        const __m128i all = _mm_and_si128(
+            _mm_and_si128(_mm_loadu_si128(block), _mm_loadu_si128(block + 1)),
+            _mm_and_si128(_mm_loadu_si128(block + 2), _mm_loadu_si128(block + 3)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(all, opaque), opaque)) != 0xFFFF) {
+            return true;
+        }
+    }
+#endif
+    for (; ix < pixelCount; ix++) {
+        // test fourth ::byte (alpha); 255 is 1.0
+        if (pixels[4 * ix + 3] != 255) {
+            return true;
         }
     }
     return false;
 }
 
-ImageProperties GetImageProperties(char const *filePath)
+static bool imageHasTransparentPixels(FILE *f) {
+    int width, height, channels;
+    // RGBA: we have to load the pixels to figure out if the image is fully opaque
+    uint8_t *pixels = stbi_load_from_file(f, &width, &height, &channels, 4);
+    if (pixels == nullptr) {
+        return false;
+    }
+    const bool transparent = hasTransparentPixels(pixels, (size_t) width * (size_t) height);
+    stbi_image_free(pixels);
+    return transparent;
+}
+
+static ImageProperties ReadImageProperties(char const *filePath)
 {
     ImageProperties result = {
         1,
         1,
         IMAGE_OPAQUE,
+        0,
+        0,
+        0,
+        false,
     };
 
     FILE *f = fopen(filePath, "rb");
@@ -45,12 +183,168 @@ ImageProperties GetImageProperties(char const *filePath)
         return result;
     }
 
-    int channels;
-    int success = stbi_info_from_file(f, &result.width, &result.height, &channels);
-
-    if (success && channels == 4 && imageHasTransparentPixels(f)) {
-        result.occlusion = IMAGE_TRANSPARENT;
+    if (!ReadDdsHeader(f, result)) {
+        fseek(f, 0, SEEK_SET);
+        int channels;
+        int success = stbi_info_from_file(f, &result.width, &result.height, &channels);
+        if (success) {
+            result.channels = channels;
+            result.hasAlpha = channels == 2 || channels == 4;
+        }
+        if (success && channels == 4 && imageHasTransparentPixels(f)) {
+            result.occlusion = IMAGE_TRANSPARENT;
+        }
     }
+    fclose(f);
     return result;
 }
 
+namespace {
+
+struct CachedImage
+{
+    uint64_t        size;
+    int64_t         mtime;
+    ImageProperties properties;
+};
+
+// Entries are appended as they are found, a later line for the same path replaces an earlier one.
+// Line: size mtime width height occlusion channels mipLevels fourCC hasAlpha path
+struct ImageCache
+{
+    std::mutex                                   mutex;
+    bool                                         configured = false;
+    bool                                         loaded     = false;
+    fs::path                                     file;
+    std::unordered_map<std::string, CachedImage> entries;
+
+    void Load()
+    {
+        loaded = true;
+        if (!configured) {
+            std::error_code ec;
+            fs::path temp = fs::temp_directory_path(ec);
+            if (!ec) {
+                file = temp / "ck-cmd" / "images.cache";
+            }
+            configured = true;
+        }
+        if (file.empty()) {
+            return;
+        }
+
+        std::ifstream in(file.string());
+        std::string line;
+        if (!in.is_open() || !std::getline(in, line) || line != imageCacheMagic) {
+            Rewrite();
+            return;
+        }
+        size_t lines = 0;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            CachedImage entry;
+            int occlusion = 0, hasAlpha = 0;
+            std::string path;
+            ImageProperties &properties = entry.properties;
+            if (!(fields >> entry.size >> entry.mtime >> properties.width >> properties.height >> occlusion >>
+                  properties.channels >> properties.mipLevels >> properties.fourCC >> hasAlpha) ||
+                !std::getline(fields >> std::ws, path)) {
+                continue;
+            }
+            properties.occlusion = occlusion ? IMAGE_TRANSPARENT : IMAGE_OPAQUE;
+            properties.hasAlpha  = hasAlpha != 0;
+            entries[path] = entry;
+            lines++;
+        }
+        in.close();
+        // textures edited over and over leave stale lines behind
+        if (lines > 2 * entries.size() + 256) {
+            Rewrite();
+        }
+    }
+
+    static void WriteEntry(std::ostream &out, const std::string &path, const CachedImage &entry)
+    {
+        const ImageProperties &properties = entry.properties;
+        out << entry.size << ' ' << entry.mtime << ' ' << properties.width << ' ' << properties.height << ' '
+            << (properties.occlusion == IMAGE_TRANSPARENT ? 1 : 0) << ' ' << properties.channels << ' '
+            << properties.mipLevels << ' ' << properties.fourCC << ' ' << (properties.hasAlpha ? 1 : 0) << ' '
+            << path << '\n';
+    }
+
+    void Rewrite()
+    {
+        std::error_code ec;
+        if (file.has_parent_path()) {
+            fs::create_directories(file.parent_path(), ec);
+        }
+        std::ofstream out(file.string(), std::ios::trunc);
+        if (!out.is_open()) {
+            file.clear();
+            return;
+        }
+        out << imageCacheMagic << '\n';
+        for (const auto &entry : entries) {
+            WriteEntry(out, entry.first, entry.second);
+        }
+    }
+
+    void Append(const std::string &path, const CachedImage &entry)
+    {
+        if (file.empty()) {
+            return;
+        }
+        std::ofstream out(file.string(), std::ios::app);
+        if (out.is_open()) {
+            WriteEntry(out, path, entry);
+        }
+    }
+};
+
+ImageCache imageCache;
+
+}
+
+void SetImagePropertiesCache(const std::string &cacheFile)
+{
+    std::lock_guard<std::mutex> lock(imageCache.mutex);
+    imageCache.configured = true;
+    imageCache.loaded     = false;
+    imageCache.file       = cacheFile;
+    imageCache.entries.clear();
+}
+
+ImageProperties GetImageProperties(char const *filePath)
+{
+    std::error_code ec;
+    fs::path path(filePath);
+    if (!path.is_absolute()) {
+        path = fs::current_path(ec) / path;
+    }
+    CachedImage entry;
+    entry.size = fs::file_size(path, ec);
+    if (ec) {
+        return ReadImageProperties(filePath);
+    }
+    const auto time = fs::last_write_time(path, ec);
+    entry.mtime = ec ? 0 : (int64_t) time.time_since_epoch().count();
+
+    const std::string key = path.string();
+    {
+        std::lock_guard<std::mutex> lock(imageCache.mutex);
+        if (!imageCache.loaded) {
+            imageCache.Load();
+        }
+        auto found = imageCache.entries.find(key);
+        if (found != imageCache.entries.end() && found->second.size == entry.size && found->second.mtime == entry.mtime) {
+            return found->second.properties;
+        }
+    }
+
+    entry.properties = ReadImageProperties(filePath);
+
+    std::lock_guard<std::mutex> lock(imageCache.mutex);
+    imageCache.entries[key] = entry;
+    imageCache.Append(key, entry);
+    return entry.properties;
+}
@@ -0,0 +1,169 @@
+#include <core/KeyReduction.h>
+#include <core/log.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+using namespace ckcmd;
+
+bool KeyReduction::parse(const std::string& fit_name, const std::string& tolerances)
+{
+	std::string name = fit_name;
+	std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+	Fit parsed;
+	if (name == "none")
+		parsed = none;
+	else if (name == "linear")
+		parsed = linear;
+	else if (name == "spline")
+		parsed = spline;
+	else
+		return false;
+
+	float units, degrees, factor;
+	if (sscanf(tolerances.c_str(), "%f,%f,%f", &units, &degrees, &factor) != 3 || units < 0.0f || degrees < 0.0f || factor < 0.0f)
+		return false;
+	fit = parsed;
+	position = units;
+	angle = degrees * 3.14159265f / 180.0f;
+	scale = factor;
+	return true;
+}
+
+void KeyReport::add(const KeyReport& other)
+{
+	keys += other.keys;
+	kept += other.kept;
+	position = std::max(position, other.position);
+	angle = std::max(angle, other.angle);
+	scale = std::max(scale, other.scale);
+}
+
+void KeyReport::log(const std::string& what) const
+{
+	float degrees = angle * 180.0f / 3.14159265f;
+	if (keys > 0)
+		Log::Info("%s: %zu of %zu keys kept, max error %.4f units, %.4f degrees, %.4f scale", what.c_str(), kept, keys, position, degrees, scale);
+	else
+		Log::Info("%s: max error %.4f units, %.4f degrees, %.4f scale", what.c_str(), position, degrees, scale);
+}
+
+KeyReducer::KeyReducer(const float* times, const float* values, int count, int width) :
+	times(times),
+	values(values),
+	count(count),
+	width(width),
+	slopes(count * width, 0.0f)
+{
+	for (int i = 0; i < count; i++)
+	{
+		int before = std::max(i - 1, 0);
+		int after = std::min(i + 1, count - 1);
+		float dt = times[after] - times[before];
+		if (dt <= 0.0f)
+			continue;
+		for (int c = 0; c < width; c++)
+			slopes[i * width + c] = (values[after * width + c] - values[before * width + c]) / dt;
+	}
+}
+
+float KeyReducer::segment_error(KeyReduction::Fit fit, int from, int to, float tolerance) const
+{
+	const float* a = &values[from * width];
+	const float* b = &values[to * width];
+	const float* ma = slope(from);
+	const float* mb = slope(to);
+	float dt = times[to] - times[from];
+
+	float worst = 0.0f;
+	for (int i = from + 1; i < to; i++)
+	{
+		float x = dt > 0.0f ? (times[i] - times[from]) / dt : 0.0f;
+		// Hermite basis, the tangents are the slopes over the segment length
+		float x2 = x * x;
+		float x3 = x2 * x;
+		float h00 = 2.0f * x3 - 3.0f * x2 + 1.0f;
+		float h10 = (x3 - 2.0f * x2 + x) * dt;
+		float h01 = -2.0f * x3 + 3.0f * x2;
+		float h11 = (x3 - x2) * dt;
+
+		const float* sample = &values[i * width];
+		float distance = 0.0f;
+		for (int c = 0; c < width; c++)
+		{
+			float value = fit == KeyReduction::spline ?
+				h00 * a[c] + h10 * ma[c] + h01 * b[c] + h11 * mb[c] :
+				a[c] + (b[c] - a[c]) * x;
+			distance += (value - sample[c]) * (value - sample[c]);
+		}
+		worst = std::max(worst, std::sqrt(distance));
+		if (worst > tolerance)
+			break;
+	}
+	return worst;
+}
+
+std::vector<int> KeyReducer::reduce(KeyReduction::Fit fit, float tolerance, float& error) const
+{
+	std::vector<int> kept;
+	error = 0.0f;
+	if (count == 0)
+		return kept;
+
+	kept.push_back(0);
+	if (fit == KeyReduction::none)
+	{
+		for (int i = 1; i < count; i++)
+			kept.push_back(i);
+		return kept;
+	}
+
+	//each segment is grown by doubling its length until a sample falls out of the
+	//tolerance, then by halving the gap left; the length kept always holds
+	int from = 0;
+	while (from < count - 1)
+	{
+		int good = from + 1;
+		float good_error = 0.0f;
+		int bad = count;
+		for (int length = 2; from + length < count; length *= 2)
+		{
+			float e = segment_error(fit, from, from + length, tolerance);
+			if (e > tolerance)
+			{
+				bad = from + length;
+				break;
+			}
+			good = from + length;
+			good_error = e;
+		}
+		if (bad == count && good < count - 1)
+		{
+			float e = segment_error(fit, from, count - 1, tolerance);
+			if (e <= tolerance)
+			{
+				good = count - 1;
+				good_error = e;
+			}
+			else
+				bad = count - 1;
+		}
+		while (bad - good > 1)
+		{
+			int middle = (good + bad) / 2;
+			float e = segment_error(fit, from, middle, tolerance);
+			if (e > tolerance)
+				bad = middle;
+			else
+			{
+				good = middle;
+				good_error = e;
+			}
+		}
+		error = std::max(error, good_error);
+		kept.push_back(good);
+		from = good;
+	}
+	return kept;
+}
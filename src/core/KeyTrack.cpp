@@ -0,0 +1,132 @@
+#include <core/KeyTrack.h>
+#include <core/NiflibHelper.h>
+
+#include <algorithm>
+
+using namespace ckcmd;
+using namespace Niflib;
+
+// ((a * x + b) * x + c) * x + d, linear segments have a = b = 0
+template<typename T>
+static inline T evaluate(const T* segment, float x, bool constant)
+{
+	if (constant)
+		return x < 0.5f ? segment[0] : segment[1];
+	return ((segment[0] * x + segment[1]) * x + segment[2]) * x + segment[3];
+}
+
+static inline Quaternion evaluate(const Quaternion* segment, float x, bool)
+{
+	return QuaternionSlerp(x, segment[0], segment[1]);
+}
+
+// value held at a key time, the key walk slerped a quaternion key with itself
+template<typename T>
+static inline T key_value(const T& value)
+{
+	return value;
+}
+
+static inline Quaternion key_value(const Quaternion& value)
+{
+	return QuaternionSlerp(0.0f, value, value);
+}
+
+// appends the curve of the segment between two keys
+template<typename T>
+static void add_segment(std::vector<T>& segments, const Key<T>& first, const Key<T>& second, int interpolation)
+{
+	const T& v1 = first.data;
+	const T& v2 = second.data;
+	if (interpolation == CONST_KEY)
+	{
+		segments.insert(segments.end(), { v1, v2, T(), T() });
+	}
+	else if (interpolation == QUADRATIC_KEY)
+	{
+		// Cubic Hermite spline
+		//	x(t) = (2t^3 - 3t^2 + 1)P1  + (-2t^3 + 3t^2)P2 + (t^3 - 2t^2 + t)T1 + (t^3 - t^2)T2
+		const T& t1 = first.backward_tangent;
+		const T& t2 = second.forward_tangent;
+		segments.insert(segments.end(), {
+			v1 * 2.0f - v2 * 2.0f + t1 + t2,
+			v2 * 3.0f - v1 * 3.0f - t1 * 2.0f - t2,
+			t1,
+			v1 });
+	}
+	else
+	{
+		segments.insert(segments.end(), { T(), T(), v2 - v1, v1 });
+	}
+}
+
+static void add_segment(std::vector<Quaternion>& segments, const Key<Quaternion>& first, const Key<Quaternion>& second, int)
+{
+	Quaternion v1 = first.data;
+	if (v1.Dot(second.data) < 0)
+		v1 = v1.Inverse(); // don't take the long path
+	segments.insert(segments.end(), { v1, second.data });
+}
+
+template<typename T>
+KeyTrack<T>::KeyTrack(const std::vector<Key<T>>& keys, int interpolation) :
+	constant(interpolation == CONST_KEY)
+{
+	size_t n = keys.size();
+	times.reserve(n);
+	values.reserve(n);
+	for (const auto& key : keys)
+	{
+		times.push_back(key.time);
+		values.push_back(key_value(key.data));
+	}
+
+	segments.reserve(n * 4);
+	for (size_t i = 0; i + 1 < n; i++)
+	{
+		add_segment(segments, keys[i], keys[i + 1], interpolation);
+	}
+	if (n > 1)
+		stride = (int)(segments.size() / (n - 1));
+}
+
+template<typename T>
+void KeyTrack<T>::sample(float step, int frames, T* out) const
+{
+	if (times.empty())
+		return;
+
+	const float first = times.front();
+	const float last = times.back();
+	int frame = 0;
+
+	//a single frame clip has an infinite step, its NaN time holds the first key too
+	for (; frame < frames && !(frame * step > first); frame++)
+		out[frame] = values.front();
+
+	if (frame < frames && frame * step < last)
+	{
+		size_t i = std::upper_bound(times.begin(), times.end(), frame * step) - times.begin() - 1;
+		float time;
+		while (frame < frames && (time = frame * step) < last)
+		{
+			while (times[i + 1] <= time)
+				i++;
+
+			const float start = times[i];
+			const float end = times[i + 1];
+			const T* segment = &segments[i * stride];
+			for (; frame < frames && (time = frame * step) < end; frame++)
+				out[frame] = evaluate(segment, (time - start) / (end - start), constant);
+		}
+	}
+
+	for (; frame < frames; frame++)
+		out[frame] = values.back();
+}
+
+namespace ckcmd {
+	template class KeyTrack<float>;
+	template class KeyTrack<Vector3>;
+	template class KeyTrack<Quaternion>;
+}
@@ -0,0 +1,61 @@
+#include <core/LogCapture.h>
+
+#include <cstdio>
+
+using namespace ckcmd;
+
+LogCapture::LogCapture(LogMessages& messages) :
+	messages(messages)
+{
+	previous = Log::SetThreadListener(this);
+}
+
+LogCapture::~LogCapture()
+{
+	Log::SetThreadListener(previous);
+}
+
+void LogCapture::Message(LogLevel level, const char* strMessage)
+{
+	messages.emplace_back(level, strMessage);
+}
+
+void LogCapture::replay(const LogMessages& messages)
+{
+	//Log::Msg logs everything as verbose
+	for (const auto& message : messages)
+	{
+		if (message.first == LOG_ERROR)
+			Log::Error("%s", message.second.c_str());
+		else if (message.first == LOG_WARN)
+			Log::Warn("%s", message.second.c_str());
+		else
+			Log::Info("%s", message.second.c_str());
+	}
+}
+
+std::string ckcmd::json_string(const std::string& text)
+{
+	std::string out = "\"";
+	for (unsigned char c : text)
+	{
+		switch (c)
+		{
+		case '"': out += "\\\""; break;
+		case '\\': out += "\\\\"; break;
+		case '\n': out += "\\n"; break;
+		case '\r': out += "\\r"; break;
+		case '\t': out += "\\t"; break;
+		default:
+			if (c < 0x20)
+			{
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+				out += escaped;
+			}
+			else
+				out += (char)c;
+		}
+	}
+	return out + "\"";
+}
@@ -0,0 +1,114 @@
+#include <core/MappedFile.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace ckcmd;
+
+MappedFile::MappedFile(const fs::path& path)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+	file_handle = file;
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+	{
+		close();
+		return;
+	}
+	HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL)
+	{
+		close();
+		return;
+	}
+	mapping_handle = mapping;
+	bytes = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (bytes == nullptr)
+	{
+		close();
+		return;
+	}
+	length = (size_t)file_size.QuadPart;
+#else
+	file_descriptor = ::open(path.c_str(), O_RDONLY);
+	if (file_descriptor < 0)
+		return;
+	struct stat info;
+	if (fstat(file_descriptor, &info) != 0 || info.st_size == 0)
+	{
+		close();
+		return;
+	}
+	void* mapped = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+	if (mapped == MAP_FAILED)
+	{
+		close();
+		return;
+	}
+	bytes = (const uint8_t*)mapped;
+	length = (size_t)info.st_size;
+#endif
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		close();
+		bytes = other.bytes;
+		length = other.length;
+		other.bytes = nullptr;
+		other.length = 0;
+#ifdef _WIN32
+		file_handle = other.file_handle;
+		mapping_handle = other.mapping_handle;
+		other.file_handle = nullptr;
+		other.mapping_handle = nullptr;
+#else
+		file_descriptor = other.file_descriptor;
+		other.file_descriptor = -1;
+#endif
+	}
+	return *this;
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (bytes != nullptr)
+		UnmapViewOfFile(bytes);
+	if (mapping_handle != nullptr)
+		CloseHandle(mapping_handle);
+	if (file_handle != nullptr)
+		CloseHandle(file_handle);
+	mapping_handle = nullptr;
+	file_handle = nullptr;
+#else
+	if (bytes != nullptr)
+		munmap((void*)bytes, length);
+	if (file_descriptor >= 0)
+		::close(file_descriptor);
+	file_descriptor = -1;
+#endif
+	bytes = nullptr;
+	length = 0;
+}
@@ -5,9 +5,38 @@ See the included LICENSE file
 */
 
 #include <core/NifFile.h>
+#include <core/BSAExtractor.h>
 
 using namespace ckcmd::NIF;
 
+vector<NiObjectRef> ckcmd::NIF::ReadNifBuffer(const uint8_t* data, size_t size, NifInfo* info)
+{
+	ckcmd::BSA::MemoryStream stream(data, size);
+	return ReadNifList(stream, info);
+}
+
+vector<NiObjectRef> ckcmd::NIF::ReadNifMapped(const fs::path& path, NifInfo* info)
+{
+	ckcmd::MappedFile mapping(path);
+	if (!mapping.is_open())
+		return ReadNifList(path.string(), info);
+	return ReadNifBuffer(mapping.data(), mapping.size(), info);
+}
+
+size_t ckcmd::NIF::WriteNifBuffer(vector<uint8_t>& buffer, NiObjectRef root, const NifInfo& info)
+{
+	if (buffer.empty())
+		buffer.resize(256 * 1024);
+	for (;;)
+	{
+		ckcmd::BSA::MemoryOutputStream stream(buffer.data(), buffer.size());
+		WriteNifTree(stream, root, info);
+		if (!stream.overflowed())
+			return stream.written();
+		buffer.resize(buffer.size() * 2);
+	}
+}
+
 template<class T>
 Ref<T> NifFile::FindBlockByName(const std::string& name) {
 	for (auto& block : blocks) {
@@ -629,7 +658,7 @@ int NifFile::Load(const std::string& fileName) {
 	this->fileName = fileName;
 	Clear();
 	try {
-		blocks = ReadNifList(fileName.c_str(), &hdr);
+		blocks = ReadNifMapped(fileName, &hdr);
 		bhkScaleFactor = hdr.version < VER_20_2_0_7 ? (1.0f / 0.1428f) : (1.0f / 0.01428f);
 	}
 	catch (...) {
@@ -666,6 +695,26 @@ int NifFile::Load(std::istream& stream) {
 	return 0;
 }
 
+int NifFile::Load(const uint8_t* data, size_t size) {
+	Clear();
+	try {
+		blocks = ReadNifBuffer(data, size, &hdr);
+		bhkScaleFactor = hdr.version < VER_20_2_0_7 ? 6.9969 : 69.99124908;
+	}
+	catch (...) {
+		throw runtime_error("Unable to read file from buffer");
+		return -1;
+	}
+	set<NiObjectRef> roots = FindRoots(blocks);
+	if (roots.size() != 1) {
+		throw runtime_error("Unable to find an unique root");
+		return -2;
+	}
+	PrepareData();
+	isValid = true;
+	return 0;
+}
+
 size_t NifFile::getNumBlocks(const Type& type) const
 {
 	size_t count = 0;
@@ -1381,6 +1430,32 @@ int NifFile::Save(std::ostream& file) {
 	}
 	return 0;
 }
+
+int NifFile::Save(uint8_t* buffer, size_t capacity, size_t& written) {
+	written = 0;
+	try {
+		ckcmd::BSA::MemoryOutputStream stream(buffer, capacity);
+		WriteNifTree(stream, GetFirstRoot(blocks), hdr);
+		if (stream.overflowed())
+			return -2;
+		written = stream.written();
+	}
+	catch (...) {
+		return -1;
+	}
+	return 0;
+}
+
+int NifFile::Save(vector<uint8_t>& buffer, size_t& written) {
+	written = 0;
+	try {
+		written = WriteNifBuffer(buffer, GetFirstRoot(blocks), hdr);
+	}
+	catch (...) {
+		return -1;
+	}
+	return 0;
+}
 //
 //void NifFile::Optimize() {
 //	for (auto &s : GetShapeNames())
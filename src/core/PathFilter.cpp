@@ -0,0 +1,131 @@
+#include <core/PathFilter.h>
+
+#include <algorithm>
+#include <cctype>
+
+using namespace ckcmd;
+
+//compiled rules use two control characters for the wildcards that can span text
+static const char any_in_component = '\x01';
+static const char any_in_path = '\x02';
+static const char any_character = '\x03';
+
+static std::string normalize(std::string_view path)
+{
+	std::string out(path.size(), '\0');
+	std::transform(path.begin(), path.end(), out.begin(), [](unsigned char c) -> char {
+		return c == '/' ? '\\' : (char)::tolower(c);
+	});
+	return out;
+}
+
+std::string PathFilter::compile(std::string_view glob)
+{
+	std::string source = normalize(glob);
+	std::string rule;
+	rule.reserve(source.size());
+	for (size_t i = 0; i < source.size(); i++)
+	{
+		if (source[i] == '*')
+		{
+			if (i + 1 < source.size() && source[i + 1] == '*')
+			{
+				rule += any_in_path;
+				i++;
+			}
+			else
+				rule += any_in_component;
+		}
+		else if (source[i] == '?')
+			rule += any_character;
+		else
+			rule += source[i];
+	}
+	return rule;
+}
+
+//reachable path positions, one rule character at a time: O(rule * path), no backtracking
+bool PathFilter::match(const std::string& rule, const std::string& path)
+{
+	size_t length = path.size();
+	std::vector<char> current(length + 1, 0), next(length + 1, 0);
+	current[0] = 1;
+	for (char token : rule)
+	{
+		std::fill(next.begin(), next.end(), 0);
+		bool reachable = false;
+		if (token == any_in_path)
+		{
+			auto first = std::find(current.begin(), current.end(), 1);
+			std::fill(next.begin() + (first - current.begin()), next.end(), 1);
+			reachable = first != current.end();
+		}
+		else if (token == any_in_component)
+		{
+			for (size_t j = 0; j <= length; j++)
+			{
+				if (!current[j])
+					continue;
+				next[j] = 1;
+				for (size_t k = j; k < length && path[k] != '\\' && !next[k + 1]; k++)
+					next[k + 1] = 1;
+				reachable = true;
+			}
+		}
+		else
+		{
+			for (size_t j = 0; j < length; j++)
+			{
+				if (current[j] && (token == any_character ? path[j] != '\\' : path[j] == token))
+				{
+					next[j + 1] = 1;
+					reachable = true;
+				}
+			}
+		}
+		if (!reachable)
+			return false;
+		current.swap(next);
+	}
+	return current[length] != 0;
+}
+
+void PathFilter::include(std::string_view glob)
+{
+	if (!glob.empty())
+		includes.push_back(compile(glob));
+}
+
+void PathFilter::exclude(std::string_view glob)
+{
+	if (!glob.empty())
+		excludes.push_back(compile(glob));
+}
+
+std::vector<std::string> PathFilter::split(std::string_view globs)
+{
+	std::vector<std::string> out;
+	size_t start = 0;
+	while (start <= globs.size())
+	{
+		size_t end = globs.find(';', start);
+		if (end == std::string_view::npos)
+			end = globs.size();
+		if (end > start)
+			out.emplace_back(globs.substr(start, end - start));
+		start = end + 1;
+	}
+	return out;
+}
+
+bool PathFilter::accepts(std::string_view path) const
+{
+	if (empty())
+		return true;
+	std::string normalized = normalize(path);
+	if (!includes.empty() && std::none_of(includes.begin(), includes.end(),
+		[&](const std::string& rule) { return match(rule, normalized); }))
+		return false;
+	return std::none_of(excludes.begin(), excludes.end(),
+		[&](const std::string& rule) { return match(rule, normalized); });
+}
@@ -0,0 +1,127 @@
+#include <core/PoseBuffer.h>
+#include <core/HavokSession.h>
+#include <core/ThreadPool.h>
+
+#include <Animation/Animation/Rig/hkaSkeletonUtils.h>
+
+#include <algorithm>
+
+using namespace ckcmd;
+
+//0 threads is one per core, or just the calling one when it already is a pool
+//worker, i.e. a ClipBatch or Batch job
+static size_t frame_tasks(int frames, size_t threads)
+{
+	size_t tasks = (frames + PoseBuffer::min_frames_per_task - 1) / PoseBuffer::min_frames_per_task;
+	if (threads == 0)
+		threads = ThreadPool::on_worker() ? 1 : ThreadPool::default_threads();
+	return std::min(tasks, threads);
+}
+
+// body(task, from, to) on [from, to) slices of the frames, inline for a single task
+template<typename F>
+static void for_frames(int frames, size_t tasks, F&& body)
+{
+	if (tasks <= 1)
+	{
+		body(0, 0, frames);
+		return;
+	}
+	ThreadPool pool(tasks);
+	pool.parallel_for(tasks, [&](size_t task) {
+		body(task, (int)(frames * task / tasks), (int)(frames * (task + 1) / tasks));
+	});
+}
+
+PoseBuffer::PoseBuffer(const hkaSkeleton& skeleton) :
+	nbones(skeleton.m_bones.getSize()),
+	parents(nbones, -1),
+	order(nbones)
+{
+	for (int i = 0; i < nbones && i < skeleton.m_parentIndices.getSize(); i++)
+	{
+		int parent = skeleton.m_parentIndices[i];
+		parents[i] = parent >= 0 && parent < nbones && parent != i ? parent : -1;
+	}
+
+	//a bone chain longer than the skeleton is a loop, its bones are taken as roots
+	std::vector<int> depth(nbones, 0);
+	for (int i = 0; i < nbones; i++)
+	{
+		int steps = 0;
+		for (int bone = parents[i]; bone != -1 && steps <= nbones; bone = parents[bone])
+			steps++;
+		if (steps > nbones)
+		{
+			parents[i] = -1;
+			steps = 0;
+		}
+		depth[i] = steps;
+	}
+	for (int i = 0; i < nbones; i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return depth[a] < depth[b]; });
+
+	referencePose.setSize(nbones, hkQsTransform::getIdentity());
+	for (int i = 0; i < nbones && i < skeleton.m_referencePose.getSize(); i++)
+		referencePose[i] = skeleton.m_referencePose[i];
+}
+
+void PoseBuffer::reference(int frames)
+{
+	nframes = frames;
+	locals.setSize(nbones * nframes);
+	for (int frame = 0; frame < nframes; frame++)
+		std::copy(referencePose.begin(), referencePose.end(), local(frame));
+}
+
+void PoseBuffer::sample(const hkaAnimation& animation, int frames, const int* track_to_bone, size_t threads)
+{
+	reference(frames);
+	int ntracks = animation.m_numberOfTransformTracks;
+	nfloats = animation.m_numberOfFloatTracks;
+	floatValues.setSize(nfloats * nframes, 0.0f);
+
+	//scratch buffers are taken here, the workers do not allocate
+	size_t tasks = frame_tasks(nframes, threads);
+	hkArray<hkQsTransform> scratch;
+	scratch.setSize((int)std::max<size_t>(tasks, 1) * ntracks, hkQsTransform::getIdentity());
+
+	hkReal step = nframes > 0 ? animation.m_duration / (hkReal)nframes : 0.0f;
+	for_frames(nframes, tasks, [&](size_t task, int from, int to) {
+		HavokSession::Scope havok;
+		hkQsTransform* tracks = scratch.begin() + task * ntracks;
+		for (int frame = from; frame < to; frame++)
+		{
+			animation.sampleTracks(step * frame, tracks, floatValues.begin() + frame * nfloats, HK_NULL);
+			hkaSkeletonUtils::normalizeRotations(tracks, ntracks);
+			hkQsTransform* pose = local(frame);
+			for (int i = 0; i < ntracks; i++)
+			{
+				int bone = track_to_bone != nullptr ? track_to_bone[i] : i;
+				if (bone >= 0 && bone < nbones)
+					pose[bone] = tracks[i];
+			}
+		}
+	});
+}
+
+void PoseBuffer::computeModel(size_t threads)
+{
+	models.setSize(nbones * nframes);
+	for_frames(nframes, frame_tasks(nframes, threads), [&](size_t, int from, int to) {
+		for (int frame = from; frame < to; frame++)
+		{
+			const hkQsTransform* pose = local(frame);
+			hkQsTransform* out = models.begin() + frame * nbones;
+			for (int bone : order)
+			{
+				int parent = parents[bone];
+				if (parent == -1)
+					out[bone] = pose[bone];
+				else
+					out[bone].setMul(out[parent], pose[bone]);
+			}
+		}
+	});
+}
@@ -11,6 +11,7 @@
 #include <string>
 #include <unordered_map>
 #include <cmath>
+#include <cstring>
 #include <map>
 #include <set>
 
@@ -66,17 +67,232 @@ void RawModel::AddVertexAttribute(const RawVertexAttribute attrib)
     vertexAttributes |= attrib;
 }
 
+static inline uint64_t MixHash(uint64_t seed, uint64_t value)
+{
+    value *= 0x9e3779b97f4a7c15ull;
+    value ^= value >> 32;
+    return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}
+
+static inline uint64_t FloatBits(float value)
+{
+    // -0.0 == 0.0, they must hash the same
+    if (value == 0.0f) {
+        value = 0.0f;
+    }
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+template<typename _vector_type_>
+static inline uint64_t HashFloats(uint64_t seed, const _vector_type_ &v)
+{
+    for (int i = 0; i < v.size(); i++) {
+        seed = MixHash(seed, FloatBits(v[i]));
+    }
+    return seed;
+}
+
+static inline uint64_t HashName(uint64_t seed, const std::string &name)
+{
+    for (const char c : name) {
+        seed = MixHash(seed, (uint64_t) (unsigned char) c);
+    }
+    return seed;
+}
+
+static inline uint64_t HashNameNoCase(uint64_t seed, const std::string &name)
+{
+    for (const char c : name) {
+        seed = MixHash(seed, (uint64_t) tolower((unsigned char) c));
+    }
+    return seed;
+}
+
+static inline uint64_t TextureKey(const std::string &name, const RawTextureUsage usage)
+{
+    return MixHash(HashNameNoCase(5381, name), (uint64_t) usage);
+}
+
+static inline uint64_t MaterialKey(const std::string &name, const RawMaterialType type, const int textures[RAW_TEXTURE_USAGE_MAX])
+{
+    uint64_t seed = MixHash(HashName(5381, name), (uint64_t) type);
+    for (int i = 0; i < RAW_TEXTURE_USAGE_MAX; i++) {
+        seed = MixHash(seed, (uint64_t) (uint32_t) textures[i]);
+    }
+    return seed;
+}
+
+template<typename _vector_type_>
+static inline bool Near(const _vector_type_ &a, const _vector_type_ &b, const float tolerance)
+{
+    for (int i = 0; i < a.size(); i++) {
+        if (std::fabs(a[i] - b[i]) > tolerance) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool Near(const RawVertex &a, const RawVertex &b, const float tolerance)
+{
+    return Near(a.position, b.position, tolerance) &&
+           Near(a.normal, b.normal, tolerance) &&
+           Near(a.tangent, b.tangent, tolerance) &&
+           Near(a.binormal, b.binormal, tolerance) &&
+           Near(a.color, b.color, tolerance) &&
+           Near(a.uv0, b.uv0, tolerance) &&
+           Near(a.uv1, b.uv1, tolerance) &&
+           (a.jointIndices == b.jointIndices) &&
+           Near(a.jointWeights, b.jointWeights, tolerance) &&
+           (a.polarityUv0 == b.polarityUv0) &&
+           (a.blendSurfaceIx == b.blendSurfaceIx) &&
+           (a.blends == b.blends);
+}
+
+void RawVertexIndex::Clear()
+{
+    slots.clear();
+    next.clear();
+    used = 0;
+}
+
+void RawVertexIndex::SetTolerance(float tolerance)
+{
+    Clear();
+    this->tolerance = tolerance > 0.0f ? tolerance : 0.0f;
+}
+
+uint64_t RawVertexIndex::Key(const RawVertex &vertex) const
+{
+    if (tolerance > 0.0f) {
+        int64_t cell[3];
+        Cell(vertex.position, cell);
+        return CellKey(cell[0], cell[1], cell[2]);
+    }
+    uint64_t seed = 5381;
+    seed = HashFloats(seed, vertex.position);
+    seed = HashFloats(seed, vertex.normal);
+    seed = HashFloats(seed, vertex.tangent);
+    seed = HashFloats(seed, vertex.binormal);
+    seed = HashFloats(seed, vertex.color);
+    seed = HashFloats(seed, vertex.uv0);
+    seed = HashFloats(seed, vertex.uv1);
+    seed = HashFloats(seed, vertex.jointWeights);
+    for (int i = 0; i < vertex.jointIndices.size(); i++) {
+        seed = MixHash(seed, (uint64_t) (uint32_t) vertex.jointIndices[i]);
+    }
+    seed = MixHash(seed, vertex.polarityUv0 ? 1 : 0);
+    seed = MixHash(seed, (uint64_t) (uint32_t) vertex.blendSurfaceIx);
+    return seed;
+}
+
+uint64_t RawVertexIndex::CellKey(int64_t x, int64_t y, int64_t z) const
+{
+    return MixHash(MixHash(MixHash(5381, (uint64_t) x), (uint64_t) y), (uint64_t) z);
+}
+
+void RawVertexIndex::Cell(const Vec3f &position, int64_t cell[3]) const
+{
+    for (int i = 0; i < 3; i++) {
+        cell[i] = (int64_t) std::floor(position[i] / tolerance);
+    }
+}
+
+size_t RawVertexIndex::Probe(const uint64_t key) const
+{
+    const size_t mask = slots.size() - 1;
+    size_t slot = (size_t) (key ^ (key >> 29)) & mask;
+    while (slots[slot].head >= 0 && slots[slot].key != key) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void RawVertexIndex::Grow()
+{
+    std::vector<Slot> old(std::max<size_t>(slots.size() * 2, 1024), Slot { 0, -1 });
+    old.swap(slots);
+    for (const Slot &entry : old) {
+        if (entry.head >= 0) {
+            slots[Probe(entry.key)] = entry;
+        }
+    }
+}
+
+int RawVertexIndex::FindInChain(const uint64_t key, const RawVertex &vertex, const std::vector<RawVertex> &vertices, int best) const
+{
+    const Slot &slot = slots[Probe(key)];
+    for (int index = slot.head; index >= 0; index = next[index]) {
+        if (best >= 0 && index >= best) {
+            continue;
+        }
+        if (tolerance > 0.0f ? Near(vertices[index], vertex, tolerance) : vertices[index] == vertex) {
+            best = index;
+        }
+    }
+    return best;
+}
+
+int RawVertexIndex::Find(const RawVertex &vertex, const std::vector<RawVertex> &vertices) const
+{
+    if (used == 0) {
+        return -1;
+    }
+    if (tolerance <= 0.0f) {
+        return FindInChain(Key(vertex), vertex, vertices, -1);
+    }
+    int64_t cell[3];
+    Cell(vertex.position, cell);
+    int best = -1;
+    for (int64_t x = cell[0] - 1; x <= cell[0] + 1; x++) {
+        for (int64_t y = cell[1] - 1; y <= cell[1] + 1; y++) {
+            for (int64_t z = cell[2] - 1; z <= cell[2] + 1; z++) {
+                best = FindInChain(CellKey(x, y, z), vertex, vertices, best);
+            }
+        }
+    }
+    return best;
+}
+
+void RawVertexIndex::Insert(const int index, const std::vector<RawVertex> &vertices)
+{
+    if ((used + 1) * 2 > slots.size()) {
+        Grow();
+    }
+    if (next.size() <= (size_t) index) {
+        next.resize(std::max<size_t>((size_t) index + 1, next.size() * 2), -1);
+    }
+    const uint64_t key = Key(vertices[index]);
+    Slot &slot = slots[Probe(key)];
+    if (slot.head < 0) {
+        slot.key = key;
+        used++;
+    }
+    next[index] = slot.head;
+    slot.head = index;
+}
+
 int RawModel::AddVertex(const RawVertex &vertex)
 {
-    auto it = vertexHash.find(vertex);
-    if (it != vertexHash.end()) {
-        return it->second;
+    const int found = vertexIndex.Find(vertex, vertices);
+    if (found >= 0) {
+        return found;
     }
-    vertexHash.emplace(vertex, (int) vertices.size());
     vertices.push_back(vertex);
+    vertexIndex.Insert((int) vertices.size() - 1, vertices);
     return (int) vertices.size() - 1;
 }
 
+void RawModel::SetWeldTolerance(const float tolerance)
+{
+    vertexIndex.SetTolerance(tolerance);
+    for (int i = 0; i < (int) vertices.size(); i++) {
+        vertexIndex.Insert(i, vertices);
+    }
+}
+
 int RawModel::AddTriangle(const int v0, const int v1, const int v2, const int materialIndex, const int surfaceIndex)
 {
     const RawTriangle triangle = {{v0, v1, v2}, materialIndex, surfaceIndex};
@@ -89,9 +305,12 @@ int RawModel::AddTexture(const std::string &name, const std::string &fileName, c
     if (name.empty()) {
         return -1;
     }
-    for (size_t i = 0; i < textures.size(); i++) {
-        if (StringUtils::CompareNoCase(textures[i].name, name) == 0 && textures[i].usage == usage) {
-            return (int) i;
+    const uint64_t key = TextureKey(name, usage);
+    const auto range = textureIndex.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) {
+        const RawTexture &texture = textures[it->second];
+        if (texture.usage == usage && StringUtils::CompareNoCase(texture.name, name) == 0) {
+            return it->second;
         }
     }
 
@@ -101,13 +320,15 @@ int RawModel::AddTexture(const std::string &name, const std::string &fileName, c
     texture.name         = name;
     texture.width        = properties.width;
     texture.height       = properties.height;
-    texture.mipLevels    = (int) ceilf(log2f(std::max((float) properties.width, (float) properties.height)));
+    texture.mipLevels    = properties.mipLevels > 0 ? properties.mipLevels :
+                           (int) ceilf(log2f(std::max((float) properties.width, (float) properties.height)));
     texture.usage        = usage;
     texture.occlusion    = (properties.occlusion == IMAGE_TRANSPARENT) ?
                            RAW_TEXTURE_OCCLUSION_TRANSPARENT : RAW_TEXTURE_OCCLUSION_OPAQUE;
     texture.fileName     = fileName;
     texture.fileLocation = fileLocation;
     textures.emplace_back(texture);
+    textureIndex.emplace(key, (int) textures.size() - 1);
     return (int) textures.size() - 1;
 }
 
@@ -122,22 +343,25 @@ int RawModel::AddMaterial(
     const int textures[RAW_TEXTURE_USAGE_MAX],
     std::shared_ptr<RawMatProps> materialInfo)
 {
-    for (size_t i = 0; i < materials.size(); i++) {
-        if (materials[i].name != name) {
+    const uint64_t key = MaterialKey(name, materialType, textures);
+    const auto range = materialIndex.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) {
+        const RawMaterial &candidate = materials[it->second];
+        if (candidate.name != name) {
             continue;
         }
-        if (materials[i].type != materialType) {
+        if (candidate.type != materialType) {
             continue;
         }
-        if (*(materials[i].info) != *materialInfo) {
+        if (*(candidate.info) != *materialInfo) {
             continue;
         }
         bool match = true;
         for (int j = 0; match && j < RAW_TEXTURE_USAGE_MAX; j++) {
-            match = match && (materials[i].textures[j] == textures[j]);
+            match = match && (candidate.textures[j] == textures[j]);
         }
         if (match) {
-            return (int) i;
+            return it->second;
         }
     }
 
@@ -151,19 +375,29 @@ int RawModel::AddMaterial(
     }
 
     materials.emplace_back(material);
+    materialIndex.emplace(key, (int) materials.size() - 1);
 
     return (int) materials.size() - 1;
 }
 
 int RawModel::AddSurface(const RawSurface &surface)
 {
-    for (size_t i = 0; i < surfaces.size(); i++) {
-        if (StringUtils::CompareNoCase(surfaces[i].name, surface.name) == 0) {
-            return (int) i;
+    // Surfaces added by id may share a name, the first one wins.
+    const uint64_t key = HashNameNoCase(5381, surface.name);
+    const auto range = surfaceNameIndex.equal_range(key);
+    int found = -1;
+    for (auto it = range.first; it != range.second; ++it) {
+        if ((found < 0 || it->second < found) && StringUtils::CompareNoCase(surfaces[it->second].name, surface.name) == 0) {
+            found = it->second;
         }
     }
+    if (found >= 0) {
+        return found;
+    }
 
     surfaces.emplace_back(surface);
+    surfaceNameIndex.emplace(key, (int) surfaces.size() - 1);
+    surfaceIdIndex.emplace(surface.id, (int) surfaces.size() - 1);
     return (int) (surfaces.size() - 1);
 }
 
@@ -171,10 +405,9 @@ int RawModel::AddSurface(const char *name, const long surfaceId)
 {
     assert(name[0] != '\0');
 
-    for (size_t i = 0; i < surfaces.size(); i++) {
-        if (surfaces[i].id == surfaceId) {
-            return (int) i;
-        }
+    const auto found = surfaceIdIndex.find(surfaceId);
+    if (found != surfaceIdIndex.end()) {
+        return found->second;
     }
     RawSurface  surface;
     surface.id = surfaceId;
@@ -183,6 +416,8 @@ int RawModel::AddSurface(const char *name, const long surfaceId)
     surface.discrete  = false;
 
     surfaces.emplace_back(surface);
+    surfaceNameIndex.emplace(HashNameNoCase(5381, surface.name), (int) surfaces.size() - 1);
+    surfaceIdIndex.emplace(surfaceId, (int) surfaces.size() - 1);
     return (int) (surfaces.size() - 1);
 }
 
@@ -262,20 +497,29 @@ int RawModel::AddNode(const long id, const char *name, const long parentId)
 
 void RawModel::Condense()
 {
+    // The tables below are condensed with one remap per old entry: each entry that is
+    // still referenced is added again once, in order of first use, and every other
+    // reference to it is looked up in the remap.
+
     // Only keep surfaces that are referenced by one or more triangles.
     {
-        std::vector<RawSurface> oldSurfaces = surfaces;
+        std::vector<RawSurface> oldSurfaces;
+        oldSurfaces.swap(surfaces);
+        std::vector<int> remap(oldSurfaces.size(), -1);
 
-        surfaces.clear();
+        surfaceNameIndex.clear();
+        surfaceIdIndex.clear();
 
-        std::set<int> survivingSurfaceIds;
+        std::set<long> survivingSurfaceIds;
         for (auto &triangle : triangles) {
-            int oldSurfaceIndex = triangle.surfaceIndex;
-            const RawSurface &surface = oldSurfaces[triangle.surfaceIndex];
-            const int surfaceIndex = AddSurface(surface.name.c_str(), surface.id);
-            surfaces[surfaceIndex] = surface;
+            int &surfaceIndex = remap[triangle.surfaceIndex];
+            if (surfaceIndex < 0) {
+                const RawSurface &surface = oldSurfaces[triangle.surfaceIndex];
+                surfaceIndex = AddSurface(surface.name.c_str(), surface.id);
+                surfaces[surfaceIndex] = surface;
+                survivingSurfaceIds.emplace(surface.id);
+            }
             triangle.surfaceIndex = surfaceIndex;
-            survivingSurfaceIds.emplace(surface.id);
         }
         // clear out references to meshes that no longer exist
         for (auto &node : nodes) {
@@ -287,46 +531,71 @@ void RawModel::Condense()
 
     // Only keep materials that are referenced by one or more triangles.
     {
-        std::vector<RawMaterial> oldMaterials = materials;
+        std::vector<RawMaterial> oldMaterials;
+        oldMaterials.swap(materials);
+        std::vector<int> remap(oldMaterials.size(), -1);
 
-        materials.clear();
+        materialIndex.clear();
 
         for (auto &triangle : triangles) {
-            const RawMaterial &material = oldMaterials[triangle.materialIndex];
-            const int materialIndex = AddMaterial(material);
-            materials[materialIndex] = material;
-            triangle.materialIndex = materialIndex;
+            int &newIndex = remap[triangle.materialIndex];
+            if (newIndex < 0) {
+                const RawMaterial &material = oldMaterials[triangle.materialIndex];
+                newIndex = AddMaterial(material);
+                materials[newIndex] = material;
+            }
+            triangle.materialIndex = newIndex;
         }
     }
 
     // Only keep textures that are referenced by one or more materials.
+    // Material texture slots change here, so the material index is built again afterwards.
     {
-        std::vector<RawTexture> oldTextures = textures;
+        std::vector<RawTexture> oldTextures;
+        oldTextures.swap(textures);
+        std::vector<int> remap(oldTextures.size(), -1);
 
-        textures.clear();
+        textureIndex.clear();
+        materialIndex.clear();
 
-        for (auto &material : materials) {
+        for (size_t i = 0; i < materials.size(); i++) {
+            RawMaterial &material = materials[i];
             for (int j = 0; j < RAW_TEXTURE_USAGE_MAX; j++) {
                 if (material.textures[j] >= 0) {
-                    const RawTexture &texture = oldTextures[material.textures[j]];
-                    const int textureIndex = AddTexture(texture.name, texture.fileName, texture.fileLocation, texture.usage);
-                    textures[textureIndex] = texture;
-                    material.textures[j] = textureIndex;
+                    int &newIndex = remap[material.textures[j]];
+                    if (newIndex < 0) {
+                        // textures are unique already, no need to probe the image again
+                        const RawTexture &texture = oldTextures[material.textures[j]];
+                        newIndex = (int) textures.size();
+                        textures.push_back(texture);
+                        textureIndex.emplace(TextureKey(texture.name, texture.usage), newIndex);
+                    }
+                    material.textures[j] = newIndex;
                 }
             }
+            materialIndex.emplace(MaterialKey(material.name, material.type, material.textures), (int) i);
         }
     }
 
     // Only keep vertices that are referenced by one or more triangles.
+    // They are unique already: move them in order of first use and index them again.
     {
-        std::vector<RawVertex> oldVertices = vertices;
+        std::vector<RawVertex> oldVertices;
+        oldVertices.swap(vertices);
+        std::vector<int> remap(oldVertices.size(), -1);
 
-        vertexHash.clear();
-        vertices.clear();
+        vertexIndex.Clear();
+        vertices.reserve(oldVertices.size());
 
         for (auto &triangle : triangles) {
             for (int j = 0; j < 3; j++) {
-                triangle.verts[j] = AddVertex(oldVertices[triangle.verts[j]]);
+                int &newIndex = remap[triangle.verts[j]];
+                if (newIndex < 0) {
+                    newIndex = (int) vertices.size();
+                    vertices.push_back(std::move(oldVertices[triangle.verts[j]]));
+                    vertexIndex.Insert(newIndex, vertices);
+                }
+                triangle.verts[j] = newIndex;
             }
         }
     }
@@ -0,0 +1,100 @@
+#include <core/TextureIndex.h>
+#include <core/ThreadPool.h>
+#include <core/log.h>
+
+#include <cstring>
+#include <unordered_set>
+
+using namespace ckcmd;
+
+static const char* textures_prefix = "textures\\";
+
+void TextureIndex::add(VirtualFileSystem& files)
+{
+	roots.push_back(&files);
+}
+
+void TextureIndex::add(const fs::path& folder)
+{
+	owned.push_back(std::make_unique<VirtualFileSystem>(folder, std::list<fs::path>()));
+	roots.push_back(owned.back().get());
+}
+
+size_t TextureIndex::size() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return textures.size();
+}
+
+TextureIndex::Texture TextureIndex::load(const std::string& key) const
+{
+	Texture texture;
+	bool prefixable = key.compare(0, strlen(textures_prefix), textures_prefix) != 0;
+	for (VirtualFileSystem* root : roots)
+	{
+		std::string found = key;
+		if (!root->exists(found))
+		{
+			if (!prefixable || !root->exists(found = textures_prefix + key))
+				continue;
+			texture.prefixed = true;
+		}
+		texture.exists = true;
+
+		//the header of the path as stored may be known already, i.e. from preload()
+		if (texture.prefixed)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto it = textures.find(found);
+			if (it != textures.end())
+			{
+				texture.dds = it->second.dds;
+				texture.properties = it->second.properties;
+				return texture;
+			}
+		}
+
+		FileView view = root->open(found);
+		if (view.is_open())
+			texture.dds = GetDdsProperties(view.data(), view.size(), texture.properties);
+		return texture;
+	}
+	return texture;
+}
+
+const TextureIndex::Texture& TextureIndex::find(std::string_view path)
+{
+	std::string key = VirtualFileSystem::normalize(path);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = textures.find(key);
+		if (it != textures.end())
+			return it->second;
+	}
+	//read outside the lock, a texture asked twice at once is read twice and the first one kept
+	Texture texture = load(key);
+	std::lock_guard<std::mutex> lock(mutex);
+	return textures.emplace(std::move(key), texture).first->second;
+}
+
+void TextureIndex::preload(size_t threads)
+{
+	std::vector<std::string> keys;
+	std::unordered_set<std::string> seen;
+	for (VirtualFileSystem* root : roots)
+	{
+		for (auto& file : root->files(".dds"))
+		{
+			if (!root->in_archive(file) && seen.insert(file).second)
+				keys.push_back(std::move(file));
+		}
+	}
+
+	ThreadPool pool(threads);
+	pool.parallel_for(keys.size(), [&](size_t i) {
+		Texture texture = load(keys[i]);
+		std::lock_guard<std::mutex> lock(mutex);
+		textures.emplace(keys[i], texture);
+	});
+	Log::Info("Textures: %zu headers read from %zu roots", keys.size(), roots.size());
+}
@@ -0,0 +1,67 @@
+#include <core/ThreadPool.h>
+
+using namespace ckcmd;
+
+static thread_local bool pool_worker = false;
+
+size_t ThreadPool::default_threads()
+{
+	size_t cores = std::thread::hardware_concurrency();
+	return cores > 0 ? cores : 1;
+}
+
+ThreadPool::ThreadPool(size_t threads)
+{
+	if (threads == 0)
+		threads = default_threads();
+	workers.reserve(threads);
+	for (size_t i = 0; i < threads; i++)
+		workers.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	available.notify_all();
+	for (auto& worker : workers)
+		worker.join();
+}
+
+bool ThreadPool::on_worker()
+{
+	return pool_worker;
+}
+
+void ThreadPool::work()
+{
+	pool_worker = true;
+	for (;;)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			available.wait(lock, [this] { return stopping || !tasks.empty(); });
+			if (tasks.empty())
+				return;
+			task = std::move(tasks.front());
+			tasks.pop();
+			running++;
+		}
+		task();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			running--;
+			if (tasks.empty() && running == 0)
+				idle.notify_all();
+		}
+	}
+}
+
+void ThreadPool::wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [this] { return tasks.empty() && running == 0; });
+}
@@ -0,0 +1,212 @@
+#include <core/VFS.h>
+#include <core/log.h>
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+
+using namespace ckcmd;
+
+static const char* vfs_index_magic = "ckcmd-vfs 1";
+
+static int64_t modification_time(const fs::path& path)
+{
+	std::error_code ec;
+	auto time = fs::last_write_time(path, ec);
+	return ec ? 0 : (int64_t)time.time_since_epoch().count();
+}
+
+std::string VirtualFileSystem::normalize(std::string_view path)
+{
+	std::string out(path.size(), '\0');
+	std::transform(path.begin(), path.end(), out.begin(), [](unsigned char c) -> char {
+		return c == '/' ? '\\' : (char)::tolower(c);
+	});
+	size_t start = out.find_first_not_of('\\');
+	if (start == std::string::npos)
+		return std::string();
+	if (out.compare(start, 5, "data\\") == 0)
+		start += 5;
+	return start > 0 ? out.substr(start) : out;
+}
+
+VirtualFileSystem::VirtualFileSystem(const fs::path& data_folder, const std::list<fs::path>& archives, const fs::path& index_file) :
+	data_folder(data_folder)
+{
+	//source 0 is the loose files folder, then the archives in priority order
+	sources.push_back({ data_folder, false, 0, 0, nullptr, nullptr });
+	for (const auto& archive : archives)
+	{
+		std::error_code ec;
+		uint64_t size = fs::file_size(archive, ec);
+		sources.push_back({ archive, true, ec ? 0 : size, modification_time(archive), nullptr, std::make_unique<std::mutex>() });
+	}
+
+	std::vector<std::vector<std::string>> listings(sources.size());
+	std::vector<char> listed(sources.size(), 0);
+	bool reused = !index_file.empty() && loadIndex(index_file, listings, listed);
+	bool changed = false;
+	for (size_t i = 1; i < sources.size(); i++)
+	{
+		if (listed[i])
+			continue;
+		BSA::BSAFile bsa(sources[i].path);
+		listings[i] = bsa.assets(".*");
+		changed = true;
+	}
+	if (!index_file.empty() && (changed || !reused))
+		saveIndex(index_file, listings);
+
+	std::vector<std::string> loose;
+	if (fs::is_directory(data_folder))
+	{
+		std::error_code ec;
+		for (auto it = fs::recursive_directory_iterator(data_folder, ec); it != fs::recursive_directory_iterator(); it.increment(ec))
+		{
+			if (ec)
+				break;
+			if (it->is_regular_file(ec))
+				loose.push_back(fs::relative(it->path(), data_folder, ec).string());
+		}
+	}
+
+	size_t total = loose.size();
+	for (const auto& listing : listings)
+		total += listing.size();
+	index.reserve(total);
+
+	for (const auto& file : loose)
+		index.emplace(normalize(file), (uint16_t)0);
+	for (size_t i = 1; i < sources.size(); i++)
+		for (const auto& asset : listings[i])
+			index.emplace(normalize(asset), (uint16_t)i);
+
+	Log::Info("VFS: %zu loose files, %zu archives (%s), %zu paths", loose.size(), sources.size() - 1, changed ? "listed" : "cached", index.size());
+}
+
+bool VirtualFileSystem::loadIndex(const fs::path& index_file, std::vector<std::vector<std::string>>& listings, std::vector<char>& listed)
+{
+	std::ifstream in(index_file.string());
+	std::string line;
+	if (!in.is_open() || !std::getline(in, line) || line != vfs_index_magic)
+		return false;
+
+	//archive lines: size mtime count path, followed by count asset lines
+	while (std::getline(in, line))
+	{
+		std::istringstream header(line);
+		uint64_t size = 0;
+		int64_t mtime = 0;
+		size_t count = 0;
+		std::string path;
+		if (!(header >> size >> mtime >> count) || !std::getline(header >> std::ws, path))
+			return false;
+
+		std::vector<std::string> assets(count);
+		for (size_t i = 0; i < count; i++)
+			if (!std::getline(in, assets[i]))
+				return false;
+
+		for (size_t i = 1; i < sources.size(); i++)
+		{
+			if (sources[i].path.string() == path && sources[i].size == size && sources[i].mtime == mtime)
+			{
+				listings[i] = std::move(assets);
+				listed[i] = 1;
+				break;
+			}
+		}
+	}
+	return true;
+}
+
+void VirtualFileSystem::saveIndex(const fs::path& index_file, const std::vector<std::vector<std::string>>& listings)
+{
+	std::error_code ec;
+	if (index_file.has_parent_path())
+		fs::create_directories(index_file.parent_path(), ec);
+	std::ofstream out(index_file.string(), std::ios::trunc);
+	if (!out.is_open())
+	{
+		Log::Warn("VFS: unable to write the index file %s", index_file.string().c_str());
+		return;
+	}
+	out << vfs_index_magic << '\n';
+	for (size_t i = 1; i < sources.size(); i++)
+	{
+		out << sources[i].size << ' ' << sources[i].mtime << ' ' << listings[i].size() << ' ' << sources[i].path.string() << '\n';
+		for (const auto& asset : listings[i])
+			out << asset << '\n';
+	}
+}
+
+const VirtualFileSystem::Source* VirtualFileSystem::find(std::string_view path) const
+{
+	auto it = index.find(normalize(path));
+	if (it == index.end())
+		return nullptr;
+	return &sources[it->second];
+}
+
+bool VirtualFileSystem::exists(std::string_view path) const
+{
+	return find(path) != nullptr;
+}
+
+bool VirtualFileSystem::in_archive(std::string_view path) const
+{
+	const Source* source = find(path);
+	return source != nullptr && source->archive;
+}
+
+fs::path VirtualFileSystem::source(std::string_view path) const
+{
+	const Source* found = find(path);
+	if (found == nullptr)
+		return fs::path();
+	if (!found->archive)
+		return found->path / normalize(path);
+	return found->path;
+}
+
+FileView VirtualFileSystem::open(std::string_view path)
+{
+	FileView view;
+	std::string key = normalize(path);
+	auto it = index.find(key);
+	if (it == index.end())
+		return view;
+
+	Source& found = sources[it->second];
+	if (!found.archive)
+	{
+		view.mapping = MappedFile(found.path / key);
+		view.bytes = view.mapping.data();
+		view.length = view.mapping.size();
+		return view;
+	}
+
+	//libbsa handles are not thread safe
+	std::lock_guard<std::mutex> lock(*found.handle_mutex);
+	if (!found.handle)
+		found.handle = std::make_unique<BSA::BSAFile>(found.path);
+	size_t size = 0;
+	const uint8_t* data = found.handle->extract(key, size);
+	view.extracted.reset(data);
+	view.bytes = data;
+	view.length = data != nullptr ? size : 0;
+	return view;
+}
+
+std::vector<std::string> VirtualFileSystem::files(std::string_view extension) const
+{
+	std::vector<std::string> out;
+	for (const auto& entry : index)
+	{
+		const std::string& path = entry.first;
+		if (path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0)
+			out.push_back(path);
+	}
+	return out;
+}
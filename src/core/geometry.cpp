@@ -2,6 +2,15 @@
 //#include <core/hkxcmd.h>
 //#include <core/hkfutils.h>
 //#include <core/log.h>
+#include <core/ThreadPool.h>
+
+#include <cfloat>
+#include <cmath>
+#include <functional>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 using namespace ckcmd::Geometry;
 
@@ -175,6 +184,208 @@ public:
 	}
 };
 
+//skin of a shape flattened out of its partitions. Influences are stored per absolute
+//vertex with a fixed stride, strongest first, bones renumbered densely in skin order
+struct FlatSkin {
+	size_t stride = 0;
+	vector<uint32_t> triangles;				//3 absolute vertices each
+	vector<uint8_t> influence_count;		//per vertex
+	vector<uint32_t> influence_bones;		//vertex * stride + i -> dense bone
+	vector<float> influence_weights;
+	vector<unsigned short> bone_ids;		//dense bone -> skin instance bone
+};
+
+static void flatten_skin(vector<SkinPartition>& blocks, size_t stride, FlatSkin& skin)
+{
+	skin.stride = stride;
+	size_t vertices = 0;
+	for (auto& block : blocks)
+	{
+		auto new_triangles = triangulate(block.strips);
+		block.triangles.insert(block.triangles.end(), new_triangles.begin(), new_triangles.end());
+		for (size_t v = 0; v < block.vertexWeights.size(); v++)
+			vertices = max(vertices, (size_t)(block.vertexMap.empty() ? v : block.vertexMap[v]) + 1);
+	}
+
+	skin.influence_count.assign(vertices, 0);
+	skin.influence_bones.assign(vertices * stride, 0);
+	skin.influence_weights.assign(vertices * stride, 0.0f);
+	vector<char> filled(vertices, 0);
+	vector<char> used_bones;
+
+	for (auto& block : blocks)
+	{
+		for (size_t v = 0; v < block.vertexWeights.size() && v < block.boneIndices.size(); v++)
+		{
+			size_t vertex = block.vertexMap.empty() ? v : block.vertexMap[v];
+			//a vertex shared by two partitions has the same weights in both
+			if (filled[vertex])
+				continue;
+			filled[vertex] = 1;
+			uint32_t* bones = &skin.influence_bones[vertex * stride];
+			float* weights = &skin.influence_weights[vertex * stride];
+			size_t count = 0;
+			const auto& vertexBones = block.boneIndices[v];
+			const auto& vertexWeights = block.vertexWeights[v];
+			for (size_t i = 0; i < vertexWeights.size() && i < vertexBones.size(); i++)
+			{
+				float weight = vertexWeights[i];
+				if (weight <= 0.001f)
+					continue;
+				uint32_t bone = block.bones[vertexBones[i]];
+				//insertion by weight, keeping only the strongest stride influences
+				size_t at = count;
+				while (at > 0 && (weights[at - 1] < weight || (weights[at - 1] == weight && bones[at - 1] > bone)))
+					at--;
+				if (at >= stride)
+					continue;
+				for (size_t j = min(count, stride - 1); j > at; j--)
+				{
+					weights[j] = weights[j - 1];
+					bones[j] = bones[j - 1];
+				}
+				weights[at] = weight;
+				bones[at] = bone;
+				count = min(count + 1, stride);
+			}
+			skin.influence_count[vertex] = (uint8_t)count;
+			for (size_t i = 0; i < count; i++)
+			{
+				if (bones[i] >= used_bones.size())
+					used_bones.resize(bones[i] + 1, 0);
+				used_bones[bones[i]] = 1;
+			}
+		}
+		for (const auto& tris : block.triangles)
+		{
+			for (size_t i = 0; i < 3; i++)
+			{
+				size_t v = tris[i];
+				size_t vertex = block.vertexMap.empty() ? v : block.vertexMap[v];
+				if (vertex >= vertices)
+					throw runtime_error("Skin partition triangle references a vertex without weights");
+				skin.triangles.push_back((uint32_t)vertex);
+			}
+		}
+	}
+
+	vector<uint32_t> dense(used_bones.size(), 0);
+	for (size_t b = 0; b < used_bones.size(); b++)
+	{
+		if (!used_bones[b])
+			continue;
+		dense[b] = (uint32_t)skin.bone_ids.size();
+		skin.bone_ids.push_back((unsigned short)b);
+	}
+	for (size_t vertex = 0; vertex < vertices; vertex++)
+		for (size_t i = 0; i < skin.influence_count[vertex]; i++)
+			skin.influence_bones[vertex * stride + i] = dense[skin.influence_bones[vertex * stride + i]];
+}
+
+static size_t count_bits(const uint64_t* words, size_t size)
+{
+	size_t count = 0;
+	for (size_t w = 0; w < size; w++)
+		count += std::bitset<64>(words[w]).count();
+	return count;
+}
+
+//Groups the triangles so that no group uses more than max_bones bones. Groups grow through
+//shared vertices from the first free triangle, then take any later triangle that still fits.
+//Everything is visited in triangle order, the result depends only on the input
+static vector<vector<uint32_t>> pack_partitions(const FlatSkin& skin, size_t max_bones)
+{
+	size_t triangles = skin.triangles.size() / 3;
+	size_t vertices = skin.influence_count.size();
+	size_t words = (skin.bone_ids.size() + 63) / 64;
+
+	//bones of every triangle as a bitset
+	vector<uint64_t> triangle_bones(max<size_t>(triangles * words, 1), 0);
+	for (size_t t = 0; t < triangles; t++)
+	{
+		uint64_t* bits = &triangle_bones[t * words];
+		for (size_t i = 0; i < 3; i++)
+		{
+			size_t vertex = skin.triangles[t * 3 + i];
+			for (size_t b = 0; b < skin.influence_count[vertex]; b++)
+			{
+				uint32_t bone = skin.influence_bones[vertex * skin.stride + b];
+				bits[bone / 64] |= uint64_t(1) << (bone % 64);
+			}
+		}
+	}
+
+	//vertex -> triangles adjacency, compressed rows
+	vector<uint32_t> adjacency_offsets(vertices + 1, 0);
+	for (uint32_t vertex : skin.triangles)
+		adjacency_offsets[vertex + 1]++;
+	for (size_t v = 0; v < vertices; v++)
+		adjacency_offsets[v + 1] += adjacency_offsets[v];
+	vector<uint32_t> adjacency(skin.triangles.size());
+	vector<uint32_t> cursor(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+	for (size_t t = 0; t < triangles; t++)
+		for (size_t i = 0; i < 3; i++)
+			adjacency[cursor[skin.triangles[t * 3 + i]]++] = (uint32_t)t;
+
+	vector<vector<uint32_t>> partitions;
+	vector<char> assigned(triangles, 0);
+	vector<uint64_t> partition_bones(max<size_t>(words, 1), 0);
+	size_t partition_bone_count = 0;
+	vector<uint32_t> queue;
+	queue.reserve(triangles);
+
+	auto try_add = [&](size_t t) -> bool {
+		if (assigned[t])
+			return false;
+		const uint64_t* bits = &triangle_bones[t * words];
+		size_t added = 0;
+		for (size_t w = 0; w < words; w++)
+			added += std::bitset<64>(bits[w] & ~partition_bones[w]).count();
+		//a triangle is always accepted by an empty partition, even above the limit
+		if (partition_bone_count > 0 && partition_bone_count + added > max_bones)
+			return false;
+		for (size_t w = 0; w < words; w++)
+			partition_bones[w] |= bits[w];
+		partition_bone_count += added;
+		assigned[t] = 1;
+		partitions.back().push_back((uint32_t)t);
+		return true;
+	};
+
+	size_t seed = 0;
+	while (true)
+	{
+		while (seed < triangles && assigned[seed])
+			seed++;
+		if (seed == triangles)
+			break;
+
+		partitions.emplace_back();
+		fill(partition_bones.begin(), partition_bones.end(), 0);
+		partition_bone_count = 0;
+		for (size_t scan = seed; scan < triangles; scan++)
+		{
+			if (!try_add(scan))
+				continue;
+			queue.assign(1, (uint32_t)scan);
+			for (size_t head = 0; head < queue.size(); head++)
+			{
+				uint32_t t = queue[head];
+				for (size_t i = 0; i < 3; i++)
+				{
+					uint32_t vertex = skin.triangles[t * 3 + i];
+					for (uint32_t a = adjacency_offsets[vertex]; a < adjacency_offsets[vertex + 1]; a++)
+						if (try_add(adjacency[a]))
+							queue.push_back(adjacency[a]);
+				}
+			}
+		}
+		//keep the source triangle order inside a partition
+		sort(partitions.back().begin(), partitions.back().end());
+	}
+	return partitions;
+}
+
 //remake partitions after triangulating
 NiTriShapeRef remake_partitions(NiTriBasedGeomRef iShape, int & maxBonesPerPartition, int & maxBonesPerVertex, bool make_strips, bool pad)
 {
@@ -197,260 +408,73 @@ NiTriShapeRef remake_partitions(NiTriBasedGeomRef iShape, int & maxBonesPerParti
 		NiSkinDataRef iSkinData = iSkinInst->GetData();
 		NiSkinPartitionRef iSkinPart = iSkinInst->GetSkinPartition();
 
-		set<size_t> bones;
-
 		if (iSkinPart == NULL)
 			iSkinPart = iSkinData->GetSkinPartition();
 
-		//bone -> {triangle, weight}
 		auto blocks = iSkinPart->GetSkinPartitionBlocks();
 
-		typedef std::array< tuple<size_t, size_t, float>, 12> triangle_data_t;
+		size_t weights_per_vertex = (size_t)max(1, min(maxBonesPerVertex, 4));
+		size_t bones_per_partition = (size_t)max(1, maxBonesPerPartition);
 
-		vector<triangle_data_t> global_map;
-		multimap< size_t, size_t> vertex_triangle_map;
+		FlatSkin skin;
+		flatten_skin(blocks, weights_per_vertex, skin);
+		vector<vector<uint32_t>> partitions = pack_partitions(skin, bones_per_partition);
 
+		//absolute vertex/dense bone -> index in the partition being built
+		vector<int> local_vertex(skin.influence_count.size(), -1);
+		vector<int> local_bone(skin.bone_ids.size(), -1);
+		vector<uint32_t> partition_bones;
 
-		for (int i = 0; i < blocks.size(); i++)
+		vector<Niflib::SkinPartition> new_blocks(partitions.size());
+		for (size_t p = 0; p < partitions.size(); p++)
 		{
-			auto& block = blocks[i];
-
-			auto new_triangles = triangulate(block.strips);
-			for (auto& tris : new_triangles)
-				block.triangles.push_back(tris);
-
-			for (size_t t = 0; t < block.triangles.size(); t++) {
-
-				triangle_data_t data;
-
-				size_t v1 = block.triangles[t].v1;
-				size_t v2 = block.triangles[t].v2;
-				size_t v3 = block.triangles[t].v3;
-
-
-
-				auto vertexBonesV1 = block.boneIndices[v1];
-				auto vertexWeightsV1 = block.vertexWeights[v1];
-
-				for (size_t bi = 0; bi < vertexWeightsV1.size(); bi++)
-				{
-					float weight = vertexWeightsV1[bi];
-					if (weight > 0.001)
-					{
-						size_t bindex = vertexBonesV1[bi];
-						bones.insert(block.bones[bindex]);
-						data[bi] = { block.vertexMap[v1], block.bones[bindex] , weight };
-					}
-					else {
-						data[bi] = { -1, -1, 0.0 };
-					}
-				}
-
-				auto vertexBonesV2 = block.boneIndices[v2];
-				auto vertexWeightsV2 = block.vertexWeights[v2];
-
-				for (size_t bi = 0; bi < vertexWeightsV2.size(); bi++)
-				{
-					float weight = vertexWeightsV2[bi];
-					if (weight > 0.001)
-					{
-						size_t bindex = vertexBonesV2[bi];
-						bones.insert(block.bones[bindex]);
-						data[bi + 4] = { block.vertexMap[v2], block.bones[bindex] , weight };
-					}
-					else {
-						data[bi + 4] = { -1, -1, 0.0 };
-					}
-				}
-
-				auto vertexBonesV3 = block.boneIndices[v3];
-				auto vertexWeightsV3 = block.vertexWeights[v3];
-
-				for (size_t bi = 0; bi < vertexWeightsV3.size(); bi++)
-				{
-					float weight = vertexWeightsV3[bi];
-					if (weight > 0.001)
-					{
-						size_t bindex = vertexBonesV3[bi];
-						bones.insert(block.bones[bindex]);
-						data[bi + 8] = { block.vertexMap[v3],  block.bones[bindex] , weight };
-					}
-					else {
-						data[bi + 8] = { -1, -1, 0.0 };
-					}
-				}
-
-				global_map.push_back(data);
-			}
-		}
-
-		vector<vector<triangle_data_t>::iterator> iters;
-		vector < vector < triangle_data_t>> new_partitions;
-
-		do {
-			iters.clear();
-			multi_partition(global_map.begin(), global_map.end(), std::back_inserter(iters),
-				[&new_partitions](triangle_data_t i) {
-					bool result = true;
-					for (int j = 0; j < 12; j++)
-					{
-						if (get<1>(i[j]) == -1)
-							continue;
-						if (get<1>(i[j]) < 60 * (new_partitions.size() + 1))
-							result &= true;
-						else
-							result &= false;
-					}
-					return result;
-				}
-			);
-			size_t it_distance = distance(global_map.begin(), iters[0]);
-			if (it_distance == global_map.size())
-				break;
-			auto it = iters[0] - 1;
-			vector <triangle_data_t> temp_partition(distance(global_map.begin(), it));
-			move(global_map.begin(), it, temp_partition.begin());
-			new_partitions.push_back(temp_partition);
-			global_map.erase(global_map.begin(), it);
-		} while (!iters.empty());
-
-		vector < triangle_data_t> temp_partition(distance(global_map.begin(), global_map.end()));
-		move(global_map.begin(), global_map.end(), temp_partition.begin());
-		new_partitions.push_back(temp_partition);
-		global_map.erase(global_map.begin(), global_map.end());
-
-		assert(global_map.empty());
-
-		vector<vector<boneweight> > weights;
-		vector<Niflib::SkinPartition> new_blocks(new_partitions.size());
-		for (size_t p = 0; p < new_partitions.size(); p++)
-		{
-			auto& new_partition = new_partitions[p];
 			auto& new_block = new_blocks[p];
-			for (size_t t = 0; t < new_partition.size(); t++)
+			partition_bones.clear();
+			for (uint32_t t : partitions[p])
 			{
-				auto& data = new_partition[t];
 				Niflib::Triangle tris;
 				for (size_t i = 0; i < 3; i++)
 				{
-					size_t absolute_vertex_index = -1;
-					for (int w = 0; w < 4; w++)
+					uint32_t vertex = skin.triangles[t * 3 + i];
+					if (local_vertex[vertex] < 0)
 					{
-						if (get<0>(data[i * 4 + w]) != -1)
+						local_vertex[vertex] = (int)new_block.vertexMap.size();
+						new_block.vertexMap.push_back((unsigned short)vertex);
+
+						size_t count = skin.influence_count[vertex];
+						const uint32_t* bones = &skin.influence_bones[vertex * skin.stride];
+						const float* weights = &skin.influence_weights[vertex * skin.stride];
+						float sum = 0.0f;
+						for (size_t w = 0; w < count; w++)
+							sum += weights[w];
+
+						//strongest first, padded and renormalized
+						vector<float> vertexWeights(weights_per_vertex, 0.0f);
+						vector<unsigned char> vertexBones(weights_per_vertex, 0);
+						for (size_t w = 0; w < count; w++)
 						{
-							absolute_vertex_index = get<0>(data[i * 4 + w]);
-							break;
-						}
-					}
-					size_t relative_vertex_index;
-					if (absolute_vertex_index != -1)
-					{
-						auto it = find(new_block.vertexMap.begin(), new_block.vertexMap.end(), absolute_vertex_index);
-						if (it == new_block.vertexMap.end())
-						{
-							relative_vertex_index = new_block.vertexMap.size();
-							new_block.vertexMap.push_back(absolute_vertex_index);
-						}
-						else {
-							relative_vertex_index = distance(new_block.vertexMap.begin(), it);
-						}
-						tris[i] = relative_vertex_index;
-						for (int w = 0; w < 4; w++)
-						{
-							size_t absolute_bone_index = get<1>(data[i * w]);
-							if (absolute_bone_index != -1)
+							if (local_bone[bones[w]] < 0)
 							{
-								//relativize later
-								float weight = get<2>(data[i * w]);
-								if (new_block.boneIndices.size() < (relative_vertex_index + 1))
-									new_block.boneIndices.resize(relative_vertex_index + 1);
-								if (new_block.vertexWeights.size() < (relative_vertex_index + 1))
-									new_block.vertexWeights.resize(relative_vertex_index + 1);
-								auto& vertexBones = new_block.boneIndices[relative_vertex_index];
-								auto& vertexWeights = new_block.vertexWeights[relative_vertex_index];
-								if (find(vertexBones.begin(), vertexBones.end(), absolute_bone_index) == vertexBones.end())
-								{
-									vertexBones.push_back(absolute_bone_index);
-									vertexWeights.push_back(weight);
-								}
+								local_bone[bones[w]] = (int)new_block.bones.size();
+								new_block.bones.push_back(skin.bone_ids[bones[w]]);
+								partition_bones.push_back(bones[w]);
 							}
+							vertexBones[w] = (unsigned char)local_bone[bones[w]];
+							vertexWeights[w] = sum > 0.0f ? weights[w] / sum : weights[w];
 						}
+						new_block.vertexWeights.push_back(vertexWeights);
+						new_block.boneIndices.push_back(vertexBones);
 					}
+					tris[i] = (unsigned short)local_vertex[vertex];
 				}
 				new_block.triangles.push_back(tris);
 				new_block.trianglesCopy.push_back(tris);
 			}
-		}
+			for (unsigned short vertex : new_block.vertexMap)
+				local_vertex[vertex] = -1;
+			for (uint32_t bone : partition_bones)
+				local_bone[bone] = -1;
 
-		//reorder by weight
-		for (size_t p = 0; p < new_blocks.size(); p++)
-		{
-			auto& new_block = new_blocks[p];
-			for (int i = 0; i < new_block.vertexWeights.size(); i++)
-			{
-				auto perm = sort_permutation(new_block.vertexWeights[i],
-					[](float const& a, float const& b) { return a > b; });
-
-				new_block.vertexWeights[i] = apply_permutation(new_block.vertexWeights[i], perm);
-				new_block.boneIndices[i] = apply_permutation(new_block.boneIndices[i], perm);
-				assert(new_block.vertexWeights[i].size() == new_block.boneIndices[i].size());
-				while (new_block.vertexWeights[i].size() < 4) {
-					new_block.vertexWeights[i].push_back(0.0);
-					new_block.boneIndices[i].push_back(0);
-				}
-				while (new_block.vertexWeights[i].size() > 4) {
-					new_block.vertexWeights[i].pop_back();
-					new_block.boneIndices[i].pop_back();
-				}
-			}
-		}
-
-		//renormalize
-		for (size_t p = 0; p < new_blocks.size(); p++)
-		{
-			auto& new_block = new_blocks[p];
-			for (int i = 0; i < new_block.vertexWeights.size(); i++)
-			{
-				float sum = 0.0;
-				for (int j = 0; j < new_block.vertexWeights[i].size(); j++)
-				{
-					sum += new_block.vertexWeights[i][j];
-				}
-				if (sum > 0.0)
-				{
-					for (int j = 0; j < new_block.vertexWeights[i].size(); j++)
-					{
-						new_block.vertexWeights[i][j] = new_block.vertexWeights[i][j] / sum;
-					}
-				}
-			}
-		}
-
-		//relativize bone indexes
-		for (size_t p = 0; p < new_blocks.size(); p++)
-		{
-			auto& new_block = new_blocks[p];
-			for (int i = 0; i < new_block.vertexWeights.size(); i++)
-			{
-				for (int j = 0; j < new_block.vertexWeights[i].size(); j++)
-				{
-					if (new_block.vertexWeights[i][j] > 0.0)
-					{
-						size_t absolute_bone_index = new_block.boneIndices[i][j];
-						size_t relative_bone_index;
-						auto bone_it = find(new_block.bones.begin(), new_block.bones.end(), absolute_bone_index);
-						if (bone_it == new_block.bones.end())
-						{
-							relative_bone_index = new_block.bones.size();
-							new_block.bones.push_back(absolute_bone_index);
-						}
-						else {
-							relative_bone_index = distance(new_block.bones.begin(), bone_it);
-						}
-						new_block.boneIndices[i][j] = relative_bone_index;
-					}
-				}
-			}
 			new_block.hasVertexMap = true;
 			new_block.hasBoneIndices = true;
 			new_block.hasVertexWeights = true;
@@ -531,95 +555,189 @@ Vector3 ckcmd::Geometry::centeroid(const vector<Vector3>& in) {
 }
 
 
-void ckcmd::Geometry::CalculateNormals(const vector<Vector3>& vertices, const vector<Triangle>& faces,
-	vector<Vector3>& normals, Vector3& COM, bool sphericalNormals, bool calculateCOM) {
+//faces per task of the normal kernels, smaller meshes are done on the calling thread
+static const size_t normal_chunk = 16384;
 
-	if (!sphericalNormals)
+//by default one thread per core, or just the calling one when it already is a pool
+//worker, i.e. a ConvertNif -j model
+static void run_chunks(size_t count, size_t chunk, size_t threads, const std::function<void(size_t, size_t)>& body)
+{
+	size_t chunks = (count + chunk - 1) / chunk;
+	if (threads == 0)
+		threads = ckcmd::ThreadPool::on_worker() ? 1 : ckcmd::ThreadPool::default_threads();
+	threads = min(threads, chunks);
+	if (threads <= 1)
 	{
-		Eigen::MatrixXf V(vertices.size(), 3);
-		for (int i = 0; i < vertices.size(); i++) {
-			V(i, 0) = vertices[i].x;
-			V(i, 1) = vertices[i].y;
-			V(i, 2) = vertices[i].z;
-		}
-		Eigen::MatrixXi F(faces.size(), 3);
-		for (int i = 0; i < faces.size(); i++) {
-			F(i, 0) = faces[i].v1;
-			F(i, 1) = faces[i].v2;
-			F(i, 2) = faces[i].v3;
+		body(0, count);
+		return;
+	}
+	ckcmd::ThreadPool pool(threads);
+	pool.parallel_for(chunks, [&](size_t c) {
+		body(c * chunk, min(count, (c + 1) * chunk));
+	});
+}
+
+//unit normal and doubled area of the faces in [begin, end), as separate arrays
+static void face_normals(const float* x, const float* y, const float* z, const Triangle* faces, size_t begin, size_t end,
+	float* fx, float* fy, float* fz, float* farea)
+{
+	size_t f = begin;
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	for (; f + 4 <= end; f += 4)
+	{
+		alignas(16) float e1[3][4], e2[3][4];
+		for (size_t i = 0; i < 4; i++)
+		{
+			const Triangle& t = faces[f + i];
+			e1[0][i] = x[t.v2] - x[t.v1]; e1[1][i] = y[t.v2] - y[t.v1]; e1[2][i] = z[t.v2] - z[t.v1];
+			e2[0][i] = x[t.v3] - x[t.v1]; e2[1][i] = y[t.v3] - y[t.v1]; e2[2][i] = z[t.v3] - z[t.v1];
 		}
+		__m128 ax = _mm_load_ps(e1[0]), ay = _mm_load_ps(e1[1]), az = _mm_load_ps(e1[2]);
+		__m128 bx = _mm_load_ps(e2[0]), by = _mm_load_ps(e2[1]), bz = _mm_load_ps(e2[2]);
+		__m128 cx = _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by));
+		__m128 cy = _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz));
+		__m128 cz = _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx));
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, cx), _mm_mul_ps(cy, cy)), _mm_mul_ps(cz, cz)));
+		//degenerate faces get a zero normal
+		__m128 inverse = _mm_and_ps(_mm_cmpgt_ps(length, zero), _mm_div_ps(one, _mm_max_ps(length, _mm_set1_ps(FLT_MIN))));
+		_mm_storeu_ps(fx + f, _mm_mul_ps(cx, inverse));
+		_mm_storeu_ps(fy + f, _mm_mul_ps(cy, inverse));
+		_mm_storeu_ps(fz + f, _mm_mul_ps(cz, inverse));
+		_mm_storeu_ps(farea + f, length);
+	}
+#endif
+	for (; f < end; f++)
+	{
+		const Triangle& t = faces[f];
+		float ax = x[t.v2] - x[t.v1], ay = y[t.v2] - y[t.v1], az = z[t.v2] - z[t.v1];
+		float bx = x[t.v3] - x[t.v1], by = y[t.v3] - y[t.v1], bz = z[t.v3] - z[t.v1];
+		float cx = ay * bz - az * by, cy = az * bx - ax * bz, cz = ax * by - ay * bx;
+		float length = sqrt(cx * cx + cy * cy + cz * cz);
+		float inverse = length > 0.0f ? 1.0f / length : 0.0f;
+		fx[f] = cx * inverse;
+		fy[f] = cy * inverse;
+		fz[f] = cz * inverse;
+		farea[f] = length;
+	}
+}
 
-		Eigen::MatrixXf N_vertices;
+static float corner_angle(const float* x, const float* y, const float* z, unsigned short at, unsigned short a, unsigned short b)
+{
+	float ax = x[a] - x[at], ay = y[a] - y[at], az = z[a] - z[at];
+	float bx = x[b] - x[at], by = y[b] - y[at], bz = z[b] - z[at];
+	float cx = ay * bz - az * by, cy = az * bx - ax * bz, cz = ax * by - ay * bx;
+	return atan2(sqrt(cx * cx + cy * cy + cz * cz), ax * bx + ay * by + az * bz);
+}
 
-		igl::per_vertex_normals(V, F, igl::PER_VERTEX_NORMALS_WEIGHTING_TYPE_UNIFORM, N_vertices);
+void ckcmd::Geometry::AccumulateNormals(const float* x, const float* y, const float* z, size_t vertex_count,
+	const Triangle* faces, size_t face_count, NormalWeighting weighting,
+	float* nx, float* ny, float* nz, size_t threads)
+{
+	vector<float> fx(face_count), fy(face_count), fz(face_count), farea(face_count);
+	vector<float> angles(weighting == NORMALS_ANGLE ? face_count * 3 : 0);
+	run_chunks(face_count, normal_chunk, threads, [&](size_t begin, size_t end) {
+		face_normals(x, y, z, faces, begin, end, fx.data(), fy.data(), fz.data(), farea.data());
+		if (weighting == NORMALS_ANGLE)
+		{
+			for (size_t f = begin; f < end; f++)
+			{
+				const Triangle& t = faces[f];
+				angles[f * 3] = corner_angle(x, y, z, t.v1, t.v2, t.v3);
+				angles[f * 3 + 1] = corner_angle(x, y, z, t.v2, t.v3, t.v1);
+				angles[f * 3 + 2] = corner_angle(x, y, z, t.v3, t.v1, t.v2);
+			}
+		}
+	});
+
+	//vertex -> face corners, compressed rows in face order
+	vector<uint32_t> offsets(vertex_count + 1, 0);
+	for (size_t f = 0; f < face_count; f++)
+	{
+		offsets[faces[f].v1 + 1]++;
+		offsets[faces[f].v2 + 1]++;
+		offsets[faces[f].v3 + 1]++;
+	}
+	for (size_t v = 0; v < vertex_count; v++)
+		offsets[v + 1] += offsets[v];
+	vector<uint32_t> corners(face_count * 3);
+	vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+	for (size_t f = 0; f < face_count; f++)
+	{
+		corners[cursor[faces[f].v1]++] = (uint32_t)(f * 3);
+		corners[cursor[faces[f].v2]++] = (uint32_t)(f * 3 + 1);
+		corners[cursor[faces[f].v3]++] = (uint32_t)(f * 3 + 2);
+	}
 
-		normals.resize(vertices.size());
-		for (int i = 0; i < vertices.size(); i++) {
-			normals[i] = Vector3(N_vertices(i, 0), N_vertices(i, 1), N_vertices(i, 2));
+	run_chunks(vertex_count, normal_chunk, threads, [&](size_t begin, size_t end) {
+		for (size_t v = begin; v < end; v++)
+		{
+			float sx = 0.0f, sy = 0.0f, sz = 0.0f;
+			for (uint32_t c = offsets[v]; c < offsets[v + 1]; c++)
+			{
+				size_t f = corners[c] / 3;
+				float weight = weighting == NORMALS_AREA ? farea[f] : weighting == NORMALS_ANGLE ? angles[corners[c]] : 1.0f;
+				sx += fx[f] * weight;
+				sy += fy[f] * weight;
+				sz += fz[f] * weight;
+			}
+			float length = sqrt(sx * sx + sy * sy + sz * sz);
+			float inverse = length > 0.0f ? 1.0f / length : 0.0f;
+			nx[v] = sx * inverse;
+			ny[v] = sy * inverse;
+			nz[v] = sz * inverse;
 		}
+	});
+}
+
+void ckcmd::Geometry::CalculateNormals(const vector<Vector3>& vertices, const vector<Triangle>& faces,
+	vector<Vector3>& normals, NormalWeighting weighting, size_t threads)
+{
+	size_t count = vertices.size();
+	vector<float> positions(count * 3), results(count * 3);
+	for (size_t i = 0; i < count; i++)
+	{
+		positions[i] = vertices[i].x;
+		positions[count + i] = vertices[i].y;
+		positions[count * 2 + i] = vertices[i].z;
 	}
-	else {
+	AccumulateNormals(positions.data(), positions.data() + count, positions.data() + count * 2, count,
+		faces.data(), faces.size(), weighting,
+		results.data(), results.data() + count, results.data() + count * 2, threads);
+	normals.resize(count);
+	for (size_t i = 0; i < count; i++)
+		normals[i] = Vector3(results[i], results[count + i], results[count * 2 + i]);
+}
 
-		std::map<unsigned int, vector<Vector3>> normalMap;
+void ckcmd::Geometry::CalculateNormals(const vector<Vector3>& vertices, const vector<Triangle>& faces,
+	vector<Vector3>& normals, Vector3& COM, bool sphericalNormals, bool calculateCOM) {
+
+	if (!sphericalNormals)
+	{
+		CalculateNormals(vertices, faces, normals, NORMALS_UNIFORM);
+	}
+	else {
 
 		if (normals.size() != vertices.size())
 			normals.resize(vertices.size());
 		//test faces before start
-		set<unsigned int> faceIndexes;
-		for (Triangle face : faces) {
-			faceIndexes.insert(face.v1); faceIndexes.insert(face.v2); faceIndexes.insert(face.v3);
+		vector<char> indexed(vertices.size(), 0);
+		for (const Triangle& face : faces) {
+			indexed[face.v1] = 1; indexed[face.v2] = 1; indexed[face.v3] = 1;
 		}
 
 		for (size_t i = 0; i < vertices.size(); i++)
-			if (faceIndexes.find(i) == faceIndexes.end())
-				throw runtime_error("Found unindexed vertex: " + i);
+			if (!indexed[i])
+				throw runtime_error("Found unindexed vertex: " + to_string(i));
 
 		if (calculateCOM)
 			COM = centeroid(vertices);
 
-		for (Triangle face : faces) {
-			Vector3 v1 = vertices[face.v1].Normalized();
-			Vector3 v2 = vertices[face.v2].Normalized();
-			Vector3 v3 = vertices[face.v3].Normalized();
-
-			Vector3 v12 = v2 - v1;
-			Vector3 v13 = v3 - v1;
-			Vector3 v23 = v3 - v2;
-
-			//All the possible normals
-			Vector3 n1 = v12 ^ v13;
-			Vector3 n2 = v12 ^ v23;
-			Vector3 n3 = v13 ^ v23;
-
-			Vector3 COT = centeroid(vector<Vector3>({ v1,v2,v3 }));
-
-			Vector3 COMtoCOT = Vector3(COT - COM).Normalized();
-
-			//we always want a normal that is faced out of the body
-			if (sphericalNormals) {
-				Vector3 COMv1 = Vector3(v1 - COM);
-				n1 = COMv1.Normalized();
-				Vector3 COMv2 = Vector3(v2 - COM);
-				n2 = COMv2.Normalized();
-				Vector3 COMv3 = Vector3(v3 - COM);
-				n3 = COMv3.Normalized();
-			}
-			else {
-				if (n1 * COMtoCOT < 0)
-					n1 = Vector3(-n1.x, -n1.y, -n1.z);
-				if (n2 * COMtoCOT < 0)
-					n2 = Vector3(-n2.x, -n2.y, -n2.z);
-				if (n3 * COMtoCOT < 0)
-					n3 = Vector3(-n3.x, -n3.y, -n3.z);
-			}
-
-			normalMap[face.v1].push_back(n1.Normalized());
-			normalMap[face.v2].push_back(n2.Normalized());
-			normalMap[face.v3].push_back(n3.Normalized());
-		}
-
+		//we always want a normal that is faced out of the body: every face gives its vertices
+		//the same direction from the center of mass, so there is nothing to average
 		for (size_t i = 0; i < vertices.size(); i++) {
-			normals[i] = centeroid(normalMap[i]).Normalized();
+			normals[i] = Vector3(vertices[i].Normalized() - COM).Normalized();
 		}
 	}
 }
@@ -1,119 +1,144 @@
 #include "stdafx.h"
 #include <core/hkcrc.h>
+#include <core/log.h>
 
-int HkCRC::reflectByte(int c)
-{
-	int outbyte = 0;
-	int i = 0x01;
-	int j;
+namespace {
 
-	for (j = 0x80; j>0; j >>= 1)
+	//slicing-by-8 tables for the reflected polynomial 0xEDB88320
+	struct CRCTables
 	{
-		int val = c & i;
-		if (val > 0) outbyte |= j;
-		i <<= 1;
-	}
-	return (outbyte);
-}
-
-int* HkCRC::reflect(int* crc, int bitnum, int startLSB)
-{
-	int i, j, k, iw, jw, bit;
-
-	for (k = 0; k + startLSB<bitnum - 1 - k; k++) {
+		uint32_t table[8][256];
 
-		iw = 7 - ((k + startLSB) >> 3);
-		jw = 1 << ((k + startLSB) & 7);
-		i = 7 - ((bitnum - 1 - k) >> 3);
-		j = 1 << ((bitnum - 1 - k) & 7);
+		CRCTables()
+		{
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				uint32_t crc = i;
+				for (int j = 0; j < 8; j++)
+					crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+				table[0][i] = crc;
+			}
+			for (uint32_t i = 0; i < 256; i++)
+				for (int k = 1; k < 8; k++)
+					table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xFF];
+		}
+	};
 
-		bit = crc[iw] & jw;
-		if ((crc[i] & j)>0) crc[iw] |= jw;
-		else crc[iw] &= (0xff - jw);
-		if ((bit)>0) crc[i] |= j;
-		else crc[i] &= (0xff - j);
+	const CRCTables& tables()
+	{
+		static const CRCTables instance;
+		return instance;
 	}
-	return(crc);
-}
 
-std::string HkCRC::compute(std::string input) {
-
-	// computes crc value
-	int i, j, k, bit, datalen, len, flag, counter, c, order, ch, actchar;
-	std::string data, output;
-	int mask[8];
-	std::string hexnum[] = { "0","1","2","3","4","5","6","7","8","9","A","B","C","D","E","F" };
-	int polynom[] = { 0,0,0,0,4,193,29,183 };
-	int init[] = { 0,0,0,0,0,0,0,0 };
-	int* crc = new int[9](); //{ 0,0,0,0,0,0,0,0,0 };
-	int xor_array[] = { 0,0,0,0,0,0,0,0 };
-	order = crc_order;
-
-	// generate bit mask
-	counter = order;
-	for (i = 7; i>0; i--)
+	inline uint32_t load32(const unsigned char* p)
 	{
-		if (counter >= 8) mask[i] = 255;
-		else mask[i] = (1 << counter) - 1;
-		counter -= 8;
-		if (counter<0) counter = 0;
+		return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
 	}
-	data = input;
-	datalen = data.length();
-	len = 0;
-	for (i = 0; i<datalen; i++)
+
+	uint32_t update_bytes(uint32_t crc, const unsigned char* data, size_t size)
 	{
-		c = (int)data.at(i);
-		if (data.at(i) == '%')				// unescape ::byte by ::byte (%00 allowed)
+		const auto& t = tables().table;
+		for (; size >= 8; data += 8, size -= 8)
 		{
-			if (i > datalen - 3)
-				throw std::runtime_error("Invalid data sequence");
+			uint32_t lo = crc ^ load32(data);
+			uint32_t hi = load32(data + 4);
+			crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+				t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+		}
+		for (; size > 0; data++, size--)
+			crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xFF];
+		return crc;
+	}
 
-			try {
-				ch = (int)data.at(++i);
-				c = (int)data.at(++i);
-				c = (c & 15) | ((ch & 15) << 4);
-			}
-			catch (...) {
-				throw std::runtime_error("Invalid data sequence");
-				return "failure";
-			}
+	inline unsigned char normalize(unsigned char c)
+	{
+		if (c >= 'A' && c <= 'Z') return c + ('a' - 'A');
+		if (c == '/') return '\\';
+		return c;
+	}
+}
 
-		}
-		c = reflectByte(c);
-		for (j = 0; j<8; j++)
+bool HkCRC::update(uint32_t& crc, std::string_view input)
+{
+	const unsigned char* data = reinterpret_cast<const unsigned char*>(input.data());
+	size_t size = input.size();
+	size_t escape = input.find('%');
+	while (escape != std::string_view::npos)
+	{
+		crc = update_bytes(crc, data, escape);
+		// unescape byte by byte (%00 allowed)
+		if (escape + 2 >= size)
 		{
-			bit = 0;
-			if ((crc[7 - ((order - 1) >> 3)] & (1 << ((order - 1) & 7)))>0) bit = 1;
-			if ((c & 0x80)>0) bit ^= 1;
-			c <<= 1;
-			for (k = 0; k<8; k++)		// rotate all (max.8) crc bytes
-			{
-				crc[k] = ((crc[k] << 1) | (crc[k + 1] >> 7)) & mask[k];
-				if ((bit)>0) crc[k] ^= polynom[k];
-			}
+			Log::Error("Invalid data sequence");
+			return false;
 		}
-		len++;
+		unsigned char c = (unsigned char)((data[escape + 2] & 15) | ((data[escape + 1] & 15) << 4));
+		crc = update_bytes(crc, &c, 1);
+		data += escape + 3;
+		size -= escape + 3;
+		escape = std::string_view(reinterpret_cast<const char*>(data), size).find('%');
 	}
-	crc = reflect(crc, order, 0);
-	for (i = 0; i<8; i++) crc[i] ^= xor_array[i];
-	output = "";
-	flag = 0;
-	for (i = 0; i<8; i++)
+	crc = update_bytes(crc, data, size);
+	return true;
+}
+
+std::optional<uint32_t> HkCRC::crc32(std::string_view input)
+{
+	uint32_t crc = 0;
+	if (!update(crc, input))
+		return std::nullopt;
+	return crc;
+}
+
+std::optional<uint32_t> HkCRC::crc32_path(std::string_view input)
+{
+	//normalize in small chunks to keep the hashing loop free of allocations
+	unsigned char buffer[256];
+	if (input.find('%') == std::string_view::npos)
 	{
-		actchar = crc[i] >> 4;
-		if (flag>0 || actchar>0)
+		uint32_t crc = 0;
+		while (!input.empty())
 		{
-			output += hexnum[actchar];
-			flag = 1;
+			size_t chunk = std::min(input.size(), sizeof(buffer));
+			for (size_t i = 0; i < chunk; i++)
+				buffer[i] = normalize((unsigned char)input[i]);
+			crc = update_bytes(crc, buffer, chunk);
+			input.remove_prefix(chunk);
 		}
+		return crc;
+	}
+	std::string normalized(input);
+	for (char& c : normalized)
+		c = (char)normalize((unsigned char)c);
+	return crc32(normalized);
+}
 
-		actchar = crc[i] & 15;
-		if (flag>0 || actchar>0 || i == 7)
-		{
-			output += hexnum[actchar];
-			flag = 1;
-		}
+std::vector<std::optional<uint32_t>> HkCRC::crc32_paths(const std::vector<std::string>& inputs)
+{
+	std::vector<std::optional<uint32_t>> out;
+	out.reserve(inputs.size());
+	for (const auto& input : inputs)
+		out.push_back(crc32_path(input));
+	return out;
+}
+
+std::string HkCRC::cache_string(uint32_t crc)
+{
+	return std::to_string(crc);
+}
+
+std::string HkCRC::compute(std::string input)
+{
+	uint32_t crc = 0;
+	if (!update(crc, input))
+		return "failure";
+	const char hexnum[] = { '0','1','2','3','4','5','6','7','8','9','A','B','C','D','E','F' };
+	std::string output;
+	for (int shift = 28; shift >= 0; shift -= 4)
+	{
+		int digit = (crc >> shift) & 15;
+		if (!output.empty() || digit > 0 || shift == 0)
+			output += hexnum[digit];
 	}
 	return output;
-}
\ No newline at end of file
+}
@@ -4,9 +4,13 @@
 
 #include <malloc.h>
 #include <list>
+#include <mutex>
 
 static std::list<ILogListenerA*> listenersA;
 static std::list<ILogListenerW*> listenersW;
+//messages can come from worker threads, listeners see one message at a time
+static std::recursive_mutex listenersMutex;
+static thread_local ILogListenerA* threadListener = NULL;
 
 static bool logEnabled = true;
 static LogLevel logLevel = LOG_NONE;
@@ -16,6 +20,11 @@ static void DispatchMessage(LogLevel level, const wchar_t *message, int len);
 
 void DispatchMessage(LogLevel level, const char *message, int len)
 {
+	if (threadListener != NULL) {
+		threadListener->Message(level, message);
+		return;
+	}
+	std::lock_guard<std::recursive_mutex> lock(listenersMutex);
 	for (std::list<ILogListenerA*>::iterator itr = listenersA.begin(); itr != listenersA.end(); ++itr) {
 		(*itr)->Message(level, message);
 	}
@@ -32,6 +41,14 @@ void DispatchMessage(LogLevel level, const char *message, int len)
 
 void DispatchMessage(LogLevel level, const wchar_t *message, int len)
 {
+	if (threadListener != NULL) {
+		char* pbuf = (char*)_alloca((len+1) * sizeof(char));
+		size_t n;
+		wcstombs_s(&n, pbuf, len+1, message, len);
+		threadListener->Message(level, pbuf);
+		return;
+	}
+	std::lock_guard<std::recursive_mutex> lock(listenersMutex);
 	for (std::list<ILogListenerW*>::iterator itr = listenersW.begin(); itr != listenersW.end(); ++itr) {
 		(*itr)->Message(level, message);
 	}
@@ -63,44 +80,59 @@ LogLevel Log::GetLogLevel()
 
 void Log::AddListener( ILogListenerA* pListener )
 {
+	std::lock_guard<std::recursive_mutex> lock(listenersMutex);
 	listenersA.push_back(pListener);
 }
 
 void Log::AddListener( ILogListenerW* pListener )
 {
+	std::lock_guard<std::recursive_mutex> lock(listenersMutex);
 	listenersW.push_back(pListener);
 }
 
 
 void Log::ClearListeners()
 {
+	std::lock_guard<std::recursive_mutex> lock(listenersMutex);
 	listenersA.clear();
 	listenersW.clear();
 }
 
+ILogListenerA* Log::SetThreadListener( ILogListenerA* pListener )
+{
+	ILogListenerA* previous = threadListener;
+	threadListener = pListener;
+	return previous;
+}
+
+static bool HasListeners()
+{
+	return threadListener != NULL || !listenersA.empty() || !listenersW.empty();
+}
+
 bool Log::IsErrorEnabled()
 {
-	return logEnabled && logLevel <= LOG_ERROR && (!listenersA.empty() || !listenersW.empty());
+	return logEnabled && logLevel <= LOG_ERROR && HasListeners();
 }
 
 bool Log::IsWarnEnabled()
 {
-	return logEnabled && logLevel <= LOG_WARN && (!listenersA.empty() || !listenersW.empty());
+	return logEnabled && logLevel <= LOG_WARN && HasListeners();
 }
 
 bool Log::IsInfoEnabled()
 {
-	return logEnabled && logLevel <= LOG_INFO && (!listenersA.empty() || !listenersW.empty());
+	return logEnabled && logLevel <= LOG_INFO && HasListeners();
 }
 
 bool Log::IsDebugEnabled()
 {
-	return logEnabled && logLevel <= LOG_DEBUG && (!listenersA.empty() || !listenersW.empty());
+	return logEnabled && logLevel <= LOG_DEBUG && HasListeners();
 }
 
 bool Log::IsVerboseEnabled()
 {
-	return logEnabled && logLevel <= LOG_VERBOSE && (!listenersA.empty() || !listenersW.empty());
+	return logEnabled && logLevel <= LOG_VERBOSE && HasListeners();
 }
 
 void Log::Error( const char* format, ... )
@@ -241,11 +273,13 @@ void Log::MsgV( LogLevel level, const wchar_t* format, va_list args )
 
 void Log::RemoveListener( ILogListenerA* pListener )
 {
+	std::lock_guard<std::recursive_mutex> lock(listenersMutex);
 	listenersA.remove(pListener);
 }
 
 void Log::RemoveListener( ILogListenerW* pListener )
 {
+	std::lock_guard<std::recursive_mutex> lock(listenersMutex);
 	listenersW.remove(pListener);
 }
 
@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+
+#include <core/hkcrc.h>
+
+//expected values were computed with the bit by bit HkCRC::compute this class replaced
+
+TEST(HkCRC, ComputeMatchesLegacyHex)
+{
+	EXPECT_EQ("0", HkCRC::compute(""));
+	EXPECT_EQ("3AB551CE", HkCRC::compute("a"));
+	EXPECT_EQ("9282CE85", HkCRC::compute("1hm_attackleft"));
+	EXPECT_EQ("B8FA7643", HkCRC::compute("skeleton"));
+	EXPECT_EQ("5D063B92", HkCRC::compute("defaultmale"));
+	EXPECT_EQ("E80D9D69", HkCRC::compute("characters\\firstperson"));
+	EXPECT_EQ("DA4E4C4B", HkCRC::compute("actors\\character\\animations\\mt_idle.hkx"));
+	EXPECT_EQ("5CE4FE65", HkCRC::compute("meshes\\actors\\character\\animations\\1hm_attackleft.hkx"));
+}
+
+TEST(HkCRC, ComputeDecodesEscapes)
+{
+	EXPECT_EQ("6642E3B6", HkCRC::compute("abc%41def"));
+	EXPECT_EQ("0", HkCRC::compute("%00"));
+	EXPECT_EQ("failure", HkCRC::compute("abc%4"));
+}
+
+TEST(HkCRC, IntegerMatchesLegacyHex)
+{
+	EXPECT_EQ(0u, HkCRC::crc32(""));
+	EXPECT_EQ(0x3AB551CEu, HkCRC::crc32("a"));
+	EXPECT_EQ(0x9282CE85u, HkCRC::crc32("1hm_attackleft"));
+	EXPECT_EQ(0x6642E3B6u, HkCRC::crc32("abc%41def"));
+}
+
+TEST(HkCRC, PathIgnoresCaseAndSlashes)
+{
+	EXPECT_EQ(0u, HkCRC::crc32_path(""));
+	EXPECT_EQ(0x9282CE85u, HkCRC::crc32_path("1HM_AttackLeft"));
+	EXPECT_EQ(0xE80D9D69u, HkCRC::crc32_path("Characters/FirstPerson"));
+	EXPECT_EQ(0xE80D9D69u, HkCRC::crc32_path("characters\\firstperson"));
+	EXPECT_EQ(0x5CE4FE65u, HkCRC::crc32_path("Meshes/Actors\\Character/Animations\\1hm_AttackLeft.HKX"));
+
+	//names longer than the normalization buffer
+	std::string upper, lower;
+	for (int i = 0; i < 40; i++)
+	{
+		upper += "Actors/Character/";
+		lower += "actors\\character\\";
+	}
+	EXPECT_EQ(HkCRC::crc32(lower), HkCRC::crc32_path(upper));
+}
+
+TEST(HkCRC, PathsKeepOrder)
+{
+	std::vector<std::optional<uint32_t>> crcs = HkCRC::crc32_paths({ "Skeleton", "", "Bad%4", "DefaultMale" });
+	ASSERT_EQ(4u, crcs.size());
+	EXPECT_EQ(0xB8FA7643u, crcs[0]);
+	EXPECT_EQ(0u, crcs[1]);
+	EXPECT_FALSE(crcs[2].has_value());
+	EXPECT_EQ(0x5D063B92u, crcs[3]);
+}
+
+TEST(HkCRC, MalformedEscapesHaveNoCRC)
+{
+	EXPECT_FALSE(HkCRC::crc32("abc%4").has_value());
+	EXPECT_FALSE(HkCRC::crc32("%").has_value());
+	EXPECT_FALSE(HkCRC::crc32_path("Attack%4").has_value());
+	EXPECT_FALSE(HkCRC::crc32_path("50%").has_value());
+}
+
+TEST(HkCRC, CacheStringIsDecimal)
+{
+	EXPECT_EQ("2458046085", HkCRC::cache_string(0x9282CE85u));
+	EXPECT_EQ("0", HkCRC::cache_string(0));
+}
@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+
+#include <core/RawModel.h>
+
+//RawModel.cpp logs through the flag Fbx2Raw.cpp defines, the tests do not link the importer
+bool verboseOutput = false;
+
+static RawVertex vertex_at(float x, float y, float z)
+{
+	RawVertex vertex;
+	vertex.position = Vec3f(x, y, z);
+	vertex.normal = Vec3f(0.0f, 0.0f, 1.0f);
+	vertex.uv0 = Vec2f(x, y);
+	return vertex;
+}
+
+TEST(RawModel, MergesOnlyEqualVerticesByDefault)
+{
+	RawModel model;
+	EXPECT_EQ(0, model.AddVertex(vertex_at(1.0f, 2.0f, 3.0f)));
+	EXPECT_EQ(1, model.AddVertex(vertex_at(1.0f, 2.0f, 3.0001f)));
+	EXPECT_EQ(0, model.AddVertex(vertex_at(1.0f, 2.0f, 3.0f)));
+	//-0.0 and 0.0 are the same vertex
+	EXPECT_EQ(2, model.AddVertex(vertex_at(0.0f, 0.0f, 0.0f)));
+	EXPECT_EQ(2, model.AddVertex(vertex_at(-0.0f, 0.0f, -0.0f)));
+	EXPECT_EQ(3, model.GetVertexCount());
+}
+
+TEST(RawModel, WeldsNearDuplicateVertices)
+{
+	RawModel model;
+	model.SetWeldTolerance(0.001f);
+	EXPECT_EQ(0, model.AddVertex(vertex_at(1.0f, 2.0f, 3.0f)));
+	EXPECT_EQ(0, model.AddVertex(vertex_at(1.0004f, 2.0f, 2.9996f)));
+	//across a grid cell boundary
+	EXPECT_EQ(1, model.AddVertex(vertex_at(0.9999f, 0.0f, 0.0f)));
+	EXPECT_EQ(1, model.AddVertex(vertex_at(1.0001f, 0.0f, 0.0f)));
+	EXPECT_EQ(2, model.AddVertex(vertex_at(1.0f, 2.0f, 3.01f)));
+	EXPECT_EQ(3, model.GetVertexCount());
+}
+
+TEST(RawModel, WeldKeepsVerticesWithDistantAttributes)
+{
+	RawModel model;
+	model.SetWeldTolerance(0.001f);
+	RawVertex a = vertex_at(1.0f, 2.0f, 3.0f);
+	RawVertex b = a;
+	b.uv0 = Vec2f(0.5f, 0.5f);
+	RawVertex c = a;
+	c.normal = Vec3f(0.0f, 1.0f, 0.0f);
+	EXPECT_EQ(0, model.AddVertex(a));
+	EXPECT_EQ(1, model.AddVertex(b));
+	EXPECT_EQ(2, model.AddVertex(c));
+	EXPECT_EQ(0, model.AddVertex(vertex_at(1.0002f, 2.0f, 3.0f)));
+}
+
+TEST(RawModel, WeldMergesIntoTheLowestIndex)
+{
+	RawModel model;
+	EXPECT_EQ(0, model.AddVertex(vertex_at(0.0f, 0.0f, 0.0f)));
+	EXPECT_EQ(1, model.AddVertex(vertex_at(0.0006f, 0.0f, 0.0f)));
+	//vertices added before keep their indices, the later ones merge into the first match
+	model.SetWeldTolerance(0.001f);
+	EXPECT_EQ(0, model.AddVertex(vertex_at(0.0003f, 0.0f, 0.0f)));
+	EXPECT_EQ(1, model.AddVertex(vertex_at(0.0015f, 0.0f, 0.0f)));
+	EXPECT_EQ(2, model.GetVertexCount());
+}